@@ -0,0 +1,30 @@
+#pragma once
+
+// The ring of props around the big cube, kept out of gl_code.cpp so the host tests can
+// check where a prop lands against the cube.
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include "math/Matrix.hpp"
+
+/*
+ * count instance matrices, 16 floats each, for props a fifth of the cube's size circling
+ * it and turning with it. model is the cube's object to clip transform as it is uploaded:
+ * row vectors, v * model. A prop's matrix is local * model with its place on the ring in
+ * row 3 of local, stored as is, so the rows become the instance mat4's columns the same
+ * way GL_FALSE makes them the columns of the cube's uniform.
+ */
+inline void propRingMatrices( const mj2::Matrix4x4& model, uint32_t count, float* matrices ) {
+    const float scale = 0.2f;
+    const float radius = 0.75f;
+    for ( uint32_t i = 0; i < count; i++ ) {
+        const float angle = 6.2831853f * i / count;
+        mj2::Matrix4x4 local( scale,                   0.0f,                    0.0f,  0.0f,
+                              0.0f,                    scale,                   0.0f,  0.0f,
+                              0.0f,                    0.0f,                    scale, 0.0f,
+                              radius * cosf( angle ),  radius * sinf( angle ),  0.0f,  1.0f );
+        const mj2::Matrix4x4 world = local * model;
+        memcpy( &matrices[i * 16], &world.m[0][0], sizeof( world.m ) );
+    }
+}
@@ -25,6 +25,8 @@
 #include <stdlib.h>
 #include <math.h>
 #include "math/Matrix.hpp"
+#include "image/BmpLoader.hpp"
+#include "image/MappedFile.hpp"
 #include <android/bitmap.h>
 #include <android/log.h>
 
@@ -76,28 +78,6 @@ typedef struct TGAImage {
     GLuint texID;                   //  textures ID
 }TGAImage;
 
-typedef struct tagBITMAPFILEHEADER {
-    unsigned short bfType;
-    unsigned int bfSize;
-    unsigned short bfReserved1;
-    unsigned short bfReserved2;
-    unsigned int bfOffBits;
-} BITMAPFILEHEADER;
-
-typedef struct tagBITMAPINFOHEADER{
-    unsigned int biSize;
-    int biWidth;
-    int biHeight;
-    unsigned short biPlanes;
-    unsigned short biBitCount;
-    unsigned int biCompression;
-    unsigned int biSizeImage;
-    int biXPelsPerMeter;
-    int biYPelsPerMeter;
-    unsigned int biClrUsed;
-    unsigned int biClrImportant;
-} BITMAPINFOHEADER;
-
 /*
  * FBO
  */
@@ -108,43 +88,23 @@ GLuint framebuffersID;
  */
 bool LoadImage( TGAImage *texture, const char * fileName ) {
 
-    GLuint imageSize;
-    GLuint type=GL_RGB;
-    FILE *file;
-    file = fopen( fileName, "rb" );
-    if( file == NULL)
+    // the file is mapped copy-on-write and uploaded from the mapping, no heap copy
+    mj2::MappedFile file;
+    mj2::BmpImage image;
+    mj2::ImageStatus status = mj2::LoadBmp( fileName, file, image );
+    if( status != mj2::ImageStatus_Ok ) {
+        LOGE( "LoadImage %s: %s", fileName, mj2::ImageStatusString( status ) );
         return false;
-
-    fseek( file, 14, 0 );
-
-    LOGE( "Info BITMAPFILEHEADER %d ", sizeof(GLubyte) );
-
-    BITMAPINFOHEADER infoHead;
-    fread( &infoHead, sizeof(BITMAPINFOHEADER), 1, file );
-    texture->width = infoHead.biWidth;
-    texture->height = infoHead.biHeight;
-    imageSize = infoHead.biSizeImage;
-
-    LOGI( "Info Info " );
-    LOGE( "Info width %d ", infoHead.biWidth );
-    LOGE( "Info height %d ", texture->height );
-    LOGE( "Info imageSize %d ", imageSize );
-
-    texture->imageData = new GLubyte[imageSize];
-
-    fread( texture->imageData, sizeof(GLubyte), imageSize, file );
-
-    for( int i = 0; i < imageSize; i += 3 ) {
-        GLubyte temp = texture->imageData[i];
-        texture->imageData[i] = texture->imageData[i + 2];
-        texture->imageData[i + 2] = temp;
     }
 
-    LOGE( "Info R %d ", texture->imageData[0] );
-    LOGE( "Info G %d ", texture->imageData[1] );
-    LOGE( "Info B %d ", texture->imageData[2] );
+    texture->width = image.width;
+    texture->height = image.height;
+    texture->bpp = image.bitsPerPixel;
 
-    fclose( file );
+    LOGI( "LoadImage %s %dx%d %d bpp", fileName, image.width, image.height, image.bitsPerPixel );
+
+    mj2::ConvertBmpToGL( image );
+    const GLenum format = image.bitsPerPixel == 32 ? GL_RGBA : GL_RGB;
 
     //glGenFramebuffers(1, &framebuffersID);
     //glBindFramebuffer(GL_FRAMEBUFFER, framebuffersID);
@@ -156,7 +116,12 @@ bool LoadImage( TGAImage *texture, const char * fileName ) {
     glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT );
     glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT );
 
-    glTexImage2D( GL_TEXTURE_2D, 0, type, texture->width, texture->height, 0, type, GL_UNSIGNED_BYTE, texture->imageData );
+    // BMP rows are padded to 4 bytes, the same as GL's unpack alignment
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+    glTexImage2D( GL_TEXTURE_2D, 0, format, texture->width, texture->height, 0, format, GL_UNSIGNED_BYTE, image.pixels );
+
+    // GL has its own copy now, the mapping goes away with file
+    texture->imageData = NULL;
 
     /*
      * BFO
@@ -19,12 +19,26 @@
 #include <jni.h>
 #include <android/log.h>
 
+#include <EGL/egl.h>
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include "math/Matrix.hpp"
+#include "image/TextureCache.hpp"
+#include "image/PixelBufferPool.hpp"
+#include "image/TextureLoader.hpp"
+#include "image/ThreadPool.hpp"
+#include "math/Frustum.hpp"
+#include "PropRing.hpp"
+#include "render/CommandBuffer.hpp"
+#include "render/InstancedMesh.hpp"
+#include "render/MeshBuffer.hpp"
+#include "render/RenderQueue.hpp"
+#include "render/StateCache.hpp"
 #include <android/bitmap.h>
 #include <android/log.h>
 
@@ -44,6 +58,31 @@ static void checkGlError(const char* op) {
     }
 }
 
+// ES 3 core formats, not in the ES 2 headers
+#ifndef GL_COMPRESSED_RGB8_ETC2
+#define GL_COMPRESSED_RGB8_ETC2 0x9274
+#endif
+#ifndef GL_COMPRESSED_RGBA8_ETC2_EAC
+#define GL_COMPRESSED_RGBA8_ETC2_EAC 0x9278
+#endif
+
+/// whole-token match in GL_EXTENSIONS, a plain strstr would also hit longer names
+static bool hasGLExtension( const char* name ) {
+    const char* extensions = (const char*) glGetString( GL_EXTENSIONS );
+    const size_t length = strlen( name );
+    for ( const char* p = extensions; p && ( p = strstr( p, name ) ) != NULL; p += length ) {
+        if ( ( p == extensions || p[-1] == ' ' ) && ( p[length] == ' ' || p[length] == '\0' ) ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool isGLES3() {
+    const char* version = (const char*) glGetString( GL_VERSION );
+    return version && strncmp( version, "OpenGL ES 3", 11 ) == 0;
+}
+
 auto gVertexShader =
         "attribute vec4 vPosition;\n"
         "attribute vec4 a_color;\n"
@@ -68,6 +107,31 @@ auto gFragmentShader =
 
 //"  gl_FragColor = v_fragmentColor;\n"
 
+/*
+ * the props are the cube many times over, with the matrix per instance coming from
+ * an instanced attribute, or from a uniform array indexed by the copy's number
+ */
+auto gInstancedVertexShader =
+        "attribute vec4 vPosition;\n"
+        "attribute vec2 a_TextureCoordinates;\n"
+        "attribute mat4 a_InstanceMatrix;\n"
+        "varying vec2 v_TextureCoordinates;\n"
+        "void main() {\n"
+        "  v_TextureCoordinates = a_TextureCoordinates;\n"
+        "  gl_Position = a_InstanceMatrix * vPosition;\n"
+        "}\n";
+
+auto gPseudoInstancedVertexShader =
+        "attribute vec4 vPosition;\n"
+        "attribute vec2 a_TextureCoordinates;\n"
+        "attribute float a_InstanceId;\n"
+        "uniform mat4 u_InstanceMatrices[%u];\n"
+        "varying vec2 v_TextureCoordinates;\n"
+        "void main() {\n"
+        "  v_TextureCoordinates = a_TextureCoordinates;\n"
+        "  gl_Position = u_InstanceMatrices[int(a_InstanceId)] * vPosition;\n"
+        "}\n";
+
 typedef struct TGAImage {
     GLubyte *imageData;             //  image data
     GLuint bpp;                     //  rgb depth
@@ -76,28 +140,6 @@ typedef struct TGAImage {
     GLuint texID;                   //  textures ID
 }TGAImage;
 
-typedef struct tagBITMAPFILEHEADER {
-    unsigned short bfType;
-    unsigned int bfSize;
-    unsigned short bfReserved1;
-    unsigned short bfReserved2;
-    unsigned int bfOffBits;
-} BITMAPFILEHEADER;
-
-typedef struct tagBITMAPINFOHEADER{
-    unsigned int biSize;
-    int biWidth;
-    int biHeight;
-    unsigned short biPlanes;
-    unsigned short biBitCount;
-    unsigned int biCompression;
-    unsigned int biSizeImage;
-    int biXPelsPerMeter;
-    int biYPelsPerMeter;
-    unsigned int biClrUsed;
-    unsigned int biClrImportant;
-} BITMAPINFOHEADER;
-
 /*
  * FBO
  */
@@ -105,76 +147,253 @@ GLuint framebuffersID;
 GLuint depthBufferNameID;
 
 /*
- * read bmp image
+ * GL format of ETC blocks, if the context can take them; ETC1 needs the OES
+ * extension, ETC2 an ES 3 context
  */
-bool LoadImage( TGAImage *texture, const char * fileName ) {
+static bool getETCFormat( mj2::EtcFormat etcFormat, GLenum* format ) {
+    const bool es3 = isGLES3();
+    switch ( etcFormat ) {
+        case mj2::EtcFormat_ETC1:
+            if ( hasGLExtension( "GL_OES_compressed_ETC1_RGB8_texture" ) ) {
+                *format = GL_ETC1_RGB8_OES;
+                return true;
+            }
+            // ETC1 blocks are valid ETC2 RGB blocks, and a strict ES 3 driver rejects the OES enum
+            if ( es3 ) {
+                *format = GL_COMPRESSED_RGB8_ETC2;
+                return true;
+            }
+            LOGE( "no ETC1 support" );
+            return false;
+        case mj2::EtcFormat_ETC2_RGB:
+        case mj2::EtcFormat_ETC2_RGBA:
+            *format = etcFormat == mj2::EtcFormat_ETC2_RGB ? GL_COMPRESSED_RGB8_ETC2 : GL_COMPRESSED_RGBA8_ETC2_EAC;
+            if ( !es3 ) {
+                LOGE( "ETC2 needs OpenGL ES 3" );
+                return false;
+            }
+            return true;
+    }
+    return false;
+}
 
-    GLuint imageSize;
-    GLuint type=GL_RGB;
-    FILE *file;
-    file = fopen( fileName, "rb" );
-    if( file == NULL)
-        return false;
+/*
+ * GL side of the texture cache: creates, fills and deletes the texture objects,
+ * the cache decides which levels go up when
+ */
+class GLTextureBackend : public mj2::TextureBackend {
+public:
+    /*
+     * set when a texture was bound or deleted here, behind the render state cache
+     */
+    bool texturesChanged = false;
 
-    fseek( file, 14, 0 );
+    bool SupportsFormat( mj2::TextureFormat format ) override {
+        GLenum glFormat;
+        return !mj2::IsCompressedTextureFormat( format ) || getETCFormat( mj2::EtcFormatOf( format ), &glFormat );
+    }
 
-    LOGE( "Info BITMAPFILEHEADER %d ", sizeof(GLubyte) );
+    bool SupportsMipmaps( uint32_t width, uint32_t height ) override {
+        // ES 2 only repeats or mipmaps non power of two textures with GL_OES_texture_npot
+        const bool powerOfTwo = ( width & ( width - 1 ) ) == 0 && ( height & ( height - 1 ) ) == 0;
+        return powerOfTwo || hasGLExtension( "GL_OES_texture_npot" );
+    }
 
-    BITMAPINFOHEADER infoHead;
-    fread( &infoHead, sizeof(BITMAPINFOHEADER), 1, file );
-    texture->width = infoHead.biWidth;
-    texture->height = infoHead.biHeight;
-    imageSize = infoHead.biSizeImage;
+    uint32_t CreateTexture( mj2::TextureFormat format, uint32_t width, uint32_t height, uint32_t levelCount ) override {
+        LOGI( "CreateTexture %dx%d, format %d, %d levels", width, height, format, levelCount );
+
+        const bool fullNPOT = SupportsMipmaps( width, height );
+        GLuint texture = 0;
+        glGenTextures( 1, &texture );
+        glBindTexture( GL_TEXTURE_2D, texture );
+        texturesChanged = true;
+        glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR );
+        glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+        glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, fullNPOT ? GL_REPEAT : GL_CLAMP_TO_EDGE );
+        glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, fullNPOT ? GL_REPEAT : GL_CLAMP_TO_EDGE );
+        checkGlError( "CreateTexture" );
+        return texture;
+    }
 
-    LOGI( "Info Info " );
-    LOGE( "Info width %d ", infoHead.biWidth );
-    LOGE( "Info height %d ", texture->height );
-    LOGE( "Info imageSize %d ", imageSize );
+    /*
+     * level data comes straight from the file mapping or the mip chain, GL copies it
+     * before this returns
+     */
+    void UploadLevel( uint32_t texture, mj2::TextureFormat format, const mj2::TextureLevel& level, uint32_t glLevel ) override {
+        glBindTexture( GL_TEXTURE_2D, texture );
+        texturesChanged = true;
+        if ( mj2::IsCompressedTextureFormat( format ) ) {
+            GLenum glFormat;
+            getETCFormat( mj2::EtcFormatOf( format ), &glFormat );
+            glCompressedTexImage2D( GL_TEXTURE_2D, glLevel, glFormat, level.width, level.height, 0, (GLsizei) level.size, level.data );
+        } else {
+            // rows are padded to 4 bytes, the same as GL's unpack alignment
+            const GLenum glFormat = format == mj2::TextureFormat_RGBA8 ? GL_RGBA : GL_RGB;
+            glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+            glTexImage2D( GL_TEXTURE_2D, glLevel, glFormat, level.width, level.height, 0, glFormat, GL_UNSIGNED_BYTE, level.data );
+        }
+        checkGlError( "UploadLevel" );
+    }
 
-    texture->imageData = new GLubyte[imageSize];
+    void DeleteTexture( uint32_t texture ) override {
+        GLuint name = texture;
+        glDeleteTextures( 1, &name );
+        texturesChanged = true;
+    }
+};
 
-    fread( texture->imageData, sizeof(GLubyte), imageSize, file );
+/*
+ * GL side of the render library, one GL call per method
+ */
+class GLRenderBackend : public mj2::RenderBackend {
+public:
+    typedef void (*VertexAttribDivisorFunc)( GLuint index, GLuint divisor );
+    typedef void (*DrawElementsInstancedFunc)( GLenum mode, GLsizei count, GLenum type, const void* indices,
+                                               GLsizei instanceCount );
 
-    for( int i = 0; i < imageSize; i += 3 ) {
-        GLubyte temp = texture->imageData[i];
-        texture->imageData[i] = texture->imageData[i + 2];
-        texture->imageData[i + 2] = temp;
+    VertexAttribDivisorFunc vertexAttribDivisor = NULL;
+    DrawElementsInstancedFunc drawElementsInstanced = NULL;
+
+    /*
+     * instancing is core in ES 3 and an extension in ES 2, the entry points belong
+     * to the context, so they are looked up again for every new one
+     */
+    void loadInstancing() {
+        static const char* const kEntryPoints[][3] = {
+            { NULL, "glVertexAttribDivisor", "glDrawElementsInstanced" },
+            { "GL_EXT_instanced_arrays", "glVertexAttribDivisorEXT", "glDrawElementsInstancedEXT" },
+            { "GL_ANGLE_instanced_arrays", "glVertexAttribDivisorANGLE", "glDrawElementsInstancedANGLE" } };
+        vertexAttribDivisor = NULL;
+        drawElementsInstanced = NULL;
+        for ( const auto& entry : kEntryPoints ) {
+            if ( entry[0] ? !hasGLExtension( entry[0] ) : !isGLES3() ) {
+                continue;
+            }
+            vertexAttribDivisor = (VertexAttribDivisorFunc) eglGetProcAddress( entry[1] );
+            drawElementsInstanced = (DrawElementsInstancedFunc) eglGetProcAddress( entry[2] );
+            if ( vertexAttribDivisor && drawElementsInstanced ) {
+                LOGI( "instancing through %s", entry[1] );
+                return;
+            }
+        }
+        vertexAttribDivisor = NULL;
+        drawElementsInstanced = NULL;
+        LOGI( "no instanced arrays, props are pseudo instanced" );
     }
 
-    LOGE( "Info R %d ", texture->imageData[0] );
-    LOGE( "Info G %d ", texture->imageData[1] );
-    LOGE( "Info B %d ", texture->imageData[2] );
+    static GLenum bufferTarget( mj2::BufferTarget target ) {
+        return target == mj2::BufferTarget_Index ? GL_ELEMENT_ARRAY_BUFFER : GL_ARRAY_BUFFER;
+    }
 
-    fclose( file );
+    static GLenum primitiveMode( mj2::PrimitiveType primitive ) {
+        switch ( primitive ) {
+            case mj2::PrimitiveType_TriangleStrip: return GL_TRIANGLE_STRIP;
+            case mj2::PrimitiveType_Lines: return GL_LINES;
+            case mj2::PrimitiveType_Points: return GL_POINTS;
+            default: return GL_TRIANGLES;
+        }
+    }
 
-    //glGenFramebuffers(1, &framebuffersID);
-    //glBindFramebuffer(GL_FRAMEBUFFER, framebuffersID);
+    uint32_t CreateBuffer() override {
+        GLuint buffer = 0;
+        glGenBuffers( 1, &buffer );
+        return buffer;
+    }
 
-    glGenTextures( 1, &texture->texID );
-    glBindTexture( GL_TEXTURE_2D, texture->texID );
-    glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
-    glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-    glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT );
-    glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT );
+    void DeleteBuffer( uint32_t buffer ) override {
+        GLuint name = buffer;
+        glDeleteBuffers( 1, &name );
+    }
 
-    glTexImage2D( GL_TEXTURE_2D, 0, GL_RGB, texture->width, texture->height, 0, GL_RGB, GL_UNSIGNED_BYTE, texture->imageData );
+    void BindBuffer( mj2::BufferTarget target, uint32_t buffer ) override {
+        glBindBuffer( bufferTarget( target ), buffer );
+    }
 
-    /*
-     * FBO
-     */
-    //glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture->texID, 0);
-    //glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    //if( glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE ) {
-    //    LOGE("glCheckFramebufferStatus ERROR!");
-    //    return false;
-    //}
-    //glTexImage2D( GL_TEXTURE_2D, 0, type, texture->width, texture->height, 0, type, GL_UNSIGNED_BYTE, texture->imageData );
-    //glBindTexture( GL_TEXTURE_2D, 0);
-    //glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    void BufferData( mj2::BufferTarget target, size_t size, const void* data, mj2::BufferUsage usage ) override {
+        const GLenum glUsage = usage == mj2::BufferUsage_Static ? GL_STATIC_DRAW :
+                               usage == mj2::BufferUsage_Dynamic ? GL_DYNAMIC_DRAW : GL_STREAM_DRAW;
+        glBufferData( bufferTarget( target ), (GLsizeiptr) size, data, glUsage );
+        checkGlError( "glBufferData" );
+    }
 
-    return true;
+    void BufferSubData( mj2::BufferTarget target, size_t offset, size_t size, const void* data ) override {
+        glBufferSubData( bufferTarget( target ), (GLintptr) offset, (GLsizeiptr) size, data );
+    }
 
-}
+    void VertexAttribPointer( uint32_t location, uint32_t components, mj2::AttributeFormat format, uint32_t stride,
+                              size_t offset ) override {
+        // with a buffer bound the pointer argument is an offset into it
+        const GLenum type = format == mj2::AttributeFormat_Float ? GL_FLOAT :
+                            format == mj2::AttributeFormat_UByteNormalized ? GL_UNSIGNED_BYTE : GL_SHORT;
+        glVertexAttribPointer( location, components, type, format != mj2::AttributeFormat_Float, stride,
+                               (const void*) offset );
+    }
+
+    void EnableVertexAttribArray( uint32_t location ) override {
+        glEnableVertexAttribArray( location );
+    }
+
+    void DisableVertexAttribArray( uint32_t location ) override {
+        glDisableVertexAttribArray( location );
+    }
+
+    void UseProgram( uint32_t program ) override {
+        glUseProgram( program );
+    }
+
+    void Uniform1i( int32_t location, int32_t value ) override {
+        glUniform1i( location, value );
+    }
+
+    void Uniform4fv( int32_t location, uint32_t count, const float* values ) override {
+        glUniform4fv( location, count, values );
+    }
+
+    void UniformMatrix4fv( int32_t location, uint32_t count, const float* values ) override {
+        glUniformMatrix4fv( location, count, GL_FALSE, values );
+    }
+
+    void ActiveTexture( uint32_t unit ) override {
+        glActiveTexture( GL_TEXTURE0 + unit );
+    }
+
+    void BindTexture( uint32_t texture ) override {
+        glBindTexture( GL_TEXTURE_2D, texture );
+    }
+
+    void BindFramebuffer( uint32_t framebuffer ) override {
+        glBindFramebuffer( GL_FRAMEBUFFER, framebuffer );
+    }
+
+    void FramebufferColorTexture( uint32_t texture ) override {
+        glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0 );
+    }
+
+    void FramebufferDepthRenderbuffer( uint32_t renderbuffer ) override {
+        glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffer );
+    }
+
+    void DrawArrays( mj2::PrimitiveType primitive, uint32_t first, uint32_t count ) override {
+        glDrawArrays( primitiveMode( primitive ), first, count );
+    }
+
+    void DrawElements( mj2::PrimitiveType primitive, uint32_t count, size_t offset ) override {
+        glDrawElements( primitiveMode( primitive ), count, GL_UNSIGNED_SHORT, (const void*) offset );
+    }
+
+    bool SupportsInstancing() override {
+        return vertexAttribDivisor && drawElementsInstanced;
+    }
+
+    void VertexAttribDivisor( uint32_t location, uint32_t divisor ) override {
+        vertexAttribDivisor( location, divisor );
+    }
+
+    void DrawElementsInstanced( mj2::PrimitiveType primitive, uint32_t count, size_t offset,
+                                uint32_t instanceCount ) override {
+        drawElementsInstanced( primitiveMode( primitive ), count, GL_UNSIGNED_SHORT, (const void*) offset, instanceCount );
+    }
+};
 
 GLuint loadShader( GLenum shaderType, const char* pSource ) {
     GLuint shader = glCreateShader( shaderType );
@@ -253,17 +472,172 @@ mj2::Matrix4x4 modelMatrix;
 mj2::Matrix4x4 rotationMatrix;
 TGAImage texture2d;
 
+/*
+ * textures are mapped and converted on loader threads, the GL thread only uploads
+ * them, for at most kUploadBudgetMs per frame; the cache keeps them under budget
+ */
+const double kUploadBudgetMs = 2.0;
+const mj2::TextureCacheBudget kTextureBudget = { 32u << 20, 16u << 20 };
+
+/*
+ * lena is tried as the pre-baked container first, then as ETC1 blocks and
+ * last as the bitmap, which every device can upload
+ */
+const char* kLenaSources[] = { "/sdcard/lena512.mj2t", "/sdcard/lena512.pkm", "/sdcard/lena512.bmp" };
+const size_t kLenaSourceCount = sizeof( kLenaSources ) / sizeof( kLenaSources[0] );
+const size_t kLenaPkm = 1;
+size_t gLenaSource = 0;
+mj2::TextureId gLena = 0;
+bool gTextureRenderable = false;
+mj2::ThreadPool* gLoaderThreads = NULL;
+/*
+ * mip levels built on the loader threads are staged in pooled buffers, retained up
+ * to the cache's staging budget, instead of a malloc and free per texture
+ */
+mj2::PixelBufferPool* gPixelBuffers = NULL;
+mj2::TextureLoader* gTextureLoader = NULL;
+GLTextureBackend gTextureBackend;
+mj2::TextureCache* gTextureCache = NULL;
+GLRenderBackend gRenderBackend;
+/*
+ * frame state goes through the cache, which drops the calls that change nothing;
+ * the counts are logged every kStateStatsFrames frames
+ */
+mj2::StateCache gRenderState( gRenderBackend );
+const int kStateStatsFrames = 600;
+int gFrameCount = 0;
+/*
+ * the frame is recorded on the loader threads, a command buffer per part, and
+ * replayed into the state cache on this thread, in order
+ */
+const size_t kFrameParts = 2;
+mj2::CommandBuffer gFrameCommands[kFrameParts];
+/*
+ * draws are sorted by state and merged where their index ranges meet
+ */
+mj2::RenderQueue gRenderQueue( gFrameCommands[0] );
+mj2::RenderProgram gCubeProgram;
+mj2::MeshBuffer* gCubeMesh = NULL;
+/*
+ * a ring of small cubes around the big one, drawn as instances of one mesh
+ */
+const uint32_t kPropCount = 64;
+mj2::InstancedMesh* gPropMesh = NULL;
+mj2::InstancingProgram gPropProgram;
+uint32_t gPropBatch = 0;
+GLfloat gPropMatrices[kPropCount * 16];
+
+void requestLena( size_t source ) {
+    // ETC1 is 4 bits per texel against 24, but it needs the extension or ES 3
+    GLenum etcFormat;
+    if ( source == kLenaPkm && !getETCFormat( mj2::EtcFormat_ETC1, &etcFormat ) ) {
+        source++;
+    }
+    gLenaSource = source;
+    gLena = gTextureCache->Acquire( kLenaSources[source] );
+}
+
+/*
+ * follow the cache: the next source when lena failed, and a new texture name and
+ * size when its full resolution replaces the preview
+ */
+void updateLena() {
+    if ( gTextureCache->State( gLena ) == mj2::TextureState_Failed && gLenaSource + 1 < kLenaSourceCount ) {
+        // missing, corrupt or not supported on this device, try the next one
+        LOGE( "texture %s failed", kLenaSources[gLenaSource] );
+        gTextureCache->Release( gLena );
+        requestLena( gLenaSource + 1 );
+    }
+
+    const GLuint texID = gTextureCache->Texture( gLena );
+    if ( texID == texture2d.texID ) {
+        return;
+    }
+    texture2d.texID = texID;
+    texture2d.imageData = NULL;
+    if ( texID == 0 ) {
+        return;
+    }
+
+    uint32_t width, height;
+    mj2::TextureFormat format;
+    gTextureCache->Info( gLena, width, height, format );
+    gTextureCache->TextureSize( gLena, texture2d.width, texture2d.height );
+    texture2d.bpp = format == mj2::TextureFormat_RGBA8 ? 32 : format == mj2::TextureFormat_RGB8 ? 24 :
+                    format == mj2::TextureFormat_ETC2_RGBA ? 8 : 4;
+
+    // compressed textures are not color-renderable
+    gTextureRenderable = !mj2::IsCompressedTextureFormat( format );
+    if ( gTextureRenderable ) {
+        // the depth buffer is attached next to the texture, so it needs the texture's size
+        glBindRenderbuffer( GL_RENDERBUFFER, depthBufferNameID );
+        glRenderbufferStorage( GL_RENDERBUFFER, GL_DEPTH_COMPONENT32_OES, texture2d.width, texture2d.height );
+    }
+}
+
+/*
+ * the instancing program the context can run; the pseudo instancing array is as long
+ * as the vertex uniforms allow, the matrices take 4 vectors each
+ */
+bool createPropProgram() {
+    const bool hardware = mj2::InstancedMesh::ModeFor( gRenderState ) == mj2::InstancingMode_Hardware;
+    GLuint program;
+    gPropBatch = 0;
+    if ( hardware ) {
+        program = createProgram( gInstancedVertexShader, gFragmentShader );
+    } else {
+        GLint maxVectors = 0;
+        glGetIntegerv( GL_MAX_VERTEX_UNIFORM_VECTORS, &maxVectors );
+        gPropBatch = mj2::PseudoInstancingBatchSize( (uint32_t) maxVectors, 4 );
+        if ( gPropBatch > kPropCount ) {
+            gPropBatch = kPropCount;
+        }
+        char source[512];
+        snprintf( source, sizeof( source ), gPseudoInstancedVertexShader, gPropBatch );
+        program = gPropBatch ? createProgram( source, gFragmentShader ) : 0;
+    }
+    gPropProgram.program = program;
+    if ( !program ) {
+        return false;
+    }
+
+    gPropProgram.textureLocation = glGetUniformLocation( program, "u_TextureUnit" );
+    gPropProgram.attributeLocations[0] = glGetAttribLocation( program, "vPosition" );
+    gPropProgram.attributeLocations[1] = -1;
+    gPropProgram.attributeLocations[2] = glGetAttribLocation( program, "a_TextureCoordinates" );
+    gPropProgram.instanceMatrixLocation = hardware ? glGetAttribLocation( program, "a_InstanceMatrix" ) : -1;
+    gPropProgram.instanceIdLocation = hardware ? -1 : glGetAttribLocation( program, "a_InstanceId" );
+    gPropProgram.instanceArrayLocation = hardware ? -1 : glGetUniformLocation( program, "u_InstanceMatrices" );
+    checkGlError( "createPropProgram" );
+    LOGI( "props: %s instancing, batch %u", hardware ? "hardware" : "pseudo", gPropBatch );
+    return true;
+}
+
 bool setupGraphics( int w, int h ) {
 
-    if ( LoadImage( &texture2d, "/sdcard/lena512.bmp" ) == false ) {
-        LOGE("INFO : ERROR!");
+    if ( !gTextureCache ) {
+        gLoaderThreads = new mj2::ThreadPool( 2 );
+        gPixelBuffers = new mj2::PixelBufferPool( kTextureBudget.stagingBytes );
+        gTextureLoader = new mj2::TextureLoader( *gLoaderThreads, gPixelBuffers );
+        gTextureCache = new mj2::TextureCache( *gTextureLoader, gTextureBackend, kTextureBudget );
+        gCubeMesh = new mj2::MeshBuffer( gRenderState );
+        gPropMesh = new mj2::InstancedMesh( gRenderState );
+    } else {
+        // a new surface means a new context, the old textures and buffers are gone
+        gTextureCache->InvalidateAll();
+        gCubeMesh->Invalidate();
+        gPropMesh->Invalidate();
+    }
+    gRenderState.Invalidate();
+    texture2d.texID = 0;
+    if ( !gLena ) {
+        requestLena( 0 );
     }
 
     glGenFramebuffers(1, &framebuffersID);
     glBindFramebuffer(GL_FRAMEBUFFER, framebuffersID);
     glGenRenderbuffers(1, &depthBufferNameID);
-    glBindRenderbuffer(GL_RENDERBUFFER, depthBufferNameID);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT32_OES, texture2d.width, texture2d.height);
+    // storage is allocated in updateLena, once the texture size is known
 
     modelMatrix.SetIdentity();
     rotationMatrix.SetIdentity();
@@ -273,6 +647,10 @@ bool setupGraphics( int w, int h ) {
     printGLString( "Vendor", GL_VENDOR );
     printGLString( "Renderer", GL_RENDERER );
     printGLString( "Extensions", GL_EXTENSIONS );
+    gRenderBackend.loadInstancing();
+    for ( mj2::CommandBuffer& commands : gFrameCommands ) {
+        commands.SetSupportsInstancing( gRenderBackend.SupportsInstancing() );
+    }
 
     LOGI( "setupGraphics(%d, %d)", w, h );
     gProgram = createProgram( gVertexShader, gFragmentShader );
@@ -305,6 +683,19 @@ bool setupGraphics( int w, int h ) {
     LOGI( "glGetUniformLocation(\"u_TextureUnit\") = %d\n",
          u_TextureUnit );
 
+    // attributes in the order of the cube's vertex layout
+    gCubeProgram.program = gProgram;
+    gCubeProgram.transformLocation = (int32_t) rotationMatrixUniform;
+    gCubeProgram.textureLocation = (int32_t) u_TextureUnit;
+    gCubeProgram.attributeLocations[0] = (int32_t) vPosition;
+    gCubeProgram.attributeLocations[1] = (int32_t) a_color;
+    gCubeProgram.attributeLocations[2] = (int32_t) a_TextureCoordinates;
+
+    // the props are optional, the big cube is drawn without them
+    if ( !createPropProgram() ) {
+        LOGE( "Could not create the prop program." );
+    }
+
     glViewport( 0, 0, w, h );
     checkGlError( "glViewport" );
 
@@ -408,50 +799,163 @@ const GLfloat gTriangleColors[] = {     0.583f, 0.771f, 0.014f, 1.0f,
                                         0.820f, 0.883f, 0.371f, 1.0f,
                                         0.982f, 0.099f, 0.879f, 1.0f };
 
+// bounding sphere of the cube around its origin, half extent 0.25
+const float gCubeBoundingRadius = 0.4330127f;
+
+struct CubeVertex {
+    GLfloat position[4];
+    GLfloat color[4];
+    GLfloat uv[2];
+};
+
+/*
+ * the 36 corners above as an indexed mesh: the two corners each face repeats become
+ * one vertex, keeping the first one's color (the shader does not read it), 24 in all
+ */
+bool createCubeMesh() {
+    CubeVertex vertices[36];
+    GLushort indices[36];
+    GLushort vertexCount = 0;
+    for ( int i = 0; i < 36; i++ ) {
+        const GLfloat* position = &gTriangleVertices[i * 4];
+        const GLfloat* uv = &textureArrays[i * 2];
+        GLushort index = 0;
+        while ( index < vertexCount && ( memcmp( vertices[index].position, position, sizeof( vertices[index].position ) ) != 0 ||
+                                         memcmp( vertices[index].uv, uv, sizeof( vertices[index].uv ) ) != 0 ) ) {
+            index++;
+        }
+        if ( index == vertexCount ) {
+            memcpy( vertices[index].position, position, sizeof( vertices[index].position ) );
+            memcpy( vertices[index].color, &gTriangleColors[i * 4], sizeof( vertices[index].color ) );
+            memcpy( vertices[index].uv, uv, sizeof( vertices[index].uv ) );
+            vertexCount++;
+        }
+        indices[i] = index;
+    }
+
+    const mj2::VertexLayout layout = { sizeof( CubeVertex ), 3, {
+        { 4, mj2::AttributeFormat_Float, offsetof( CubeVertex, position ) },
+        { 4, mj2::AttributeFormat_Float, offsetof( CubeVertex, color ) },
+        { 2, mj2::AttributeFormat_Float, offsetof( CubeVertex, uv ) } } };
+    if ( !gCubeMesh->Create( layout, vertices, vertexCount, indices, 36, mj2::BufferUsage_Static ) ) {
+        LOGE( "Could not create the cube mesh" );
+        return false;
+    }
+    LOGI( "cube mesh: %d vertices, %d indices, %zu bytes", vertexCount, 36, gCubeMesh->Bytes() );
+
+    if ( gPropProgram.program ) {
+        const mj2::InstancingMode mode = mj2::InstancedMesh::ModeFor( gRenderState );
+        if ( !gPropMesh->Create( mode, gPropBatch, layout, vertices, vertexCount, indices, 36 ) ) {
+            LOGE( "Could not create the prop mesh" );
+        } else {
+            LOGI( "prop mesh: %zu bytes", gPropMesh->Bytes() );
+        }
+    }
+    return true;
+}
+
+/*
+ * the big cube, culled and queued, recorded into gFrameCommands[0]
+ */
+void recordCube() {
+    // modelMatrix is the whole object to clip transform, so its planes are in object space
+    const mj2::Frustum frustum = mj2::Frustum::FromMatrix( modelMatrix );
+    if ( frustum.TestSphere( 0.0f, 0.0f, 0.0f, gCubeBoundingRadius ) ) {
+        mj2::DrawItem cube;
+        cube.framebuffer = gTextureRenderable ? framebuffersID : 0;
+        cube.program = &gCubeProgram;
+        cube.texture = texture2d.texID;
+        cube.mesh = gCubeMesh;
+        cube.part = 0;
+        cube.firstIndex = 0;
+        cube.indexCount = gCubeMesh->IndexCount();
+        cube.transform = &modelMatrix.m[0][0];
+        cube.key = mj2::MakeSortKey( 0, cube.framebuffer, gProgram, cube.texture, 0 );
+        gRenderQueue.Submit( cube );
+    }
+    gRenderQueue.Flush();
+}
+
+/*
+ * the props circle the big cube, see PropRing.hpp
+ */
+void recordProps( mj2::RenderBackend& commands ) {
+    if ( !gPropMesh->IsValid() ) {
+        return;
+    }
+    propRingMatrices( modelMatrix, kPropCount, gPropMatrices );
+    gPropMesh->Draw( commands, gPropProgram, texture2d.texID, gPropMatrices, kPropCount );
+}
+
 void renderFrame() {
 
-    glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture2d.texID, 0 );
-    glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBufferNameID );
-    //glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glBindFramebuffer( GL_FRAMEBUFFER, framebuffersID );
+    gTextureCache->Update( kUploadBudgetMs );
+    updateLena();
+    if ( gTextureBackend.texturesChanged ) {
+        gRenderState.InvalidateTextures();
+        gTextureBackend.texturesChanged = false;
+    }
+
+    if ( ++gFrameCount % kStateStatsFrames == 0 ) {
+        const mj2::StateCacheStats& stats = gRenderState.Stats();
+        LOGI( "state calls over %d frames: %llu issued, %llu elided; last frame %u items in %u draws, %u props in %u",
+              kStateStatsFrames, (unsigned long long) stats.issued, (unsigned long long) stats.elided,
+              gRenderQueue.Stats().submitted, gRenderQueue.Stats().draws, kPropCount, gPropMesh->Draws() );
+        gRenderState.ResetStats();
+
+        const mj2::PixelBufferPoolStats staging = gPixelBuffers->Stats();
+        LOGI( "staging buffers: %zu KB in use, peak %zu KB, %zu KB footprint peak, %llu of %llu reused",
+              staging.inUseBytes >> 10, staging.peakInUseBytes >> 10, staging.peakTotalBytes >> 10,
+              (unsigned long long) staging.reuses, (unsigned long long) staging.acquires );
+    }
+
+    // the framebuffer renders into the texture, nothing to do until it is uploaded
+    if ( texture2d.texID == 0 ) {
+        gRenderState.BindFramebuffer( 0 );
+        glClearColor( 1.0f,  1.0f,  1.0f, 1.0f );
+        glClear( GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT );
+        return;
+    }
+
+    // compressed textures are not color-renderable, those are drawn straight to the screen;
+    // attachments go to the bound framebuffer, so bind it first
+    if ( gTextureRenderable ) {
+        gRenderState.BindFramebuffer( framebuffersID );
+        gRenderState.FramebufferColorTexture( texture2d.texID );
+        gRenderState.FramebufferDepthRenderbuffer( depthBufferNameID );
+    } else {
+        gRenderState.BindFramebuffer( 0 );
+    }
 
     glClearColor( 1.0f,  1.0f,  1.0f, 1.0f );
     checkGlError( "glClearColor" );
     glClear( GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT );
     checkGlError( "glClear" );
 
-    glUseProgram( gProgram );
-    checkGlError( "glUseProgram" );
-
-    glVertexAttribPointer( vPosition, 4, GL_FLOAT, GL_FALSE, 0, gTriangleVertices );
-    checkGlError( "glVertexAttribPointer" );
-    glEnableVertexAttribArray( vPosition );
-    checkGlError( "glEnableVertexAttribArray" );
-
-    glVertexAttribPointer( a_color, 4, GL_FLOAT, GL_FALSE, 0, gTriangleColors );
-    checkGlError( "glVertexAttribPointer" );
-    glEnableVertexAttribArray( a_color );
-    checkGlError( "glEnableVertexAttribArray" );
+    // the cube lives in a VBO / IBO, uploaded the first time it is drawn on a context
+    if ( !gCubeMesh->IsValid() && !createCubeMesh() ) {
+        return;
+    }
 
     // set the roatation uniform
     modelMatrix = rotationMatrix * modelMatrix;
 
-    glUniformMatrix4fv( rotationMatrixUniform, 1, GL_FALSE, &modelMatrix.m[0][0] );
-    checkGlError( "glUniformMatrix4fv" );
-
-    // Texture
-    glActiveTexture( GL_TEXTURE0 );
-    glBindTexture( GL_TEXTURE_2D, texture2d.texID );
-    glUniform1i( u_TextureUnit, 0 );
-
-    glVertexAttribPointer( a_TextureCoordinates, 2, GL_FLOAT, GL_FALSE, 0, textureArrays );
-    checkGlError( "glVertexAttribPointer" );
-    glEnableVertexAttribArray( a_TextureCoordinates );
-    checkGlError( "glEnableVertexAttribArray" );
-
-    glDrawArrays( GL_TRIANGLES, 0, 36 );
-
-    checkGlError( "glDrawArrays" );
+    // the loader threads only read the frame's state, GL calls stay on this thread;
+    // while they are busy loading this thread records the parts itself
+    gLoaderThreads->ParallelFor( kFrameParts, 1, []( size_t begin, size_t end ) {
+        for ( size_t part = begin; part < end; part++ ) {
+            if ( part == 0 ) {
+                recordCube();
+            } else {
+                recordProps( gFrameCommands[part] );
+            }
+        }
+    } );
+    for ( mj2::CommandBuffer& commands : gFrameCommands ) {
+        commands.Execute( gRenderState );
+        commands.Clear();
+    }
+    checkGlError( "CommandBuffer::Execute" );
 
 }
 
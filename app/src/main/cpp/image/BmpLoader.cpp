@@ -0,0 +1,178 @@
+#include "BmpLoader.hpp"
+
+#include <algorithm>
+
+#include "MappedFile.hpp"
+#include "PixelConvert.hpp"
+
+namespace mj2
+{
+    /////
+    // Headers are read field by field in little endian instead of casting to structs,
+    // BITMAPFILEHEADER is 14 bytes and would be padded by the compiler.
+    //
+    //   file header   0 bfType 'BM', 2 bfSize, 6 reserved, 10 bfOffBits
+    //   info header  14 biSize, 18 biWidth, 22 biHeight, 26 biPlanes, 28 biBitCount,
+    //                30 biCompression, 34 biSizeImage, ... 54 channel masks (BI_BITFIELDS)
+    /////
+    static const size_t kFileHeaderSize = 14;
+    static const size_t kInfoHeaderSize = 40;
+    static const size_t kMasksOffset = kFileHeaderSize + kInfoHeaderSize;
+
+    enum BmpCompression
+    {
+        BmpCompression_RGB = 0,
+        BmpCompression_BitFields = 3,
+        BmpCompression_AlphaBitFields = 6
+    };
+
+    static inline uint16_t ReadU16(const uint8_t* p)
+    {
+        return (uint16_t)(p[0] | (p[1] << 8));
+    }
+
+    static inline uint32_t ReadU32(const uint8_t* p)
+    {
+        return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+    static inline int32_t ReadS32(const uint8_t* p)
+    {
+        return (int32_t)ReadU32(p);
+    }
+
+    /// 32 bit bitfields are only accepted in the BGRA byte order BI_RGB uses
+    static ImageStatus ParseMasks(const uint8_t* data, size_t size, uint32_t infoSize, uint32_t compression, bool& hasAlpha)
+    {
+        hasAlpha = false;
+        if (compression == BmpCompression_RGB) {
+            return ImageStatus_Ok;
+        }
+
+        // alpha mask is part of V3+ headers, or follows the colour masks for BI_ALPHABITFIELDS
+        const bool alphaMask = infoSize >= 56 || compression == BmpCompression_AlphaBitFields;
+        const size_t masksEnd = kMasksOffset + (alphaMask ? 16 : 12);
+        if (masksEnd > size) {
+            return ImageStatus_Truncated;
+        }
+
+        const uint8_t* masks = data + kMasksOffset;
+        if (ReadU32(masks + 0) != 0x00FF0000u || ReadU32(masks + 4) != 0x0000FF00u || ReadU32(masks + 8) != 0x000000FFu) {
+            return ImageStatus_Unsupported;
+        }
+        if (alphaMask) {
+            const uint32_t alpha = ReadU32(masks + 12);
+            if (alpha != 0 && alpha != 0xFF000000u) {
+                return ImageStatus_Unsupported;
+            }
+            hasAlpha = alpha != 0;
+        }
+        return ImageStatus_Ok;
+    }
+
+    ImageStatus ParseBmp(uint8_t* data, size_t size, BmpImage& image)
+    {
+        if (size < kFileHeaderSize + kInfoHeaderSize) {
+            return ImageStatus_Truncated;
+        }
+        if (data[0] != 'B' || data[1] != 'M') {
+            return ImageStatus_BadSignature;
+        }
+
+        const uint32_t pixelOffset = ReadU32(data + 10);
+        const uint8_t* info = data + kFileHeaderSize;
+        const uint32_t infoSize = ReadU32(info + 0);
+        const int32_t width = ReadS32(info + 4);
+        const int32_t height = ReadS32(info + 8);
+        const uint16_t planes = ReadU16(info + 12);
+        const uint16_t bitCount = ReadU16(info + 14);
+        const uint32_t compression = ReadU32(info + 16);
+        const uint32_t sizeImage = ReadU32(info + 20);
+
+        // BITMAPCOREHEADER (12 bytes) and other pre-Windows 3 variants are not supported
+        if (infoSize < kInfoHeaderSize) {
+            return ImageStatus_Unsupported;
+        }
+        if (width <= 0 || height == 0 || height == INT32_MIN || planes != 1) {
+            return ImageStatus_BadHeader;
+        }
+        if ((uint64_t)kFileHeaderSize + infoSize > pixelOffset) {
+            return ImageStatus_BadHeader;
+        }
+
+        bool hasAlpha = false;
+        if (bitCount == 24 && compression == BmpCompression_RGB) {
+            hasAlpha = false;
+        } else if (bitCount == 32 && (compression == BmpCompression_RGB || compression == BmpCompression_BitFields || compression == BmpCompression_AlphaBitFields)) {
+            const ImageStatus status = ParseMasks(data, size, infoSize, compression, hasAlpha);
+            if (status != ImageStatus_Ok) {
+                return status;
+            }
+        } else {
+            // palettes, 16 bit and RLE
+            return ImageStatus_Unsupported;
+        }
+
+        // rows are padded to 4 bytes; 64 bit math so huge dimensions cannot wrap
+        const uint64_t rows = height < 0 ? (uint64_t)(-(int64_t)height) : (uint64_t)height;
+        if ((uint64_t)width > MaxImageDimension || rows > MaxImageDimension) {
+            return ImageStatus_Unsupported;
+        }
+        const uint64_t rowStride = (((uint64_t)width * bitCount + 31) / 32) * 4;
+        const uint64_t pixelBytes = rowStride * rows;
+
+        // biSizeImage may be 0 for BI_RGB, a non-zero value must at least cover the pixels
+        if (sizeImage != 0 && sizeImage < pixelBytes) {
+            return ImageStatus_BadHeader;
+        }
+        if ((uint64_t)pixelOffset + pixelBytes > size) {
+            return ImageStatus_Truncated;
+        }
+
+        image.pixels = data + pixelOffset;
+        image.width = (uint32_t)width;
+        image.height = (uint32_t)rows;
+        image.bitsPerPixel = bitCount;
+        image.rowStride = (size_t)rowStride;
+        image.bottomUp = height > 0;
+        image.hasAlpha = hasAlpha;
+        return ImageStatus_Ok;
+    }
+
+    ImageStatus LoadBmp(const char* path, MappedFile& file, BmpImage& image)
+    {
+        const ImageStatus status = file.Open(path);
+        if (status != ImageStatus_Ok) {
+            return status;
+        }
+        return ParseBmp(file.Data(), file.Size(), image);
+    }
+
+    void ConvertBmpToGL(BmpImage& image)
+    {
+        SwizzleBmpToRGB(image);
+        FlipBmpToBottomUp(image);
+    }
+
+    void SwizzleBmpToRGB(BmpImage& image)
+    {
+        if (image.bitsPerPixel == 24) {
+            ConvertBGRToRGB(image.pixels, image.rowStride, image.pixels, image.rowStride, image.width, image.height);
+        } else {
+            ConvertBGRAToRGBA(image.pixels, image.rowStride, image.pixels, image.rowStride, image.width, image.height, image.hasAlpha);
+        }
+    }
+
+    void FlipBmpToBottomUp(BmpImage& image)
+    {
+        if (!image.bottomUp) {
+            const size_t rowBytes = (size_t)image.width * (image.bitsPerPixel / 8);
+            for (uint32_t y = 0; y < image.height / 2; y++) {
+                uint8_t* top = image.pixels + y * image.rowStride;
+                uint8_t* bottom = image.pixels + (image.height - 1 - y) * image.rowStride;
+                std::swap_ranges(top, top + rowBytes, bottom);
+            }
+            image.bottomUp = true;
+        }
+    }
+}
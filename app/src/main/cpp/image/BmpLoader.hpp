@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Image.hpp"
+
+namespace mj2 {
+
+    class MappedFile;
+
+    //-------------------------------------------------------------
+    // BmpImage
+    //-------------------------------------------------------------
+    /// View of the pixel array inside a BMP file, nothing is copied
+    struct BmpImage {
+    public:
+        uint8_t* pixels;       // first row in memory, the bottom row when bottomUp
+        uint32_t width;
+        uint32_t height;
+        uint32_t bitsPerPixel; // 24 (BGR) or 32 (BGRA)
+        size_t rowStride;      // bytes from one row to the next, padded to 4
+        bool bottomUp;         // positive biHeight, GL's row order
+        bool hasAlpha;         // 32 bit with an alpha mask, otherwise the 4th byte is unused
+    };
+
+    /// Validate the headers of an in-memory BMP and point image at its pixel array.
+    /// Accepts uncompressed 24 bit and 32 bit (BI_RGB or BI_BITFIELDS in BGRA order),
+    /// bottom-up and top-down, with biSizeImage == 0, up to MaxImageDimension a side.
+    ImageStatus ParseBmp(uint8_t* data, size_t size, BmpImage& image);
+
+    /// Map path and parse it. image points into file and stays valid while file is open.
+    ImageStatus LoadBmp(const char* path, MappedFile& file, BmpImage& image);
+
+    /// In place BGR(A) -> RGB(A) and top-down -> bottom-up, so pixels can go straight to
+    /// glTexImage2D with GL_UNPACK_ALIGNMENT 4. Row padding is skipped, 32 bit images
+    /// without an alpha mask get opaque alpha.
+    void ConvertBmpToGL(BmpImage& image);
+
+    /// The two halves of ConvertBmpToGL, separate for the benchmarks: the channel swizzle
+    /// (SIMD kernels) and the row flip of top-down files.
+    void SwizzleBmpToRGB(BmpImage& image);
+    void FlipBmpToBottomUp(BmpImage& image);
+
+} // namespace mj2
@@ -0,0 +1,663 @@
+#include "EtcCodec.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+
+#include "ThreadPool.hpp"
+
+namespace mj2
+{
+    /// blocks per ParallelFor band
+    static const size_t BlocksPerBand = 256;
+
+    //-------------------------------------------------------------
+    // Tables
+    //-------------------------------------------------------------
+    /// ETC intensity modifiers (a, b); block index 0 is +a, 1 is +b, 2 is -a, 3 is -b
+    static const int EtcModifierTable[8][2] = {
+        { 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 }
+    };
+
+    /// EAC alpha modifiers, scaled by the block's multiplier
+    static const int EacModifierTable[16][8] = {
+        { -3, -6, -9, -15, 2, 5, 8, 14 }, { -3, -7, -10, -13, 2, 6, 9, 12 },
+        { -2, -5, -8, -13, 1, 4, 7, 12 }, { -2, -4, -6, -13, 1, 3, 5, 12 },
+        { -3, -6, -8, -12, 2, 5, 7, 11 }, { -3, -7, -9, -11, 2, 6, 8, 10 },
+        { -4, -7, -8, -11, 3, 6, 7, 10 }, { -3, -5, -8, -11, 2, 4, 7, 10 },
+        { -2, -6, -8, -10, 1, 5, 7, 9 }, { -2, -5, -8, -10, 1, 4, 7, 9 },
+        { -2, -4, -8, -10, 1, 3, 7, 9 }, { -2, -5, -7, -10, 1, 4, 6, 9 },
+        { -3, -4, -7, -10, 2, 3, 6, 9 }, { -1, -2, -3, -10, 0, 1, 2, 9 },
+        { -4, -6, -8, -9, 3, 5, 7, 8 }, { -3, -5, -7, -9, 2, 4, 6, 8 }
+    };
+
+    /// table 13 has a 0 modifier at index 4, for blocks of constant alpha
+    static const int EacZeroTable = 13;
+    static const int EacZeroIndex = 4;
+
+    /// pixel numbers (x * 4 + y, the order of the index bits) of the two subblocks per flip
+    static const uint8_t SubblockPixels[2][2][8] = {
+        { { 0, 1, 2, 3, 4, 5, 6, 7 }, { 8, 9, 10, 11, 12, 13, 14, 15 } },  // 2x4 left, right
+        { { 0, 1, 4, 5, 8, 9, 12, 13 }, { 2, 3, 6, 7, 10, 11, 14, 15 } }   // 4x2 top, bottom
+    };
+
+    //-------------------------------------------------------------
+    // Helpers
+    //-------------------------------------------------------------
+    static inline int ClampByte(int v)
+    {
+        return v < 0 ? 0 : v > 255 ? 255 : v;
+    }
+
+    /// bit replication of a bits wide value to 8 bits, 4 <= bits <= 7
+    static inline int Expand(int q, int bits)
+    {
+        return (q << (8 - bits)) | (q >> (2 * bits - 8));
+    }
+
+    /// the bits wide value whose expansion is closest to v
+    static int Quantize(int v, int bits)
+    {
+        const int maxValue = (1 << bits) - 1;
+        const int guess = (ClampByte(v) * maxValue + 127) / 255;
+        int best = guess;
+        int bestError = INT_MAX;
+        for (int q = std::max(guess - 1, 0); q <= std::min(guess + 1, maxValue); q++) {
+            const int error = abs(Expand(q, bits) - v);
+            if (error < bestError) {
+                bestError = error;
+                best = q;
+            }
+        }
+        return best;
+    }
+
+    static inline int EtcModifier(int table, int index)
+    {
+        const int modifier = EtcModifierTable[table][index & 1];
+        return (index & 2) ? -modifier : modifier;
+    }
+
+    static inline int SignExtend3(uint32_t v)
+    {
+        return (v & 4) ? (int)v - 8 : (int)v;
+    }
+
+    static inline uint32_t ReadU32BE(const uint8_t* p)
+    {
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    }
+
+    static inline void WriteU32BE(uint8_t* p, uint32_t v)
+    {
+        p[0] = (uint8_t)(v >> 24);
+        p[1] = (uint8_t)(v >> 16);
+        p[2] = (uint8_t)(v >> 8);
+        p[3] = (uint8_t)v;
+    }
+
+    /// channels of a block by pixel number, see SubblockPixels
+    struct BlockPixels {
+    public:
+        int c[4][16];
+
+        explicit BlockPixels(const uint8_t* rgba)
+        {
+            for (int y = 0; y < 4; y++) {
+                for (int x = 0; x < 4; x++) {
+                    for (int channel = 0; channel < 4; channel++) {
+                        c[channel][x * 4 + y] = rgba[(y * 4 + x) * 4 + channel];
+                    }
+                }
+            }
+        }
+    };
+
+    /// a color block as its two big endian words
+    struct EtcCandidate {
+    public:
+        uint32_t error;
+        uint32_t high;
+        uint32_t low;
+    };
+
+    //-------------------------------------------------------------
+    // Individual and differential mode
+    //-------------------------------------------------------------
+    struct SubblockFit {
+    public:
+        uint32_t error;
+        int table;
+        uint8_t indices[8];
+    };
+
+    /// best table and per pixel modifiers for one subblock around base color (r, g, b)
+    static void FitSubblock(const BlockPixels& px, const uint8_t* pixels, int r, int g, int b, SubblockFit& fit)
+    {
+        fit.error = UINT32_MAX;
+        for (int table = 0; table < 8; table++) {
+            int colors[4][3];
+            for (int m = 0; m < 4; m++) {
+                const int modifier = EtcModifier(table, m);
+                colors[m][0] = ClampByte(r + modifier);
+                colors[m][1] = ClampByte(g + modifier);
+                colors[m][2] = ClampByte(b + modifier);
+            }
+
+            uint32_t error = 0;
+            uint8_t indices[8];
+            for (int i = 0; i < 8 && error < fit.error; i++) {
+                const int p = pixels[i];
+                uint32_t best = UINT32_MAX;
+                for (int m = 0; m < 4; m++) {
+                    const int dr = colors[m][0] - px.c[0][p];
+                    const int dg = colors[m][1] - px.c[1][p];
+                    const int db = colors[m][2] - px.c[2][p];
+                    const uint32_t e = (uint32_t)(dr * dr + dg * dg + db * db);
+                    if (e < best) {
+                        best = e;
+                        indices[i] = (uint8_t)m;
+                    }
+                }
+                error += best;
+            }
+            if (error < fit.error) {
+                fit.error = error;
+                fit.table = table;
+                memcpy(fit.indices, indices, sizeof(indices));
+            }
+        }
+    }
+
+    static inline void FitHalf(const BlockPixels& px, int flip, int half, int bits, const int q[3], SubblockFit& fit)
+    {
+        FitSubblock(px, SubblockPixels[flip][half], Expand(q[0], bits), Expand(q[1], bits), Expand(q[2], bits), fit);
+    }
+
+    static bool DeltaFits(const int q[2][3])
+    {
+        for (int c = 0; c < 3; c++) {
+            const int delta = q[1][c] - q[0][c];
+            if (delta < -4 || delta > 3) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// greedy +-1 steps of the quantized base colors while the error drops; the halves
+    /// are fitted independently, so only the changed one is refitted
+    static uint32_t RefineBases(const BlockPixels& px, int flip, int bits, bool differential, int q[2][3], SubblockFit fits[2])
+    {
+        const int maxValue = (1 << bits) - 1;
+        uint32_t error = fits[0].error + fits[1].error;
+        bool improved = true;
+        for (int pass = 0; improved && pass < 4 && error > 0; pass++) {
+            improved = false;
+            for (int half = 0; half < 2; half++) {
+                for (int c = 0; c < 3; c++) {
+                    for (int step = -1; step <= 1; step += 2) {
+                        int trial[2][3];
+                        memcpy(trial, q, sizeof(trial));
+                        trial[half][c] += step;
+                        if (trial[half][c] < 0 || trial[half][c] > maxValue || (differential && !DeltaFits(trial))) {
+                            continue;
+                        }
+
+                        SubblockFit fit;
+                        FitHalf(px, flip, half, bits, trial[half], fit);
+                        if (fit.error < fits[half].error) {
+                            error = error - fits[half].error + fit.error;
+                            q[half][c] = trial[half][c];
+                            fits[half] = fit;
+                            improved = true;
+                        }
+                    }
+                }
+            }
+        }
+        return error;
+    }
+
+    static uint32_t PackIndices(int flip, const SubblockFit fits[2])
+    {
+        uint32_t low = 0;
+        for (int half = 0; half < 2; half++) {
+            for (int i = 0; i < 8; i++) {
+                const uint32_t p = SubblockPixels[flip][half][i];
+                const uint32_t m = fits[half].indices[i];
+                low |= ((m >> 1) << (16 + p)) | ((m & 1) << p);
+            }
+        }
+        return low;
+    }
+
+    /// one flip in individual (444) or differential (555 + 333 delta) mode
+    struct BaseFit {
+    public:
+        int flip;
+        bool differential;
+        int q[2][3];
+        SubblockFit fits[2];
+        uint32_t error;
+    };
+
+    static EtcCandidate PackBaseFit(const BaseFit& fit)
+    {
+        const int (*q)[3] = fit.q;
+        EtcCandidate candidate;
+        candidate.error = fit.error;
+        if (fit.differential) {
+            candidate.high = ((uint32_t)q[0][0] << 27) | ((uint32_t)((q[1][0] - q[0][0]) & 7) << 24) |
+                             ((uint32_t)q[0][1] << 19) | ((uint32_t)((q[1][1] - q[0][1]) & 7) << 16) |
+                             ((uint32_t)q[0][2] << 11) | ((uint32_t)((q[1][2] - q[0][2]) & 7) << 8) | 2u;
+        } else {
+            candidate.high = ((uint32_t)q[0][0] << 28) | ((uint32_t)q[1][0] << 24) |
+                             ((uint32_t)q[0][1] << 20) | ((uint32_t)q[1][1] << 16) |
+                             ((uint32_t)q[0][2] << 12) | ((uint32_t)q[1][2] << 8);
+        }
+        candidate.high |= ((uint32_t)fit.fits[0].table << 5) | ((uint32_t)fit.fits[1].table << 2) | (uint32_t)fit.flip;
+        candidate.low = PackIndices(fit.flip, fit.fits);
+        return candidate;
+    }
+
+    /// both flips in both modes from the subblock averages; High then searches around the
+    /// base colors of the best one only, the others rarely catch up
+    static EtcCandidate EncodeEtc1Modes(const BlockPixels& px, EtcQuality quality)
+    {
+        BaseFit best;
+        best.error = UINT32_MAX;
+
+        for (int flip = 0; flip < 2; flip++) {
+            int average[2][3];
+            for (int half = 0; half < 2; half++) {
+                for (int c = 0; c < 3; c++) {
+                    int sum = 0;
+                    for (int i = 0; i < 8; i++) {
+                        sum += px.c[c][SubblockPixels[flip][half][i]];
+                    }
+                    average[half][c] = (sum + 4) / 8;
+                }
+            }
+
+            for (int differential = 1; differential >= 0; differential--) {
+                BaseFit fit;
+                fit.flip = flip;
+                fit.differential = differential != 0;
+                const int bits = differential ? 5 : 4;
+                for (int half = 0; half < 2; half++) {
+                    for (int c = 0; c < 3; c++) {
+                        fit.q[half][c] = Quantize(average[half][c], bits);
+                    }
+                }
+                if (differential && !DeltaFits(fit.q)) {
+                    continue;
+                }
+
+                FitHalf(px, flip, 0, bits, fit.q[0], fit.fits[0]);
+                FitHalf(px, flip, 1, bits, fit.q[1], fit.fits[1]);
+                fit.error = fit.fits[0].error + fit.fits[1].error;
+                if (fit.error < best.error) {
+                    best = fit;
+                }
+            }
+        }
+
+        if (quality == EtcQuality_High && best.error > 0) {
+            best.error = RefineBases(px, best.flip, best.differential ? 5 : 4, best.differential, best.q, best.fits);
+        }
+        return PackBaseFit(best);
+    }
+
+    //-------------------------------------------------------------
+    // ETC2 planar mode
+    //-------------------------------------------------------------
+    /////
+    // Three colors O, H, V (676 bits) at pixel (0, 0), (4, 0) and (0, 4) of a plane:
+    //   c(x, y) = (x * (H - O) + y * (V - O) + 4 * O + 2) >> 2
+    //
+    //   63 -  62-57 RO  56 GO1  55 -  54-49 GO2  48 BO1  47-45 -  44-43 BO2  42 -
+    //   41-39 BO3  38-34 RH1  33 D=1  32 RH2  31-25 GH  24-19 BH  18-13 RV  12-6 GV  5-0 BV
+    //
+    // The free bits (-) are chosen so that, read as a differential block, red and
+    // green stay in range and blue overflows, which is how decoders pick planar mode.
+    /////
+    static const int PlanarBits[3] = { 6, 7, 6 };
+
+    static inline int PlanarValue(const int o[3], const int h[3], const int v[3], int c, int x, int y)
+    {
+        return ClampByte((x * (h[c] - o[c]) + y * (v[c] - o[c]) + 4 * o[c] + 2) >> 2);
+    }
+
+    static uint32_t PlanarError(const BlockPixels& px, const int q[3][3])
+    {
+        int o[3], h[3], v[3];
+        for (int c = 0; c < 3; c++) {
+            o[c] = Expand(q[0][c], PlanarBits[c]);
+            h[c] = Expand(q[1][c], PlanarBits[c]);
+            v[c] = Expand(q[2][c], PlanarBits[c]);
+        }
+
+        uint32_t error = 0;
+        for (int p = 0; p < 16; p++) {
+            for (int c = 0; c < 3; c++) {
+                const int d = PlanarValue(o, h, v, c, p >> 2, p & 3) - px.c[c][p];
+                error += (uint32_t)(d * d);
+            }
+        }
+        return error;
+    }
+
+    static bool PlanarFreeBits(uint32_t& high)
+    {
+        for (uint32_t free = 0; free < 64; free++) {
+            const uint32_t trial = high | ((free & 1) << 31) | (((free >> 1) & 1) << 23) | (((free >> 2) & 7) << 13) | ((free >> 5) << 10);
+            const int r = (int)((trial >> 27) & 31) + SignExtend3((trial >> 24) & 7);
+            const int g = (int)((trial >> 19) & 31) + SignExtend3((trial >> 16) & 7);
+            const int b = (int)((trial >> 11) & 31) + SignExtend3((trial >> 8) & 7);
+            if (r >= 0 && r <= 31 && g >= 0 && g <= 31 && (b < 0 || b > 31)) {
+                high = trial;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static EtcCandidate EncodePlanar(const BlockPixels& px, EtcQuality quality)
+    {
+        // least squares plane per channel; sum((x - 1.5)^2) over the block is 20
+        int q[3][3];
+        for (int c = 0; c < 3; c++) {
+            float sum = 0.0f, sumX = 0.0f, sumY = 0.0f;
+            for (int p = 0; p < 16; p++) {
+                const float value = (float)px.c[c][p];
+                sum += value;
+                sumX += ((p >> 2) - 1.5f) * value;
+                sumY += ((p & 3) - 1.5f) * value;
+            }
+            const float slopeX = sumX / 20.0f;
+            const float slopeY = sumY / 20.0f;
+            const float origin = sum / 16.0f - 1.5f * (slopeX + slopeY);
+            q[0][c] = Quantize((int)(origin + 0.5f), PlanarBits[c]);
+            q[1][c] = Quantize((int)(origin + 4.0f * slopeX + 0.5f), PlanarBits[c]);
+            q[2][c] = Quantize((int)(origin + 4.0f * slopeY + 0.5f), PlanarBits[c]);
+        }
+
+        uint32_t error = PlanarError(px, q);
+        bool improved = quality == EtcQuality_High;
+        for (int pass = 0; improved && pass < 4 && error > 0; pass++) {
+            improved = false;
+            for (int point = 0; point < 3; point++) {
+                for (int c = 0; c < 3; c++) {
+                    for (int step = -1; step <= 1; step += 2) {
+                        const int value = q[point][c] + step;
+                        if (value < 0 || value >= (1 << PlanarBits[c])) {
+                            continue;
+                        }
+                        const int previous = q[point][c];
+                        q[point][c] = value;
+                        const uint32_t trialError = PlanarError(px, q);
+                        if (trialError < error) {
+                            error = trialError;
+                            improved = true;
+                        } else {
+                            q[point][c] = previous;
+                        }
+                    }
+                }
+            }
+        }
+
+        EtcCandidate candidate;
+        candidate.error = error;
+        candidate.high = ((uint32_t)q[0][0] << 25) | ((uint32_t)(q[0][1] >> 6) << 24) | ((uint32_t)(q[0][1] & 63) << 17) |
+                         ((uint32_t)(q[0][2] >> 5) << 16) | ((uint32_t)((q[0][2] >> 3) & 3) << 11) | ((uint32_t)(q[0][2] & 7) << 7) |
+                         ((uint32_t)(q[1][0] >> 1) << 2) | 2u | ((uint32_t)q[1][0] & 1);
+        candidate.low = ((uint32_t)q[1][1] << 25) | ((uint32_t)q[1][2] << 19) |
+                        ((uint32_t)q[2][0] << 13) | ((uint32_t)q[2][1] << 6) | (uint32_t)q[2][2];
+        if (!PlanarFreeBits(candidate.high)) {
+            candidate.error = UINT32_MAX;
+        }
+        return candidate;
+    }
+
+    //-------------------------------------------------------------
+    // EAC alpha
+    //-------------------------------------------------------------
+    static uint32_t EacError(const BlockPixels& px, int base, int multiplier, int table, uint8_t* indices, uint32_t limit)
+    {
+        uint32_t error = 0;
+        for (int p = 0; p < 16 && error < limit; p++) {
+            uint32_t best = UINT32_MAX;
+            for (int m = 0; m < 8; m++) {
+                const int d = ClampByte(base + EacModifierTable[table][m] * multiplier) - px.c[3][p];
+                if ((uint32_t)(d * d) < best) {
+                    best = (uint32_t)(d * d);
+                    indices[p] = (uint8_t)m;
+                }
+            }
+            error += best;
+        }
+        return error;
+    }
+
+    static void EncodeEacBlock(uint8_t* block, const BlockPixels& px, EtcQuality quality)
+    {
+        int minAlpha = 255, maxAlpha = 0;
+        for (int p = 0; p < 16; p++) {
+            minAlpha = std::min(minAlpha, px.c[3][p]);
+            maxAlpha = std::max(maxAlpha, px.c[3][p]);
+        }
+
+        int bestBase = minAlpha, bestMultiplier = 1, bestTable = EacZeroTable;
+        uint8_t bestIndices[16];
+        memset(bestIndices, EacZeroIndex, sizeof(bestIndices));
+
+        if (minAlpha != maxAlpha) {
+            uint32_t bestError = UINT32_MAX;
+            const int spread = quality == EtcQuality_High ? 1 : 0;
+            for (int table = 0; table < 16 && bestError > 0; table++) {
+                const int low = EacModifierTable[table][3];
+                const int high = EacModifierTable[table][7];
+                const int multiplier = std::max(1, std::min(15, ((maxAlpha - minAlpha) + (high - low) / 2) / (high - low)));
+                for (int m = std::max(1, multiplier - spread); m <= std::min(15, multiplier + spread); m++) {
+                    const int center = (minAlpha + maxAlpha - (low + high) * m + 1) / 2;
+                    for (int base = center - spread; base <= center + spread; base++) {
+                        if (base < 0 || base > 255) {
+                            continue;
+                        }
+                        uint8_t indices[16];
+                        const uint32_t error = EacError(px, base, m, table, indices, bestError);
+                        if (error < bestError) {
+                            bestError = error;
+                            bestBase = base;
+                            bestMultiplier = m;
+                            bestTable = table;
+                            memcpy(bestIndices, indices, sizeof(indices));
+                        }
+                    }
+                }
+            }
+        }
+
+        // 8 bit base, 4 bit multiplier, 4 bit table, 16 3 bit indices from bit 47 down
+        uint64_t bits = 0;
+        for (int p = 0; p < 16; p++) {
+            bits |= (uint64_t)bestIndices[p] << (45 - 3 * p);
+        }
+        block[0] = (uint8_t)bestBase;
+        block[1] = (uint8_t)((bestMultiplier << 4) | bestTable);
+        for (int i = 0; i < 6; i++) {
+            block[2 + i] = (uint8_t)(bits >> (40 - 8 * i));
+        }
+    }
+
+    static void DecodeEacBlock(uint8_t* rgba, const uint8_t* block)
+    {
+        const int base = block[0];
+        const int multiplier = block[1] >> 4;
+        const int table = block[1] & 15;
+        uint64_t bits = 0;
+        for (int i = 0; i < 6; i++) {
+            bits = (bits << 8) | block[2 + i];
+        }
+
+        for (int p = 0; p < 16; p++) {
+            const int index = (int)((bits >> (45 - 3 * p)) & 7);
+            rgba[((p & 3) * 4 + (p >> 2)) * 4 + 3] = (uint8_t)ClampByte(base + EacModifierTable[table][index] * multiplier);
+        }
+    }
+
+    //-------------------------------------------------------------
+    // Blocks
+    //-------------------------------------------------------------
+    size_t EtcBlockBytes(EtcFormat format)
+    {
+        return format == EtcFormat_ETC2_RGBA ? 16 : 8;
+    }
+
+    size_t EtcImageBytes(EtcFormat format, uint32_t width, uint32_t height)
+    {
+        return (size_t)((width + 3) / 4) * ((height + 3) / 4) * EtcBlockBytes(format);
+    }
+
+    void EncodeEtcBlock(uint8_t* block, const uint8_t* rgba, EtcFormat format, EtcQuality quality)
+    {
+        const BlockPixels px(rgba);
+        if (format == EtcFormat_ETC2_RGBA) {
+            EncodeEacBlock(block, px, quality);
+            block += 8;
+        }
+
+        EtcCandidate best = EncodeEtc1Modes(px, quality);
+        if (format != EtcFormat_ETC1 && best.error > 0) {
+            const EtcCandidate planar = EncodePlanar(px, quality);
+            if (planar.error < best.error) {
+                best = planar;
+            }
+        }
+
+        WriteU32BE(block, best.high);
+        WriteU32BE(block + 4, best.low);
+    }
+
+    bool DecodeEtcBlock(uint8_t* rgba, const uint8_t* block, EtcFormat format)
+    {
+        if (format == EtcFormat_ETC2_RGBA) {
+            DecodeEacBlock(rgba, block);
+            block += 8;
+        } else {
+            for (int i = 0; i < 16; i++) {
+                rgba[i * 4 + 3] = 255;
+            }
+        }
+
+        const uint32_t high = ReadU32BE(block);
+        const uint32_t low = ReadU32BE(block + 4);
+        const int flip = (int)(high & 1);
+        int base[2][3];
+
+        if ((high & 2) == 0) {
+            for (int c = 0; c < 3; c++) {
+                base[0][c] = Expand((int)(high >> (28 - 8 * c)) & 15, 4);
+                base[1][c] = Expand((int)(high >> (24 - 8 * c)) & 15, 4);
+            }
+        } else {
+            int q[2][3];
+            bool overflow[3];
+            for (int c = 0; c < 3; c++) {
+                q[0][c] = (int)(high >> (27 - 8 * c)) & 31;
+                q[1][c] = q[0][c] + SignExtend3((high >> (24 - 8 * c)) & 7);
+                overflow[c] = q[1][c] < 0 || q[1][c] > 31;
+            }
+
+            // ETC2 T (red) and H (green) modes are not decoded; ETC1 has no overflow
+            if (overflow[0] || overflow[1] || (overflow[2] && format == EtcFormat_ETC1)) {
+                return false;
+            }
+            if (overflow[2]) {
+                const int o[3] = { Expand((int)(high >> 25) & 63, 6),
+                                   Expand((int)(((high >> 24) & 1) << 6 | ((high >> 17) & 63)), 7),
+                                   Expand((int)(((high >> 16) & 1) << 5 | ((high >> 11) & 3) << 3 | ((high >> 7) & 7)), 6) };
+                const int h[3] = { Expand((int)(((high >> 2) & 31) << 1 | (high & 1)), 6),
+                                   Expand((int)(low >> 25) & 127, 7),
+                                   Expand((int)(low >> 19) & 63, 6) };
+                const int v[3] = { Expand((int)(low >> 13) & 63, 6),
+                                   Expand((int)(low >> 6) & 127, 7),
+                                   Expand((int)low & 63, 6) };
+                for (int y = 0; y < 4; y++) {
+                    for (int x = 0; x < 4; x++) {
+                        for (int c = 0; c < 3; c++) {
+                            rgba[(y * 4 + x) * 4 + c] = (uint8_t)PlanarValue(o, h, v, c, x, y);
+                        }
+                    }
+                }
+                return true;
+            }
+
+            for (int c = 0; c < 3; c++) {
+                base[0][c] = Expand(q[0][c], 5);
+                base[1][c] = Expand(q[1][c], 5);
+            }
+        }
+
+        const int tables[2] = { (int)(high >> 5) & 7, (int)(high >> 2) & 7 };
+        for (int y = 0; y < 4; y++) {
+            for (int x = 0; x < 4; x++) {
+                const int p = x * 4 + y;
+                const int half = flip ? (y >= 2) : (x >= 2);
+                const int index = (int)((((low >> (16 + p)) & 1) << 1) | ((low >> p) & 1));
+                const int modifier = EtcModifier(tables[half], index);
+                for (int c = 0; c < 3; c++) {
+                    rgba[(y * 4 + x) * 4 + c] = (uint8_t)ClampByte(base[half][c] + modifier);
+                }
+            }
+        }
+        return true;
+    }
+
+    ImageStatus EncodeEtcImage(uint8_t* blocks, const uint8_t* pixels, uint32_t width, uint32_t height, size_t rowStride,
+                               uint32_t channels, EtcFormat format, EtcQuality quality, ThreadPool* pool)
+    {
+        if (channels != 3 && channels != 4) {
+            return ImageStatus_Unsupported;
+        }
+        if (!pixels || width == 0 || height == 0 || rowStride < (size_t)width * channels) {
+            return ImageStatus_BadHeader;
+        }
+
+        const size_t blocksX = (width + 3) / 4;
+        const size_t blocksY = (height + 3) / 4;
+        const size_t blockBytes = EtcBlockBytes(format);
+
+        const std::function<void(size_t, size_t)> rows = [&](size_t begin, size_t end) {
+            uint8_t rgba[64];
+            for (size_t by = begin; by < end; by++) {
+                for (size_t bx = 0; bx < blocksX; bx++) {
+                    for (uint32_t y = 0; y < 4; y++) {
+                        const size_t sy = std::min((size_t)(by * 4 + y), (size_t)height - 1);
+                        for (uint32_t x = 0; x < 4; x++) {
+                            const size_t sx = std::min((size_t)(bx * 4 + x), (size_t)width - 1);
+                            const uint8_t* src = pixels + sy * rowStride + sx * channels;
+                            uint8_t* dst = rgba + (y * 4 + x) * 4;
+                            dst[0] = src[0];
+                            dst[1] = src[1];
+                            dst[2] = src[2];
+                            dst[3] = channels == 4 ? src[3] : 255;
+                        }
+                    }
+                    EncodeEtcBlock(blocks + (by * blocksX + bx) * blockBytes, rgba, format, quality);
+                }
+            }
+        };
+
+        if (pool) {
+            pool->ParallelFor(blocksY, std::max(BlocksPerBand / blocksX, (size_t)1), rows);
+        } else {
+            rows(0, blocksY);
+        }
+        return ImageStatus_Ok;
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Image.hpp"
+
+namespace mj2 {
+
+    class ThreadPool;
+
+    enum EtcFormat
+    {
+        EtcFormat_ETC1 = 0,   // GL_ETC1_RGB8_OES, any ES 2 device with the OES extension
+        EtcFormat_ETC2_RGB,   // GL_COMPRESSED_RGB8_ETC2, ES 3, decodes ETC1 blocks too
+        EtcFormat_ETC2_RGBA   // GL_COMPRESSED_RGBA8_ETC2_EAC, an EAC alpha block before each color block
+    };
+
+    enum EtcQuality
+    {
+        EtcQuality_Fast = 0,  // subblock averages as base colors
+        EtcQuality_High       // plus a greedy search around the best base colors, ~3x slower
+    };
+
+    //-------------------------------------------------------------
+    // ETC1 / ETC2 block codec
+    //-------------------------------------------------------------
+    /////
+    // Blocks are 4x4 pixels, 8 bytes (16 for ETC2_RGBA), stored big endian as in the
+    // Khronos spec. The encoder tries both subblock flips in individual and differential
+    // mode and, for ETC2, planar mode for smooth gradients. The ETC2 T and H modes are
+    // never emitted, the decoder reports them as unsupported.
+    //
+    // rgba is a 4x4 block of RGBA pixels in rows, 64 bytes.
+    /////
+
+    /// 8, or 16 for EtcFormat_ETC2_RGBA
+    size_t EtcBlockBytes(EtcFormat format);
+
+    /// size of the block data of a width x height image, partial blocks count as whole
+    size_t EtcImageBytes(EtcFormat format, uint32_t width, uint32_t height);
+
+    void EncodeEtcBlock(uint8_t* block, const uint8_t* rgba, EtcFormat format, EtcQuality quality);
+
+    /// false for T and H mode blocks. Alpha is 255 for the RGB formats.
+    bool DecodeEtcBlock(uint8_t* rgba, const uint8_t* block, EtcFormat format);
+
+    /// Encodes a whole RGB (channels 3) or RGBA (4) image, blocks in row order. Blocks over
+    /// the right and bottom edges repeat the last column and row. With a pool, block rows
+    /// are encoded in parallel.
+    ImageStatus EncodeEtcImage(uint8_t* blocks, const uint8_t* pixels, uint32_t width, uint32_t height, size_t rowStride,
+                               uint32_t channels, EtcFormat format, EtcQuality quality, ThreadPool* pool = nullptr);
+
+} // namespace mj2
@@ -0,0 +1,29 @@
+#include "Image.hpp"
+
+namespace mj2
+{
+    const char* ImageStatusString(ImageStatus status)
+    {
+        switch (status) {
+            case ImageStatus_Ok:
+                return "ok";
+            case ImageStatus_OpenFailed:
+                return "cannot open file";
+            case ImageStatus_MapFailed:
+                return "cannot map file";
+            case ImageStatus_Truncated:
+                return "file is truncated";
+            case ImageStatus_BadSignature:
+                return "unexpected file type";
+            case ImageStatus_BadHeader:
+                return "corrupt header";
+            case ImageStatus_Unsupported:
+                return "unsupported format";
+            case ImageStatus_OutOfMemory:
+                return "out of memory";
+            case ImageStatus_BadChecksum:
+                return "checksum mismatch";
+        }
+        return "unknown error";
+    }
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+namespace mj2 {
+
+    enum ImageStatus
+    {
+        ImageStatus_Ok = 0,
+        ImageStatus_OpenFailed,   // file missing or not readable
+        ImageStatus_MapFailed,    // mmap refused the file
+        ImageStatus_Truncated,    // headers or pixel data run past the end of the file
+        ImageStatus_BadSignature, // not the expected file type
+        ImageStatus_BadHeader,    // inconsistent header fields
+        ImageStatus_Unsupported,  // valid, but a variant we do not decode
+        ImageStatus_OutOfMemory,  // no memory for derived data (mip levels, ...)
+        ImageStatus_BadChecksum   // payload does not match the checksum in the header
+    };
+
+    const char* ImageStatusString(ImageStatus status);
+
+    /// Widest / tallest image we decode: 16 mip levels, what a texture file holds and
+    /// more than any GLES device samples. Bigger ones are ImageStatus_Unsupported.
+    static const unsigned MaxImageDimension = 32768;
+
+} // namespace mj2
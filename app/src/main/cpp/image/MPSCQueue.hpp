@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+
+namespace mj2 {
+
+    struct MPSCNode {
+    public:
+        std::atomic<MPSCNode*> next;
+    };
+
+    //-------------------------------------------------------------
+    // MPSCQueue
+    //-------------------------------------------------------------
+    /////
+    // Intrusive multi-producer single-consumer queue (D. Vyukov). Push is one atomic
+    // exchange and never blocks or fails, Pop is only ever called from one thread.
+    // T derives from MPSCNode, the queue does not own the nodes.
+    //
+    // Pop can return nullptr while a producer sits between its exchange and linking the
+    // node; the element shows up on a later Pop, which is fine for per-frame polling.
+    /////
+    template<typename T>
+    class MPSCQueue {
+    public:
+        MPSCQueue()
+                : head(&stub)
+                , tail(&stub)
+        {
+            stub.next.store(nullptr, std::memory_order_relaxed);
+        }
+
+        MPSCQueue(const MPSCQueue&) = delete;
+        MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+        /// any thread
+        void Push(T* element)
+        {
+            PushNode(element);
+        }
+
+        /// consumer thread only
+        T* Pop()
+        {
+            MPSCNode* first = tail;
+            MPSCNode* next = first->next.load(std::memory_order_acquire);
+
+            if (first == &stub) {
+                if (!next) {
+                    return nullptr;
+                }
+                tail = next;
+                first = next;
+                next = next->next.load(std::memory_order_acquire);
+            }
+
+            if (next) {
+                tail = next;
+                return static_cast<T*>(first);
+            }
+
+            // first is the last linked node; a producer may be half way through a push
+            if (first != head.load(std::memory_order_acquire)) {
+                return nullptr;
+            }
+
+            // requeue the stub behind first so first can be detached
+            PushNode(&stub);
+            next = first->next.load(std::memory_order_acquire);
+            if (next) {
+                tail = next;
+                return static_cast<T*>(first);
+            }
+            return nullptr;
+        }
+
+    private:
+        void PushNode(MPSCNode* node)
+        {
+            node->next.store(nullptr, std::memory_order_relaxed);
+            MPSCNode* previous = head.exchange(node, std::memory_order_acq_rel);
+            previous->next.store(node, std::memory_order_release);
+        }
+
+        std::atomic<MPSCNode*> head;
+        MPSCNode* tail;
+        MPSCNode stub;
+    };
+
+} // namespace mj2
@@ -0,0 +1,68 @@
+#include "MappedFile.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace mj2
+{
+    MappedFile::MappedFile()
+            : data(nullptr)
+            , size(0)
+    {
+    }
+
+    MappedFile::~MappedFile()
+    {
+        Close();
+    }
+
+    ImageStatus MappedFile::Open(const char* path)
+    {
+        Close();
+
+        const int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return ImageStatus_OpenFailed;
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+            close(fd);
+            return ImageStatus_OpenFailed;
+        }
+        if (info.st_size <= 0) {
+            close(fd);
+            return ImageStatus_Truncated;
+        }
+        // a 32 bit process would otherwise map a silently truncated prefix of the file
+        if ((uint64_t)info.st_size > SIZE_MAX) {
+            close(fd);
+            return ImageStatus_MapFailed;
+        }
+
+        void* mapping = mmap(nullptr, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        // the mapping keeps its own reference to the file
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            return ImageStatus_MapFailed;
+        }
+
+        // the whole file is about to be read front to back
+        madvise(mapping, (size_t)info.st_size, MADV_WILLNEED);
+
+        data = (uint8_t*)mapping;
+        size = (size_t)info.st_size;
+        return ImageStatus_Ok;
+    }
+
+    void MappedFile::Close()
+    {
+        if (data) {
+            munmap(data, size);
+            data = nullptr;
+            size = 0;
+        }
+    }
+}
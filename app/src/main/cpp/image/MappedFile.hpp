@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Image.hpp"
+
+namespace mj2 {
+
+    //-------------------------------------------------------------
+    // MappedFile
+    //-------------------------------------------------------------
+    /// Read-only file mapped copy-on-write (MAP_PRIVATE): callers may convert pixels in place,
+    /// the touched pages become private copies and nothing is ever written back to the file.
+    class MappedFile {
+    public:
+        MappedFile();
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        /// Closes any previous mapping first
+        ImageStatus Open(const char* path);
+        void Close();
+
+        uint8_t* Data() const { return data; }
+        size_t Size() const { return size; }
+
+    private:
+        uint8_t* data;
+        size_t size;
+    };
+
+} // namespace mj2
@@ -0,0 +1,330 @@
+#include "MipChain.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include "PixelKernels.hpp"
+#include "ThreadPool.hpp"
+
+namespace mj2
+{
+    /// output pixels per ParallelFor band, small levels run in one band on the caller
+    static const size_t PixelsPerBand = 16384;
+
+    //-------------------------------------------------------------
+    // Color space tables
+    //-------------------------------------------------------------
+    /// linear -> sRGB is looked up at this resolution; 1/255 in sRGB is ~5 steps
+    static const int EncodeTableSize = 16384;
+
+    struct ColorTables {
+    public:
+        float decodeLinear[256];
+        float decodeSRGB[256];
+        uint8_t encodeSRGB[EncodeTableSize];
+
+        ColorTables()
+        {
+            for (int i = 0; i < 256; i++) {
+                const float c = i / 255.0f;
+                decodeLinear[i] = c;
+                decodeSRGB[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+            }
+            for (int i = 0; i < EncodeTableSize; i++) {
+                const float l = i / (float)(EncodeTableSize - 1);
+                const float c = l <= 0.0031308f ? l * 12.92f : 1.055f * powf(l, 1.0f / 2.4f) - 0.055f;
+                encodeSRGB[i] = (uint8_t)(c * 255.0f + 0.5f);
+            }
+        }
+    };
+
+    static const ColorTables& GetColorTables()
+    {
+        static const ColorTables tables;
+        return tables;
+    }
+
+    static inline uint8_t EncodeLinear(float v)
+    {
+        const float scaled = v * 255.0f + 0.5f;
+        return scaled <= 0.0f ? 0 : scaled >= 255.0f ? 255 : (uint8_t)scaled;
+    }
+
+    static inline uint8_t EncodeSRGB(const ColorTables& tables, float v)
+    {
+        const float scaled = v * (EncodeTableSize - 1) + 0.5f;
+        return tables.encodeSRGB[scaled <= 0.0f ? 0 : scaled >= EncodeTableSize - 1 ? EncodeTableSize - 1 : (int)scaled];
+    }
+
+    //-------------------------------------------------------------
+    // Filter taps
+    //-------------------------------------------------------------
+    /// For each output index along one axis, the source indices and normalized weights.
+    /// Taps past the edge are clamped to it.
+    struct FilterTaps {
+    public:
+        uint32_t maxTaps;
+        std::vector<uint32_t> count;
+        std::vector<uint32_t> index;  // dstSize * maxTaps
+        std::vector<float> weight;    // dstSize * maxTaps
+    };
+
+    static const float KaiserRadius = 3.0f;  // in output pixels
+    static const float KaiserBeta = 4.0f;
+
+    /// zeroth order modified Bessel function of the first kind
+    static float BesselI0(float x)
+    {
+        float sum = 1.0f;
+        float term = 1.0f;
+        const float quarterX2 = 0.25f * x * x;
+        for (int k = 1; k < 32 && term > 1e-8f * sum; k++) {
+            term *= quarterX2 / (float)(k * k);
+            sum += term;
+        }
+        return sum;
+    }
+
+    static float KaiserWeight(float x)
+    {
+        const float t = x / KaiserRadius;
+        if (t <= -1.0f || t >= 1.0f) {
+            return 0.0f;
+        }
+        const float px = 3.14159265f * x;
+        const float sinc = fabsf(x) < 1e-5f ? 1.0f : sinf(px) / px;
+        return sinc * BesselI0(KaiserBeta * sqrtf(1.0f - t * t)) / BesselI0(KaiserBeta);
+    }
+
+    static void BuildTaps(FilterTaps& taps, uint32_t srcSize, uint32_t dstSize, MipFilter filter)
+    {
+        const float scale = (float)srcSize / (float)dstSize;
+        const float support = filter == MipFilter_Kaiser ? KaiserRadius * scale : 0.5f * scale;
+
+        taps.maxTaps = (uint32_t)ceilf(2.0f * support) + 2;
+        taps.count.assign(dstSize, 0);
+        taps.index.assign((size_t)dstSize * taps.maxTaps, 0);
+        taps.weight.assign((size_t)dstSize * taps.maxTaps, 0.0f);
+
+        for (uint32_t d = 0; d < dstSize; d++) {
+            uint32_t* index = &taps.index[(size_t)d * taps.maxTaps];
+            float* weight = &taps.weight[(size_t)d * taps.maxTaps];
+            const float center = (d + 0.5f) * scale;
+            const int first = (int)floorf(center - support);
+            const int last = (int)ceilf(center + support);
+
+            uint32_t n = 0;
+            float total = 0.0f;
+            for (int s = first; s < last && n < taps.maxTaps; s++) {
+                float w;
+                if (filter == MipFilter_Kaiser) {
+                    w = KaiserWeight((s + 0.5f - center) / scale);
+                } else {
+                    // overlap of source pixel [s, s + 1) with the footprint
+                    w = std::min(s + 1.0f, center + support) - std::max((float)s, center - support);
+                }
+                if (w == 0.0f || (filter == MipFilter_Box && w < 0.0f)) {
+                    continue;
+                }
+                index[n] = (uint32_t)std::min(std::max(s, 0), (int)srcSize - 1);
+                weight[n] = w;
+                total += w;
+                n++;
+            }
+
+            for (uint32_t k = 0; k < n; k++) {
+                weight[k] /= total;
+            }
+            taps.count[d] = n;
+        }
+    }
+
+    //-------------------------------------------------------------
+    // Level builders
+    //-------------------------------------------------------------
+    static inline size_t AlignedStride(uint32_t width, uint32_t channels)
+    {
+        return ((size_t)width * channels + 3) & ~(size_t)3;
+    }
+
+    /// storage taken by a level, rounded up so the next one starts 64 byte aligned
+    static inline size_t LevelBytes(const MipLevel& level)
+    {
+        return (level.rowStride * level.height + 63) & ~(size_t)63;
+    }
+
+    static void BoxDownsampleRows(const MipLevel& src, MipLevel& dst, uint32_t channels, size_t begin, size_t end)
+    {
+        const PixelKernels& kernels = GetPixelKernels();
+        const auto kernel = channels == 4 ? kernels.BoxDownsampleRGBA : kernels.BoxDownsampleRGB;
+        uint8_t* out = (uint8_t*)dst.pixels;
+
+        for (size_t y = begin; y < end; y++) {
+            const uint8_t* row0 = src.pixels + (src.height == 1 ? 0 : 2 * y) * src.rowStride;
+            const uint8_t* row1 = src.height == 1 ? row0 : row0 + src.rowStride;
+            kernel(out + y * dst.rowStride, row0, row1, dst.width);
+        }
+    }
+
+    struct Resampler {
+    public:
+        FilterTaps horizontal;
+        FilterTaps vertical;
+        uint32_t channels;
+        bool srgb;
+
+        void Rows(const MipLevel& src, MipLevel& dst, size_t begin, size_t end) const
+        {
+            const ColorTables& tables = GetColorTables();
+            const float* colorDecode = srgb ? tables.decodeSRGB : tables.decodeLinear;
+            const size_t srcValues = (size_t)src.width * channels;
+            std::vector<float> column(srcValues);
+
+            for (size_t y = begin; y < end; y++) {
+                // vertical pass over the whole source row, in linear light for sRGB
+                std::fill(column.begin(), column.end(), 0.0f);
+                const uint32_t* index = &vertical.index[y * vertical.maxTaps];
+                const float* weight = &vertical.weight[y * vertical.maxTaps];
+                for (uint32_t k = 0; k < vertical.count[y]; k++) {
+                    const uint8_t* row = src.pixels + index[k] * src.rowStride;
+                    const float w = weight[k];
+                    for (size_t i = 0; i < srcValues; i += channels) {
+                        column[i] += w * colorDecode[row[i]];
+                        column[i + 1] += w * colorDecode[row[i + 1]];
+                        column[i + 2] += w * colorDecode[row[i + 2]];
+                        if (channels == 4) {
+                            column[i + 3] += w * tables.decodeLinear[row[i + 3]];
+                        }
+                    }
+                }
+
+                uint8_t* out = (uint8_t*)dst.pixels + y * dst.rowStride;
+                for (uint32_t x = 0; x < dst.width; x++, out += channels) {
+                    float value[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+                    const uint32_t* hIndex = &horizontal.index[(size_t)x * horizontal.maxTaps];
+                    const float* hWeight = &horizontal.weight[(size_t)x * horizontal.maxTaps];
+                    for (uint32_t k = 0; k < horizontal.count[x]; k++) {
+                        const float* in = &column[(size_t)hIndex[k] * channels];
+                        for (uint32_t c = 0; c < channels; c++) {
+                            value[c] += hWeight[k] * in[c];
+                        }
+                    }
+
+                    for (uint32_t c = 0; c < 3; c++) {
+                        out[c] = srgb ? EncodeSRGB(tables, value[c]) : EncodeLinear(value[c]);
+                    }
+                    if (channels == 4) {
+                        out[3] = EncodeLinear(value[3]);
+                    }
+                }
+            }
+        }
+    };
+
+    //-------------------------------------------------------------
+    // MipChain
+    //-------------------------------------------------------------
+    MipChain::MipChain()
+            : channels(0)
+    {
+    }
+
+    MipChain::~MipChain()
+    {
+        Clear();
+    }
+
+    void MipChain::Clear()
+    {
+        storage.Release();
+        levels.clear();
+        channels = 0;
+    }
+
+    uint32_t MipChain::FullLevelCount(uint32_t width, uint32_t height)
+    {
+        uint32_t size = std::max(width, height);
+        uint32_t count = 1;
+        while (size > 1) {
+            size >>= 1;
+            count++;
+        }
+        return count;
+    }
+
+    ImageStatus MipChain::Build(const uint8_t* pixels, uint32_t width, uint32_t height, size_t rowStride, uint32_t channels,
+                                MipFilter filter, MipColorSpace colorSpace, ThreadPool* pool, PixelBufferPool* buffers)
+    {
+        Clear();
+        if (channels != 3 && channels != 4) {
+            return ImageStatus_Unsupported;
+        }
+        if (!pixels || width == 0 || height == 0 || rowStride < (size_t)width * channels) {
+            return ImageStatus_BadHeader;
+        }
+        if (width > MaxImageDimension || height > MaxImageDimension) {
+            return ImageStatus_Unsupported;
+        }
+
+        const uint32_t count = FullLevelCount(width, height);
+        levels.resize(count);
+        levels[0].pixels = pixels;
+        levels[0].width = width;
+        levels[0].height = height;
+        levels[0].rowStride = rowStride;
+
+        // all smaller levels share one buffer, each starting on a cache line
+        size_t bytes = 0;
+        for (uint32_t i = 1; i < count; i++) {
+            levels[i].width = std::max(levels[i - 1].width >> 1, 1u);
+            levels[i].height = std::max(levels[i - 1].height >> 1, 1u);
+            levels[i].rowStride = AlignedStride(levels[i].width, channels);
+            bytes += LevelBytes(levels[i]);
+        }
+        if (bytes) {
+            storage = buffers ? buffers->Acquire(bytes) : PixelBuffer::Allocate(bytes);
+            if (!storage.Data()) {
+                levels.clear();
+                return ImageStatus_OutOfMemory;
+            }
+        }
+        this->channels = channels;
+
+        uint8_t* next = storage.Data();
+        for (uint32_t i = 1; i < count; i++) {
+            const MipLevel& src = levels[i - 1];
+            MipLevel& dst = levels[i];
+            dst.pixels = next;
+            next += LevelBytes(dst);
+
+            const size_t grain = std::max(PixelsPerBand / dst.width, (size_t)1);
+            const bool fastBox = filter == MipFilter_Box && colorSpace == MipColorSpace_Linear &&
+                                 src.width == 2 * dst.width && (src.height == 2 * dst.height || src.height == 1);
+
+            std::function<void(size_t, size_t)> rows;
+            Resampler resampler;
+            if (fastBox) {
+                rows = [&src, &dst, channels](size_t begin, size_t end) {
+                    BoxDownsampleRows(src, dst, channels, begin, end);
+                };
+            } else {
+                BuildTaps(resampler.horizontal, src.width, dst.width, filter);
+                BuildTaps(resampler.vertical, src.height, dst.height, filter);
+                resampler.channels = channels;
+                resampler.srgb = colorSpace == MipColorSpace_SRGB;
+                rows = [&resampler, &src, &dst](size_t begin, size_t end) {
+                    resampler.Rows(src, dst, begin, end);
+                };
+            }
+
+            if (pool) {
+                pool->ParallelFor(dst.height, grain, rows);
+            } else {
+                rows(0, dst.height);
+            }
+        }
+
+        return ImageStatus_Ok;
+    }
+}
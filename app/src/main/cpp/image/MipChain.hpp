@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Image.hpp"
+#include "PixelBufferPool.hpp"
+
+namespace mj2 {
+
+    class ThreadPool;
+
+    enum MipFilter
+    {
+        MipFilter_Box = 0, // 2x2 average, area weighted for odd sizes
+        MipFilter_Kaiser   // Kaiser windowed sinc, sharper, 12 taps per axis
+    };
+
+    enum MipColorSpace
+    {
+        MipColorSpace_Linear = 0, // average the stored values as they are
+        MipColorSpace_SRGB        // decode rgb to linear light first, alpha stays linear
+    };
+
+    struct MipLevel {
+    public:
+        const uint8_t* pixels;
+        uint32_t width;
+        uint32_t height;
+        size_t rowStride;  // bytes, padded to 4 like GL_UNPACK_ALIGNMENT
+    };
+
+    //-------------------------------------------------------------
+    // MipChain
+    //-------------------------------------------------------------
+    /////
+    // Full mip chain of an 8 bit RGB or RGBA image, built on the CPU so the quality does
+    // not depend on the driver's glGenerateMipmap and the GL thread does not stall on it.
+    //
+    // Sizes halve rounding down to 1 x 1, so non power of two images work too (ES 2 only
+    // samples those with mipmaps under GL_OES_texture_npot). Even sized levels of the
+    // linear box filter go through the SIMD row kernels, everything else through a
+    // separable float resampler. With a ThreadPool each level is split into row bands.
+    /////
+    class MipChain {
+    public:
+        MipChain();
+        ~MipChain();
+
+        MipChain(const MipChain&) = delete;
+        MipChain& operator=(const MipChain&) = delete;
+
+        /// pixels is level 0 and is not copied, it has to outlive the chain.
+        /// channels is 3 (RGB) or 4 (RGBA), sides up to MaxImageDimension. The smaller
+        /// levels come from buffers when given and go back to it on Clear, each level
+        /// starts 64 byte aligned.
+        ImageStatus Build(const uint8_t* pixels, uint32_t width, uint32_t height, size_t rowStride, uint32_t channels,
+                          MipFilter filter, MipColorSpace colorSpace, ThreadPool* pool = nullptr,
+                          PixelBufferPool* buffers = nullptr);
+
+        void Clear();
+
+        uint32_t LevelCount() const { return (uint32_t)levels.size(); }
+        const MipLevel& Level(uint32_t index) const { return levels[index]; }
+        uint32_t Channels() const { return channels; }
+        /// memory behind the smaller levels
+        size_t StorageBytes() const { return storage.Capacity(); }
+
+        /// floor(log2(max(width, height))) + 1
+        static uint32_t FullLevelCount(uint32_t width, uint32_t height);
+
+    private:
+        std::vector<MipLevel> levels;
+        PixelBuffer storage;
+        uint32_t channels;
+    };
+
+} // namespace mj2
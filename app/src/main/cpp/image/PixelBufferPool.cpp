@@ -0,0 +1,237 @@
+#include "PixelBufferPool.hpp"
+
+#include <cstdlib>
+
+namespace mj2
+{
+    /// a cache line, and enough for any SIMD load the pixel kernels do
+    static const size_t BufferAlignment = 64;
+
+    static uint8_t* AllocateAligned(size_t bytes)
+    {
+        void* data = nullptr;
+        return posix_memalign(&data, BufferAlignment, bytes) == 0 ? (uint8_t*)data : nullptr;
+    }
+
+    static void RaiseTo(std::atomic<size_t>& peak, size_t value)
+    {
+        size_t current = peak.load(std::memory_order_relaxed);
+        while (value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    //-------------------------------------------------------------
+    // PixelBuffer
+    //-------------------------------------------------------------
+    PixelBuffer::PixelBuffer()
+            : data(nullptr)
+            , size(0)
+            , capacity(0)
+            , pool(nullptr)
+    {
+    }
+
+    PixelBuffer::~PixelBuffer()
+    {
+        Release();
+    }
+
+    PixelBuffer::PixelBuffer(PixelBuffer&& other)
+            : data(other.data)
+            , size(other.size)
+            , capacity(other.capacity)
+            , pool(other.pool)
+    {
+        other.data = nullptr;
+        other.size = 0;
+        other.capacity = 0;
+        other.pool = nullptr;
+    }
+
+    PixelBuffer& PixelBuffer::operator=(PixelBuffer&& other)
+    {
+        if (this != &other) {
+            Release();
+            data = other.data;
+            size = other.size;
+            capacity = other.capacity;
+            pool = other.pool;
+            other.data = nullptr;
+            other.size = 0;
+            other.capacity = 0;
+            other.pool = nullptr;
+        }
+        return *this;
+    }
+
+    PixelBuffer PixelBuffer::Allocate(size_t bytes)
+    {
+        PixelBuffer buffer;
+        buffer.data = AllocateAligned(bytes ? bytes : 1);
+        if (buffer.data) {
+            buffer.size = bytes;
+            buffer.capacity = bytes;
+        }
+        return buffer;
+    }
+
+    void PixelBuffer::Release()
+    {
+        if (data) {
+            if (pool) {
+                pool->Release(data, capacity);
+            } else {
+                free(data);
+            }
+        }
+        data = nullptr;
+        size = 0;
+        capacity = 0;
+        pool = nullptr;
+    }
+
+    //-------------------------------------------------------------
+    // PixelBufferPool
+    //-------------------------------------------------------------
+    PixelBufferPool::PixelBufferPool(size_t maxRetainedBytes)
+            : maxRetainedBytes(maxRetainedBytes)
+            , inUseBytes(0)
+            , retainedBytes(0)
+            , peakInUseBytes(0)
+            , peakTotalBytes(0)
+            , acquires(0)
+            , reuses(0)
+            , allocations(0)
+            , oversize(0)
+    {
+    }
+
+    PixelBufferPool::~PixelBufferPool()
+    {
+        Trim();
+    }
+
+    uint32_t PixelBufferPool::ClassIndex(size_t bytes)
+    {
+        if (bytes <= SmallestClass) {
+            return 0;
+        }
+        // doubling d spans (SmallestClass << d, SmallestClass << (d + 1)] in four steps
+        uint32_t doubling = 0;
+        for (size_t above = (bytes - 1) / SmallestClass; above > 1; above >>= 1) {
+            doubling++;
+        }
+        const size_t base = SmallestClass << doubling;
+        const size_t step = base / ClassesPerDoubling;
+        return doubling * ClassesPerDoubling + (uint32_t)((bytes - base + step - 1) / step);
+    }
+
+    size_t PixelBufferPool::ClassBytes(uint32_t index)
+    {
+        const uint32_t doubling = index / ClassesPerDoubling;
+        const size_t base = SmallestClass << doubling;
+        return base + (index % ClassesPerDoubling) * (base / ClassesPerDoubling);
+    }
+
+    size_t PixelBufferPool::ClassSize(size_t bytes)
+    {
+        const uint32_t index = ClassIndex(bytes);
+        return index < ClassCount ? ClassBytes(index) : bytes;
+    }
+
+    void PixelBufferPool::AddInUse(size_t bytes)
+    {
+        const size_t inUse = inUseBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        RaiseTo(peakInUseBytes, inUse);
+        RaiseTo(peakTotalBytes, inUse + retainedBytes.load(std::memory_order_relaxed));
+    }
+
+    PixelBuffer PixelBufferPool::Acquire(size_t bytes)
+    {
+        acquires.fetch_add(1, std::memory_order_relaxed);
+
+        PixelBuffer buffer;
+        const uint32_t index = ClassIndex(bytes);
+        const size_t capacity = index < ClassCount ? ClassBytes(index) : bytes;
+        if (index < ClassCount) {
+            SizeClass& sizeClass = classes[index];
+            std::lock_guard<std::mutex> lock(sizeClass.mutex);
+            if (!sizeClass.free.empty()) {
+                buffer.data = sizeClass.free.back();
+                sizeClass.free.pop_back();
+            }
+        } else {
+            oversize.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        if (buffer.data) {
+            reuses.fetch_add(1, std::memory_order_relaxed);
+            retainedBytes.fetch_sub(capacity, std::memory_order_relaxed);
+        } else {
+            buffer.data = AllocateAligned(capacity ? capacity : 1);
+            if (!buffer.data) {
+                return buffer;
+            }
+            allocations.fetch_add(1, std::memory_order_relaxed);
+        }
+        buffer.size = bytes;
+        buffer.capacity = capacity;
+        buffer.pool = this;
+        AddInUse(capacity);
+        return buffer;
+    }
+
+    void PixelBufferPool::Release(uint8_t* data, size_t capacity)
+    {
+        inUseBytes.fetch_sub(capacity, std::memory_order_relaxed);
+
+        const uint32_t index = ClassIndex(capacity);
+        if (index < ClassCount) {
+            // reserve the room first so concurrent releases cannot overshoot the cap together
+            const size_t retained = retainedBytes.fetch_add(capacity, std::memory_order_relaxed) + capacity;
+            if (retained <= maxRetainedBytes) {
+                SizeClass& sizeClass = classes[index];
+                std::lock_guard<std::mutex> lock(sizeClass.mutex);
+                sizeClass.free.push_back(data);
+                return;
+            }
+            retainedBytes.fetch_sub(capacity, std::memory_order_relaxed);
+        }
+        free(data);
+    }
+
+    void PixelBufferPool::Trim()
+    {
+        for (uint32_t i = 0; i < ClassCount; i++) {
+            SizeClass& sizeClass = classes[i];
+            std::lock_guard<std::mutex> lock(sizeClass.mutex);
+            for (uint8_t* data : sizeClass.free) {
+                free(data);
+            }
+            retainedBytes.fetch_sub(sizeClass.free.size() * ClassBytes(i), std::memory_order_relaxed);
+            sizeClass.free.clear();
+            sizeClass.free.shrink_to_fit();
+        }
+    }
+
+    PixelBufferPoolStats PixelBufferPool::Stats() const
+    {
+        PixelBufferPoolStats stats;
+        stats.inUseBytes = inUseBytes.load(std::memory_order_relaxed);
+        stats.peakInUseBytes = peakInUseBytes.load(std::memory_order_relaxed);
+        stats.retainedBytes = retainedBytes.load(std::memory_order_relaxed);
+        stats.peakTotalBytes = peakTotalBytes.load(std::memory_order_relaxed);
+        stats.acquires = acquires.load(std::memory_order_relaxed);
+        stats.reuses = reuses.load(std::memory_order_relaxed);
+        stats.allocations = allocations.load(std::memory_order_relaxed);
+        stats.oversize = oversize.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    void PixelBufferPool::ResetPeaks()
+    {
+        const size_t inUse = inUseBytes.load(std::memory_order_relaxed);
+        peakInUseBytes.store(inUse, std::memory_order_relaxed);
+        peakTotalBytes.store(inUse + retainedBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+}
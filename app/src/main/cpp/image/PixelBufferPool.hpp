@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace mj2 {
+
+    class PixelBufferPool;
+
+    //-------------------------------------------------------------
+    // PixelBuffer
+    //-------------------------------------------------------------
+    /// Move-only staging memory, 64 byte aligned. Goes back to its pool when released or
+    /// destroyed, from any thread; buffers without a pool are simply freed.
+    class PixelBuffer {
+    public:
+        PixelBuffer();
+        ~PixelBuffer();
+
+        PixelBuffer(PixelBuffer&& other);
+        PixelBuffer& operator=(PixelBuffer&& other);
+        PixelBuffer(const PixelBuffer&) = delete;
+        PixelBuffer& operator=(const PixelBuffer&) = delete;
+
+        /// Unpooled, for callers without a PixelBufferPool. Data() is nullptr when out of memory.
+        static PixelBuffer Allocate(size_t bytes);
+
+        uint8_t* Data() const { return data; }
+        /// the bytes asked for
+        size_t Size() const { return size; }
+        /// the bytes behind Data(), the size class for pooled buffers
+        size_t Capacity() const { return capacity; }
+
+        void Release();
+
+    private:
+        friend class PixelBufferPool;
+
+        uint8_t* data;
+        size_t size;
+        size_t capacity;
+        PixelBufferPool* pool;
+    };
+
+    struct PixelBufferPoolStats {
+    public:
+        size_t inUseBytes;      // capacity of the buffers handed out right now
+        size_t peakInUseBytes;  // high-water mark of inUseBytes
+        size_t retainedBytes;   // free buffers kept for reuse
+        size_t peakTotalBytes;  // high-water mark of inUseBytes + retainedBytes, the footprint
+        uint64_t acquires;
+        uint64_t reuses;        // acquires served from a free list
+        uint64_t allocations;   // acquires that went to the system allocator
+        uint64_t oversize;      // larger than the biggest size class, never retained
+    };
+
+    //-------------------------------------------------------------
+    // PixelBufferPool
+    //-------------------------------------------------------------
+    /////
+    // Recycles the large short-lived buffers of the load path (mip levels today) instead
+    // of going to malloc for every image, which keeps the heap flat while streaming.
+    //
+    // Sizes are rounded up to a class, four per power of two from 4 KB to 64 MB, so at
+    // most 25% is wasted and a buffer fits any request of its class. Each class has its
+    // own lock and LIFO free list (the most recently used buffer is the warmest), so the
+    // workers acquiring and the GL thread releasing rarely meet. Free buffers are kept up
+    // to maxRetainedBytes, beyond that a release frees; bigger requests always go to the
+    // system. Every buffer has to be released before the pool is destroyed.
+    /////
+    class PixelBufferPool {
+    public:
+        explicit PixelBufferPool(size_t maxRetainedBytes = 64 * 1024 * 1024);
+        ~PixelBufferPool();
+
+        PixelBufferPool(const PixelBufferPool&) = delete;
+        PixelBufferPool& operator=(const PixelBufferPool&) = delete;
+
+        /// Any thread. Data() is nullptr when out of memory, the contents are undefined.
+        PixelBuffer Acquire(size_t bytes);
+
+        /// Frees every retained buffer, for onTrimMemory and the like
+        void Trim();
+
+        PixelBufferPoolStats Stats() const;
+        /// peaks restart from the current values, e.g. at a level change
+        void ResetPeaks();
+
+        /// what a request of bytes really takes, bytes itself past the largest class
+        static size_t ClassSize(size_t bytes);
+
+    private:
+        friend class PixelBuffer;
+
+        static const size_t SmallestClass = 4096;
+        static const uint32_t ClassesPerDoubling = 4;
+        static const uint32_t ClassCount = 14 * ClassesPerDoubling + 1;  // up to 64 MB
+
+        struct SizeClass {
+        public:
+            std::mutex mutex;
+            std::vector<uint8_t*> free;
+        };
+
+        static uint32_t ClassIndex(size_t bytes);
+        static size_t ClassBytes(uint32_t index);
+
+        void Release(uint8_t* data, size_t capacity);
+        void AddInUse(size_t bytes);
+
+        SizeClass classes[ClassCount];
+        const size_t maxRetainedBytes;
+        std::atomic<size_t> inUseBytes;
+        std::atomic<size_t> retainedBytes;
+        std::atomic<size_t> peakInUseBytes;
+        std::atomic<size_t> peakTotalBytes;
+        std::atomic<uint64_t> acquires;
+        std::atomic<uint64_t> reuses;
+        std::atomic<uint64_t> allocations;
+        std::atomic<uint64_t> oversize;
+    };
+
+} // namespace mj2
@@ -0,0 +1,250 @@
+#include "PixelConvert.hpp"
+
+#include <atomic>
+
+#include "PixelKernels.hpp"
+#include "../math/SIMD_Dispatch.hpp"
+
+namespace mj2
+{
+    //-------------------------------------------------------------
+    // Scalar row kernels
+    //-------------------------------------------------------------
+    void BGRToRGBScalar(uint8_t* dst, const uint8_t* src, size_t count)
+    {
+        for (size_t i = 0; i < count; i++, dst += 3, src += 3) {
+            const uint8_t b = src[0];
+            const uint8_t g = src[1];
+            const uint8_t r = src[2];
+            dst[0] = r;
+            dst[1] = g;
+            dst[2] = b;
+        }
+    }
+
+    void BGRToRGBAScalar(uint8_t* dst, const uint8_t* src, size_t count)
+    {
+        for (size_t i = 0; i < count; i++, dst += 4, src += 3) {
+            dst[0] = src[2];
+            dst[1] = src[1];
+            dst[2] = src[0];
+            dst[3] = 0xFF;
+        }
+    }
+
+    void BGRAToRGBAScalar(uint8_t* dst, const uint8_t* src, size_t count)
+    {
+        for (size_t i = 0; i < count; i++, dst += 4, src += 4) {
+            const uint8_t b = src[0];
+            const uint8_t g = src[1];
+            const uint8_t r = src[2];
+            const uint8_t a = src[3];
+            dst[0] = r;
+            dst[1] = g;
+            dst[2] = b;
+            dst[3] = a;
+        }
+    }
+
+    void BGRXToRGBAScalar(uint8_t* dst, const uint8_t* src, size_t count)
+    {
+        for (size_t i = 0; i < count; i++, dst += 4, src += 4) {
+            const uint8_t b = src[0];
+            const uint8_t g = src[1];
+            const uint8_t r = src[2];
+            dst[0] = r;
+            dst[1] = g;
+            dst[2] = b;
+            dst[3] = 0xFF;
+        }
+    }
+
+    void RGBAToRGB565Scalar(uint16_t* dst, const uint8_t* src, size_t count)
+    {
+        for (size_t i = 0; i < count; i++, src += 4) {
+            dst[i] = (uint16_t)(((src[0] >> 3) << 11) | ((src[1] >> 2) << 5) | (src[2] >> 3));
+        }
+    }
+
+    void RGBAToRGBA4444Scalar(uint16_t* dst, const uint8_t* src, size_t count)
+    {
+        for (size_t i = 0; i < count; i++, src += 4) {
+            dst[i] = (uint16_t)(((src[0] >> 4) << 12) | ((src[1] >> 4) << 8) | ((src[2] >> 4) << 4) | (src[3] >> 4));
+        }
+    }
+
+    /// c * a / 255 rounded, exact for all 8 bit inputs
+    static inline uint8_t MultiplyUnorm8(uint32_t c, uint32_t a)
+    {
+        const uint32_t t = c * a + 128;
+        return (uint8_t)((t + (t >> 8)) >> 8);
+    }
+
+    void PremultiplyRGBAScalar(uint8_t* dst, const uint8_t* src, size_t count)
+    {
+        for (size_t i = 0; i < count; i++, dst += 4, src += 4) {
+            const uint8_t a = src[3];
+            dst[0] = MultiplyUnorm8(src[0], a);
+            dst[1] = MultiplyUnorm8(src[1], a);
+            dst[2] = MultiplyUnorm8(src[2], a);
+            dst[3] = a;
+        }
+    }
+
+    template<int Channels>
+    static inline void BoxDownsample(uint8_t* dst, const uint8_t* row0, const uint8_t* row1, size_t count)
+    {
+        for (size_t i = 0; i < count; i++, dst += Channels, row0 += 2 * Channels, row1 += 2 * Channels) {
+            for (int c = 0; c < Channels; c++) {
+                dst[c] = (uint8_t)((row0[c] + row0[c + Channels] + row1[c] + row1[c + Channels] + 2) >> 2);
+            }
+        }
+    }
+
+    void BoxDownsampleRGBScalar(uint8_t* dst, const uint8_t* row0, const uint8_t* row1, size_t count)
+    {
+        BoxDownsample<3>(dst, row0, row1, count);
+    }
+
+    void BoxDownsampleRGBAScalar(uint8_t* dst, const uint8_t* row0, const uint8_t* row1, size_t count)
+    {
+        BoxDownsample<4>(dst, row0, row1, count);
+    }
+
+    //-------------------------------------------------------------
+    // Dispatch
+    //-------------------------------------------------------------
+    static const PixelKernels ScalarKernels = {
+        PixelKernelLevel_Scalar, "scalar",
+        BGRToRGBScalar,
+        BGRToRGBAScalar,
+        BGRAToRGBAScalar,
+        BGRXToRGBAScalar,
+        RGBAToRGB565Scalar,
+        RGBAToRGBA4444Scalar,
+        PremultiplyRGBAScalar,
+        BoxDownsampleRGBScalar,
+        BoxDownsampleRGBAScalar,
+    };
+
+#if defined(MJ2_HAS_SSSE3_PIXEL_KERNELS)
+    static const PixelKernels SSSE3Kernels = {
+        PixelKernelLevel_SSSE3, "SSSE3",
+        BGRToRGBSSSE3,
+        BGRToRGBASSSE3,
+        BGRAToRGBASSSE3,
+        BGRXToRGBASSSE3,
+        RGBAToRGB565SSSE3,
+        RGBAToRGBA4444SSSE3,
+        PremultiplyRGBASSSE3,
+        BoxDownsampleRGBSSSE3,
+        BoxDownsampleRGBASSSE3,
+    };
+#endif
+
+#if defined(MJ2_HAS_NEON_PIXEL_KERNELS)
+    static const PixelKernels NEONKernels = {
+        PixelKernelLevel_NEON, "NEON",
+        BGRToRGBNEON,
+        BGRToRGBANEON,
+        BGRAToRGBANEON,
+        BGRXToRGBANEON,
+        RGBAToRGB565NEON,
+        RGBAToRGBA4444NEON,
+        PremultiplyRGBANEON,
+        BoxDownsampleRGBNEON,
+        BoxDownsampleRGBANEON,
+    };
+#endif
+
+    static const PixelKernels* SelectPixelKernels(PixelKernelLevel level)
+    {
+        switch (level) {
+            case PixelKernelLevel_Scalar:
+                return &ScalarKernels;
+#if defined(MJ2_HAS_SSSE3_PIXEL_KERNELS)
+            case PixelKernelLevel_SSSE3:
+                return GetCpuFeatures().ssse3 ? &SSSE3Kernels : nullptr;
+#endif
+#if defined(MJ2_HAS_NEON_PIXEL_KERNELS)
+            case PixelKernelLevel_NEON:
+                return GetCpuFeatures().neon ? &NEONKernels : nullptr;
+#endif
+            default:
+                return nullptr;
+        }
+    }
+
+    static const PixelKernels* SelectBestPixelKernels()
+    {
+        const PixelKernels* kernels = SelectPixelKernels(PixelKernelLevel_NEON);
+        if (!kernels)
+            kernels = SelectPixelKernels(PixelKernelLevel_SSSE3);
+        return kernels ? kernels : &ScalarKernels;
+    }
+
+    static std::atomic<const PixelKernels*> gPixelKernels(nullptr);
+
+    const PixelKernels& GetPixelKernels()
+    {
+        const PixelKernels* kernels = gPixelKernels.load(std::memory_order_acquire);
+        if (!kernels) {
+            // racing threads pick the same table, so a plain store is enough
+            kernels = SelectBestPixelKernels();
+            gPixelKernels.store(kernels, std::memory_order_release);
+        }
+        return *kernels;
+    }
+
+    bool SetPixelKernelLevel(PixelKernelLevel level)
+    {
+        const PixelKernels* kernels = SelectPixelKernels(level);
+        if (!kernels)
+            return false;
+        gPixelKernels.store(kernels, std::memory_order_release);
+        return true;
+    }
+
+    //-------------------------------------------------------------
+    // Row walkers
+    //-------------------------------------------------------------
+    template<typename Dst, typename Kernel>
+    static inline void ForEachRow(Dst* dst, size_t dstStride, const uint8_t* src, size_t srcStride, uint32_t width, uint32_t height, Kernel kernel)
+    {
+        uint8_t* dstRow = (uint8_t*)dst;
+        for (uint32_t y = 0; y < height; y++, dstRow += dstStride, src += srcStride) {
+            kernel((Dst*)dstRow, src, width);
+        }
+    }
+
+    void ConvertBGRToRGB(uint8_t* dst, size_t dstStride, const uint8_t* src, size_t srcStride, uint32_t width, uint32_t height)
+    {
+        ForEachRow(dst, dstStride, src, srcStride, width, height, GetPixelKernels().BGRToRGB);
+    }
+
+    void ConvertBGRToRGBA(uint8_t* dst, size_t dstStride, const uint8_t* src, size_t srcStride, uint32_t width, uint32_t height)
+    {
+        ForEachRow(dst, dstStride, src, srcStride, width, height, GetPixelKernels().BGRToRGBA);
+    }
+
+    void ConvertBGRAToRGBA(uint8_t* dst, size_t dstStride, const uint8_t* src, size_t srcStride, uint32_t width, uint32_t height, bool keepAlpha)
+    {
+        const PixelKernels& kernels = GetPixelKernels();
+        ForEachRow(dst, dstStride, src, srcStride, width, height, keepAlpha ? kernels.BGRAToRGBA : kernels.BGRXToRGBA);
+    }
+
+    void ConvertRGBAToRGB565(uint16_t* dst, size_t dstStride, const uint8_t* src, size_t srcStride, uint32_t width, uint32_t height)
+    {
+        ForEachRow(dst, dstStride, src, srcStride, width, height, GetPixelKernels().RGBAToRGB565);
+    }
+
+    void ConvertRGBAToRGBA4444(uint16_t* dst, size_t dstStride, const uint8_t* src, size_t srcStride, uint32_t width, uint32_t height)
+    {
+        ForEachRow(dst, dstStride, src, srcStride, width, height, GetPixelKernels().RGBAToRGBA4444);
+    }
+
+    void PremultiplyAlpha(uint8_t* dst, size_t dstStride, const uint8_t* src, size_t srcStride, uint32_t width, uint32_t height)
+    {
+        ForEachRow(dst, dstStride, src, srcStride, width, height, GetPixelKernels().PremultiplyRGBA);
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace mj2 {
+
+    /////
+    // Pixel format conversion over rows of pixels. Strides are in bytes so padded rows
+    // (BMP, GL_UNPACK_ALIGNMENT) are walked correctly and the padding is never touched.
+    // Byte order names are memory order, RGBA is R at the lowest address.
+    // 16 bit outputs are GL_UNSIGNED_SHORT_5_6_5 / _4_4_4_4 in native endianness.
+    /////
+
+    /// dst may be src, for in place conversion of a mapped file
+    void ConvertBGRToRGB(uint8_t* dst, size_t dstStride, const uint8_t* src, size_t srcStride, uint32_t width, uint32_t height);
+
+    /// Opaque alpha. dst must not overlap src.
+    void ConvertBGRToRGBA(uint8_t* dst, size_t dstStride, const uint8_t* src, size_t srcStride, uint32_t width, uint32_t height);
+
+    /// dst may be src. Without keepAlpha the 4th byte is treated as unused (BI_RGB) and set opaque.
+    void ConvertBGRAToRGBA(uint8_t* dst, size_t dstStride, const uint8_t* src, size_t srcStride, uint32_t width, uint32_t height, bool keepAlpha);
+
+    /// Truncates to 5/6/5 bits, alpha is dropped. dst must not overlap src.
+    void ConvertRGBAToRGB565(uint16_t* dst, size_t dstStride, const uint8_t* src, size_t srcStride, uint32_t width, uint32_t height);
+
+    /// Truncates to 4 bits per channel. dst must not overlap src.
+    void ConvertRGBAToRGBA4444(uint16_t* dst, size_t dstStride, const uint8_t* src, size_t srcStride, uint32_t width, uint32_t height);
+
+    /// rgb * a / 255 rounded to nearest, alpha kept. dst may be src.
+    void PremultiplyAlpha(uint8_t* dst, size_t dstStride, const uint8_t* src, size_t srcStride, uint32_t width, uint32_t height);
+
+} // namespace mj2
@@ -0,0 +1,161 @@
+// Built with NEON enabled, see CMakeLists.txt. Only POD headers here, see PixelConvert_SSSE3.cpp.
+#include <arm_neon.h>
+
+#include "PixelKernels.hpp"
+
+namespace mj2
+{
+    void BGRToRGBNEON(uint8_t* dst, const uint8_t* src, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16, src += 48, dst += 48) {
+            const uint8x16x3_t bgr = vld3q_u8(src);
+            uint8x16x3_t rgb;
+            rgb.val[0] = bgr.val[2];
+            rgb.val[1] = bgr.val[1];
+            rgb.val[2] = bgr.val[0];
+            vst3q_u8(dst, rgb);
+        }
+
+        BGRToRGBScalar(dst, src, count - i);
+    }
+
+    void BGRToRGBANEON(uint8_t* dst, const uint8_t* src, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16, src += 48, dst += 64) {
+            const uint8x16x3_t bgr = vld3q_u8(src);
+            uint8x16x4_t rgba;
+            rgba.val[0] = bgr.val[2];
+            rgba.val[1] = bgr.val[1];
+            rgba.val[2] = bgr.val[0];
+            rgba.val[3] = vdupq_n_u8(0xFF);
+            vst4q_u8(dst, rgba);
+        }
+
+        BGRToRGBAScalar(dst, src, count - i);
+    }
+
+    template<bool KeepAlpha>
+    static inline void SwapRedBlue32(uint8_t* dst, const uint8_t* src, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16, src += 64, dst += 64) {
+            const uint8x16x4_t bgra = vld4q_u8(src);
+            uint8x16x4_t rgba;
+            rgba.val[0] = bgra.val[2];
+            rgba.val[1] = bgra.val[1];
+            rgba.val[2] = bgra.val[0];
+            rgba.val[3] = KeepAlpha ? bgra.val[3] : vdupq_n_u8(0xFF);
+            vst4q_u8(dst, rgba);
+        }
+
+        if (KeepAlpha)
+            BGRAToRGBAScalar(dst, src, count - i);
+        else
+            BGRXToRGBAScalar(dst, src, count - i);
+    }
+
+    void BGRAToRGBANEON(uint8_t* dst, const uint8_t* src, size_t count)
+    {
+        SwapRedBlue32<true>(dst, src, count);
+    }
+
+    void BGRXToRGBANEON(uint8_t* dst, const uint8_t* src, size_t count)
+    {
+        SwapRedBlue32<false>(dst, src, count);
+    }
+
+    /////
+    // Channels are widened into the top byte of a 16 bit lane and shifted in from the
+    // left with vsri, which keeps the top bits already placed: r 15-11, g 10-5, b 4-0.
+    /////
+    void RGBAToRGB565NEON(uint16_t* dst, const uint8_t* src, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8, src += 32) {
+            const uint8x8x4_t rgba = vld4_u8(src);
+            uint16x8_t packed = vshll_n_u8(rgba.val[0], 8);
+            packed = vsriq_n_u16(packed, vshll_n_u8(rgba.val[1], 8), 5);
+            packed = vsriq_n_u16(packed, vshll_n_u8(rgba.val[2], 8), 11);
+            vst1q_u16(dst + i, packed);
+        }
+
+        RGBAToRGB565Scalar(dst + i, src, count - i);
+    }
+
+    void RGBAToRGBA4444NEON(uint16_t* dst, const uint8_t* src, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8, src += 32) {
+            const uint8x8x4_t rgba = vld4_u8(src);
+            uint16x8_t packed = vshll_n_u8(rgba.val[0], 8);
+            packed = vsriq_n_u16(packed, vshll_n_u8(rgba.val[1], 8), 4);
+            packed = vsriq_n_u16(packed, vshll_n_u8(rgba.val[2], 8), 8);
+            packed = vsriq_n_u16(packed, vshll_n_u8(rgba.val[3], 8), 12);
+            vst1q_u16(dst + i, packed);
+        }
+
+        RGBAToRGBA4444Scalar(dst + i, src, count - i);
+    }
+
+    /// c * a / 255 rounded: vraddhn(t, t >> 8 rounded) is (t + ((t + 128) >> 8) + 128) >> 8
+    static inline uint8x8_t MultiplyUnorm8x8(uint8x8_t c, uint8x8_t a)
+    {
+        const uint16x8_t t = vmull_u8(c, a);
+        return vraddhn_u16(t, vrshrq_n_u16(t, 8));
+    }
+
+    void PremultiplyRGBANEON(uint8_t* dst, const uint8_t* src, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8, src += 32, dst += 32) {
+            uint8x8x4_t rgba = vld4_u8(src);
+            rgba.val[0] = MultiplyUnorm8x8(rgba.val[0], rgba.val[3]);
+            rgba.val[1] = MultiplyUnorm8x8(rgba.val[1], rgba.val[3]);
+            rgba.val[2] = MultiplyUnorm8x8(rgba.val[2], rgba.val[3]);
+            vst4_u8(dst, rgba);
+        }
+
+        PremultiplyRGBAScalar(dst, src, count - i);
+    }
+
+    /// (a + b + c + d + 2) >> 2 of the horizontal pairs of one channel of two rows
+    static inline uint8x8_t BoxChannel(uint8x16_t row0, uint8x16_t row1)
+    {
+        return vrshrn_n_u16(vpadalq_u8(vpaddlq_u8(row0), row1), 2);
+    }
+
+    void BoxDownsampleRGBNEON(uint8_t* dst, const uint8_t* row0, const uint8_t* row1, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8, row0 += 48, row1 += 48, dst += 24) {
+            const uint8x16x3_t a = vld3q_u8(row0);
+            const uint8x16x3_t b = vld3q_u8(row1);
+            uint8x8x3_t rgb;
+            rgb.val[0] = BoxChannel(a.val[0], b.val[0]);
+            rgb.val[1] = BoxChannel(a.val[1], b.val[1]);
+            rgb.val[2] = BoxChannel(a.val[2], b.val[2]);
+            vst3_u8(dst, rgb);
+        }
+
+        BoxDownsampleRGBScalar(dst, row0, row1, count - i);
+    }
+
+    void BoxDownsampleRGBANEON(uint8_t* dst, const uint8_t* row0, const uint8_t* row1, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8, row0 += 64, row1 += 64, dst += 32) {
+            const uint8x16x4_t a = vld4q_u8(row0);
+            const uint8x16x4_t b = vld4q_u8(row1);
+            uint8x8x4_t rgba;
+            rgba.val[0] = BoxChannel(a.val[0], b.val[0]);
+            rgba.val[1] = BoxChannel(a.val[1], b.val[1]);
+            rgba.val[2] = BoxChannel(a.val[2], b.val[2]);
+            rgba.val[3] = BoxChannel(a.val[3], b.val[3]);
+            vst4_u8(dst, rgba);
+        }
+
+        BoxDownsampleRGBAScalar(dst, row0, row1, count - i);
+    }
+}
@@ -0,0 +1,229 @@
+// Built with -mssse3, only entered through GetPixelKernels once CPUID reports SSSE3.
+// Only POD headers here, so no inline function is emitted with SSSE3 instructions
+// and then picked by the linker for the baseline translation units.
+#include <tmmintrin.h>
+
+#include "PixelKernels.hpp"
+
+// pshufb writes zero for a mask byte with the high bit set
+#define Z -1
+
+namespace mj2
+{
+    static inline __m128i Load16(const uint8_t* p)
+    {
+        return _mm_loadu_si128((const __m128i*)p);
+    }
+
+    static inline void Store16(uint8_t* p, __m128i v)
+    {
+        _mm_storeu_si128((__m128i*)p, v);
+    }
+
+    /////
+    // 16 pixels are 48 bytes, a b c. Swapping bytes 0 and 2 of every pixel moves three
+    // bytes across register boundaries (out 15 <- b1, out 17 <- a15, out 30 <- c0,
+    // out 32 <- b14), those are OR'ed in from the neighbour with a second shuffle.
+    /////
+    void BGRToRGBSSSE3(uint8_t* dst, const uint8_t* src, size_t count)
+    {
+        const __m128i maskA = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, Z);
+        const __m128i maskAFromB = _mm_setr_epi8(Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, 1);
+        const __m128i maskB = _mm_setr_epi8(0, Z, 4, 3, 2, 7, 6, 5, 10, 9, 8, 13, 12, 11, Z, 15);
+        const __m128i maskBFromA = _mm_setr_epi8(Z, 15, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z);
+        const __m128i maskBFromC = _mm_setr_epi8(Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, 0, Z);
+        const __m128i maskC = _mm_setr_epi8(Z, 3, 2, 1, 6, 5, 4, 9, 8, 7, 12, 11, 10, 15, 14, 13);
+        const __m128i maskCFromB = _mm_setr_epi8(14, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z);
+
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16, src += 48, dst += 48) {
+            const __m128i a = Load16(src);
+            const __m128i b = Load16(src + 16);
+            const __m128i c = Load16(src + 32);
+
+            const __m128i outA = _mm_or_si128(_mm_shuffle_epi8(a, maskA), _mm_shuffle_epi8(b, maskAFromB));
+            __m128i outB = _mm_or_si128(_mm_shuffle_epi8(b, maskB), _mm_shuffle_epi8(a, maskBFromA));
+            outB = _mm_or_si128(outB, _mm_shuffle_epi8(c, maskBFromC));
+            const __m128i outC = _mm_or_si128(_mm_shuffle_epi8(c, maskC), _mm_shuffle_epi8(b, maskCFromB));
+
+            Store16(dst, outA);
+            Store16(dst + 16, outB);
+            Store16(dst + 32, outC);
+        }
+
+        BGRToRGBScalar(dst, src, count - i);
+    }
+
+    void BGRToRGBASSSE3(uint8_t* dst, const uint8_t* src, size_t count)
+    {
+        const __m128i mask = _mm_setr_epi8(2, 1, 0, Z, 5, 4, 3, Z, 8, 7, 6, Z, 11, 10, 9, Z);
+        const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16, src += 48, dst += 64) {
+            const __m128i a = Load16(src);
+            const __m128i b = Load16(src + 16);
+            const __m128i c = Load16(src + 32);
+
+            // pixels 0-3 start at byte 0, 4-7 at 12, 8-11 at 24, 12-15 at 36
+            Store16(dst, _mm_or_si128(_mm_shuffle_epi8(a, mask), alpha));
+            Store16(dst + 16, _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(b, a, 12), mask), alpha));
+            Store16(dst + 32, _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(c, b, 8), mask), alpha));
+            Store16(dst + 48, _mm_or_si128(_mm_shuffle_epi8(_mm_srli_si128(c, 4), mask), alpha));
+        }
+
+        BGRToRGBAScalar(dst, src, count - i);
+    }
+
+    template<bool KeepAlpha>
+    static inline void SwapRedBlue32(uint8_t* dst, const uint8_t* src, size_t count)
+    {
+        const __m128i mask = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+        const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4, src += 16, dst += 16) {
+            __m128i v = _mm_shuffle_epi8(Load16(src), mask);
+            if (!KeepAlpha)
+                v = _mm_or_si128(v, alpha);
+            Store16(dst, v);
+        }
+
+        if (KeepAlpha)
+            BGRAToRGBAScalar(dst, src, count - i);
+        else
+            BGRXToRGBAScalar(dst, src, count - i);
+    }
+
+    void BGRAToRGBASSSE3(uint8_t* dst, const uint8_t* src, size_t count)
+    {
+        SwapRedBlue32<true>(dst, src, count);
+    }
+
+    void BGRXToRGBASSSE3(uint8_t* dst, const uint8_t* src, size_t count)
+    {
+        SwapRedBlue32<false>(dst, src, count);
+    }
+
+    /// low 16 bits of the four 32 bit lanes of lo and hi, as eight 16 bit lanes
+    static inline __m128i PackLow16(__m128i lo, __m128i hi)
+    {
+        const __m128i mask = _mm_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, Z, Z, Z, Z, Z, Z, Z, Z);
+        return _mm_unpacklo_epi64(_mm_shuffle_epi8(lo, mask), _mm_shuffle_epi8(hi, mask));
+    }
+
+    /// pixel as a 32 bit lane is r | g << 8 | b << 16 | a << 24
+    static inline __m128i PackRGB565(__m128i v)
+    {
+        const __m128i r = _mm_slli_epi32(_mm_and_si128(v, _mm_set1_epi32(0xF8)), 8);
+        const __m128i g = _mm_and_si128(_mm_srli_epi32(v, 5), _mm_set1_epi32(0x7E0));
+        const __m128i b = _mm_and_si128(_mm_srli_epi32(v, 19), _mm_set1_epi32(0x1F));
+        return _mm_or_si128(_mm_or_si128(r, g), b);
+    }
+
+    static inline __m128i PackRGBA4444(__m128i v)
+    {
+        const __m128i r = _mm_slli_epi32(_mm_and_si128(v, _mm_set1_epi32(0xF0)), 8);
+        const __m128i g = _mm_and_si128(_mm_srli_epi32(v, 4), _mm_set1_epi32(0xF00));
+        const __m128i b = _mm_and_si128(_mm_srli_epi32(v, 16), _mm_set1_epi32(0xF0));
+        const __m128i a = _mm_srli_epi32(v, 28);
+        return _mm_or_si128(_mm_or_si128(r, g), _mm_or_si128(b, a));
+    }
+
+    void RGBAToRGB565SSSE3(uint16_t* dst, const uint8_t* src, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8, src += 32) {
+            const __m128i lo = PackRGB565(Load16(src));
+            const __m128i hi = PackRGB565(Load16(src + 16));
+            Store16((uint8_t*)(dst + i), PackLow16(lo, hi));
+        }
+
+        RGBAToRGB565Scalar(dst + i, src, count - i);
+    }
+
+    void RGBAToRGBA4444SSSE3(uint16_t* dst, const uint8_t* src, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8, src += 32) {
+            const __m128i lo = PackRGBA4444(Load16(src));
+            const __m128i hi = PackRGBA4444(Load16(src + 16));
+            Store16((uint8_t*)(dst + i), PackLow16(lo, hi));
+        }
+
+        RGBAToRGBA4444Scalar(dst + i, src, count - i);
+    }
+
+    /// c * a / 255 rounded on 16 bit lanes: t = c * a + 128, (t + (t >> 8)) >> 8
+    static inline __m128i MultiplyUnorm8x8(__m128i c, __m128i a)
+    {
+        const __m128i t = _mm_add_epi16(_mm_mullo_epi16(c, a), _mm_set1_epi16(128));
+        return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+    }
+
+    void PremultiplyRGBASSSE3(uint8_t* dst, const uint8_t* src, size_t count)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        // alpha of each pixel into its r, g, b lanes; the alpha lane gets 255 so it is kept
+        const __m128i alphaLo = _mm_setr_epi8(3, Z, 3, Z, 3, Z, Z, Z, 7, Z, 7, Z, 7, Z, Z, Z);
+        const __m128i alphaHi = _mm_setr_epi8(11, Z, 11, Z, 11, Z, Z, Z, 15, Z, 15, Z, 15, Z, Z, Z);
+        const __m128i keepAlpha = _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255);
+
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4, src += 16, dst += 16) {
+            const __m128i v = Load16(src);
+            const __m128i lo = _mm_unpacklo_epi8(v, zero);
+            const __m128i hi = _mm_unpackhi_epi8(v, zero);
+            const __m128i aLo = _mm_or_si128(_mm_shuffle_epi8(v, alphaLo), keepAlpha);
+            const __m128i aHi = _mm_or_si128(_mm_shuffle_epi8(v, alphaHi), keepAlpha);
+            Store16(dst, _mm_packus_epi16(MultiplyUnorm8x8(lo, aLo), MultiplyUnorm8x8(hi, aHi)));
+        }
+
+        PremultiplyRGBAScalar(dst, src, count - i);
+    }
+
+    /// sums of horizontal pixel pairs of 16 bytes, shuffled next to each other for pmaddubsw
+    static inline __m128i PairSums(__m128i v, __m128i pairs)
+    {
+        return _mm_maddubs_epi16(_mm_shuffle_epi8(v, pairs), _mm_set1_epi8(1));
+    }
+
+    static inline __m128i RoundQuarter(__m128i sum)
+    {
+        return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2);
+    }
+
+    /////
+    // 4 source pixels per 16 byte load give 2 output pixels (12 bytes); the loads overlap
+    // by 4 bytes and the 16 byte store spills 4 zeros into the next output pixels, which
+    // the next iteration or the scalar tail overwrites. Hence the margin in the loop test.
+    /////
+    void BoxDownsampleRGBSSSE3(uint8_t* dst, const uint8_t* row0, const uint8_t* row1, size_t count)
+    {
+        const __m128i pairs = _mm_setr_epi8(0, 3, 1, 4, 2, 5, 6, 9, 7, 10, 8, 11, Z, Z, Z, Z);
+        const __m128i compact = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 8, 9, 10, 11, 12, 13, Z, Z, Z, Z);
+
+        size_t i = 0;
+        for (; i + 6 <= count; i += 4, row0 += 24, row1 += 24, dst += 12) {
+            const __m128i lo = _mm_add_epi16(PairSums(Load16(row0), pairs), PairSums(Load16(row1), pairs));
+            const __m128i hi = _mm_add_epi16(PairSums(Load16(row0 + 12), pairs), PairSums(Load16(row1 + 12), pairs));
+            Store16(dst, _mm_shuffle_epi8(_mm_packus_epi16(RoundQuarter(lo), RoundQuarter(hi)), compact));
+        }
+
+        BoxDownsampleRGBScalar(dst, row0, row1, count - i);
+    }
+
+    void BoxDownsampleRGBASSSE3(uint8_t* dst, const uint8_t* row0, const uint8_t* row1, size_t count)
+    {
+        const __m128i pairs = _mm_setr_epi8(0, 4, 1, 5, 2, 6, 3, 7, 8, 12, 9, 13, 10, 14, 11, 15);
+
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4, row0 += 32, row1 += 32, dst += 16) {
+            const __m128i lo = _mm_add_epi16(PairSums(Load16(row0), pairs), PairSums(Load16(row1), pairs));
+            const __m128i hi = _mm_add_epi16(PairSums(Load16(row0 + 16), pairs), PairSums(Load16(row1 + 16), pairs));
+            Store16(dst, _mm_packus_epi16(RoundQuarter(lo), RoundQuarter(hi)));
+        }
+
+        BoxDownsampleRGBAScalar(dst, row0, row1, count - i);
+    }
+}
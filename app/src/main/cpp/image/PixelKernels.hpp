@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace mj2 {
+
+    enum PixelKernelLevel
+    {
+        PixelKernelLevel_Scalar = 0, PixelKernelLevel_SSSE3 = 1, PixelKernelLevel_NEON = 2
+    };
+
+    //-------------------------------------------------------------
+    // PixelKernels
+    //-------------------------------------------------------------
+    /// Row kernels of one backend, count is in pixels. Kept free of other mj2 headers so the
+    /// SSSE3 translation unit only sees POD types, see PixelConvert_SSSE3.cpp.
+    struct PixelKernels {
+    public:
+        PixelKernelLevel level;
+        const char* name;
+
+        void (*BGRToRGB)(uint8_t* dst, const uint8_t* src, size_t count);
+        void (*BGRToRGBA)(uint8_t* dst, const uint8_t* src, size_t count);
+        void (*BGRAToRGBA)(uint8_t* dst, const uint8_t* src, size_t count);
+        void (*BGRXToRGBA)(uint8_t* dst, const uint8_t* src, size_t count);
+        void (*RGBAToRGB565)(uint16_t* dst, const uint8_t* src, size_t count);
+        void (*RGBAToRGBA4444)(uint16_t* dst, const uint8_t* src, size_t count);
+        void (*PremultiplyRGBA)(uint8_t* dst, const uint8_t* src, size_t count);
+        /// (a + b + c + d + 2) / 4 over 2x2 blocks of row0 and row1, count output pixels
+        void (*BoxDownsampleRGB)(uint8_t* dst, const uint8_t* row0, const uint8_t* row1, size_t count);
+        void (*BoxDownsampleRGBA)(uint8_t* dst, const uint8_t* row0, const uint8_t* row1, size_t count);
+    };
+
+    /// Best backend for the running CPU, picked on first use
+    const PixelKernels& GetPixelKernels();
+
+    /// Force a backend, e.g. for benchmarks. Returns false if the CPU or build lacks it.
+    bool SetPixelKernelLevel(PixelKernelLevel level);
+
+    /// Backend row kernels. The SIMD ones finish their tails with the scalar kernels.
+    void BGRToRGBScalar(uint8_t* dst, const uint8_t* src, size_t count);
+    void BGRToRGBAScalar(uint8_t* dst, const uint8_t* src, size_t count);
+    void BGRAToRGBAScalar(uint8_t* dst, const uint8_t* src, size_t count);
+    void BGRXToRGBAScalar(uint8_t* dst, const uint8_t* src, size_t count);
+    void RGBAToRGB565Scalar(uint16_t* dst, const uint8_t* src, size_t count);
+    void RGBAToRGBA4444Scalar(uint16_t* dst, const uint8_t* src, size_t count);
+    void PremultiplyRGBAScalar(uint8_t* dst, const uint8_t* src, size_t count);
+    void BoxDownsampleRGBScalar(uint8_t* dst, const uint8_t* row0, const uint8_t* row1, size_t count);
+    void BoxDownsampleRGBAScalar(uint8_t* dst, const uint8_t* row0, const uint8_t* row1, size_t count);
+#if defined(__arm__) || defined(__aarch64__)
+#define MJ2_HAS_NEON_PIXEL_KERNELS 1
+    void BGRToRGBNEON(uint8_t* dst, const uint8_t* src, size_t count);
+    void BGRToRGBANEON(uint8_t* dst, const uint8_t* src, size_t count);
+    void BGRAToRGBANEON(uint8_t* dst, const uint8_t* src, size_t count);
+    void BGRXToRGBANEON(uint8_t* dst, const uint8_t* src, size_t count);
+    void RGBAToRGB565NEON(uint16_t* dst, const uint8_t* src, size_t count);
+    void RGBAToRGBA4444NEON(uint16_t* dst, const uint8_t* src, size_t count);
+    void PremultiplyRGBANEON(uint8_t* dst, const uint8_t* src, size_t count);
+    void BoxDownsampleRGBNEON(uint8_t* dst, const uint8_t* row0, const uint8_t* row1, size_t count);
+    void BoxDownsampleRGBANEON(uint8_t* dst, const uint8_t* row0, const uint8_t* row1, size_t count);
+#elif defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define MJ2_HAS_SSSE3_PIXEL_KERNELS 1
+    void BGRToRGBSSSE3(uint8_t* dst, const uint8_t* src, size_t count);
+    void BGRToRGBASSSE3(uint8_t* dst, const uint8_t* src, size_t count);
+    void BGRAToRGBASSSE3(uint8_t* dst, const uint8_t* src, size_t count);
+    void BGRXToRGBASSSE3(uint8_t* dst, const uint8_t* src, size_t count);
+    void RGBAToRGB565SSSE3(uint16_t* dst, const uint8_t* src, size_t count);
+    void RGBAToRGBA4444SSSE3(uint16_t* dst, const uint8_t* src, size_t count);
+    void PremultiplyRGBASSSE3(uint8_t* dst, const uint8_t* src, size_t count);
+    void BoxDownsampleRGBSSSE3(uint8_t* dst, const uint8_t* row0, const uint8_t* row1, size_t count);
+    void BoxDownsampleRGBASSSE3(uint8_t* dst, const uint8_t* row0, const uint8_t* row1, size_t count);
+#endif
+
+} // namespace mj2
@@ -0,0 +1,99 @@
+#include "PkmFile.hpp"
+
+#include "MappedFile.hpp"
+
+namespace mj2
+{
+    /////
+    //   0 "PKM "   4 version "10" or "20"   6 format   8 padded width   10 padded height
+    //  12 width   14 height, all 16 bit big endian; the padded size is a multiple of 4
+    /////
+    enum PkmFormat
+    {
+        PkmFormat_ETC1_RGB = 0,
+        PkmFormat_ETC2_RGB = 1,
+        PkmFormat_ETC2_RGBA = 3
+    };
+
+    static inline uint16_t ReadU16BE(const uint8_t* p)
+    {
+        return (uint16_t)((p[0] << 8) | p[1]);
+    }
+
+    static inline void WriteU16BE(uint8_t* p, uint32_t v)
+    {
+        p[0] = (uint8_t)(v >> 8);
+        p[1] = (uint8_t)v;
+    }
+
+    ImageStatus ParsePkm(const uint8_t* data, size_t size, PkmImage& image)
+    {
+        if (size < PkmHeaderSize) {
+            return ImageStatus_Truncated;
+        }
+        if (data[0] != 'P' || data[1] != 'K' || data[2] != 'M' || data[3] != ' ') {
+            return ImageStatus_BadSignature;
+        }
+
+        const bool version1 = data[4] == '1' && data[5] == '0';
+        const bool version2 = data[4] == '2' && data[5] == '0';
+        const uint16_t format = ReadU16BE(data + 6);
+        const uint16_t paddedWidth = ReadU16BE(data + 8);
+        const uint16_t paddedHeight = ReadU16BE(data + 10);
+        const uint16_t width = ReadU16BE(data + 12);
+        const uint16_t height = ReadU16BE(data + 14);
+
+        EtcFormat etcFormat;
+        if ((version1 || version2) && format == PkmFormat_ETC1_RGB) {
+            etcFormat = EtcFormat_ETC1;
+        } else if (version2 && format == PkmFormat_ETC2_RGB) {
+            etcFormat = EtcFormat_ETC2_RGB;
+        } else if (version2 && format == PkmFormat_ETC2_RGBA) {
+            etcFormat = EtcFormat_ETC2_RGBA;
+        } else {
+            // punch-through alpha, EAC R11 / RG11 and unknown versions
+            return ImageStatus_Unsupported;
+        }
+
+        if (width == 0 || height == 0 || paddedWidth != ((width + 3) & ~3) || paddedHeight != ((height + 3) & ~3)) {
+            return ImageStatus_BadHeader;
+        }
+
+        const size_t blocksSize = EtcImageBytes(etcFormat, width, height);
+        if (PkmHeaderSize + blocksSize > size) {
+            return ImageStatus_Truncated;
+        }
+
+        image.blocks = data + PkmHeaderSize;
+        image.blocksSize = blocksSize;
+        image.width = width;
+        image.height = height;
+        image.format = etcFormat;
+        return ImageStatus_Ok;
+    }
+
+    ImageStatus LoadPkm(const char* path, MappedFile& file, PkmImage& image)
+    {
+        const ImageStatus status = file.Open(path);
+        if (status != ImageStatus_Ok) {
+            return status;
+        }
+        return ParsePkm(file.Data(), file.Size(), image);
+    }
+
+    void WritePkmHeader(uint8_t* header, EtcFormat format, uint32_t width, uint32_t height)
+    {
+        header[0] = 'P';
+        header[1] = 'K';
+        header[2] = 'M';
+        header[3] = ' ';
+        header[4] = format == EtcFormat_ETC1 ? '1' : '2';
+        header[5] = '0';
+        WriteU16BE(header + 6, format == EtcFormat_ETC1 ? PkmFormat_ETC1_RGB :
+                               format == EtcFormat_ETC2_RGB ? PkmFormat_ETC2_RGB : PkmFormat_ETC2_RGBA);
+        WriteU16BE(header + 8, (width + 3) & ~3u);
+        WriteU16BE(header + 10, (height + 3) & ~3u);
+        WriteU16BE(header + 12, width);
+        WriteU16BE(header + 14, height);
+    }
+}
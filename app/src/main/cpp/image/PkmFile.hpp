@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "EtcCodec.hpp"
+#include "Image.hpp"
+
+namespace mj2 {
+
+    class MappedFile;
+
+    /// "PKM " header of etcpack and the Android SDK's etc1tool, big endian
+    static const size_t PkmHeaderSize = 16;
+
+    //-------------------------------------------------------------
+    // PkmImage
+    //-------------------------------------------------------------
+    /// View of the ETC blocks of a PKM file, one mip level, nothing is copied
+    struct PkmImage {
+    public:
+        const uint8_t* blocks;
+        size_t blocksSize;     // EtcImageBytes(format, width, height)
+        uint32_t width;        // the original size, glCompressedTexImage2D takes this
+        uint32_t height;
+        EtcFormat format;
+    };
+
+    /// Validate the header (version 10 for ETC1, 20 for ETC2) and point image at the blocks
+    ImageStatus ParsePkm(const uint8_t* data, size_t size, PkmImage& image);
+
+    /// Map path and parse it. image points into file and stays valid while file is open.
+    ImageStatus LoadPkm(const char* path, MappedFile& file, PkmImage& image);
+
+    /// header for width x height blocks of format, followed by EtcImageBytes of them
+    void WritePkmHeader(uint8_t* header, EtcFormat format, uint32_t width, uint32_t height);
+
+} // namespace mj2
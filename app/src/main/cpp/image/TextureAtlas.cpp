@@ -0,0 +1,229 @@
+#include "TextureAtlas.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace mj2
+{
+    //-------------------------------------------------------------
+    // SkylinePacker
+    //-------------------------------------------------------------
+    SkylinePacker::SkylinePacker()
+            : width(0)
+            , height(0)
+            , usedArea(0)
+    {
+    }
+
+    void SkylinePacker::Reset(uint32_t width, uint32_t height)
+    {
+        this->width = width;
+        this->height = height;
+        usedArea = 0;
+        skyline.clear();
+        skyline.push_back(Segment{ 0, 0, width });
+    }
+
+    bool SkylinePacker::Fit(size_t index, uint32_t width, uint32_t height, uint32_t& y) const
+    {
+        const uint32_t x = skyline[index].x;
+        if (x + width > this->width) {
+            return false;
+        }
+
+        // the rectangle rests on the highest segment under it
+        y = 0;
+        uint32_t covered = 0;
+        for (size_t i = index; covered < width; i++) {
+            y = std::max(y, skyline[i].y);
+            covered += skyline[i].width;
+        }
+        return y + height <= this->height;
+    }
+
+    bool SkylinePacker::Insert(uint32_t width, uint32_t height, uint32_t& x, uint32_t& y)
+    {
+        if (width == 0 || height == 0) {
+            return false;
+        }
+
+        size_t best = skyline.size();
+        uint32_t bestTop = UINT32_MAX;
+        uint32_t bestY = 0;
+        for (size_t i = 0; i < skyline.size(); i++) {
+            uint32_t fitY;
+            if (Fit(i, width, height, fitY) && fitY + height < bestTop) {
+                best = i;
+                bestTop = fitY + height;
+                bestY = fitY;
+            }
+        }
+        if (best == skyline.size()) {
+            return false;
+        }
+
+        x = skyline[best].x;
+        y = bestY;
+        usedArea += (uint64_t)width * height;
+
+        // the new segment covers [x, x + width), shrink or drop the ones it hides
+        skyline.insert(skyline.begin() + best, Segment{ x, bestTop, width });
+        for (size_t i = best + 1; i < skyline.size();) {
+            Segment& segment = skyline[i];
+            const uint32_t end = x + width;
+            if (segment.x >= end) {
+                break;
+            }
+            const uint32_t segmentEnd = segment.x + segment.width;
+            if (segmentEnd <= end) {
+                skyline.erase(skyline.begin() + i);
+            } else {
+                segment.width = segmentEnd - end;
+                segment.x = end;
+                break;
+            }
+        }
+
+        // neighbours at the same height become one segment
+        for (size_t i = 0; i + 1 < skyline.size();) {
+            if (skyline[i].y == skyline[i + 1].y) {
+                skyline[i].width += skyline[i + 1].width;
+                skyline.erase(skyline.begin() + i + 1);
+            } else {
+                i++;
+            }
+        }
+        return true;
+    }
+
+    float SkylinePacker::Occupancy() const
+    {
+        return width && height ? (float)((double)usedArea / ((double)width * height)) : 0.0f;
+    }
+
+    //-------------------------------------------------------------
+    // AtlasBuilder
+    //-------------------------------------------------------------
+    static inline uint32_t AlignUp(uint32_t value, uint32_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    AtlasBuilder::AtlasBuilder(const AtlasOptions& options)
+            : options(options)
+            , pageRowStride(0)
+    {
+        if (this->options.alignment == 0 || (this->options.alignment & (this->options.alignment - 1)) != 0) {
+            this->options.alignment = 1;
+        }
+    }
+
+    uint32_t AtlasBuilder::Add(const uint8_t* pixels, uint32_t width, uint32_t height, size_t rowStride, uint32_t channels)
+    {
+        sources.push_back(Source{ pixels, width, height, rowStride, channels });
+        return (uint32_t)sources.size() - 1;
+    }
+
+    ImageStatus AtlasBuilder::Build()
+    {
+        const uint32_t pageWidth = options.pageWidth;
+        const uint32_t pageHeight = options.pageHeight;
+        if (options.channels != 3 && options.channels != 4) {
+            return ImageStatus_Unsupported;
+        }
+        pageRowStride = ((size_t)pageWidth * options.channels + 3) & ~(size_t)3;
+        pages.clear();
+        sprites.assign(sources.size(), AtlasSprite());
+
+        // tallest first keeps the skyline flat
+        std::vector<uint32_t> order(sources.size());
+        for (uint32_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+            return sources[a].height != sources[b].height ? sources[a].height > sources[b].height
+                                                          : sources[a].width > sources[b].width;
+        });
+
+        const uint32_t border = options.gutter + (options.padding + 1) / 2;
+        for (uint32_t index : order) {
+            const Source& source = sources[index];
+            if ((source.channels != 3 && source.channels != 4) || source.width == 0 || source.height == 0) {
+                return ImageStatus_Unsupported;
+            }
+            const uint32_t cellWidth = AlignUp(source.width + 2 * border, options.alignment);
+            const uint32_t cellHeight = AlignUp(source.height + 2 * border, options.alignment);
+
+            uint32_t page = 0;
+            uint32_t x = 0;
+            uint32_t y = 0;
+            while (page < pages.size() && !pages[page].packer.Insert(cellWidth, cellHeight, x, y)) {
+                page++;
+            }
+            if (page == pages.size()) {
+                pages.emplace_back();
+                pages.back().packer.Reset(pageWidth, pageHeight);
+                if (!pages.back().packer.Insert(cellWidth, cellHeight, x, y)) {
+                    return ImageStatus_Unsupported;
+                }
+                pages.back().pixels.assign(pageRowStride * pageHeight, 0);
+            }
+
+            AtlasSprite& sprite = sprites[index];
+            sprite.page = page;
+            sprite.x = x + border;
+            sprite.y = y + border;
+            sprite.width = source.width;
+            sprite.height = source.height;
+            sprite.u0 = (float)sprite.x / pageWidth;
+            sprite.v0 = (float)sprite.y / pageHeight;
+            sprite.u1 = (float)(sprite.x + sprite.width) / pageWidth;
+            sprite.v1 = (float)(sprite.y + sprite.height) / pageHeight;
+            Blit(source, sprite);
+        }
+        return ImageStatus_Ok;
+    }
+
+    void AtlasBuilder::Blit(const Source& source, const AtlasSprite& sprite)
+    {
+        const uint32_t channels = options.channels;
+        const uint32_t gutter = options.gutter;
+        uint8_t* page = pages[sprite.page].pixels.data();
+
+        // sprite rows, each extended sideways by the gutter
+        for (uint32_t row = 0; row < source.height; row++) {
+            const uint8_t* in = source.pixels + row * source.rowStride;
+            uint8_t* out = page + (sprite.y + row) * pageRowStride + (size_t)(sprite.x - gutter) * channels;
+            for (int32_t column = -(int32_t)gutter; column < (int32_t)(source.width + gutter); column++) {
+                const uint32_t clamped = (uint32_t)std::min(std::max(column, 0), (int32_t)source.width - 1);
+                const uint8_t* texel = in + clamped * source.channels;
+                out[0] = texel[0];
+                out[1] = texel[1];
+                out[2] = texel[2];
+                if (channels == 4) {
+                    out[3] = source.channels == 4 ? texel[3] : 255;
+                }
+                out += channels;
+            }
+        }
+
+        // then the first and last extended rows repeated over the gutter
+        const size_t rowBytes = (size_t)(source.width + 2 * gutter) * channels;
+        const uint8_t* first = page + sprite.y * pageRowStride + (size_t)(sprite.x - gutter) * channels;
+        const uint8_t* last = first + (source.height - 1) * pageRowStride;
+        for (uint32_t i = 1; i <= gutter; i++) {
+            memcpy((uint8_t*)first - i * pageRowStride, first, rowBytes);
+            memcpy((uint8_t*)last + i * pageRowStride, last, rowBytes);
+        }
+    }
+
+    void RemapUVs(float* uvs, size_t vertexCount, size_t stride, const AtlasSprite& sprite)
+    {
+        const float scaleU = sprite.u1 - sprite.u0;
+        const float scaleV = sprite.v1 - sprite.v0;
+        for (size_t i = 0; i < vertexCount; i++, uvs += stride) {
+            uvs[0] = sprite.u0 + uvs[0] * scaleU;
+            uvs[1] = sprite.v0 + uvs[1] * scaleV;
+        }
+    }
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Image.hpp"
+
+namespace mj2 {
+
+    //-------------------------------------------------------------
+    // SkylinePacker
+    //-------------------------------------------------------------
+    /////
+    // Bottom-left skyline rectangle packing: the packed area is kept as a list of
+    // horizontal segments and each rectangle goes where its top edge ends up lowest,
+    // leftmost on ties. Fast, and within a few percent of maxrects for sprite sets.
+    /////
+    class SkylinePacker {
+    public:
+        SkylinePacker();
+
+        void Reset(uint32_t width, uint32_t height);
+
+        /// false when width x height does not fit anywhere
+        bool Insert(uint32_t width, uint32_t height, uint32_t& x, uint32_t& y);
+
+        /// area of the inserted rectangles over the whole area
+        float Occupancy() const;
+
+    private:
+        struct Segment {
+        public:
+            uint32_t x;
+            uint32_t y;
+            uint32_t width;
+        };
+
+        /// top of the rectangle placed at segment index, or false if it sticks out
+        bool Fit(size_t index, uint32_t width, uint32_t height, uint32_t& y) const;
+
+        std::vector<Segment> skyline;
+        uint32_t width;
+        uint32_t height;
+        uint64_t usedArea;
+    };
+
+    struct AtlasOptions {
+    public:
+        uint32_t pageWidth = 1024;
+        uint32_t pageHeight = 1024;
+        uint32_t channels = 4;   // 3 (RGB) or 4 (RGBA) for the pages
+        uint32_t padding = 0;    // empty texels between neighbouring gutters
+        uint32_t gutter = 2;     // edge texels repeated around each sprite
+        uint32_t alignment = 4;  // cells start and end on multiples of this, a power of two
+    };
+
+    /// Where a sprite ended up. UVs span exactly its texels, v grows with the row like GL's t.
+    struct AtlasSprite {
+    public:
+        uint32_t page;
+        uint32_t x;
+        uint32_t y;
+        uint32_t width;
+        uint32_t height;
+        float u0;
+        float v0;
+        float u1;
+        float v1;
+    };
+
+    //-------------------------------------------------------------
+    // AtlasBuilder
+    //-------------------------------------------------------------
+    /////
+    // Packs many small images into a few large pages so they draw with one bind.
+    //
+    // Each sprite gets a cell of its size plus the gutter on every side plus padding,
+    // rounded up to the alignment. With an alignment of 2^n no 2^n x 2^n block straddles
+    // two cells, so box filtered mip levels up to n never mix sprites, and 4 keeps ETC
+    // blocks inside one cell too. The gutter repeats the sprite's edge texels so bilinear
+    // taps at the UV border read the sprite instead of its neighbour; it needs about 2^n
+    // texels to hold up to level n.
+    //
+    // Sprites are sorted by height before packing, pages are opened as needed. Images are
+    // in GL row order, as ConvertBmpToGL leaves them, and so are the pages.
+    /////
+    class AtlasBuilder {
+    public:
+        explicit AtlasBuilder(const AtlasOptions& options);
+
+        /// pixels are read in Build, not copied here. channels is 3 or 4, RGB gets
+        /// opaque alpha on RGBA pages. Returns the sprite index.
+        uint32_t Add(const uint8_t* pixels, uint32_t width, uint32_t height, size_t rowStride, uint32_t channels);
+
+        /// Unsupported when a sprite does not fit an empty page
+        ImageStatus Build();
+
+        uint32_t SpriteCount() const { return (uint32_t)sprites.size(); }
+        const AtlasSprite& Sprite(uint32_t index) const { return sprites[index]; }
+
+        uint32_t PageCount() const { return (uint32_t)pages.size(); }
+        const uint8_t* Page(uint32_t index) const { return pages[index].pixels.data(); }
+        /// padded to 4 bytes like GL_UNPACK_ALIGNMENT
+        size_t PageRowStride() const { return pageRowStride; }
+        float PageOccupancy(uint32_t index) const { return pages[index].packer.Occupancy(); }
+
+    private:
+        struct Source {
+        public:
+            const uint8_t* pixels;
+            uint32_t width;
+            uint32_t height;
+            size_t rowStride;
+            uint32_t channels;
+        };
+
+        struct PageData {
+        public:
+            SkylinePacker packer;
+            std::vector<uint8_t> pixels;
+        };
+
+        void Blit(const Source& source, const AtlasSprite& sprite);
+
+        AtlasOptions options;
+        std::vector<Source> sources;
+        std::vector<AtlasSprite> sprites;
+        std::vector<PageData> pages;
+        size_t pageRowStride;
+    };
+
+    /// Map UVs in [0, 1] over a whole image onto sprite's rectangle in its page, in place.
+    /// uvs holds vertexCount pairs, stride floats apart (2 for a packed UV array).
+    void RemapUVs(float* uvs, size_t vertexCount, size_t stride, const AtlasSprite& sprite);
+
+} // namespace mj2
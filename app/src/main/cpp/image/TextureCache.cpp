@@ -0,0 +1,462 @@
+#include "TextureCache.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+#include "TextureLoader.hpp"
+
+namespace mj2
+{
+    /// loads on the workers at once, more only queue up behind each other in the pool
+    static const uint32_t MaxLoadsInFlight = 4;
+
+    typedef std::chrono::steady_clock Clock;
+
+    static double ElapsedMs(const Clock::time_point& start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    template <typename T>
+    static void EraseValue(std::deque<T>& values, const T& value)
+    {
+        values.erase(std::remove(values.begin(), values.end(), value), values.end());
+    }
+
+    /// Any loaded file as a list of levels, without copying
+    static void DescribeLoadedImage(const LoadedImage& loaded, TextureFile& view)
+    {
+        switch (loaded.fileType) {
+            case LoadedFile_Bmp: {
+                const BmpImage& image = loaded.image;
+                view.format = image.bitsPerPixel == 32 ? TextureFormat_RGBA8 : TextureFormat_RGB8;
+                view.width = image.width;
+                view.height = image.height;
+                // the parser and the chain stop at MaxImageDimension, the table holds that many
+                view.levelCount = std::min(std::max(loaded.mips.LevelCount(), 1u), TextureFileMaxLevels);
+                view.hasChecksum = false;
+                for (uint32_t i = 0; i < view.levelCount; i++) {
+                    TextureLevel& level = view.levels[i];
+                    level.width = i == 0 ? image.width : loaded.mips.Level(i).width;
+                    level.height = i == 0 ? image.height : loaded.mips.Level(i).height;
+                    // BMP rows and mip rows are both padded to 4 bytes
+                    level.data = i == 0 ? image.pixels : loaded.mips.Level(i).pixels;
+                    level.size = (size_t)TextureLevelBytes(view.format, level.width, level.height);
+                }
+                break;
+            }
+            case LoadedFile_Pkm: {
+                const PkmImage& image = loaded.compressedImage;
+                view.format = (TextureFormat)(TextureFormat_ETC1 + image.format);
+                view.width = image.width;
+                view.height = image.height;
+                view.levelCount = 1;
+                view.hasChecksum = false;
+                view.levels[0].data = image.blocks;
+                view.levels[0].size = image.blocksSize;
+                view.levels[0].width = image.width;
+                view.levels[0].height = image.height;
+                break;
+            }
+            case LoadedFile_Texture:
+                view = loaded.texture;
+                break;
+        }
+    }
+
+    TextureCache::TextureCache(TextureLoader& loader, TextureBackend& backend, const TextureCacheBudget& budget)
+            : loader(loader)
+            , backend(backend)
+            , budget(budget)
+            , nextId(1)
+            , loading(0)
+            , gpuBytes(0)
+            , stagingBytes(0)
+    {
+    }
+
+    TextureCache::~TextureCache()
+    {
+        for (auto& pair : entries) {
+            DeleteTextures(pair.second);
+            ReleaseSource(pair.second);
+        }
+        // loads still in flight are deleted by the loader
+    }
+
+    TextureCache::Entry* TextureCache::Find(TextureId id)
+    {
+        auto found = entries.find(id);
+        return found == entries.end() ? nullptr : &found->second;
+    }
+
+    const TextureCache::Entry* TextureCache::Find(TextureId id) const
+    {
+        auto found = entries.find(id);
+        return found == entries.end() ? nullptr : &found->second;
+    }
+
+    //-------------------------------------------------------------
+    // References
+    //-------------------------------------------------------------
+    TextureId TextureCache::Acquire(const char* path, bool mipmaps)
+    {
+        auto found = ids.find(path);
+        if (found != ids.end()) {
+            Entry& entry = entries[found->second];
+            if (entry.refCount++ == 0 && entry.lru != unused.end()) {
+                unused.erase(entry.lru);
+                entry.lru = unused.end();
+                // still queued when released and acquired again before Update
+                if (entry.reduced && !entry.promotionQueued) {
+                    entry.promotionQueued = true;
+                    reduced.push_back(found->second);
+                }
+            }
+            return found->second;
+        }
+
+        const TextureId id = nextId++;
+        Entry& entry = entries[id];
+        entry.path = path;
+        entry.refCount = 1;
+        entry.state = TextureState_Queued;
+        entry.mipmaps = mipmaps;
+        entry.reduced = false;
+        entry.promotionQueued = false;
+        entry.texture = 0;
+        entry.textureWidth = 0;
+        entry.textureHeight = 0;
+        entry.textureBytes = 0;
+        entry.streaming = 0;
+        entry.streamingBytes = 0;
+        entry.nextLevel = 0;
+        entry.levelCount = 0;
+        entry.previewLevel = 0;
+        entry.fullBytes = 0;
+        entry.source = nullptr;
+        entry.hasInfo = false;
+        entry.lru = unused.end();
+        ids[entry.path] = id;
+        queued.push_back(id);
+        return id;
+    }
+
+    void TextureCache::Release(TextureId id)
+    {
+        Entry* entry = Find(id);
+        if (!entry || entry->refCount == 0 || --entry->refCount != 0) {
+            return;
+        }
+
+        // nothing worth keeping yet, a later Acquire starts over
+        if (entry->state == TextureState_Queued || entry->state == TextureState_Failed) {
+            Erase(id);
+            return;
+        }
+        entry->lru = unused.insert(unused.end(), id);
+    }
+
+    uint32_t TextureCache::Texture(TextureId id) const
+    {
+        const Entry* entry = Find(id);
+        return entry ? entry->texture : 0;
+    }
+
+    TextureState TextureCache::State(TextureId id) const
+    {
+        const Entry* entry = Find(id);
+        return entry ? entry->state : TextureState_Failed;
+    }
+
+    bool TextureCache::Info(TextureId id, uint32_t& width, uint32_t& height, TextureFormat& format) const
+    {
+        const Entry* entry = Find(id);
+        if (!entry || !entry->hasInfo) {
+            return false;
+        }
+        width = entry->view.width;
+        height = entry->view.height;
+        format = entry->view.format;
+        return true;
+    }
+
+    void TextureCache::TextureSize(TextureId id, uint32_t& width, uint32_t& height) const
+    {
+        const Entry* entry = Find(id);
+        width = entry ? entry->textureWidth : 0;
+        height = entry ? entry->textureHeight : 0;
+    }
+
+    //-------------------------------------------------------------
+    // Memory
+    //-------------------------------------------------------------
+    void TextureCache::ReleaseSource(Entry& entry)
+    {
+        if (entry.source) {
+            stagingBytes -= entry.source->file.Size() + entry.source->mips.StorageBytes();
+            delete entry.source;
+            entry.source = nullptr;
+        }
+    }
+
+    void TextureCache::DeleteTextures(Entry& entry)
+    {
+        if (entry.texture) {
+            backend.DeleteTexture(entry.texture);
+            gpuBytes -= entry.textureBytes;
+        }
+        if (entry.streaming) {
+            backend.DeleteTexture(entry.streaming);
+            gpuBytes -= entry.streamingBytes;
+        }
+        entry.texture = 0;
+        entry.textureWidth = 0;
+        entry.textureHeight = 0;
+        entry.textureBytes = 0;
+        entry.streaming = 0;
+        entry.streamingBytes = 0;
+    }
+
+    void TextureCache::Erase(TextureId id)
+    {
+        Entry& entry = entries[id];
+        DeleteTextures(entry);
+        ReleaseSource(entry);
+        if (entry.lru != unused.end()) {
+            unused.erase(entry.lru);
+        }
+        EraseValue(queued, id);
+        EraseValue(streaming, id);
+        EraseValue(reduced, id);
+        // a load still in flight finds no entry and is dropped in Accept
+        ids.erase(entry.path);
+        entries.erase(id);
+    }
+
+    bool TextureCache::MakeRoom(size_t bytes)
+    {
+        while (gpuBytes + bytes > budget.gpuBytes && !unused.empty()) {
+            Erase(unused.front());
+        }
+        return gpuBytes + bytes <= budget.gpuBytes;
+    }
+
+    void TextureCache::SetBudget(const TextureCacheBudget& budget)
+    {
+        this->budget = budget;
+        MakeRoom(0);
+    }
+
+    void TextureCache::InvalidateAll()
+    {
+        streaming.clear();
+        reduced.clear();
+        for (auto it = entries.begin(); it != entries.end();) {
+            Entry& entry = it->second;
+            const TextureId id = it->first;
+            ++it;
+
+            // the names died with the context
+            entry.promotionQueued = false;
+            entry.texture = 0;
+            entry.textureWidth = 0;
+            entry.textureHeight = 0;
+            entry.textureBytes = 0;
+            entry.streaming = 0;
+            entry.streamingBytes = 0;
+            ReleaseSource(entry);
+
+            if (entry.state == TextureState_Loading || entry.state == TextureState_Queued) {
+                // no GL state yet, the load carries on
+                continue;
+            }
+            if (entry.refCount == 0) {
+                Erase(id);
+            } else {
+                entry.state = TextureState_Queued;
+                entry.reduced = false;
+                queued.push_back(id);
+            }
+        }
+        gpuBytes = 0;
+    }
+
+    //-------------------------------------------------------------
+    // Streaming
+    //-------------------------------------------------------------
+    void TextureCache::Accept(LoadedImage* loaded)
+    {
+        Entry* entry = Find(loaded->id);
+        if (!entry || entry->state != TextureState_Loading) {
+            delete loaded;
+            return;
+        }
+        if (loaded->status == ImageStatus_Ok) {
+            DescribeLoadedImage(*loaded, entry->view);
+        }
+        if (loaded->status != ImageStatus_Ok || !backend.SupportsFormat(entry->view.format)) {
+            const TextureId id = loaded->id;
+            delete loaded;
+            DeleteTextures(*entry);
+            entry->state = TextureState_Failed;
+            if (entry->refCount == 0) {
+                Erase(id);
+            }
+            return;
+        }
+
+        const TextureFile& view = entry->view;
+        entry->hasInfo = true;
+        entry->source = loaded;
+        stagingBytes += loaded->file.Size() + loaded->mips.StorageBytes();
+
+        entry->levelCount = backend.SupportsMipmaps(view.width, view.height) ? view.levelCount : 1;
+        entry->fullBytes = 0;
+        entry->previewLevel = 0;
+        // a texture no bigger than a preview is its own
+        const bool needsPreview = std::max(view.width, view.height) > PreviewSize;
+        for (uint32_t i = 0; i < entry->levelCount; i++) {
+            entry->fullBytes += view.levels[i].size;
+            if (needsPreview && entry->previewLevel == 0 &&
+                std::max(view.levels[i].width, view.levels[i].height) <= PreviewSize) {
+                entry->previewLevel = i;
+            }
+        }
+
+        // lowest levels first: a complete small texture right away. A reduced texture
+        // coming back for promotion still has its preview bound.
+        if (entry->previewLevel > 0 && entry->texture == 0) {
+            const TextureLevel& top = view.levels[entry->previewLevel];
+            const uint32_t texture = backend.CreateTexture(view.format, top.width, top.height,
+                                                           entry->levelCount - entry->previewLevel);
+            if (texture) {
+                for (uint32_t i = entry->levelCount; i-- > entry->previewLevel;) {
+                    backend.UploadLevel(texture, view.format, view.levels[i], i - entry->previewLevel);
+                    entry->textureBytes += view.levels[i].size;
+                }
+                entry->texture = texture;
+                entry->textureWidth = top.width;
+                entry->textureHeight = top.height;
+                gpuBytes += entry->textureBytes;
+            }
+        }
+
+        entry->state = TextureState_Streaming;
+        streaming.push_back(loaded->id);
+    }
+
+    bool TextureCache::StartFull(Entry& entry)
+    {
+        // a preview is good enough for something nobody uses (which MakeRoom could also
+        // evict from under us), and so it is when the full chain does not fit; without a
+        // preview the full texture is the minimum
+        const bool hasPreview = entry.texture != 0;
+        if (entry.refCount == 0 || (hasPreview && !MakeRoom(entry.fullBytes))) {
+            return false;
+        }
+        if (!hasPreview) {
+            MakeRoom(entry.fullBytes);
+        }
+
+        const TextureFile& view = entry.view;
+        entry.streaming = backend.CreateTexture(view.format, view.width, view.height, entry.levelCount);
+        if (!entry.streaming) {
+            return false;
+        }
+        entry.streamingBytes = entry.fullBytes;
+        gpuBytes += entry.fullBytes;
+        entry.nextLevel = entry.levelCount - 1;
+        return true;
+    }
+
+    /// true when the last level is in and the full texture has replaced the preview
+    bool TextureCache::UploadNextLevel(Entry& entry)
+    {
+        backend.UploadLevel(entry.streaming, entry.view.format, entry.view.levels[entry.nextLevel], entry.nextLevel);
+        if (entry.nextLevel > 0) {
+            entry.nextLevel--;
+            return false;
+        }
+
+        if (entry.texture) {
+            backend.DeleteTexture(entry.texture);
+            gpuBytes -= entry.textureBytes;
+        }
+        entry.texture = entry.streaming;
+        entry.textureWidth = entry.view.width;
+        entry.textureHeight = entry.view.height;
+        entry.textureBytes = entry.streamingBytes;
+        entry.streaming = 0;
+        entry.streamingBytes = 0;
+        entry.reduced = false;
+        return true;
+    }
+
+    void TextureCache::Update(double budgetMs)
+    {
+        const Clock::time_point start = Clock::now();
+
+        // a reduced texture in use goes back for its full chain once that fits
+        while (!reduced.empty()) {
+            Entry* entry = Find(reduced.front());
+            if (entry && entry->refCount > 0 && entry->reduced) {
+                if (!MakeRoom(entry->fullBytes)) {
+                    break;
+                }
+                entry->state = TextureState_Queued;
+                queued.push_back(reduced.front());
+            }
+            if (entry) {
+                entry->promotionQueued = false;
+            }
+            reduced.pop_front();
+        }
+
+        // file mappings are held until a texture is streamed, so cap how many pile up
+        while (!queued.empty() && loading < MaxLoadsInFlight && stagingBytes < budget.stagingBytes) {
+            const TextureId id = queued.front();
+            queued.pop_front();
+            Entry& entry = entries[id];
+            entry.state = TextureState_Loading;
+            loader.Request(entry.path.c_str(), id, entry.mipmaps);
+            loading++;
+        }
+
+        bool worked = false;
+        while (!worked || ElapsedMs(start) < budgetMs) {
+            if (LoadedImage* loaded = loader.Take()) {
+                loading--;
+                Accept(loaded);
+            } else if (!streaming.empty()) {
+                const TextureId id = streaming.front();
+                Entry& entry = entries[id];
+                bool done;
+                if (!entry.streaming && !StartFull(entry)) {
+                    // stays at preview resolution, or failed outright without one
+                    entry.reduced = entry.texture != 0;
+                    if (entry.reduced && entry.refCount > 0 && !entry.promotionQueued) {
+                        entry.promotionQueued = true;
+                        reduced.push_back(id);
+                    }
+                    done = true;
+                } else {
+                    done = UploadNextLevel(entry);
+                }
+                if (done) {
+                    streaming.pop_front();
+                    ReleaseSource(entry);
+                    entry.state = entry.texture ? TextureState_Resident : TextureState_Failed;
+                    if (entry.state == TextureState_Failed && entry.refCount == 0) {
+                        Erase(id);
+                    }
+                }
+            } else {
+                break;
+            }
+            worked = true;
+        }
+
+        MakeRoom(0);
+    }
+}
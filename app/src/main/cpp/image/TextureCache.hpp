@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#include "TextureFile.hpp"
+
+namespace mj2 {
+
+    class TextureLoader;
+    struct LoadedImage;
+
+    /// 0 is never a valid id. Ids are not reused, a stale one just finds nothing.
+    typedef uint32_t TextureId;
+
+    enum TextureState
+    {
+        TextureState_Queued = 0, // waiting for a loader slot under the staging budget
+        TextureState_Loading,    // on the loader threads
+        TextureState_Streaming,  // a low resolution texture is bound, the full chain follows
+        TextureState_Resident,   // done; may still be the low resolution one when over budget
+        TextureState_Failed      // missing, corrupt or a format the backend cannot take
+    };
+
+    //-------------------------------------------------------------
+    // TextureBackend
+    //-------------------------------------------------------------
+    /// The GL side of TextureCache, which itself makes no GL calls. Textures are GL names.
+    class TextureBackend {
+    public:
+        virtual ~TextureBackend() {}
+
+        /// whether the format can be uploaded at all (ETC needs extensions or ES 3)
+        virtual bool SupportsFormat(TextureFormat format) = 0;
+
+        /// whether a width x height texture can be mipmapped (ES 2 non power of two)
+        virtual bool SupportsMipmaps(uint32_t width, uint32_t height) = 0;
+
+        /// New texture for levelCount levels of format, the first one width x height.
+        /// Sets up sampling for that many levels, returns 0 on failure.
+        virtual uint32_t CreateTexture(TextureFormat format, uint32_t width, uint32_t height, uint32_t levelCount) = 0;
+
+        virtual void UploadLevel(uint32_t texture, TextureFormat format, const TextureLevel& level, uint32_t glLevel) = 0;
+
+        virtual void DeleteTexture(uint32_t texture) = 0;
+    };
+
+    struct TextureCacheBudget {
+    public:
+        size_t gpuBytes;      // texture memory of everything resident or streaming
+        size_t stagingBytes;  // file mappings and mip buffers held while textures stream in
+    };
+
+    //-------------------------------------------------------------
+    // TextureCache
+    //-------------------------------------------------------------
+    /////
+    // Textures by asset path with reference counts and a memory budget. GL thread only.
+    //
+    // Acquire starts a load through the TextureLoader; textures with a mip chain first
+    // get a small texture from their lowest levels (at most PreviewSize across), then the
+    // full chain is uploaded into a second texture smallest level first, a few levels per
+    // Update, and swapped in when complete. ES 2 has no GL_TEXTURE_BASE_LEVEL, so the two
+    // textures cannot be one.
+    //
+    // Released textures stay cached until the GPU budget needs their memory, least
+    // recently released first. When the budget is still exceeded by textures in use, new
+    // textures stop at their low resolution version and are promoted once there is room.
+    //
+    // The cache takes every image the loader finishes, do not Drain the same loader.
+    /////
+    class TextureCache {
+    public:
+        static const uint32_t PreviewSize = 64;
+
+        TextureCache(TextureLoader& loader, TextureBackend& backend, const TextureCacheBudget& budget);
+        /// Deletes every texture, so the GL context has to be current
+        ~TextureCache();
+
+        TextureCache(const TextureCache&) = delete;
+        TextureCache& operator=(const TextureCache&) = delete;
+
+        /// Reference path, loading it if it is not cached. mipmaps asks for the full chain
+        /// of a BMP (pre-baked files bring their own) and only counts on the first Acquire.
+        TextureId Acquire(const char* path, bool mipmaps = true);
+
+        /// Drop a reference, at zero the texture becomes evictable
+        void Release(TextureId id);
+
+        /// GL name to bind, 0 while nothing is uploaded. Changes when streaming finishes.
+        uint32_t Texture(TextureId id) const;
+
+        /// Failed for unknown ids, including evicted ones
+        TextureState State(TextureId id) const;
+
+        /// the full size and format; false until the file is loaded
+        bool Info(TextureId id, uint32_t& width, uint32_t& height, TextureFormat& format) const;
+
+        /// size of Texture(id), smaller than Info's while only the preview is up; 0 x 0 without one
+        void TextureSize(TextureId id, uint32_t& width, uint32_t& height) const;
+
+        /// Once per frame: take finished loads, upload levels and evict, for about budgetMs.
+        /// At least one upload happens per call when anything is waiting.
+        void Update(double budgetMs);
+
+        /// Evicts right away when lowering it
+        void SetBudget(const TextureCacheBudget& budget);
+
+        size_t GpuBytes() const { return gpuBytes; }
+        size_t StagingBytes() const { return stagingBytes; }
+
+        /// The GL context was lost: forget every texture without deleting it. Textures in
+        /// use load again, unused ones are dropped.
+        void InvalidateAll();
+
+    private:
+        struct Entry {
+        public:
+            std::string path;
+            uint32_t refCount;
+            TextureState state;
+            bool mipmaps;
+            bool reduced;             // resident at preview resolution for lack of budget
+            bool promotionQueued;     // on the reduced queue, waiting for room to promote
+            uint32_t texture;         // what Texture() returns
+            uint32_t textureWidth;
+            uint32_t textureHeight;
+            size_t textureBytes;
+            uint32_t streaming;       // the full texture while its levels go up
+            size_t streamingBytes;
+            uint32_t nextLevel;       // next level to upload into streaming, counting down
+            uint32_t levelCount;      // levels the full texture gets
+            uint32_t previewLevel;    // first level of the preview texture, 0 for none
+            size_t fullBytes;
+            LoadedImage* source;      // held while streaming
+            TextureFile view;         // source as levels, whatever its file type
+            bool hasInfo;
+            std::list<TextureId>::iterator lru;  // unused.end() when not on the list
+        };
+
+        Entry* Find(TextureId id);
+        const Entry* Find(TextureId id) const;
+
+        void Accept(LoadedImage* loaded);
+        bool StartFull(Entry& entry);
+        bool UploadNextLevel(Entry& entry);
+        void ReleaseSource(Entry& entry);
+        void DeleteTextures(Entry& entry);
+        void Erase(TextureId id);
+        bool MakeRoom(size_t bytes);
+
+        TextureLoader& loader;
+        TextureBackend& backend;
+        TextureCacheBudget budget;
+
+        std::unordered_map<std::string, TextureId> ids;
+        std::unordered_map<TextureId, Entry> entries;
+        std::list<TextureId> unused;     // refCount 0, least recently released first
+        std::deque<TextureId> queued;    // waiting to be requested
+        std::deque<TextureId> streaming; // uploading levels, oldest first
+        std::deque<TextureId> reduced;   // resident at preview resolution, oldest first
+        TextureId nextId;
+        uint32_t loading;
+        size_t gpuBytes;
+        size_t stagingBytes;
+    };
+
+} // namespace mj2
@@ -0,0 +1,250 @@
+#include "TextureFile.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "MappedFile.hpp"
+#include "MipChain.hpp"
+
+namespace mj2
+{
+    /////
+    // All fields little endian, read one by one like the BMP headers.
+    //
+    //   header       0 "MJ2T"   4 version   6 header size   8 format   12 width   16 height
+    //               20 level count   24 flags   28 CRC-32 of everything after the header
+    //   level table 32 per level: offset, size, width, height
+    //   payload      each level at a multiple of TextureFilePayloadAlignment, zero padded
+    /////
+    static const uint16_t kVersion = 1;
+    static const size_t kHeaderSize = 32;
+    static const size_t kLevelEntrySize = 16;
+
+    enum TextureFileFlag
+    {
+        TextureFileFlag_Checksum = 1
+    };
+
+    static inline uint16_t ReadU16(const uint8_t* p)
+    {
+        return (uint16_t)(p[0] | (p[1] << 8));
+    }
+
+    static inline uint32_t ReadU32(const uint8_t* p)
+    {
+        return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+    static inline void WriteU16(uint8_t* p, uint32_t v)
+    {
+        p[0] = (uint8_t)v;
+        p[1] = (uint8_t)(v >> 8);
+    }
+
+    static inline void WriteU32(uint8_t* p, uint32_t v)
+    {
+        p[0] = (uint8_t)v;
+        p[1] = (uint8_t)(v >> 8);
+        p[2] = (uint8_t)(v >> 16);
+        p[3] = (uint8_t)(v >> 24);
+    }
+
+    //-------------------------------------------------------------
+    // CRC-32
+    //-------------------------------------------------------------
+    /// zlib's polynomial, so `python -c "import zlib"` can check a file by hand
+    struct CrcTable {
+    public:
+        uint32_t entries[256];
+
+        CrcTable()
+        {
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++) {
+                    c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                entries[i] = c;
+            }
+        }
+    };
+
+    static uint32_t Crc32(const uint8_t* data, size_t size)
+    {
+        static const CrcTable table;
+        uint32_t crc = 0xFFFFFFFFu;
+        for (size_t i = 0; i < size; i++) {
+            crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return crc ^ 0xFFFFFFFFu;
+    }
+
+    //-------------------------------------------------------------
+    // Reading
+    //-------------------------------------------------------------
+    uint64_t TextureLevelBytes(TextureFormat format, uint32_t width, uint32_t height)
+    {
+        if (IsCompressedTextureFormat(format)) {
+            return (uint64_t)((width + 3) / 4) * ((height + 3) / 4) * EtcBlockBytes(EtcFormatOf(format));
+        }
+        const uint64_t channels = format == TextureFormat_RGBA8 ? 4 : 3;
+        return (((uint64_t)width * channels + 3) & ~(uint64_t)3) * height;
+    }
+
+    ImageStatus ParseTextureFile(const uint8_t* data, size_t size, TextureFile& texture, bool verifyChecksum)
+    {
+        if (size < kHeaderSize) {
+            return ImageStatus_Truncated;
+        }
+        if (data[0] != 'M' || data[1] != 'J' || data[2] != '2' || data[3] != 'T') {
+            return ImageStatus_BadSignature;
+        }
+        if (ReadU16(data + 4) != kVersion) {
+            return ImageStatus_Unsupported;
+        }
+
+        const uint16_t headerSize = ReadU16(data + 6);
+        const uint32_t format = ReadU32(data + 8);
+        const uint32_t width = ReadU32(data + 12);
+        const uint32_t height = ReadU32(data + 16);
+        const uint32_t levelCount = ReadU32(data + 20);
+        const uint32_t flags = ReadU32(data + 24);
+
+        if (headerSize != kHeaderSize) {
+            return ImageStatus_BadHeader;
+        }
+        if (format >= TextureFormat_Count) {
+            return ImageStatus_Unsupported;
+        }
+        if (width == 0 || height == 0 || width > 1u << (TextureFileMaxLevels - 1) ||
+            height > 1u << (TextureFileMaxLevels - 1)) {
+            return ImageStatus_BadHeader;
+        }
+        if (levelCount != 1 && levelCount != MipChain::FullLevelCount(width, height)) {
+            return ImageStatus_BadHeader;
+        }
+
+        const size_t tableEnd = kHeaderSize + levelCount * kLevelEntrySize;
+        if (tableEnd > size) {
+            return ImageStatus_Truncated;
+        }
+
+        texture.format = (TextureFormat)format;
+        texture.width = width;
+        texture.height = height;
+        texture.levelCount = levelCount;
+        texture.hasChecksum = (flags & TextureFileFlag_Checksum) != 0;
+
+        uint32_t levelWidth = width;
+        uint32_t levelHeight = height;
+        for (uint32_t i = 0; i < levelCount; i++) {
+            const uint8_t* entry = data + kHeaderSize + i * kLevelEntrySize;
+            const uint32_t offset = ReadU32(entry);
+            const uint32_t levelSize = ReadU32(entry + 4);
+            // a 32768 x 32768 RGBA8 level is 2^32 bytes, which a 32 bit size_t wraps to 0
+            const uint64_t levelBytes = TextureLevelBytes(texture.format, levelWidth, levelHeight);
+
+            if (ReadU32(entry + 8) != levelWidth || ReadU32(entry + 12) != levelHeight || levelBytes > SIZE_MAX ||
+                levelSize != levelBytes ||
+                offset < tableEnd || offset % TextureFilePayloadAlignment != 0) {
+                return ImageStatus_BadHeader;
+            }
+            if ((uint64_t)offset + levelSize > size) {
+                return ImageStatus_Truncated;
+            }
+
+            TextureLevel& level = texture.levels[i];
+            level.data = data + offset;
+            level.size = levelSize;
+            level.width = levelWidth;
+            level.height = levelHeight;
+
+            levelWidth = levelWidth > 1 ? levelWidth >> 1 : 1;
+            levelHeight = levelHeight > 1 ? levelHeight >> 1 : 1;
+        }
+
+        if (verifyChecksum && texture.hasChecksum && Crc32(data + kHeaderSize, size - kHeaderSize) != ReadU32(data + 28)) {
+            return ImageStatus_BadChecksum;
+        }
+        return ImageStatus_Ok;
+    }
+
+    ImageStatus LoadTextureFile(const char* path, MappedFile& file, TextureFile& texture, bool verifyChecksum)
+    {
+        const ImageStatus status = file.Open(path);
+        if (status != ImageStatus_Ok) {
+            return status;
+        }
+        return ParseTextureFile(file.Data(), file.Size(), texture, verifyChecksum);
+    }
+
+    //-------------------------------------------------------------
+    // Writing
+    //-------------------------------------------------------------
+    static inline size_t AlignPayload(size_t offset)
+    {
+        return (offset + TextureFilePayloadAlignment - 1) & ~(TextureFilePayloadAlignment - 1);
+    }
+
+    bool WriteTextureFile(const char* path, TextureFormat format, const TextureLevel* levels, uint32_t levelCount,
+                          bool checksum)
+    {
+        const uint32_t maxSize = 1u << (TextureFileMaxLevels - 1);
+        if (levelCount == 0 || levels[0].width == 0 || levels[0].height == 0 || levels[0].width > maxSize ||
+            levels[0].height > maxSize) {
+            return false;
+        }
+        if (levelCount != 1 && levelCount != MipChain::FullLevelCount(levels[0].width, levels[0].height)) {
+            return false;
+        }
+
+        size_t end = kHeaderSize + levelCount * kLevelEntrySize;
+        std::vector<size_t> offsets(levelCount);
+        for (uint32_t i = 0; i < levelCount; i++) {
+            // the same chain ParseTextureFile expects
+            const bool halved = i == 0 || (levels[i].width == (levels[i - 1].width > 1 ? levels[i - 1].width >> 1 : 1) &&
+                                           levels[i].height == (levels[i - 1].height > 1 ? levels[i - 1].height >> 1 : 1));
+            if (!halved || levels[i].size != TextureLevelBytes(format, levels[i].width, levels[i].height)) {
+                return false;
+            }
+            offsets[i] = AlignPayload(end);
+            end = offsets[i] + levels[i].size;
+        }
+        if (end > 0xFFFFFFFFu) {
+            return false;
+        }
+
+        // the whole file is built in memory so the checksum is one pass at the end
+        std::vector<uint8_t> file(end, 0);
+        uint8_t* header = file.data();
+        header[0] = 'M';
+        header[1] = 'J';
+        header[2] = '2';
+        header[3] = 'T';
+        WriteU16(header + 4, kVersion);
+        WriteU16(header + 6, kHeaderSize);
+        WriteU32(header + 8, format);
+        WriteU32(header + 12, levels[0].width);
+        WriteU32(header + 16, levels[0].height);
+        WriteU32(header + 20, levelCount);
+        WriteU32(header + 24, checksum ? TextureFileFlag_Checksum : 0);
+
+        for (uint32_t i = 0; i < levelCount; i++) {
+            uint8_t* entry = header + kHeaderSize + i * kLevelEntrySize;
+            WriteU32(entry, (uint32_t)offsets[i]);
+            WriteU32(entry + 4, (uint32_t)levels[i].size);
+            WriteU32(entry + 8, levels[i].width);
+            WriteU32(entry + 12, levels[i].height);
+            memcpy(header + offsets[i], levels[i].data, levels[i].size);
+        }
+        WriteU32(header + 28, checksum ? Crc32(header + kHeaderSize, end - kHeaderSize) : 0);
+
+        FILE* out = fopen(path, "wb");
+        if (!out) {
+            return false;
+        }
+        const bool written = fwrite(file.data(), 1, file.size(), out) == file.size();
+        return fclose(out) == 0 && written;
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "EtcCodec.hpp"
+#include "Image.hpp"
+
+namespace mj2 {
+
+    class MappedFile;
+
+    enum TextureFormat
+    {
+        TextureFormat_RGB8 = 0,   // rows padded to 4 bytes, GL_UNPACK_ALIGNMENT 4
+        TextureFormat_RGBA8,
+        TextureFormat_ETC1,
+        TextureFormat_ETC2_RGB,
+        TextureFormat_ETC2_RGBA,
+        TextureFormat_Count
+    };
+
+    static const uint32_t TextureFileMaxLevels = 16;        // MaxImageDimension x MaxImageDimension
+    static const size_t TextureFilePayloadAlignment = 64;   // level data starts on a cache line
+
+    static inline bool IsCompressedTextureFormat(TextureFormat format)
+    {
+        return format >= TextureFormat_ETC1;
+    }
+
+    /// only meaningful when IsCompressedTextureFormat(format)
+    static inline EtcFormat EtcFormatOf(TextureFormat format)
+    {
+        return (EtcFormat)(format - TextureFormat_ETC1);
+    }
+
+    /// bytes of one level: padded rows, or whole ETC blocks. 64 bit, since the largest
+    /// RGBA8 level does not fit a 32 bit size_t.
+    uint64_t TextureLevelBytes(TextureFormat format, uint32_t width, uint32_t height);
+
+    struct TextureLevel {
+    public:
+        const uint8_t* data;
+        size_t size;           // TextureLevelBytes(format, width, height)
+        uint32_t width;
+        uint32_t height;
+    };
+
+    //-------------------------------------------------------------
+    // TextureFile
+    //-------------------------------------------------------------
+    /////
+    // View of a .mj2t file, the pre-baked texture container the asset tools write.
+    // Levels are stored in GL order and the upload format, so the runtime hands
+    // pointers into the mapping to glTexImage2D / glCompressedTexImage2D without
+    // decoding, converting or copying anything.
+    //
+    // Levels are either just the base level or the full chain down to 1 x 1.
+    /////
+    struct TextureFile {
+    public:
+        TextureFormat format;
+        uint32_t width;
+        uint32_t height;
+        uint32_t levelCount;
+        bool hasChecksum;
+        TextureLevel levels[TextureFileMaxLevels];
+    };
+
+    /// Validate the header and level table and point file at the levels. With verifyChecksum
+    /// and a checksum in the file, everything after the header is read once and compared.
+    ImageStatus ParseTextureFile(const uint8_t* data, size_t size, TextureFile& texture, bool verifyChecksum);
+
+    /// Map path and parse it. texture points into file and stays valid while file is open.
+    ImageStatus LoadTextureFile(const char* path, MappedFile& file, TextureFile& texture, bool verifyChecksum);
+
+    /// Host side: write levelCount levels of format to path. levels[i].size has to match
+    /// TextureLevelBytes. Returns false on a bad level table or an I/O error.
+    bool WriteTextureFile(const char* path, TextureFormat format, const TextureLevel* levels, uint32_t levelCount,
+                          bool checksum);
+
+} // namespace mj2
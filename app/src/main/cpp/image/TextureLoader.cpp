@@ -0,0 +1,111 @@
+#include "TextureLoader.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <strings.h>
+
+#include "ThreadPool.hpp"
+
+namespace mj2
+{
+    TextureLoader::TextureLoader(ThreadPool& pool, PixelBufferPool* buffers)
+            : pool(pool)
+            , buffers(buffers)
+            , pending(0)
+            , inFlight(0)
+    {
+    }
+
+    TextureLoader::~TextureLoader()
+    {
+        // workers still hold this, loads are short so yielding beats a condition variable
+        while (inFlight.load(std::memory_order_acquire) != 0) {
+            std::this_thread::yield();
+        }
+        while (LoadedImage* loaded = completed.Pop()) {
+            delete loaded;
+        }
+    }
+
+    static bool HasExtension(const std::string& path, const char* extension)
+    {
+        const size_t length = strlen(extension);
+        return path.size() >= length && strcasecmp(path.c_str() + path.size() - length, extension) == 0;
+    }
+
+    static LoadedFile FileTypeOf(const std::string& path)
+    {
+        if (HasExtension(path, ".mj2t")) {
+            return LoadedFile_Texture;
+        }
+        return HasExtension(path, ".pkm") ? LoadedFile_Pkm : LoadedFile_Bmp;
+    }
+
+    void TextureLoader::Request(const char* path, uint32_t id, bool mipmaps, MipFilter filter)
+    {
+        pending.fetch_add(1, std::memory_order_acq_rel);
+        inFlight.fetch_add(1, std::memory_order_acq_rel);
+
+        std::string file(path);
+        pool.Submit([this, file, id, mipmaps, filter]() {
+            LoadedImage* loaded = new LoadedImage();
+            loaded->id = id;
+            loaded->fileType = FileTypeOf(file);
+            switch (loaded->fileType) {
+                case LoadedFile_Bmp:
+                    loaded->status = LoadBmp(file.c_str(), loaded->file, loaded->image);
+                    break;
+                case LoadedFile_Pkm:
+                    loaded->status = LoadPkm(file.c_str(), loaded->file, loaded->compressedImage);
+                    break;
+                case LoadedFile_Texture:
+                    loaded->status = LoadTextureFile(file.c_str(), loaded->file, loaded->texture, true);
+                    break;
+            }
+            if (loaded->status == ImageStatus_Ok && loaded->fileType == LoadedFile_Bmp) {
+                ConvertBmpToGL(loaded->image);
+                if (mipmaps) {
+                    const BmpImage& image = loaded->image;
+                    loaded->status = loaded->mips.Build(image.pixels, image.width, image.height, image.rowStride,
+                                                        image.bitsPerPixel / 8, filter, MipColorSpace_Linear, &pool, buffers);
+                }
+            }
+            if (loaded->status != ImageStatus_Ok) {
+                loaded->file.Close();
+            }
+
+            completed.Push(loaded);
+            inFlight.fetch_sub(1, std::memory_order_acq_rel);
+        });
+    }
+
+    size_t TextureLoader::Drain(double budgetMs, const std::function<void(LoadedImage&)>& upload)
+    {
+        typedef std::chrono::steady_clock Clock;
+        const Clock::time_point start = Clock::now();
+
+        size_t drained = 0;
+        while (LoadedImage* loaded = Take()) {
+            upload(*loaded);
+            delete loaded;
+            drained++;
+
+            if (std::chrono::duration<double, std::milli>(Clock::now() - start).count() >= budgetMs) {
+                break;
+            }
+        }
+        return drained;
+    }
+
+    LoadedImage* TextureLoader::Take()
+    {
+        LoadedImage* loaded = completed.Pop();
+        if (loaded) {
+            pending.fetch_sub(1, std::memory_order_acq_rel);
+        }
+        return loaded;
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+#include "BmpLoader.hpp"
+#include "MPSCQueue.hpp"
+#include "MappedFile.hpp"
+#include "MipChain.hpp"
+#include "PkmFile.hpp"
+#include "TextureFile.hpp"
+
+namespace mj2 {
+
+    class PixelBufferPool;
+    class ThreadPool;
+
+    /// which of the views in LoadedImage is set, picked by the file extension
+    enum LoadedFile
+    {
+        LoadedFile_Bmp = 0,  // image, and mips when requested
+        LoadedFile_Pkm,      // compressedImage
+        LoadedFile_Texture   // texture, a .mj2t container
+    };
+
+    /// A finished load: mapped, validated and converted to GL order on a worker thread
+    struct LoadedImage : public MPSCNode {
+    public:
+        uint32_t id;         // the id passed to TextureLoader::Request
+        ImageStatus status;
+        MappedFile file;
+        LoadedFile fileType;
+        BmpImage image;      // points into file, only valid when status is ImageStatus_Ok
+        MipChain mips;       // level 0 is image, empty unless requested with mipmaps
+        PkmImage compressedImage;
+        TextureFile texture; // levels point into file
+    };
+
+    //-------------------------------------------------------------
+    // TextureLoader
+    //-------------------------------------------------------------
+    /// Loads images on a ThreadPool and hands them to the GL thread, which uploads them
+    /// under a time budget per frame. No GL calls in here, uploading is the caller's job.
+    class TextureLoader {
+    public:
+        /// Mip levels are staged in buffers when given, and go back to it when the
+        /// LoadedImage is deleted after the upload
+        explicit TextureLoader(ThreadPool& pool, PixelBufferPool* buffers = nullptr);
+        /// Waits for loads in flight, then drops whatever was not drained
+        ~TextureLoader();
+
+        TextureLoader(const TextureLoader&) = delete;
+        TextureLoader& operator=(const TextureLoader&) = delete;
+
+        /// Any thread. path is copied. Paths ending in .mj2t and .pkm are mapped, validated
+        /// and uploaded as they are (a .mj2t checksum is verified here, off the GL thread),
+        /// anything else is decoded as a BMP. With mipmaps the full chain of a BMP is built
+        /// on the workers too, a linear box filter unless filter says otherwise; .mj2t files
+        /// carry their own chain.
+        void Request(const char* path, uint32_t id, bool mipmaps = false, MipFilter filter = MipFilter_Box);
+
+        /// GL thread. Calls upload for finished images until budgetMs has passed, at least
+        /// once if anything is ready so a slow upload cannot stall the queue. Returns the
+        /// number of images handed out; each is released when upload returns.
+        size_t Drain(double budgetMs, const std::function<void(LoadedImage&)>& upload);
+
+        /// GL thread. The next finished image or nullptr. The caller owns it and deletes it
+        /// when done, so it can keep the mapping over several frames (mip streaming).
+        LoadedImage* Take();
+
+        /// requested but not drained or taken yet
+        size_t Pending() const { return pending.load(std::memory_order_acquire); }
+
+    private:
+        ThreadPool& pool;
+        PixelBufferPool* buffers;
+        MPSCQueue<LoadedImage> completed;
+        std::atomic<size_t> pending;
+        std::atomic<size_t> inFlight;
+    };
+
+} // namespace mj2
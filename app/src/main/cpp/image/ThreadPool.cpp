@@ -0,0 +1,117 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace mj2
+{
+    ThreadPool::ThreadPool(unsigned threadCount)
+            : stopping(false)
+    {
+        if (threadCount == 0) {
+            const unsigned hardware = std::thread::hardware_concurrency();
+            threadCount = hardware > 1 ? hardware - 1 : 1;
+        }
+
+        threads.reserve(threadCount);
+        for (unsigned i = 0; i < threadCount; i++) {
+            threads.emplace_back(&ThreadPool::WorkerLoop, this);
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+
+    void ThreadPool::Submit(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+        }
+        wake.notify_one();
+    }
+
+    /// shared with the helper tasks, which can start after ParallelFor has returned
+    struct ParallelForState {
+    public:
+        const std::function<void(size_t, size_t)>* body;
+        size_t count;
+        size_t grain;
+        size_t bands;
+        std::atomic<size_t> next;
+        std::atomic<size_t> done;
+        std::mutex mutex;
+        std::condition_variable finished;
+
+        void RunBands()
+        {
+            for (size_t band = next.fetch_add(1); band < bands; band = next.fetch_add(1)) {
+                (*body)(band * grain, std::min(count, (band + 1) * grain));
+                if (done.fetch_add(1) + 1 == bands) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    finished.notify_all();
+                }
+            }
+        }
+    };
+
+    void ThreadPool::ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body)
+    {
+        if (grain == 0) {
+            grain = 1;
+        }
+        const size_t bands = (count + grain - 1) / grain;
+        if (bands <= 1) {
+            if (count) {
+                body(0, count);
+            }
+            return;
+        }
+
+        std::shared_ptr<ParallelForState> state = std::make_shared<ParallelForState>();
+        state->body = &body;
+        state->count = count;
+        state->grain = grain;
+        state->bands = bands;
+        state->next = 0;
+        state->done = 0;
+
+        // body is only called for claimed bands, all of which finish before we return
+        const size_t helpers = std::min(bands - 1, threads.size());
+        for (size_t i = 0; i < helpers; i++) {
+            Submit([state] { state->RunBands(); });
+        }
+        state->RunBands();
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->finished.wait(lock, [&state] { return state->done.load() == state->bands; });
+    }
+
+    void ThreadPool::WorkerLoop()
+    {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (tasks.empty()) {
+                    return;
+                }
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+}
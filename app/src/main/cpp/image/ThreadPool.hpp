@@ -0,0 +1,46 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mj2 {
+
+    //-------------------------------------------------------------
+    // ThreadPool
+    //-------------------------------------------------------------
+    /// Fixed set of worker threads running tasks in submission order. Tasks are coarse
+    /// (a file load, a band of pixels), so a mutex protected queue is plenty.
+    class ThreadPool {
+    public:
+        /// threadCount 0 uses one thread less than the hardware has, at least one
+        explicit ThreadPool(unsigned threadCount = 0);
+        /// Runs the tasks still queued, then joins the workers
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        void Submit(std::function<void()> task);
+
+        /// Calls body(begin, end) over [0, count) in bands of grain items and returns when
+        /// all have run. The calling thread takes bands too, so this is safe from inside a
+        /// task of the same pool; it just gets less help while the workers are busy.
+        void ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+        unsigned ThreadCount() const { return (unsigned)threads.size(); }
+
+    private:
+        void WorkerLoop();
+
+        std::vector<std::thread> threads;
+        std::deque<std::function<void()>> tasks;
+        std::mutex mutex;
+        std::condition_variable wake;
+        bool stopping;
+    };
+
+} // namespace mj2
@@ -0,0 +1,559 @@
+/////
+// Host benchmark for the BMP load path, the work a TextureLoader worker does per image.
+//
+// usage: mj2image_bench [--json] [--threads <n>] [--repeat <n>] [--mips] [<file.bmp | dir>...]
+//
+// Without inputs it writes a corpus to a temporary directory: 64x64 up to 2048x2048,
+// each size as 24 bit bottom-up and 32 bit top-down, so both the plain swizzle and the
+// swizzle + flip path are covered. Directories are scanned for *.bmp.
+//
+// Single threaded, per file and stage, the best of --repeat runs (5 by default):
+//
+//   io       open + mmap + reading one byte per page. The file is dropped from the page
+//            cache first with posix_fadvise, which is best effort: without write access
+//            to the pages' owner, or on tmpfs, this is a warm read.
+//   parse    ParseBmp, header validation only
+//   swizzle  SwizzleBmpToRGB, once per pixel kernel level the CPU supports
+//   565      ConvertRGBAToRGB565, 4444 ConvertRGBAToRGBA4444 and premul PremultiplyAlpha,
+//            per kernel level like swizzle, on the image expanded to RGBA; their MB/s
+//            count those 4 bytes per pixel, swizzle's the file bytes
+//   flip     FlipBmpToBottomUp, top-down files only
+//
+// Then the whole corpus through TextureLoader with 1, 2, 4 ... --threads workers (the
+// hardware concurrency by default), reported as wall clock MB/s of file bytes. With
+// --mips every load builds its mip chain too, staged in a PixelBufferPool whose
+// high-water marks are printed with the results.
+// MB is 10^6 bytes throughout.
+/////
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../BmpLoader.hpp"
+#include "../MappedFile.hpp"
+#include "../PixelBufferPool.hpp"
+#include "../PixelConvert.hpp"
+#include "../PixelKernels.hpp"
+#include "../TextureLoader.hpp"
+#include "../ThreadPool.hpp"
+
+using namespace mj2;
+
+namespace {
+
+    typedef std::chrono::steady_clock Clock;
+
+    struct Options {
+    public:
+        bool json = false;
+        bool mips = false;
+        unsigned threads = 0;
+        int repeat = 5;
+        std::vector<std::string> inputs;
+    };
+
+    /// the stages timed once per kernel level
+    enum KernelStage
+    {
+        KernelStage_Swizzle = 0,
+        KernelStage_RGB565,
+        KernelStage_RGBA4444,
+        KernelStage_Premultiply,
+        KernelStage_Count
+    };
+
+    struct FileResult {
+    public:
+        std::string path;
+        uint64_t bytes;
+        uint32_t width;
+        uint32_t height;
+        uint32_t bitsPerPixel;
+        bool topDown;
+        double ioMs;
+        double parseMs;
+        double kernelMs[KernelStage_Count][3];  // by PixelKernelLevel, < 0 when the CPU lacks it
+        double flipMs;         // < 0 for bottom-up files
+    };
+
+    struct ThreadResult {
+    public:
+        unsigned threads;
+        double ms;
+        double megabytesPerSecond;
+    };
+
+    const char* const kLevelNames[] = { "scalar", "ssse3", "neon" };
+    const char* const kStageNames[] = { "swizzle", "565", "4444", "premul" };
+    const char* const kStageJsonNames[] = { "swizzle_ms", "rgb565_ms", "rgba4444_ms", "premultiply_ms" };
+
+    double Milliseconds(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    double MegabytesPerSecond(uint64_t bytes, double ms)
+    {
+        return ms > 0.0 ? (double)bytes / (ms * 1e3) : 0.0;
+    }
+
+    /// what a kernel stage's MB/s are counted in
+    uint64_t StageBytes(const FileResult& file, int stage)
+    {
+        return stage == KernelStage_Swizzle ? file.bytes : (uint64_t)file.width * file.height * 4;
+    }
+
+    //-------------------------------------------------------------
+    // Corpus
+    //-------------------------------------------------------------
+    void PutU16(uint8_t* out, uint32_t v)
+    {
+        out[0] = (uint8_t)v;
+        out[1] = (uint8_t)(v >> 8);
+    }
+
+    void PutU32(uint8_t* out, uint32_t v)
+    {
+        PutU16(out, v);
+        PutU16(out + 2, v >> 16);
+    }
+
+    /// noise rather than a flat colour, so nothing downstream can shortcut it
+    bool WriteBmp(const std::string& path, uint32_t width, uint32_t height, uint32_t bitsPerPixel, bool topDown)
+    {
+        const size_t stride = (((size_t)width * bitsPerPixel + 31) / 32) * 4;
+        std::vector<uint8_t> file(54 + stride * height);
+        uint8_t* header = file.data();
+        header[0] = 'B';
+        header[1] = 'M';
+        PutU32(header + 2, (uint32_t)file.size());
+        PutU32(header + 10, 54);
+        PutU32(header + 14, 40);
+        PutU32(header + 18, width);
+        PutU32(header + 22, topDown ? (uint32_t)-(int32_t)height : height);
+        PutU16(header + 26, 1);
+        PutU16(header + 28, bitsPerPixel);
+        uint32_t state = width * 2654435761u + bitsPerPixel;
+        for (size_t i = 54; i < file.size(); i++) {
+            state = state * 1664525u + 1013904223u;
+            file[i] = (uint8_t)(state >> 24);
+        }
+
+        FILE* out = fopen(path.c_str(), "wb");
+        if (!out) {
+            return false;
+        }
+        const bool written = fwrite(file.data(), 1, file.size(), out) == file.size();
+        // flushed to disk so the page cache can actually drop it before the io stage
+        fflush(out);
+        fsync(fileno(out));
+        return fclose(out) == 0 && written;
+    }
+
+    bool GenerateCorpus(std::string& directory, std::vector<std::string>& paths)
+    {
+        char pattern[] = "/tmp/mj2image_bench_XXXXXX";
+        if (!mkdtemp(pattern)) {
+            return false;
+        }
+        directory = pattern;
+        for (uint32_t size = 64; size <= 2048; size *= 2) {
+            for (int variant = 0; variant < 2; variant++) {
+                const uint32_t bitsPerPixel = variant ? 32 : 24;
+                const std::string path = directory + "/" + std::to_string(size) + (variant ? "_32_topdown.bmp" : "_24.bmp");
+                if (!WriteBmp(path, size, size, bitsPerPixel, variant != 0)) {
+                    return false;
+                }
+                paths.push_back(path);
+            }
+        }
+        return true;
+    }
+
+    void RemoveCorpus(const std::string& directory, const std::vector<std::string>& paths)
+    {
+        for (const std::string& path : paths) {
+            unlink(path.c_str());
+        }
+        rmdir(directory.c_str());
+    }
+
+    bool EndsWithBmp(const char* name)
+    {
+        const size_t length = strlen(name);
+        return length > 4 && strcasecmp(name + length - 4, ".bmp") == 0;
+    }
+
+    bool CollectInputs(const std::vector<std::string>& inputs, std::vector<std::string>& paths)
+    {
+        for (const std::string& input : inputs) {
+            struct stat info;
+            if (stat(input.c_str(), &info) != 0) {
+                fprintf(stderr, "%s: not found\n", input.c_str());
+                return false;
+            }
+            if (!S_ISDIR(info.st_mode)) {
+                paths.push_back(input);
+                continue;
+            }
+            DIR* dir = opendir(input.c_str());
+            if (!dir) {
+                fprintf(stderr, "%s: cannot read\n", input.c_str());
+                return false;
+            }
+            std::vector<std::string> found;
+            while (dirent* entry = readdir(dir)) {
+                if (EndsWithBmp(entry->d_name)) {
+                    found.push_back(input + "/" + entry->d_name);
+                }
+            }
+            closedir(dir);
+            std::sort(found.begin(), found.end());
+            paths.insert(paths.end(), found.begin(), found.end());
+        }
+        return true;
+    }
+
+    //-------------------------------------------------------------
+    // Stages
+    //-------------------------------------------------------------
+    void DropFromPageCache(const char* path)
+    {
+        const int fd = open(path, O_RDONLY);
+        if (fd >= 0) {
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            close(fd);
+        }
+    }
+
+    double TimeIo(const char* path, int repeat, uint64_t& bytes)
+    {
+        const long pageSize = sysconf(_SC_PAGESIZE);
+        double best = 1e300;
+        for (int i = 0; i < repeat; i++) {
+            DropFromPageCache(path);
+            const Clock::time_point start = Clock::now();
+            MappedFile file;
+            if (file.Open(path) != ImageStatus_Ok) {
+                return -1.0;
+            }
+            volatile uint8_t sink = 0;
+            for (size_t offset = 0; offset < file.Size(); offset += pageSize) {
+                sink = sink + file.Data()[offset];
+            }
+            best = std::min(best, Milliseconds(start));
+            bytes = file.Size();
+        }
+        return best;
+    }
+
+    /// best of repeat runs of work at every kernel level the CPU has, after one run to
+    /// fault in the buffers
+    template <typename Work>
+    void TimeKernelLevels(int repeat, double* ms, Work work)
+    {
+        const PixelKernelLevel initial = GetPixelKernels().level;
+        for (int level = 0; level < 3; level++) {
+            ms[level] = -1.0;
+            if (!SetPixelKernelLevel((PixelKernelLevel)level)) {
+                continue;
+            }
+            double best = 1e300;
+            for (int i = 0; i < repeat + 1; i++) {
+                const Clock::time_point start = Clock::now();
+                work();
+                if (i > 0) {
+                    best = std::min(best, Milliseconds(start));
+                }
+            }
+            ms[level] = best;
+        }
+        SetPixelKernelLevel(initial);
+    }
+
+    bool BenchmarkFile(const std::string& path, int repeat, FileResult& result)
+    {
+        result.path = path;
+        result.ioMs = TimeIo(path.c_str(), repeat, result.bytes);
+        if (result.ioMs < 0.0) {
+            fprintf(stderr, "%s: cannot map\n", path.c_str());
+            return false;
+        }
+
+        // stays mapped for the in-place stages; the first pass takes the copy-on-write
+        // faults, which the best-of then leaves out
+        MappedFile file;
+        BmpImage image;
+        ImageStatus status = file.Open(path.c_str());
+        double best = 1e300;
+        for (int i = 0; i < repeat && status == ImageStatus_Ok; i++) {
+            const Clock::time_point start = Clock::now();
+            status = ParseBmp(file.Data(), file.Size(), image);
+            best = std::min(best, Milliseconds(start));
+        }
+        if (status != ImageStatus_Ok) {
+            fprintf(stderr, "%s: %s\n", path.c_str(), ImageStatusString(status));
+            return false;
+        }
+        result.parseMs = best;
+        result.width = image.width;
+        result.height = image.height;
+        result.bitsPerPixel = image.bitsPerPixel;
+        result.topDown = !image.bottomUp;
+
+        // swizzling twice is the identity for 24 bit, for 32 bit it only changes the
+        // bytes; either way the kernels see the same amount of work every pass
+        TimeKernelLevels(repeat, result.kernelMs[KernelStage_Swizzle], [&]() { SwizzleBmpToRGB(image); });
+
+        // the 16 bit and premultiply conversions start from tightly packed RGBA, as
+        // they would after a load; the noise makes for every alpha value
+        const uint32_t width = image.width;
+        const uint32_t height = image.height;
+        std::vector<uint8_t> rgba((size_t)width * height * 4);
+        std::vector<uint8_t> premultiplied(rgba.size());
+        std::vector<uint16_t> packed((size_t)width * height);
+        if (image.bitsPerPixel == 32) {
+            ConvertBGRAToRGBA(rgba.data(), width * 4, image.pixels, image.rowStride, width, height, true);
+        } else {
+            ConvertBGRToRGBA(rgba.data(), width * 4, image.pixels, image.rowStride, width, height);
+        }
+        TimeKernelLevels(repeat, result.kernelMs[KernelStage_RGB565], [&]() {
+            ConvertRGBAToRGB565(packed.data(), width * 2, rgba.data(), width * 4, width, height);
+        });
+        TimeKernelLevels(repeat, result.kernelMs[KernelStage_RGBA4444], [&]() {
+            ConvertRGBAToRGBA4444(packed.data(), width * 2, rgba.data(), width * 4, width, height);
+        });
+        TimeKernelLevels(repeat, result.kernelMs[KernelStage_Premultiply], [&]() {
+            PremultiplyAlpha(premultiplied.data(), width * 4, rgba.data(), width * 4, width, height);
+        });
+
+        result.flipMs = -1.0;
+        if (result.topDown) {
+            best = 1e300;
+            for (int i = 0; i < repeat; i++) {
+                image.bottomUp = false;
+                const Clock::time_point start = Clock::now();
+                FlipBmpToBottomUp(image);
+                best = std::min(best, Milliseconds(start));
+            }
+            result.flipMs = best;
+        }
+        return true;
+    }
+
+    /// whole loads, as the app does them: every file requested at once, taken as they finish
+    double TimeLoader(const std::vector<std::string>& paths, unsigned threads, int repeat, bool mips,
+                      PixelBufferPool& buffers)
+    {
+        double best = 1e300;
+        for (int i = 0; i < repeat; i++) {
+            ThreadPool pool(threads);
+            TextureLoader loader(pool, &buffers);
+            const Clock::time_point start = Clock::now();
+            for (size_t j = 0; j < paths.size(); j++) {
+                loader.Request(paths[j].c_str(), (uint32_t)j, mips);
+            }
+            while (loader.Pending() > 0) {
+                if (LoadedImage* image = loader.Take()) {
+                    delete image;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+            best = std::min(best, Milliseconds(start));
+        }
+        return best;
+    }
+
+    //-------------------------------------------------------------
+    // Report
+    //-------------------------------------------------------------
+    std::string FileName(const std::string& path)
+    {
+        const size_t slash = path.rfind('/');
+        return slash == std::string::npos ? path : path.substr(slash + 1);
+    }
+
+    void PrintText(const std::vector<FileResult>& files, const std::vector<ThreadResult>& threads,
+                   const PixelBufferPoolStats& staging)
+    {
+        printf("%-24s %9s %11s %11s", "file", "MB", "io MB/s", "parse us");
+        for (int stage = 0; stage < KernelStage_Count; stage++) {
+            for (int level = 0; level < 3; level++) {
+                if (files[0].kernelMs[stage][level] >= 0.0) {
+                    const std::string name = std::string(kStageNames[stage]) + " " + kLevelNames[level];
+                    printf(" %14s", name.c_str());
+                }
+            }
+        }
+        printf(" %11s\n", "flip MB/s");
+
+        uint64_t totalBytes = 0;
+        double totalIo = 0.0;
+        for (const FileResult& file : files) {
+            totalBytes += file.bytes;
+            totalIo += file.ioMs;
+            printf("%-24s %9.3f %11.1f %11.2f", FileName(file.path).c_str(), file.bytes / 1e6,
+                   MegabytesPerSecond(file.bytes, file.ioMs), file.parseMs * 1e3);
+            for (int stage = 0; stage < KernelStage_Count; stage++) {
+                for (int level = 0; level < 3; level++) {
+                    if (file.kernelMs[stage][level] >= 0.0) {
+                        printf(" %14.1f", MegabytesPerSecond(StageBytes(file, stage), file.kernelMs[stage][level]));
+                    }
+                }
+            }
+            if (file.flipMs >= 0.0) {
+                printf(" %11.1f\n", MegabytesPerSecond(file.bytes, file.flipMs));
+            } else {
+                printf(" %11s\n", "-");
+            }
+        }
+        printf("\n%zu files, %.1f MB, io %.1f MB/s; kernel columns in MB/s\n\n", files.size(), totalBytes / 1e6,
+               MegabytesPerSecond(totalBytes, totalIo));
+
+        printf("TextureLoader, whole corpus (%s pixel kernels)\n", kLevelNames[GetPixelKernels().level]);
+        for (const ThreadResult& result : threads) {
+            printf("  %2u threads %10.2f ms %10.1f MB/s %6.2fx\n", result.threads, result.ms, result.megabytesPerSecond,
+                   result.megabytesPerSecond / threads[0].megabytesPerSecond);
+        }
+        if (staging.acquires) {
+            printf("  mip staging: peak %.1f MB in use, %.1f MB footprint, %llu of %llu buffers reused\n",
+                   staging.peakInUseBytes / 1e6, staging.peakTotalBytes / 1e6, (unsigned long long)staging.reuses,
+                   (unsigned long long)staging.acquires);
+        }
+    }
+
+    void PrintJson(const std::vector<FileResult>& files, const std::vector<ThreadResult>& threads,
+                   const PixelBufferPoolStats& staging)
+    {
+        printf("{\n  \"kernels\": \"%s\",\n  \"files\": [\n", kLevelNames[GetPixelKernels().level]);
+        for (size_t i = 0; i < files.size(); i++) {
+            const FileResult& file = files[i];
+            printf("    {\"file\": \"%s\", \"bytes\": %llu, \"width\": %u, \"height\": %u, \"bpp\": %u, "
+                   "\"io_ms\": %.4f, \"parse_ms\": %.6f, \"flip_ms\": %.4f",
+                   FileName(file.path).c_str(), (unsigned long long)file.bytes, file.width, file.height,
+                   file.bitsPerPixel, file.ioMs, file.parseMs, file.flipMs);
+            for (int stage = 0; stage < KernelStage_Count; stage++) {
+                printf(", \"%s\": {", kStageJsonNames[stage]);
+                bool first = true;
+                for (int level = 0; level < 3; level++) {
+                    if (file.kernelMs[stage][level] >= 0.0) {
+                        printf("%s\"%s\": %.4f", first ? "" : ", ", kLevelNames[level], file.kernelMs[stage][level]);
+                        first = false;
+                    }
+                }
+                printf("}");
+            }
+            printf("}%s\n", i + 1 < files.size() ? "," : "");
+        }
+        printf("  ],\n  \"loader\": [\n");
+        for (size_t i = 0; i < threads.size(); i++) {
+            printf("    {\"threads\": %u, \"ms\": %.4f, \"mb_per_sec\": %.1f}%s\n", threads[i].threads, threads[i].ms,
+                   threads[i].megabytesPerSecond, i + 1 < threads.size() ? "," : "");
+        }
+        printf("  ],\n  \"staging\": {\"peak_in_use_bytes\": %zu, \"peak_total_bytes\": %zu, \"acquires\": %llu, "
+               "\"reuses\": %llu}\n}\n", staging.peakInUseBytes, staging.peakTotalBytes,
+               (unsigned long long)staging.acquires, (unsigned long long)staging.reuses);
+    }
+
+    bool ParseOptions(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; i++) {
+            if (strcmp(argv[i], "--json") == 0) {
+                options.json = true;
+            } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+                options.threads = (unsigned)atoi(argv[++i]);
+            } else if (strcmp(argv[i], "--mips") == 0) {
+                options.mips = true;
+            } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+                options.repeat = std::max(atoi(argv[++i]), 1);
+            } else if (argv[i][0] == '-') {
+                return false;
+            } else {
+                options.inputs.push_back(argv[i]);
+            }
+        }
+        return true;
+    }
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        fprintf(stderr, "usage: mj2image_bench [--json] [--threads <n>] [--repeat <n>] [--mips] [<file.bmp | dir>...]\n");
+        return 2;
+    }
+    if (options.threads == 0) {
+        options.threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    std::vector<std::string> paths;
+    std::string corpusDirectory;
+    if (options.inputs.empty()) {
+        if (!GenerateCorpus(corpusDirectory, paths)) {
+            fprintf(stderr, "cannot write the corpus to /tmp\n");
+            RemoveCorpus(corpusDirectory, paths);
+            return 1;
+        }
+    } else if (!CollectInputs(options.inputs, paths)) {
+        return 1;
+    }
+    if (paths.empty()) {
+        fprintf(stderr, "no .bmp files\n");
+        return 1;
+    }
+
+    std::vector<FileResult> files;
+    bool ok = true;
+    for (const std::string& path : paths) {
+        FileResult result;
+        if (!BenchmarkFile(path, options.repeat, result)) {
+            ok = false;
+            break;
+        }
+        files.push_back(result);
+    }
+
+    std::vector<ThreadResult> threads;
+    PixelBufferPool buffers;
+    if (ok) {
+        uint64_t totalBytes = 0;
+        for (const FileResult& file : files) {
+            totalBytes += file.bytes;
+        }
+        for (unsigned count = 1;; count = std::min(count * 2, options.threads)) {
+            ThreadResult result;
+            result.threads = count;
+            result.ms = TimeLoader(paths, count, options.repeat, options.mips, buffers);
+            result.megabytesPerSecond = MegabytesPerSecond(totalBytes, result.ms);
+            threads.push_back(result);
+            if (count == options.threads) {
+                break;
+            }
+        }
+        if (options.json) {
+            PrintJson(files, threads, buffers.Stats());
+        } else {
+            PrintText(files, threads, buffers.Stats());
+        }
+    }
+
+    if (!corpusDirectory.empty()) {
+        RemoveCorpus(corpusDirectory, paths);
+    }
+    return ok ? 0 : 1;
+}
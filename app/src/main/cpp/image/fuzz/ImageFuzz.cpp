@@ -0,0 +1,445 @@
+/////
+// Fuzz target for everything that parses asset files: BMP, PKM and .mj2t headers, and
+// whatever runs on the data once a header is accepted (swizzle, flip, mip chain, ETC
+// block decode). Every input goes through all three parsers; each rejects the others'
+// signatures in a few instructions, so the fuzzer finds its way into all of them.
+// Whatever a parser accepts is then loaded again from a temporary file through
+// TextureLoader and TextureCache, with a backend that checks every level it is handed,
+// so the level tables built from decoded images get the same inputs.
+//
+// With -DMJ2_LIBFUZZER the file only provides LLVMFuzzerTestOneInput for clang's
+// -fsanitize=fuzzer. Otherwise it carries a small standalone driver, so any compiler
+// with -fsanitize=address can run it:
+//
+// usage: mj2image_fuzz [--iterations <n>] [--seed <n>] [--max-size <bytes>] [<file>...]
+//
+// The files are replayed first (a crash reproducer, or a corpus as seeds), then mutated
+// for the given number of iterations. Without files it starts from small valid images
+// of each type. Mutations favour the header bytes and the values that break size math.
+/////
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "../BmpLoader.hpp"
+#include "../EtcCodec.hpp"
+#include "../MipChain.hpp"
+#include "../PkmFile.hpp"
+#include "../TextureCache.hpp"
+#include "../TextureFile.hpp"
+#include "../TextureLoader.hpp"
+#include "../ThreadPool.hpp"
+
+using namespace mj2;
+
+namespace {
+
+    /// valid images above this many pixels skip the mip chain, it only slows the run down
+    const uint64_t kMaxMipPixels = 1 << 16;
+
+    /// Takes anything, ES 2 style: mipmaps only for power of two sizes. Every upload is
+    /// checked against the texture it goes to and read at both ends like a driver would.
+    class CheckingTextureBackend : public TextureBackend {
+    public:
+        bool SupportsFormat(TextureFormat) override { return true; }
+
+        bool SupportsMipmaps(uint32_t width, uint32_t height) override
+        {
+            return (width & (width - 1)) == 0 && (height & (height - 1)) == 0;
+        }
+
+        uint32_t CreateTexture(TextureFormat format, uint32_t width, uint32_t height, uint32_t levelCount) override
+        {
+            if (width == 0 || height == 0 || levelCount == 0 || levelCount > TextureFileMaxLevels) {
+                Fail("CreateTexture", width, height, levelCount);
+            }
+            textures.push_back(Texture{ format, width, height, levelCount });
+            return (uint32_t)textures.size();
+        }
+
+        void UploadLevel(uint32_t texture, TextureFormat format, const TextureLevel& level, uint32_t glLevel) override
+        {
+            if (texture == 0 || texture > textures.size()) {
+                Fail("UploadLevel to an unknown texture", texture, 0, 0);
+            }
+            const Texture& target = textures[texture - 1];
+            if (format != target.format || glLevel >= target.levelCount ||
+                level.width != std::max(target.width >> glLevel, 1u) ||
+                level.height != std::max(target.height >> glLevel, 1u) ||
+                level.size != TextureLevelBytes(format, level.width, level.height)) {
+                Fail("UploadLevel", level.width, level.height, glLevel);
+            }
+            volatile uint8_t sink = 0;
+            sink = sink + level.data[0] + level.data[level.size - 1];
+        }
+
+        void DeleteTexture(uint32_t) override {}
+
+    private:
+        struct Texture {
+        public:
+            TextureFormat format;
+            uint32_t width;
+            uint32_t height;
+            uint32_t levelCount;
+        };
+
+        static void Fail(const char* what, uint32_t a, uint32_t b, uint32_t c)
+        {
+            fprintf(stderr, "%s: bad arguments %u %u %u\n", what, a, b, c);
+            abort();
+        }
+
+        std::vector<Texture> textures;
+    };
+
+    /// Loads data from a file named for its type and streams it into a fresh cache
+    void FuzzTextureCache(const uint8_t* data, size_t size, const char* extension, bool mipmaps)
+    {
+        static ThreadPool pool(1);
+        static TextureLoader loader(pool);
+        static const std::string base = "/tmp/mj2image_fuzz_" + std::to_string(getpid());
+
+        const std::string path = base + extension;
+        FILE* out = fopen(path.c_str(), "wb");
+        if (!out) {
+            return;
+        }
+        const bool written = fwrite(data, 1, size, out) == size;
+        if (fclose(out) != 0 || !written) {
+            remove(path.c_str());
+            return;
+        }
+
+        CheckingTextureBackend backend;
+        {
+            TextureCache cache(loader, backend, TextureCacheBudget{ (size_t)1 << 30, (size_t)1 << 30 });
+            const TextureId id = cache.Acquire(path.c_str(), mipmaps);
+            while (cache.State(id) != TextureState_Resident && cache.State(id) != TextureState_Failed) {
+                cache.Update(1.0);
+                if (cache.State(id) == TextureState_Loading) {
+                    std::this_thread::yield();
+                }
+            }
+            cache.Release(id);
+        }
+        remove(path.c_str());
+    }
+
+    void FuzzBmp(const uint8_t* data, size_t size)
+    {
+        // the loader converts in place on a private mapping, this is the same on a copy
+        // of exactly size bytes, so reading past the end hits the heap redzone
+        std::vector<uint8_t> copy(data, data + size);
+        BmpImage image;
+        if (ParseBmp(copy.data(), copy.size(), image) != ImageStatus_Ok) {
+            return;
+        }
+        ConvertBmpToGL(image);
+        if ((uint64_t)image.width * image.height <= kMaxMipPixels) {
+            MipChain mips;
+            mips.Build(image.pixels, image.width, image.height, image.rowStride, image.bitsPerPixel / 8,
+                       image.width & 1 ? MipFilter_Kaiser : MipFilter_Box, MipColorSpace_SRGB);
+        }
+        FuzzTextureCache(data, size, ".bmp", (uint64_t)image.width * image.height <= kMaxMipPixels);
+    }
+
+    void FuzzPkm(const uint8_t* data, size_t size)
+    {
+        PkmImage image;
+        if (ParsePkm(data, size, image) != ImageStatus_Ok) {
+            return;
+        }
+        // first and last block, anything in between is the same code on other bits
+        const size_t blockBytes = EtcBlockBytes(image.format);
+        uint8_t rgba[64];
+        DecodeEtcBlock(rgba, image.blocks, image.format);
+        DecodeEtcBlock(rgba, image.blocks + image.blocksSize - blockBytes, image.format);
+        FuzzTextureCache(data, size, ".pkm", false);
+    }
+
+    void FuzzTextureFile(const uint8_t* data, size_t size)
+    {
+        TextureFile texture;
+        if (ParseTextureFile(data, size, texture, true) != ImageStatus_Ok) {
+            return;
+        }
+        // what the upload would read: the first and last byte of every level
+        volatile uint8_t sink = 0;
+        for (uint32_t i = 0; i < texture.levelCount; i++) {
+            sink = sink + texture.levels[i].data[0] + texture.levels[i].data[texture.levels[i].size - 1];
+        }
+        FuzzTextureCache(data, size, ".mj2t", false);
+    }
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    FuzzBmp(data, size);
+    FuzzPkm(data, size);
+    FuzzTextureFile(data, size);
+    return 0;
+}
+
+#ifndef MJ2_LIBFUZZER
+
+#include <chrono>
+
+namespace {
+
+    struct DriverOptions {
+    public:
+        uint64_t iterations = 100000;
+        uint32_t seed = 1;
+        size_t maxSize = 1 << 16;
+        std::vector<const char*> files;
+    };
+
+    /// xorshift, the seed makes a run reproducible
+    uint32_t gRandomState = 1;
+
+    uint32_t Random()
+    {
+        gRandomState ^= gRandomState << 13;
+        gRandomState ^= gRandomState >> 17;
+        gRandomState ^= gRandomState << 5;
+        return gRandomState;
+    }
+
+    void PutU16(std::vector<uint8_t>& out, size_t at, uint32_t v, bool bigEndian)
+    {
+        out[at + (bigEndian ? 1 : 0)] = (uint8_t)v;
+        out[at + (bigEndian ? 0 : 1)] = (uint8_t)(v >> 8);
+    }
+
+    void PutU32(std::vector<uint8_t>& out, size_t at, uint32_t v)
+    {
+        for (int i = 0; i < 4; i++) {
+            out[at + i] = (uint8_t)(v >> (8 * i));
+        }
+    }
+
+    std::vector<uint8_t> MakeBmp(uint32_t width, int32_t height, uint32_t bitCount, uint32_t compression)
+    {
+        const uint32_t rows = (uint32_t)(height < 0 ? -height : height);
+        const uint32_t stride = ((width * bitCount + 31) / 32) * 4;
+        const uint32_t offset = compression == 3 ? 14 + 40 + 16 : 14 + 40;
+        std::vector<uint8_t> out(offset + stride * rows);
+        out[0] = 'B';
+        out[1] = 'M';
+        PutU32(out, 2, (uint32_t)out.size());
+        PutU32(out, 10, offset);
+        PutU32(out, 14, 40);
+        PutU32(out, 18, width);
+        PutU32(out, 22, (uint32_t)height);
+        PutU16(out, 26, 1, false);
+        PutU16(out, 28, bitCount, false);
+        PutU32(out, 30, compression);
+        if (compression == 3) {
+            PutU32(out, 54, 0x00FF0000u);
+            PutU32(out, 58, 0x0000FF00u);
+            PutU32(out, 62, 0x000000FFu);
+            PutU32(out, 66, 0xFF000000u);
+        }
+        for (size_t i = offset; i < out.size(); i++) {
+            out[i] = (uint8_t)Random();
+        }
+        return out;
+    }
+
+    std::vector<uint8_t> MakePkm(EtcFormat format, uint32_t width, uint32_t height)
+    {
+        std::vector<uint8_t> out(PkmHeaderSize + EtcImageBytes(format, width, height));
+        WritePkmHeader(out.data(), format, width, height);
+        for (size_t i = PkmHeaderSize; i < out.size(); i++) {
+            out[i] = (uint8_t)Random();
+        }
+        return out;
+    }
+
+    /// WriteTextureFile only writes files, so go through a temporary one
+    std::vector<uint8_t> MakeTextureFile(TextureFormat format, uint32_t width, uint32_t height)
+    {
+        std::vector<std::vector<uint8_t> > data;
+        std::vector<TextureLevel> levels;
+        const uint32_t count = MipChain::FullLevelCount(width, height);
+        for (uint32_t i = 0; i < count; i++) {
+            TextureLevel level;
+            level.width = std::max(width >> i, 1u);
+            level.height = std::max(height >> i, 1u);
+            level.size = (size_t)TextureLevelBytes(format, level.width, level.height);
+            data.emplace_back(level.size, (uint8_t)i);
+            level.data = data.back().data();
+            levels.push_back(level);
+        }
+
+        char path[] = "/tmp/mj2image_fuzz_XXXXXX";
+        const int fd = mkstemp(path);
+        std::vector<uint8_t> out;
+        if (fd < 0) {
+            return out;
+        }
+        close(fd);
+        if (WriteTextureFile(path, format, levels.data(), count, true)) {
+            FILE* in = fopen(path, "rb");
+            uint8_t buffer[4096];
+            size_t read;
+            while (in && (read = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+                out.insert(out.end(), buffer, buffer + read);
+            }
+            if (in) {
+                fclose(in);
+            }
+        }
+        remove(path);
+        return out;
+    }
+
+    std::vector<std::vector<uint8_t> > BuiltinSeeds()
+    {
+        std::vector<std::vector<uint8_t> > seeds;
+        seeds.push_back(MakeBmp(5, 3, 24, 0));
+        seeds.push_back(MakeBmp(7, -4, 24, 0));
+        seeds.push_back(MakeBmp(4, 4, 32, 0));
+        seeds.push_back(MakeBmp(3, -2, 32, 3));
+        // extreme aspects: the longest side the parser takes, and one past it
+        seeds.push_back(MakeBmp(MaxImageDimension, 1, 24, 0));
+        seeds.push_back(MakeBmp(1, -(int32_t)MaxImageDimension, 32, 0));
+        seeds.push_back(MakeBmp(MaxImageDimension * 2, 1, 24, 0));
+        seeds.push_back(MakeBmp(1, (int32_t)MaxImageDimension * 2, 24, 0));
+        seeds.push_back(MakePkm(EtcFormat_ETC1, 8, 4));
+        seeds.push_back(MakePkm(EtcFormat_ETC2_RGB, 5, 7));
+        seeds.push_back(MakePkm(EtcFormat_ETC2_RGBA, 4, 4));
+        seeds.push_back(MakeTextureFile(TextureFormat_RGB8, 5, 3));
+        seeds.push_back(MakeTextureFile(TextureFormat_ETC1, 8, 8));
+        return seeds;
+    }
+
+    bool ReadFile(const char* path, std::vector<uint8_t>& out)
+    {
+        FILE* in = fopen(path, "rb");
+        if (!in) {
+            return false;
+        }
+        uint8_t buffer[4096];
+        size_t read;
+        out.clear();
+        while ((read = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+            out.insert(out.end(), buffer, buffer + read);
+        }
+        fclose(in);
+        return true;
+    }
+
+    /// Values that sit on the edges of the size checks
+    const uint32_t kInteresting[] = {
+        0, 1, 2, 3, 4, 0x7F, 0x80, 0xFF, 0x100, 0x7FFF, 0x8000, 0xFFFF, 0x10000,
+        0x7FFFFFFFu, 0x80000000u, 0xFFFFFFFFu, 0xFFFFFFFEu, 0x40000000u, 0x20000000u
+    };
+
+    void Mutate(std::vector<uint8_t>& data, size_t maxSize)
+    {
+        const int count = 1 + Random() % 4;
+        for (int m = 0; m < count; m++) {
+            if (data.empty()) {
+                data.push_back((uint8_t)Random());
+                continue;
+            }
+            // headers are small, most mutations land in them
+            const size_t range = Random() % 4 != 0 ? std::min(data.size(), (size_t)80) : data.size();
+            const size_t at = Random() % range;
+            switch (Random() % 6) {
+                case 0:
+                    data[at] ^= (uint8_t)(1u << (Random() % 8));
+                    break;
+                case 1:
+                    data[at] = (uint8_t)Random();
+                    break;
+                case 2:
+                    if (at + 4 <= data.size()) {
+                        PutU32(data, at & ~(size_t)1, kInteresting[Random() % (sizeof(kInteresting) / sizeof(kInteresting[0]))]);
+                    }
+                    break;
+                case 3:
+                    if (at + 2 <= data.size()) {
+                        PutU16(data, at, kInteresting[Random() % 13], Random() & 1);
+                    }
+                    break;
+                case 4:
+                    data.resize(Random() % (data.size() + 1));
+                    break;
+                case 5:
+                    if (data.size() < maxSize) {
+                        data.resize(std::min(maxSize, data.size() + 1 + Random() % 256), (uint8_t)Random());
+                    }
+                    break;
+            }
+        }
+    }
+
+    bool ParseDriverOptions(int argc, char** argv, DriverOptions& options)
+    {
+        for (int i = 1; i < argc; i++) {
+            if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+                options.iterations = strtoull(argv[++i], nullptr, 10);
+            } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+                options.seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+            } else if (strcmp(argv[i], "--max-size") == 0 && i + 1 < argc) {
+                options.maxSize = (size_t)strtoull(argv[++i], nullptr, 10);
+            } else if (argv[i][0] == '-') {
+                return false;
+            } else {
+                options.files.push_back(argv[i]);
+            }
+        }
+        return true;
+    }
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    DriverOptions options;
+    if (!ParseDriverOptions(argc, argv, options)) {
+        fprintf(stderr, "usage: mj2image_fuzz [--iterations <n>] [--seed <n>] [--max-size <bytes>] [<file>...]\n");
+        return 2;
+    }
+    gRandomState = options.seed ? options.seed : 1;
+
+    std::vector<std::vector<uint8_t> > seeds;
+    for (const char* file : options.files) {
+        std::vector<uint8_t> data;
+        if (!ReadFile(file, data)) {
+            fprintf(stderr, "%s: cannot read\n", file);
+            return 1;
+        }
+        printf("replaying %s (%zu bytes)\n", file, data.size());
+        LLVMFuzzerTestOneInput(data.data(), data.size());
+        seeds.push_back(data);
+    }
+    if (seeds.empty()) {
+        seeds = BuiltinSeeds();
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<uint8_t> input;
+    for (uint64_t i = 0; i < options.iterations; i++) {
+        input = seeds[Random() % seeds.size()];
+        Mutate(input, options.maxSize);
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%llu mutated inputs from %zu seeds in %.1f s (%.0f/s), no crashes\n", (unsigned long long)options.iterations,
+           seeds.size(), seconds, options.iterations / seconds);
+    return 0;
+}
+
+#endif // MJ2_LIBFUZZER
@@ -0,0 +1,373 @@
+/////
+// The ETC1 / ETC2 / EAC block codec. Known-answer blocks are packed by hand from the
+// Khronos bit layouts and decoded to the pixels the spec gives for them, so a layout
+// mistake shared by the encoder and the decoder cannot hide behind a round trip. The
+// round trips then hold the encoder to a PSNR floor on a solid block, a gradient that
+// only planar mode gets right, an alpha ramp, and whole images with partial blocks.
+/////
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "../EtcCodec.hpp"
+#include "../../math/tests/Check.hpp"
+
+using namespace mj2;
+using namespace mj2::test;
+
+namespace {
+
+    /// pixels of a 4x4 block in rows, as DecodeEtcBlock writes them
+    struct Block {
+    public:
+        uint8_t rgba[64];
+
+        const uint8_t* At(int x, int y) const { return rgba + (y * 4 + x) * 4; }
+        uint8_t* At(int x, int y) { return rgba + (y * 4 + x) * 4; }
+    };
+
+    bool PixelIs(const Block& block, int x, int y, int r, int g, int b, int a)
+    {
+        const uint8_t* p = block.At(x, y);
+        return p[0] == r && p[1] == g && p[2] == b && p[3] == a;
+    }
+
+    /// PSNR over the given channels, 99 when exact
+    double Psnr(const uint8_t* a, const uint8_t* b, size_t pixels, int firstChannel, int channelCount)
+    {
+        double sum = 0.0;
+        for (size_t i = 0; i < pixels; i++) {
+            for (int c = firstChannel; c < firstChannel + channelCount; c++) {
+                const double d = (double)a[i * 4 + c] - b[i * 4 + c];
+                sum += d * d;
+            }
+        }
+        if (sum == 0.0) {
+            return 99.0;
+        }
+        return 10.0 * std::log10(255.0 * 255.0 / (sum / (pixels * channelCount)));
+    }
+
+    Block RoundTrip(const Block& in, EtcFormat format, EtcQuality quality, uint8_t* encoded = nullptr)
+    {
+        uint8_t block[16];
+        EncodeEtcBlock(block, in.rgba, format, quality);
+        Block out;
+        MJ2_CHECK(DecodeEtcBlock(out.rgba, block, format));
+        if (encoded) {
+            memcpy(encoded, block, EtcBlockBytes(format));
+        }
+        return out;
+    }
+
+    void WriteWords(uint8_t* block, uint32_t high, uint32_t low)
+    {
+        const uint32_t words[2] = { high, low };
+        for (int w = 0; w < 2; w++) {
+            for (int i = 0; i < 4; i++) {
+                block[w * 4 + i] = (uint8_t)(words[w] >> (24 - 8 * i));
+            }
+        }
+    }
+
+    //-------------------------------------------------------------
+    // Known answers
+    //-------------------------------------------------------------
+    /////
+    // Individual mode, flip 0 (left | right), bases 444 F80 | 04F, tables 0 and 7.
+    // Each pixel's index is its row: pixel numbers run down the columns (a = (0, 0),
+    // b = (0, 1)), so index = p & 3 gives LSBs 0xAAAA and MSBs 0xCCCC. Index 0 is +a,
+    // 1 +b, 2 -a, 3 -b.
+    /////
+    void TestIndividualMode()
+    {
+        uint8_t data[8];
+        WriteWords(data, 0xF0840F1Cu, 0xCCCCAAAAu);
+        const int left[4][3] = { { 255, 138, 2 }, { 255, 144, 8 }, { 253, 134, 0 }, { 247, 128, 0 } };
+        const int right[4][3] = { { 47, 115, 255 }, { 183, 251, 255 }, { 0, 21, 208 }, { 0, 0, 72 } };
+
+        for (int format = EtcFormat_ETC1; format <= EtcFormat_ETC2_RGB; format++) {
+            Block out;
+            MJ2_CHECK(DecodeEtcBlock(out.rgba, data, (EtcFormat)format));
+            for (int y = 0; y < 4; y++) {
+                for (int x = 0; x < 4; x++) {
+                    const int* expected = x < 2 ? left[y] : right[y];
+                    MJ2_CHECK(PixelIs(out, x, y, expected[0], expected[1], expected[2], 255));
+                }
+            }
+        }
+    }
+
+    /////
+    // Differential mode, flip 1 (top / bottom): base 555 (20, 0, 31) with delta (-4, +3, 0),
+    // tables 2 and 5. Each pixel's index is its column: LSBs 0xF0F0, MSBs 0xFF00.
+    /////
+    void TestDifferentialMode()
+    {
+        uint8_t data[8];
+        WriteWords(data, 0xA403F857u, 0xFF00F0F0u);
+        const int top[4][3] = { { 174, 9, 255 }, { 194, 29, 255 }, { 156, 0, 246 }, { 136, 0, 226 } };
+        const int bottom[4][3] = { { 156, 48, 255 }, { 212, 104, 255 }, { 108, 0, 231 }, { 52, 0, 175 } };
+
+        Block out;
+        MJ2_CHECK(DecodeEtcBlock(out.rgba, data, EtcFormat_ETC1));
+        for (int y = 0; y < 4; y++) {
+            for (int x = 0; x < 4; x++) {
+                const int* expected = y < 2 ? top[x] : bottom[x];
+                MJ2_CHECK(PixelIs(out, x, y, expected[0], expected[1], expected[2], 255));
+            }
+        }
+    }
+
+    /////
+    // ETC2 planar: O = (0, 0, 0), H = (63, 127, 0), V = (0, 0, 63), so red and green ramp
+    // along x and blue along y: (255 * i + 2) >> 2 = 0, 64, 128, 191. Read as differential
+    // the block has R = G = 0 and B = 0 with a delta of -4 (the free bit 42), the blue
+    // overflow that selects planar mode.
+    /////
+    void TestPlanarMode()
+    {
+        uint8_t data[8];
+        WriteWords(data, 0x0000047Fu, 0xFE00003Fu);
+        const int ramp[4] = { 0, 64, 128, 191 };
+
+        Block out;
+        MJ2_CHECK(DecodeEtcBlock(out.rgba, data, EtcFormat_ETC2_RGB));
+        for (int y = 0; y < 4; y++) {
+            for (int x = 0; x < 4; x++) {
+                MJ2_CHECK(PixelIs(out, x, y, ramp[x], ramp[x], ramp[y], 255));
+            }
+        }
+
+        // ETC1 has no planar mode, the overflow makes the block invalid
+        MJ2_CHECK(!DecodeEtcBlock(out.rgba, data, EtcFormat_ETC1));
+    }
+
+    /// T mode overflows red, H mode green; neither is decoded, in any format
+    void TestTAndHModes()
+    {
+        uint8_t data[8];
+        Block out;
+        const EtcFormat formats[] = { EtcFormat_ETC1, EtcFormat_ETC2_RGB };
+
+        // R = 0 + -4
+        WriteWords(data, 0x04000002u, 0);
+        for (EtcFormat format : formats) {
+            MJ2_CHECK(!DecodeEtcBlock(out.rgba, data, format));
+        }
+        // R = 31 + 1, the top end
+        WriteWords(data, 0xF9000002u, 0);
+        for (EtcFormat format : formats) {
+            MJ2_CHECK(!DecodeEtcBlock(out.rgba, data, format));
+        }
+        // G = 0 + -4, red in range
+        WriteWords(data, 0x00040002u, 0);
+        for (EtcFormat format : formats) {
+            MJ2_CHECK(!DecodeEtcBlock(out.rgba, data, format));
+        }
+        // red and blue both overflow: T mode wins over planar
+        WriteWords(data, 0x04000402u, 0);
+        MJ2_CHECK(!DecodeEtcBlock(out.rgba, data, EtcFormat_ETC2_RGB));
+
+        // R = 31 + 0, G = 0 + 3: in range, a plain differential block
+        WriteWords(data, 0xF8030002u, 0);
+        MJ2_CHECK(DecodeEtcBlock(out.rgba, data, EtcFormat_ETC2_RGB));
+    }
+
+    /////
+    // EAC: base 128, multiplier 2, table 0 (-3 -6 -9 -15 2 5 8 14). Pixel p (column
+    // order) gets index p & 7, 3 bits each from bit 47 down: 000 001 ... 111 twice.
+    // With the individual mode block above as the color half.
+    /////
+    void TestEacAlpha()
+    {
+        uint8_t data[16] = { 0x80, 0x20, 0x05, 0x39, 0x77, 0x05, 0x39, 0x77 };
+        WriteWords(data + 8, 0xF0840F1Cu, 0xCCCCAAAAu);
+        const int even[4] = { 122, 116, 110, 98 };   // x = 0, 2: indices 0-3
+        const int odd[4] = { 132, 138, 144, 156 };   // x = 1, 3: indices 4-7
+
+        Block out;
+        MJ2_CHECK(DecodeEtcBlock(out.rgba, data, EtcFormat_ETC2_RGBA));
+        for (int y = 0; y < 4; y++) {
+            for (int x = 0; x < 4; x++) {
+                MJ2_CHECK(out.At(x, y)[3] == (x & 1 ? odd[y] : even[y]));
+            }
+        }
+        MJ2_CHECK(PixelIs(out, 0, 0, 255, 138, 2, 122) && PixelIs(out, 3, 3, 0, 0, 72, 156));
+
+        // base 16, multiplier 15, table 3: index 7 is +180, index 0 -30 and clamps
+        uint8_t clamped[16] = { 0x10, 0xF3, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00 };
+        WriteWords(clamped + 8, 0xF0840F1Cu, 0xCCCCAAAAu);
+        MJ2_CHECK(DecodeEtcBlock(out.rgba, clamped, EtcFormat_ETC2_RGBA));
+        MJ2_CHECK(out.At(0, 0)[3] == 196 && out.At(3, 3)[3] == 0);
+    }
+
+    //-------------------------------------------------------------
+    // Round trips
+    //-------------------------------------------------------------
+    void TestSolid()
+    {
+        const uint8_t colors[][4] = { { 0, 0, 0, 255 }, { 255, 255, 255, 255 }, { 200, 30, 90, 255 }, { 17, 140, 251, 255 } };
+        const EtcFormat formats[] = { EtcFormat_ETC1, EtcFormat_ETC2_RGB, EtcFormat_ETC2_RGBA };
+        for (const uint8_t* color : colors) {
+            Block in;
+            for (int i = 0; i < 16; i++) {
+                memcpy(in.rgba + i * 4, color, 4);
+            }
+            for (EtcFormat format : formats) {
+                for (int quality = EtcQuality_Fast; quality <= EtcQuality_High; quality++) {
+                    // 444 and 555 bases plus a modifier land within a few steps of any
+                    // color; planar's 676 bases get closer
+                    const Block out = RoundTrip(in, format, (EtcQuality)quality);
+                    MJ2_CHECK(Psnr(in.rgba, out.rgba, 16, 0, 3) >= (format == EtcFormat_ETC1 ? 38.0 : 45.0));
+                    MJ2_CHECK(Psnr(in.rgba, out.rgba, 16, 3, 1) == 99.0);
+                }
+            }
+        }
+    }
+
+    /// a plane in each channel, steep enough that two flat halves with modifiers cannot follow
+    void TestGradient()
+    {
+        Block in;
+        for (int y = 0; y < 4; y++) {
+            for (int x = 0; x < 4; x++) {
+                uint8_t* p = in.At(x, y);
+                p[0] = (uint8_t)(20 + 60 * x);
+                p[1] = (uint8_t)(230 - 45 * y);
+                p[2] = (uint8_t)(40 + 25 * x + 30 * y);
+                p[3] = 255;
+            }
+        }
+
+        for (int quality = EtcQuality_Fast; quality <= EtcQuality_High; quality++) {
+            uint8_t encoded[8];
+            const Block planar = RoundTrip(in, EtcFormat_ETC2_RGB, (EtcQuality)quality, encoded);
+            const Block etc1 = RoundTrip(in, EtcFormat_ETC1, (EtcQuality)quality);
+
+            // the encoder picked planar: differential bit set, red and green in range, blue out
+            const int r = (encoded[0] >> 3) + ((encoded[0] & 4) ? (encoded[0] & 7) - 8 : (encoded[0] & 7));
+            const int g = (encoded[1] >> 3) + ((encoded[1] & 4) ? (encoded[1] & 7) - 8 : (encoded[1] & 7));
+            const int b = (encoded[2] >> 3) + ((encoded[2] & 4) ? (encoded[2] & 7) - 8 : (encoded[2] & 7));
+            MJ2_CHECK((encoded[3] & 2) != 0 && r >= 0 && r <= 31 && g >= 0 && g <= 31 && (b < 0 || b > 31));
+
+            MJ2_CHECK(Psnr(in.rgba, planar.rgba, 16, 0, 3) >= 42.0);
+            MJ2_CHECK(Psnr(in.rgba, planar.rgba, 16, 0, 3) > Psnr(in.rgba, etc1.rgba, 16, 0, 3) + 6.0);
+            MJ2_CHECK(Psnr(in.rgba, etc1.rgba, 16, 0, 3) >= 16.0);
+        }
+    }
+
+    /// alpha in column order, value = base + step * p, over a color with some structure
+    Block AlphaRamp(int base, int step)
+    {
+        Block in;
+        for (int y = 0; y < 4; y++) {
+            for (int x = 0; x < 4; x++) {
+                uint8_t* p = in.At(x, y);
+                p[0] = (uint8_t)(x < 2 ? 200 : 60);
+                p[1] = (uint8_t)(100 + 10 * y);
+                p[2] = 30;
+                p[3] = (uint8_t)(base + step * (x * 4 + y));
+            }
+        }
+        return in;
+    }
+
+    void TestAlphaRamp()
+    {
+        // 5 to 245: eight levels cannot follow sixteen, an exhaustive search over base,
+        // multiplier and table tops out at 29.3 dB
+        const double fullFloor[2] = { 28.0, 29.3 };
+        for (int quality = EtcQuality_Fast; quality <= EtcQuality_High; quality++) {
+            const Block full = AlphaRamp(5, 16);
+            Block out = RoundTrip(full, EtcFormat_ETC2_RGBA, (EtcQuality)quality);
+            MJ2_CHECK(Psnr(full.rgba, out.rgba, 16, 3, 1) >= fullFloor[quality]);
+            MJ2_CHECK(Psnr(full.rgba, out.rgba, 16, 0, 3) >= 30.0);
+            // the ramp keeps its direction, so the indices are not transposed
+            for (int p = 1; p < 16; p++) {
+                MJ2_CHECK(out.At(p >> 2, p & 3)[3] >= out.At((p - 1) >> 2, (p - 1) & 3)[3]);
+            }
+
+            const Block gentle = AlphaRamp(100, 3);
+            out = RoundTrip(gentle, EtcFormat_ETC2_RGBA, (EtcQuality)quality);
+            MJ2_CHECK(Psnr(gentle.rgba, out.rgba, 16, 3, 1) >= 40.0);
+        }
+
+        // a constant alpha other than 255 survives exactly
+        const Block constant = AlphaRamp(77, 0);
+        const Block out = RoundTrip(constant, EtcFormat_ETC2_RGBA, EtcQuality_Fast);
+        MJ2_CHECK(Psnr(constant.rgba, out.rgba, 16, 3, 1) == 99.0);
+    }
+
+    /// whole images through EncodeEtcImage, partial blocks on both edges
+    void TestImage()
+    {
+        const uint32_t width = 13;
+        const uint32_t height = 7;
+        const size_t stride = width * 3 + 1;
+        std::vector<uint8_t> pixels(stride * height);
+        for (uint32_t y = 0; y < height; y++) {
+            for (uint32_t x = 0; x < width; x++) {
+                uint8_t* p = &pixels[y * stride + x * 3];
+                p[0] = (uint8_t)(x * 19);
+                p[1] = (uint8_t)(y * 35);
+                p[2] = (uint8_t)(128 + 4 * x - 6 * y);
+            }
+        }
+
+        const EtcFormat formats[] = { EtcFormat_ETC1, EtcFormat_ETC2_RGB, EtcFormat_ETC2_RGBA };
+        for (EtcFormat format : formats) {
+            std::vector<uint8_t> blocks(EtcImageBytes(format, width, height));
+            MJ2_CHECK(blocks.size() == 4 * 2 * EtcBlockBytes(format));
+            MJ2_CHECK(EncodeEtcImage(blocks.data(), pixels.data(), width, height, stride, 3, format, EtcQuality_High) ==
+                      ImageStatus_Ok);
+
+            std::vector<uint8_t> original, decoded;
+            for (uint32_t by = 0; by < 2; by++) {
+                for (uint32_t bx = 0; bx < 4; bx++) {
+                    Block out;
+                    MJ2_CHECK(DecodeEtcBlock(out.rgba, &blocks[(by * 4 + bx) * EtcBlockBytes(format)], format));
+                    for (uint32_t y = 0; y < 4; y++) {
+                        for (uint32_t x = 0; x < 4; x++) {
+                            const uint32_t sx = bx * 4 + x;
+                            const uint32_t sy = by * 4 + y;
+                            if (sx >= width || sy >= height) {
+                                continue;
+                            }
+                            const uint8_t* p = &pixels[sy * stride + sx * 3];
+                            original.insert(original.end(), { p[0], p[1], p[2], 255 });
+                            decoded.insert(decoded.end(), out.At(x, y), out.At(x, y) + 4);
+                        }
+                    }
+                }
+            }
+            MJ2_CHECK(original.size() == width * height * 4);
+            // steep on purpose: ETC1 has to spend its two base colors on it, planar does not
+            MJ2_CHECK(Psnr(original.data(), decoded.data(), width * height, 0, 3) >= (format == EtcFormat_ETC1 ? 24.0 : 35.0));
+            MJ2_CHECK(Psnr(original.data(), decoded.data(), width * height, 3, 1) == 99.0);
+        }
+
+        std::vector<uint8_t> blocks(EtcImageBytes(EtcFormat_ETC1, width, height));
+        MJ2_CHECK(EncodeEtcImage(blocks.data(), pixels.data(), width, height, stride, 2, EtcFormat_ETC1, EtcQuality_Fast) ==
+                  ImageStatus_Unsupported);
+        MJ2_CHECK(EncodeEtcImage(blocks.data(), pixels.data(), width, height, width * 3 - 1, 3, EtcFormat_ETC1,
+                                 EtcQuality_Fast) == ImageStatus_BadHeader);
+    }
+
+} // namespace
+
+int main()
+{
+    TestIndividualMode();
+    TestDifferentialMode();
+    TestPlanarMode();
+    TestTAndHModes();
+    TestEacAlpha();
+    TestSolid();
+    TestGradient();
+    TestAlphaRamp();
+    TestImage();
+    return CheckResult("EtcCodecTest");
+}
@@ -0,0 +1,252 @@
+/////
+// MipChain: the SIMD box path against the float resampler it stands in for, level sizes
+// down to 1 x 1 for any shape, chains built on a ThreadPool byte for byte the same as
+// serial ones, and level alignment in pooled and unpooled storage.
+/////
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "../MipChain.hpp"
+#include "../PixelBufferPool.hpp"
+#include "../PixelKernels.hpp"
+#include "../ThreadPool.hpp"
+#include "../../math/tests/Check.hpp"
+
+using namespace mj2;
+using namespace mj2::test;
+
+namespace {
+
+    /// xorshift, fixed seed
+    uint32_t gRandomState = 3141592653u;
+
+    uint8_t RandomByte()
+    {
+        gRandomState ^= gRandomState << 13;
+        gRandomState ^= gRandomState >> 17;
+        gRandomState ^= gRandomState << 5;
+        return (uint8_t)(gRandomState >> 24);
+    }
+
+    /// width x height of noise in rows padded to 4 bytes
+    struct TestImage {
+    public:
+        TestImage(uint32_t width, uint32_t height, uint32_t channels)
+                : width(width)
+                , height(height)
+                , channels(channels)
+                , stride(((size_t)width * channels + 3) & ~(size_t)3)
+                , pixels(stride * height)
+        {
+            for (uint8_t& b : pixels) {
+                b = RandomByte();
+            }
+        }
+
+        uint32_t width;
+        uint32_t height;
+        uint32_t channels;
+        size_t stride;
+        std::vector<uint8_t> pixels;
+    };
+
+    /// what the resampler in MipChain.cpp computes for a 2x2 box with weights of one half
+    /// per axis: a vertical pass in float, a horizontal one, then v * 255 + 0.5 truncated
+    uint8_t ResampledBox(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+    {
+        float left = 0.0f, right = 0.0f;
+        left += 0.5f * (a / 255.0f);
+        left += 0.5f * (c / 255.0f);
+        right += 0.5f * (b / 255.0f);
+        right += 0.5f * (d / 255.0f);
+        float value = 0.0f;
+        value += 0.5f * left;
+        value += 0.5f * right;
+        const float scaled = value * 255.0f + 0.5f;
+        return scaled <= 0.0f ? 0 : scaled >= 255.0f ? 255 : (uint8_t)scaled;
+    }
+
+    bool SameLevels(const MipChain& a, const MipChain& b)
+    {
+        if (a.LevelCount() != b.LevelCount()) {
+            return false;
+        }
+        for (uint32_t i = 1; i < a.LevelCount(); i++) {
+            const MipLevel& x = a.Level(i);
+            const MipLevel& y = b.Level(i);
+            if (x.width != y.width || x.height != y.height) {
+                return false;
+            }
+            for (uint32_t row = 0; row < x.height; row++) {
+                if (memcmp(x.pixels + row * x.rowStride, y.pixels + row * y.rowStride, (size_t)x.width * a.Channels())) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    void TestBoxMatchesResampler()
+    {
+        const uint32_t sizes[][2] = { { 2, 2 }, { 64, 32 }, { 130, 6 }, { 34, 1 } };
+        const PixelKernelLevel initial = GetPixelKernels().level;
+        const PixelKernelLevel levels[] = { PixelKernelLevel_Scalar, PixelKernelLevel_SSSE3, PixelKernelLevel_NEON };
+        for (PixelKernelLevel kernelLevel : levels) {
+            if (!SetPixelKernelLevel(kernelLevel)) {
+                continue;
+            }
+            for (uint32_t channels = 3; channels <= 4; channels++) {
+                for (const auto& size : sizes) {
+                    const TestImage image(size[0], size[1], channels);
+                    MipChain chain;
+                    MJ2_CHECK(chain.Build(image.pixels.data(), image.width, image.height, image.stride, channels,
+                                          MipFilter_Box, MipColorSpace_Linear) == ImageStatus_Ok);
+                    const MipLevel& level = chain.Level(1);
+                    bool same = true;
+                    for (uint32_t y = 0; y < level.height; y++) {
+                        const uint8_t* row0 = &image.pixels[(image.height == 1 ? 0 : 2 * y) * image.stride];
+                        const uint8_t* row1 = image.height == 1 ? row0 : row0 + image.stride;
+                        for (uint32_t x = 0; x < level.width; x++) {
+                            for (uint32_t c = 0; c < channels; c++) {
+                                const size_t left = 2 * x * channels + c;
+                                const uint8_t expected =
+                                    ResampledBox(row0[left], row0[left + channels], row1[left], row1[left + channels]);
+                                same = same && level.pixels[y * level.rowStride + x * channels + c] == expected;
+                            }
+                        }
+                    }
+                    MJ2_CHECK(same);
+                }
+            }
+        }
+        SetPixelKernelLevel(initial);
+
+        // every sum of four, including the halves both paths have to round up
+        bool same = true;
+        for (uint32_t sum = 0; sum <= 4 * 255; sum++) {
+            const uint8_t a = (uint8_t)std::min(sum, 255u);
+            const uint8_t b = (uint8_t)std::min(sum - a, 255u);
+            const uint8_t c = (uint8_t)std::min(sum - a - b, 255u);
+            const uint8_t d = (uint8_t)(sum - a - b - c);
+            same = same && ResampledBox(a, b, c, d) == (sum + 2) / 4;
+            same = same && ResampledBox(d, c, b, a) == (sum + 2) / 4;
+        }
+        MJ2_CHECK(same);
+    }
+
+    void TestLevelSizes()
+    {
+        const uint32_t sizes[][2] = { { 1, 1 }, { 1, 37 }, { 37, 1 }, { 13, 7 }, { 100, 3 }, { 255, 256 }, { 1, 1024 } };
+        const MipFilter filters[] = { MipFilter_Box, MipFilter_Kaiser };
+        for (const auto& size : sizes) {
+            for (MipFilter filter : filters) {
+                // a flat colour has to stay that colour through any filter
+                TestImage image(size[0], size[1], 4);
+                for (size_t i = 0; i < image.pixels.size(); i++) {
+                    image.pixels[i] = (uint8_t)(40 + 50 * (i % 4));
+                }
+                MipChain chain;
+                MJ2_CHECK(chain.Build(image.pixels.data(), image.width, image.height, image.stride, 4, filter,
+                                      MipColorSpace_Linear) == ImageStatus_Ok);
+                MJ2_CHECK(chain.LevelCount() == MipChain::FullLevelCount(size[0], size[1]));
+                const MipLevel& last = chain.Level(chain.LevelCount() - 1);
+                MJ2_CHECK(last.width == 1 && last.height == 1);
+
+                bool halved = true;
+                bool flat = true;
+                for (uint32_t i = 1; i < chain.LevelCount(); i++) {
+                    const MipLevel& level = chain.Level(i);
+                    const MipLevel& above = chain.Level(i - 1);
+                    halved = halved && level.width == std::max(above.width >> 1, 1u) &&
+                             level.height == std::max(above.height >> 1, 1u) && level.rowStride % 4 == 0 &&
+                             level.rowStride >= (size_t)level.width * 4;
+                    for (uint32_t y = 0; y < level.height; y++) {
+                        for (uint32_t x = 0; x < level.width * 4; x++) {
+                            flat = flat && level.pixels[y * level.rowStride + x] == 40 + 50 * (x % 4);
+                        }
+                    }
+                }
+                MJ2_CHECK(halved);
+                MJ2_CHECK(flat);
+            }
+        }
+        MJ2_CHECK(MipChain::FullLevelCount(1, 1) == 1 && MipChain::FullLevelCount(1, 1024) == 11 &&
+                  MipChain::FullLevelCount(255, 256) == 9 && MipChain::FullLevelCount(255, 1) == 8);
+
+        // what Build turns away
+        MipChain chain;
+        const TestImage image(8, 8, 4);
+        MJ2_CHECK(chain.Build(image.pixels.data(), 8, 8, image.stride, 2, MipFilter_Box, MipColorSpace_Linear) ==
+                  ImageStatus_Unsupported);
+        MJ2_CHECK(chain.Build(nullptr, 8, 8, image.stride, 4, MipFilter_Box, MipColorSpace_Linear) ==
+                  ImageStatus_BadHeader);
+        MJ2_CHECK(chain.Build(image.pixels.data(), 8, 8, 31, 4, MipFilter_Box, MipColorSpace_Linear) ==
+                  ImageStatus_BadHeader);
+        MJ2_CHECK(chain.Build(image.pixels.data(), 0, 8, image.stride, 4, MipFilter_Box, MipColorSpace_Linear) ==
+                  ImageStatus_BadHeader);
+        MJ2_CHECK(chain.LevelCount() == 0);
+    }
+
+    void TestParallel()
+    {
+        ThreadPool pool(4);
+        const MipFilter filters[] = { MipFilter_Box, MipFilter_Kaiser };
+        const MipColorSpace spaces[] = { MipColorSpace_Linear, MipColorSpace_SRGB };
+        // even all the way down, odd from the first level, and tall enough for many bands
+        const uint32_t sizes[][2] = { { 512, 256 }, { 1031, 517 }, { 3, 2000 } };
+        for (const auto& size : sizes) {
+            for (uint32_t channels = 3; channels <= 4; channels++) {
+                const TestImage image(size[0], size[1], channels);
+                for (MipFilter filter : filters) {
+                    for (MipColorSpace space : spaces) {
+                        MipChain serial, parallel;
+                        MJ2_CHECK(serial.Build(image.pixels.data(), image.width, image.height, image.stride, channels,
+                                               filter, space) == ImageStatus_Ok);
+                        MJ2_CHECK(parallel.Build(image.pixels.data(), image.width, image.height, image.stride,
+                                                 channels, filter, space, &pool) == ImageStatus_Ok);
+                        MJ2_CHECK(SameLevels(serial, parallel));
+                    }
+                }
+            }
+        }
+    }
+
+    void TestAlignment()
+    {
+        PixelBufferPool buffers;
+        const TestImage image(37, 91, 3);
+        {
+            MipChain pooled, unpooled;
+            MJ2_CHECK(pooled.Build(image.pixels.data(), image.width, image.height, image.stride, 3, MipFilter_Box,
+                                   MipColorSpace_Linear, nullptr, &buffers) == ImageStatus_Ok);
+            MJ2_CHECK(unpooled.Build(image.pixels.data(), image.width, image.height, image.stride, 3, MipFilter_Box,
+                                     MipColorSpace_Linear) == ImageStatus_Ok);
+            for (uint32_t i = 1; i < pooled.LevelCount(); i++) {
+                MJ2_CHECK((uintptr_t)pooled.Level(i).pixels % 64 == 0);
+                MJ2_CHECK((uintptr_t)unpooled.Level(i).pixels % 64 == 0);
+            }
+            MJ2_CHECK(SameLevels(pooled, unpooled));
+            MJ2_CHECK(buffers.Stats().inUseBytes == pooled.StorageBytes() && pooled.StorageBytes() > 0);
+
+            // rebuilt into the same buffer
+            MJ2_CHECK(pooled.Build(image.pixels.data(), image.width, image.height, image.stride, 3, MipFilter_Box,
+                                   MipColorSpace_Linear, nullptr, &buffers) == ImageStatus_Ok);
+            MJ2_CHECK(buffers.Stats().reuses == 1);
+        }
+        // back to the pool with the chains
+        MJ2_CHECK(buffers.Stats().inUseBytes == 0);
+    }
+
+} // namespace
+
+int main()
+{
+    TestBoxMatchesResampler();
+    TestLevelSizes();
+    TestParallel();
+    TestAlignment();
+    return CheckResult("MipChainTest");
+}
@@ -0,0 +1,200 @@
+/////
+// PixelBufferPool: size classes at most 25% over the request at every class boundary,
+// oversize requests never retained, maxRetainedBytes holding while several threads
+// release at once, and the peaks following acquires, releases and ResetPeaks.
+/////
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "../PixelBufferPool.hpp"
+#include "../../math/tests/Check.hpp"
+
+using namespace mj2;
+using namespace mj2::test;
+
+namespace {
+
+    const size_t KB = 1024;
+    const size_t MB = 1024 * 1024;
+
+    /// a class holds the request and wastes at most a quarter of it
+    bool FitsClass(size_t bytes)
+    {
+        const size_t size = PixelBufferPool::ClassSize(bytes);
+        return size >= bytes && (bytes <= 4 * KB || size <= bytes + bytes / 4);
+    }
+
+    void TestClassSizes()
+    {
+        MJ2_CHECK(PixelBufferPool::ClassSize(0) == 4 * KB);
+        MJ2_CHECK(PixelBufferPool::ClassSize(1) == 4 * KB);
+        MJ2_CHECK(PixelBufferPool::ClassSize(4096) == 4096);
+        MJ2_CHECK(PixelBufferPool::ClassSize(4097) == 5120);
+        MJ2_CHECK(PixelBufferPool::ClassSize(8192) == 8192);
+        MJ2_CHECK(PixelBufferPool::ClassSize(8193) == 10240);
+        MJ2_CHECK(PixelBufferPool::ClassSize(64 * MB) == 64 * MB);
+        // past the largest class a request takes exactly what it asks for
+        MJ2_CHECK(PixelBufferPool::ClassSize(64 * MB + 1) == 64 * MB + 1);
+        MJ2_CHECK(PixelBufferPool::ClassSize(100 * MB) == 100 * MB);
+
+        // every class boundary: a class spans (previous boundary, boundary], one more byte
+        // is the next class up
+        bool fits = true;
+        bool boundaries = true;
+        int classes = 0;
+        for (size_t base = 4 * KB; base < 64 * MB; base *= 2) {
+            for (size_t step = 0; step < 4; step++) {
+                const size_t boundary = base + step * (base / 4);
+                const size_t next = boundary + base / 4;
+                fits = fits && FitsClass(boundary - 1) && FitsClass(boundary) && FitsClass(boundary + 1);
+                boundaries = boundaries && PixelBufferPool::ClassSize(boundary - 1) == boundary &&
+                             PixelBufferPool::ClassSize(boundary) == boundary &&
+                             PixelBufferPool::ClassSize(boundary + 1) == next;
+                classes++;
+            }
+        }
+        // and the 64 MB class closes the list
+        MJ2_CHECK(classes + 1 == 57);
+        MJ2_CHECK(fits);
+        MJ2_CHECK(boundaries);
+    }
+
+    void TestOversize()
+    {
+        PixelBufferPool pool(256 * MB);
+        {
+            PixelBuffer buffer = pool.Acquire(64 * MB + 1);
+            MJ2_CHECK(buffer.Data() != nullptr);
+            MJ2_CHECK(buffer.Size() == 64 * MB + 1 && buffer.Capacity() == 64 * MB + 1);
+            MJ2_CHECK((uintptr_t)buffer.Data() % 64 == 0);
+            MJ2_CHECK(pool.Stats().inUseBytes == 64 * MB + 1);
+        }
+        PixelBufferPoolStats stats = pool.Stats();
+        MJ2_CHECK(stats.oversize == 1 && stats.allocations == 1);
+        MJ2_CHECK(stats.inUseBytes == 0 && stats.retainedBytes == 0);
+
+        // so the next one allocates again
+        pool.Acquire(64 * MB + 1).Release();
+        stats = pool.Stats();
+        MJ2_CHECK(stats.oversize == 2 && stats.allocations == 2 && stats.reuses == 0);
+        MJ2_CHECK(stats.retainedBytes == 0);
+
+        // while the largest class is kept
+        pool.Acquire(64 * MB).Release();
+        MJ2_CHECK(pool.Stats().retainedBytes == 64 * MB);
+        pool.Acquire(64 * MB - 1).Release();
+        stats = pool.Stats();
+        MJ2_CHECK(stats.reuses == 1 && stats.oversize == 2 && stats.retainedBytes == 64 * MB);
+    }
+
+    void TestConcurrentReleases()
+    {
+        const size_t maxRetained = 1 * MB;
+        const int threadCount = 8;
+        const int rounds = 50;
+        const size_t sizes[] = { 4 * KB, 12 * KB, 40 * KB, 100 * KB, 300 * KB };
+        PixelBufferPool pool(maxRetained);
+
+        // each thread holds a batch, then lets it all go at once, many times over
+        std::vector<std::thread> threads;
+        std::vector<uint8_t> threadAligned(threadCount, 0);
+        for (int t = 0; t < threadCount; t++) {
+            threads.emplace_back([&pool, &sizes, &threadAligned, t]() {
+                bool ok = true;
+                for (int round = 0; round < rounds; round++) {
+                    std::vector<PixelBuffer> held;
+                    for (size_t i = 0; i < 16; i++) {
+                        held.push_back(pool.Acquire(sizes[(i + t + round) % 5]));
+                        ok = ok && held.back().Data() && (uintptr_t)held.back().Data() % 64 == 0;
+                        if (held.back().Data()) {
+                            held.back().Data()[0] = (uint8_t)t;
+                        }
+                    }
+                }
+                threadAligned[t] = ok;
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        bool aligned = true;
+        for (int t = 0; t < threadCount; t++) {
+            aligned = aligned && threadAligned[t];
+        }
+        MJ2_CHECK(aligned);
+
+        const PixelBufferPoolStats stats = pool.Stats();
+        MJ2_CHECK(stats.inUseBytes == 0);
+        MJ2_CHECK(stats.retainedBytes <= maxRetained);
+        MJ2_CHECK(stats.retainedBytes > 0);
+        MJ2_CHECK(stats.acquires == (uint64_t)threadCount * rounds * 16);
+        MJ2_CHECK(stats.reuses + stats.allocations == stats.acquires);
+        MJ2_CHECK(stats.reuses > 0);
+
+        // the count matches what the free lists really hold
+        pool.Trim();
+        MJ2_CHECK(pool.Stats().retainedBytes == 0);
+    }
+
+    void TestPeaks()
+    {
+        PixelBufferPool pool(1 * MB);
+        PixelBufferPoolStats stats = pool.Stats();
+        MJ2_CHECK(stats.peakInUseBytes == 0 && stats.peakTotalBytes == 0);
+
+        PixelBuffer a = pool.Acquire(8 * KB);
+        stats = pool.Stats();
+        MJ2_CHECK(stats.inUseBytes == 8 * KB && stats.peakInUseBytes == 8 * KB && stats.peakTotalBytes == 8 * KB);
+
+        // released, the bytes move from in use to retained and the footprint stays
+        a.Release();
+        stats = pool.Stats();
+        MJ2_CHECK(stats.inUseBytes == 0 && stats.retainedBytes == 8 * KB);
+        MJ2_CHECK(stats.peakInUseBytes == 8 * KB && stats.peakTotalBytes == 8 * KB);
+
+        // a bigger class allocates next to the retained one
+        PixelBuffer b = pool.Acquire(15 * KB);
+        stats = pool.Stats();
+        MJ2_CHECK(b.Capacity() == 16 * KB);
+        MJ2_CHECK(stats.peakInUseBytes == 16 * KB && stats.peakTotalBytes == 24 * KB);
+
+        // reusing the retained one moves bytes without growing the footprint
+        PixelBuffer c = pool.Acquire(8 * KB);
+        stats = pool.Stats();
+        MJ2_CHECK(stats.reuses == 1 && stats.retainedBytes == 0);
+        MJ2_CHECK(stats.peakInUseBytes == 24 * KB && stats.peakTotalBytes == 24 * KB);
+
+        // restart from the current values, which are the peaks right now
+        pool.ResetPeaks();
+        stats = pool.Stats();
+        MJ2_CHECK(stats.peakInUseBytes == 24 * KB && stats.peakTotalBytes == 24 * KB);
+
+        b.Release();
+        c.Release();
+        pool.ResetPeaks();
+        stats = pool.Stats();
+        MJ2_CHECK(stats.peakInUseBytes == 0 && stats.peakTotalBytes == 24 * KB);
+
+        pool.Trim();
+        pool.ResetPeaks();
+        stats = pool.Stats();
+        MJ2_CHECK(stats.peakInUseBytes == 0 && stats.peakTotalBytes == 0 && stats.retainedBytes == 0);
+
+        // and climb again from there
+        PixelBuffer d = pool.Acquire(4 * KB);
+        stats = pool.Stats();
+        MJ2_CHECK(stats.peakInUseBytes == 4 * KB && stats.peakTotalBytes == 4 * KB);
+    }
+
+} // namespace
+
+int main()
+{
+    TestClassSizes();
+    TestOversize();
+    TestConcurrentReleases();
+    TestPeaks();
+    return CheckResult("PixelBufferPoolTest");
+}
@@ -0,0 +1,249 @@
+/////
+// Every pixel kernel level the CPU has against the scalar kernels: each row kernel at
+// every length up to 69 and a few past the SIMD widths, from unaligned sources, in place
+// where the API allows it, with nothing written past count. Then the Convert* walkers
+// over padded strides, whose padding has to stay untouched.
+/////
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "../PixelConvert.hpp"
+#include "../PixelKernels.hpp"
+#include "../../math/tests/Check.hpp"
+
+using namespace mj2;
+using namespace mj2::test;
+
+namespace {
+
+    const size_t kMaxShortLength = 69;
+    const size_t kLongLengths[] = { 127, 128, 129, 255, 256, 257, 1000 };
+
+    /// what buffers start as; a kernel that writes past count changes it
+    const uint8_t kFill = 0xA5;
+    /// bytes after the last pixel of every destination
+    const size_t kGuardBytes = 64;
+
+    /// xorshift, fixed seed
+    uint32_t gRandomState = 2463534242u;
+
+    uint8_t RandomByte()
+    {
+        gRandomState ^= gRandomState << 13;
+        gRandomState ^= gRandomState >> 17;
+        gRandomState ^= gRandomState << 5;
+        return (uint8_t)(gRandomState >> 24);
+    }
+
+    std::vector<uint8_t> RandomBytes(size_t count)
+    {
+        std::vector<uint8_t> bytes(count);
+        for (uint8_t& b : bytes) {
+            b = RandomByte();
+        }
+        // the ends of every channel
+        for (size_t i = 0; i < count && i < 8; i++) {
+            bytes[i] = i % 2 ? 0xFF : 0x00;
+        }
+        return bytes;
+    }
+
+    std::vector<size_t> Lengths()
+    {
+        std::vector<size_t> lengths;
+        for (size_t length = 0; length <= kMaxShortLength; length++) {
+            lengths.push_back(length);
+        }
+        lengths.insert(lengths.end(), kLongLengths, kLongLengths + sizeof(kLongLengths) / sizeof(kLongLengths[0]));
+        return lengths;
+    }
+
+    typedef void (*ByteKernel)(uint8_t* dst, const uint8_t* src, size_t count);
+    typedef void (*ShortKernel)(uint16_t* dst, const uint8_t* src, size_t count);
+    typedef void (*BoxKernel)(uint8_t* dst, const uint8_t* row0, const uint8_t* row1, size_t count);
+
+    /// out of place from a source offset by 0 or 1 bytes, then in place when allowed
+    void CheckByteKernel(ByteKernel kernel, ByteKernel scalar, size_t srcSize, size_t dstSize, bool inPlace)
+    {
+        for (size_t length : Lengths()) {
+            for (size_t offset = 0; offset < 2; offset++) {
+                const std::vector<uint8_t> source = RandomBytes(length * srcSize + offset);
+                std::vector<uint8_t> expected(length * dstSize + kGuardBytes, kFill);
+                std::vector<uint8_t> actual(expected.size(), kFill);
+                scalar(expected.data(), source.data() + offset, length);
+                kernel(actual.data(), source.data() + offset, length);
+                MJ2_CHECK(actual == expected);
+            }
+            if (inPlace) {
+                std::vector<uint8_t> expected = RandomBytes(length * srcSize);
+                expected.resize(expected.size() + kGuardBytes, kFill);
+                std::vector<uint8_t> actual = expected;
+                scalar(expected.data(), expected.data(), length);
+                kernel(actual.data(), actual.data(), length);
+                MJ2_CHECK(actual == expected);
+            }
+        }
+    }
+
+    void CheckShortKernel(ShortKernel kernel, ShortKernel scalar)
+    {
+        for (size_t length : Lengths()) {
+            for (size_t offset = 0; offset < 2; offset++) {
+                const std::vector<uint8_t> source = RandomBytes(length * 4 + offset);
+                std::vector<uint16_t> expected(length + kGuardBytes / 2, kFill * 0x101);
+                std::vector<uint16_t> actual(expected.size(), kFill * 0x101);
+                scalar(expected.data(), source.data() + offset, length);
+                kernel(actual.data(), source.data() + offset, length);
+                MJ2_CHECK(actual == expected);
+            }
+        }
+    }
+
+    void CheckBoxKernel(BoxKernel kernel, BoxKernel scalar, size_t channels)
+    {
+        for (size_t length : Lengths()) {
+            const std::vector<uint8_t> row0 = RandomBytes(length * 2 * channels + 1);
+            const std::vector<uint8_t> row1 = RandomBytes(length * 2 * channels + 1);
+            std::vector<uint8_t> expected(length * channels + kGuardBytes, kFill);
+            std::vector<uint8_t> actual(expected.size(), kFill);
+            scalar(expected.data(), row0.data() + 1, row1.data() + 1, length);
+            kernel(actual.data(), row0.data() + 1, row1.data() + 1, length);
+            MJ2_CHECK(actual == expected);
+        }
+    }
+
+    void TestRowKernels(const PixelKernels& kernels)
+    {
+        CheckByteKernel(kernels.BGRToRGB, BGRToRGBScalar, 3, 3, true);
+        CheckByteKernel(kernels.BGRToRGBA, BGRToRGBAScalar, 3, 4, false);
+        CheckByteKernel(kernels.BGRAToRGBA, BGRAToRGBAScalar, 4, 4, true);
+        CheckByteKernel(kernels.BGRXToRGBA, BGRXToRGBAScalar, 4, 4, true);
+        CheckByteKernel(kernels.PremultiplyRGBA, PremultiplyRGBAScalar, 4, 4, true);
+        CheckShortKernel(kernels.RGBAToRGB565, RGBAToRGB565Scalar);
+        CheckShortKernel(kernels.RGBAToRGBA4444, RGBAToRGBA4444Scalar);
+        CheckBoxKernel(kernels.BoxDownsampleRGB, BoxDownsampleRGBScalar, 3);
+        CheckBoxKernel(kernels.BoxDownsampleRGBA, BoxDownsampleRGBAScalar, 4);
+    }
+
+    /// rgb * a / 255 rounded to nearest, as PixelConvert.hpp promises, for every pair
+    void TestPremultiplyExact(const PixelKernels& kernels)
+    {
+        std::vector<uint8_t> pixels(256 * 256 * 4);
+        for (uint32_t a = 0; a < 256; a++) {
+            for (uint32_t c = 0; c < 256; c++) {
+                uint8_t* pixel = &pixels[(a * 256 + c) * 4];
+                pixel[0] = (uint8_t)c;
+                pixel[1] = (uint8_t)(255 - c);
+                pixel[2] = (uint8_t)(c ^ 0x55);
+                pixel[3] = (uint8_t)a;
+            }
+        }
+        kernels.PremultiplyRGBA(pixels.data(), pixels.data(), 256 * 256);
+        bool exact = true;
+        for (uint32_t a = 0; a < 256; a++) {
+            for (uint32_t c = 0; c < 256; c++) {
+                const uint8_t* pixel = &pixels[(a * 256 + c) * 4];
+                const uint32_t channels[3] = { c, 255 - c, c ^ 0x55 };
+                for (int i = 0; i < 3; i++) {
+                    exact = exact && pixel[i] == (channels[i] * a * 2 + 255) / 510;
+                }
+                exact = exact && pixel[3] == a;
+            }
+        }
+        MJ2_CHECK(exact);
+    }
+
+    /// an image of width x height in rows of stride bytes, padding filled with kFill
+    std::vector<uint8_t> PaddedImage(uint32_t width, uint32_t height, size_t pixelSize, size_t stride)
+    {
+        std::vector<uint8_t> image(stride * height, kFill);
+        for (uint32_t y = 0; y < height; y++) {
+            const std::vector<uint8_t> row = RandomBytes(width * pixelSize);
+            memcpy(&image[y * stride], row.data(), row.size());
+        }
+        return image;
+    }
+
+    /// each row of actual is what the scalar kernel makes of the same row, and the padding
+    /// after it is still kFill
+    template <typename Dst, typename Kernel>
+    bool SameRows(const std::vector<uint8_t>& actual, size_t dstStride, const std::vector<uint8_t>& src, size_t srcStride,
+                  uint32_t width, uint32_t height, Kernel scalar)
+    {
+        for (uint32_t y = 0; y < height; y++) {
+            std::vector<uint8_t> expected(dstStride, kFill);
+            scalar((Dst*)expected.data(), &src[y * srcStride], width);
+            if (memcmp(&actual[y * dstStride], expected.data(), dstStride) != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void TestPaddedStrides()
+    {
+        const uint32_t widths[] = { 1, 7, 13, 37, 70 };
+        const uint32_t height = 5;
+        for (uint32_t width : widths) {
+            // BMP padding for 3 byte pixels, a few spare bytes for 4 byte ones
+            const size_t stride3 = ((width * 3 + 3) & ~3u) + 4;
+            const size_t stride4 = width * 4 + 12;
+            const size_t stride2 = width * 2 + 6;
+
+            const std::vector<uint8_t> bgr = PaddedImage(width, height, 3, stride3);
+            const std::vector<uint8_t> bgra = PaddedImage(width, height, 4, stride4);
+
+            std::vector<uint8_t> out = bgr;
+            ConvertBGRToRGB(out.data(), stride3, out.data(), stride3, width, height);
+            MJ2_CHECK(SameRows<uint8_t>(out, stride3, bgr, stride3, width, height, BGRToRGBScalar));
+
+            out.assign(stride4 * height, kFill);
+            ConvertBGRToRGBA(out.data(), stride4, bgr.data(), stride3, width, height);
+            MJ2_CHECK(SameRows<uint8_t>(out, stride4, bgr, stride3, width, height, BGRToRGBAScalar));
+
+            out = bgra;
+            ConvertBGRAToRGBA(out.data(), stride4, out.data(), stride4, width, height, true);
+            MJ2_CHECK(SameRows<uint8_t>(out, stride4, bgra, stride4, width, height, BGRAToRGBAScalar));
+            out = bgra;
+            ConvertBGRAToRGBA(out.data(), stride4, out.data(), stride4, width, height, false);
+            MJ2_CHECK(SameRows<uint8_t>(out, stride4, bgra, stride4, width, height, BGRXToRGBAScalar));
+
+            out = bgra;
+            PremultiplyAlpha(out.data(), stride4, out.data(), stride4, width, height);
+            MJ2_CHECK(SameRows<uint8_t>(out, stride4, bgra, stride4, width, height, PremultiplyRGBAScalar));
+
+            out.assign(stride2 * height, kFill);
+            ConvertRGBAToRGB565((uint16_t*)out.data(), stride2, bgra.data(), stride4, width, height);
+            MJ2_CHECK(SameRows<uint16_t>(out, stride2, bgra, stride4, width, height, RGBAToRGB565Scalar));
+            out.assign(stride2 * height, kFill);
+            ConvertRGBAToRGBA4444((uint16_t*)out.data(), stride2, bgra.data(), stride4, width, height);
+            MJ2_CHECK(SameRows<uint16_t>(out, stride2, bgra, stride4, width, height, RGBAToRGBA4444Scalar));
+        }
+    }
+
+} // namespace
+
+int main()
+{
+    const PixelKernelLevel initial = GetPixelKernels().level;
+    const PixelKernelLevel levels[] = { PixelKernelLevel_Scalar, PixelKernelLevel_SSSE3, PixelKernelLevel_NEON };
+    int tested = 0;
+    for (PixelKernelLevel level : levels) {
+        if (!SetPixelKernelLevel(level)) {
+            continue;
+        }
+        const PixelKernels& kernels = GetPixelKernels();
+        MJ2_CHECK(kernels.level == level);
+        printf("PixelConvertTest: %s kernels\n", kernels.name);
+        TestRowKernels(kernels);
+        TestPremultiplyExact(kernels);
+        TestPaddedStrides();
+        tested++;
+    }
+    MJ2_CHECK(tested >= 1);
+    SetPixelKernelLevel(initial);
+    return CheckResult("PixelConvertTest");
+}
@@ -0,0 +1,259 @@
+/////
+// SkylinePacker and AtlasBuilder: squares that tile a page exactly fill it, 300 random
+// RGB and RGBA sprites land on three pages in aligned cells that never overlap, with the
+// sprite texels copied, every gutter texel equal to the nearest edge texel, and UVs that
+// RemapUVs turns into the sprite's corners.
+/////
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "../TextureAtlas.hpp"
+#include "../../math/tests/Check.hpp"
+
+using namespace mj2;
+using namespace mj2::test;
+
+namespace {
+
+    /// xorshift, fixed seed
+    uint32_t gRandomState = 1234567891u;
+
+    uint32_t Random()
+    {
+        gRandomState ^= gRandomState << 13;
+        gRandomState ^= gRandomState >> 17;
+        gRandomState ^= gRandomState << 5;
+        return gRandomState;
+    }
+
+    /// width x height of noise in rows padded past the pixels, so the builder has to use the stride
+    struct TestSprite {
+    public:
+        TestSprite(uint32_t width, uint32_t height, uint32_t channels)
+                : width(width)
+                , height(height)
+                , channels(channels)
+                , stride((size_t)width * channels + 5)
+                , pixels(stride * height)
+        {
+            for (uint8_t& b : pixels) {
+                b = (uint8_t)(Random() >> 24);
+            }
+        }
+
+        uint32_t width;
+        uint32_t height;
+        uint32_t channels;
+        size_t stride;
+        std::vector<uint8_t> pixels;
+    };
+
+    void TestExactFill()
+    {
+        // 64 squares of 32 tile 256 x 256 with nothing left over
+        SkylinePacker packer;
+        packer.Reset(256, 256);
+        std::vector<uint8_t> covered(256 * 256, 0);
+        bool inserted = true;
+        bool disjoint = true;
+        for (int i = 0; i < 64; i++) {
+            uint32_t x, y;
+            inserted = inserted && packer.Insert(32, 32, x, y);
+            for (uint32_t row = y; inserted && row < y + 32; row++) {
+                for (uint32_t column = x; column < x + 32; column++) {
+                    disjoint = disjoint && covered[row * 256 + column]++ == 0;
+                }
+            }
+        }
+        MJ2_CHECK(inserted);
+        MJ2_CHECK(disjoint);
+        MJ2_CHECK(packer.Occupancy() == 1.0f);
+        uint32_t x, y;
+        MJ2_CHECK(!packer.Insert(1, 1, x, y));
+        MJ2_CHECK(!packer.Insert(0, 4, x, y));
+
+        packer.Reset(256, 256);
+        MJ2_CHECK(packer.Occupancy() == 0.0f);
+        MJ2_CHECK(!packer.Insert(257, 1, x, y));
+        MJ2_CHECK(packer.Insert(256, 256, x, y) && x == 0 && y == 0);
+
+        // and through the builder, with no gutter, padding or alignment to grow the cells
+        AtlasOptions options;
+        options.pageWidth = 256;
+        options.pageHeight = 256;
+        options.gutter = 0;
+        options.alignment = 1;
+        std::vector<TestSprite> sprites;
+        for (int i = 0; i < 64; i++) {
+            sprites.emplace_back(32, 32, 4);
+        }
+        AtlasBuilder builder(options);
+        for (const TestSprite& sprite : sprites) {
+            builder.Add(sprite.pixels.data(), sprite.width, sprite.height, sprite.stride, sprite.channels);
+        }
+        MJ2_CHECK(builder.Build() == ImageStatus_Ok);
+        MJ2_CHECK(builder.PageCount() == 1);
+        MJ2_CHECK(builder.PageOccupancy(0) == 1.0f);
+
+        // one more opens a second page
+        sprites.emplace_back(32, 32, 4);
+        builder.Add(sprites.back().pixels.data(), 32, 32, sprites.back().stride, 4);
+        MJ2_CHECK(builder.Build() == ImageStatus_Ok);
+        MJ2_CHECK(builder.PageCount() == 2);
+        MJ2_CHECK(builder.Sprite(64).page == 1);
+    }
+
+    /// the page texel at (x, y) is the source texel at the clamped position, with opaque
+    /// alpha for RGB sources
+    bool SameTexel(const AtlasBuilder& builder, const AtlasSprite& sprite, const TestSprite& source, int32_t x, int32_t y)
+    {
+        const int32_t sx = std::min(std::max(x - (int32_t)sprite.x, 0), (int32_t)source.width - 1);
+        const int32_t sy = std::min(std::max(y - (int32_t)sprite.y, 0), (int32_t)source.height - 1);
+        const uint8_t* in = &source.pixels[sy * source.stride + sx * source.channels];
+        const uint8_t* out = builder.Page(sprite.page) + y * builder.PageRowStride() + x * 4;
+        return out[0] == in[0] && out[1] == in[1] && out[2] == in[2] && out[3] == (source.channels == 4 ? in[3] : 255);
+    }
+
+    void TestRandomSprites()
+    {
+        AtlasOptions options;
+        options.pageWidth = 512;
+        options.pageHeight = 512;
+        options.gutter = 2;
+        options.padding = 1;
+        options.alignment = 4;
+        const uint32_t border = options.gutter + (options.padding + 1) / 2;
+
+        std::vector<TestSprite> sources;
+        sources.reserve(300);
+        for (int i = 0; i < 300; i++) {
+            sources.emplace_back(4 + Random() % 61, 4 + Random() % 61, 3 + Random() % 2);
+        }
+        AtlasBuilder builder(options);
+        for (const TestSprite& source : sources) {
+            builder.Add(source.pixels.data(), source.width, source.height, source.stride, source.channels);
+        }
+        MJ2_CHECK(builder.Build() == ImageStatus_Ok);
+        MJ2_CHECK(builder.SpriteCount() == 300);
+        MJ2_CHECK(builder.PageCount() == 3);
+        MJ2_CHECK(builder.PageRowStride() == 512 * 4);
+        for (uint32_t page = 0; page + 1 < builder.PageCount(); page++) {
+            MJ2_CHECK(builder.PageOccupancy(page) > 0.9f);
+        }
+
+        // cells on the alignment grid and inside the page
+        bool aligned = true;
+        for (uint32_t i = 0; i < builder.SpriteCount(); i++) {
+            const AtlasSprite& sprite = builder.Sprite(i);
+            const uint32_t cellX = sprite.x - border;
+            const uint32_t cellY = sprite.y - border;
+            aligned = aligned && sprite.width == sources[i].width && sprite.height == sources[i].height &&
+                      sprite.page < builder.PageCount() && sprite.x >= border && sprite.y >= border &&
+                      cellX % options.alignment == 0 && cellY % options.alignment == 0 &&
+                      sprite.x + sprite.width + border <= options.pageWidth &&
+                      sprite.y + sprite.height + border <= options.pageHeight;
+        }
+        MJ2_CHECK(aligned);
+
+        // no two sprites with their gutters and padding share a texel
+        bool disjoint = true;
+        for (uint32_t i = 0; i < builder.SpriteCount(); i++) {
+            for (uint32_t j = i + 1; j < builder.SpriteCount(); j++) {
+                const AtlasSprite& a = builder.Sprite(i);
+                const AtlasSprite& b = builder.Sprite(j);
+                if (a.page == b.page) {
+                    disjoint = disjoint && (a.x + a.width + border <= b.x - border ||
+                                            b.x + b.width + border <= a.x - border ||
+                                            a.y + a.height + border <= b.y - border ||
+                                            b.y + b.height + border <= a.y - border);
+                }
+            }
+        }
+        MJ2_CHECK(disjoint);
+
+        // the sprite's texels, then the gutter ring around them repeating the nearest edge
+        bool copied = true;
+        bool guttered = true;
+        const int32_t gutter = (int32_t)options.gutter;
+        for (uint32_t i = 0; i < builder.SpriteCount(); i++) {
+            const AtlasSprite& sprite = builder.Sprite(i);
+            const int32_t x0 = (int32_t)sprite.x;
+            const int32_t y0 = (int32_t)sprite.y;
+            const int32_t x1 = x0 + (int32_t)sprite.width;
+            const int32_t y1 = y0 + (int32_t)sprite.height;
+            for (int32_t y = y0 - gutter; y < y1 + gutter; y++) {
+                for (int32_t x = x0 - gutter; x < x1 + gutter; x++) {
+                    const bool inside = x >= x0 && x < x1 && y >= y0 && y < y1;
+                    bool& result = inside ? copied : guttered;
+                    result = result && SameTexel(builder, sprite, sources[i], x, y);
+                }
+            }
+        }
+        MJ2_CHECK(copied);
+        MJ2_CHECK(guttered);
+
+        // UVs span exactly the sprite's texels, and a unit quad maps onto them
+        bool mapped = true;
+        for (uint32_t i = 0; i < builder.SpriteCount(); i++) {
+            const AtlasSprite& sprite = builder.Sprite(i);
+            mapped = mapped && sprite.u0 == (float)sprite.x / options.pageWidth &&
+                     sprite.v0 == (float)sprite.y / options.pageHeight &&
+                     sprite.u1 == (float)(sprite.x + sprite.width) / options.pageWidth &&
+                     sprite.v1 == (float)(sprite.y + sprite.height) / options.pageHeight;
+
+            // position, uv, position: a stride of 4 floats leaves the positions alone
+            float vertices[] = { 9.0f, 9.0f, 0.0f, 0.0f, 9.0f, 9.0f, 1.0f, 0.0f, 9.0f, 9.0f, 0.0f, 1.0f,
+                                 9.0f, 9.0f, 1.0f, 1.0f, 9.0f, 9.0f, 0.5f, 0.5f };
+            RemapUVs(vertices + 2, 5, 4, sprite);
+            const float eps = 1e-6f;
+            mapped = mapped && fabsf(vertices[2] - sprite.u0) < eps && fabsf(vertices[3] - sprite.v0) < eps &&
+                     fabsf(vertices[6] - sprite.u1) < eps && fabsf(vertices[7] - sprite.v0) < eps &&
+                     fabsf(vertices[10] - sprite.u0) < eps && fabsf(vertices[11] - sprite.v1) < eps &&
+                     fabsf(vertices[14] - sprite.u1) < eps && fabsf(vertices[15] - sprite.v1) < eps &&
+                     fabsf(vertices[18] - (sprite.u0 + sprite.u1) * 0.5f) < eps &&
+                     fabsf(vertices[19] - (sprite.v0 + sprite.v1) * 0.5f) < eps;
+            for (int v = 0; v < 5; v++) {
+                mapped = mapped && vertices[v * 4] == 9.0f && vertices[v * 4 + 1] == 9.0f;
+            }
+        }
+        MJ2_CHECK(mapped);
+    }
+
+    void TestRejects()
+    {
+        const TestSprite sprite(64, 64, 4);
+        AtlasOptions options;
+        options.pageWidth = 64;
+        options.pageHeight = 64;
+
+        // the gutter pushes the cell past an empty page
+        AtlasBuilder tooBig(options);
+        tooBig.Add(sprite.pixels.data(), 64, 64, sprite.stride, 4);
+        MJ2_CHECK(tooBig.Build() == ImageStatus_Unsupported);
+
+        options.gutter = 0;
+        AtlasBuilder exact(options);
+        exact.Add(sprite.pixels.data(), 64, 64, sprite.stride, 4);
+        MJ2_CHECK(exact.Build() == ImageStatus_Ok && exact.PageCount() == 1);
+
+        AtlasBuilder badChannels(options);
+        badChannels.Add(sprite.pixels.data(), 32, 32, sprite.stride, 2);
+        MJ2_CHECK(badChannels.Build() == ImageStatus_Unsupported);
+
+        options.channels = 2;
+        AtlasBuilder badPage(options);
+        MJ2_CHECK(badPage.Build() == ImageStatus_Unsupported);
+    }
+
+} // namespace
+
+int main()
+{
+    TestExactFill();
+    TestRandomSprites();
+    TestRejects();
+    return CheckResult("TextureAtlasTest");
+}
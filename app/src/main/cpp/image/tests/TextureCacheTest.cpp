@@ -0,0 +1,459 @@
+/////
+// TextureCache against a backend that only hands out names: which textures the GPU
+// budget evicts and in what order, that textures in use are never among them, how many
+// loads one Update starts, previews promoted to the full chain once there is room, and
+// what is left after the context is lost. Loads go through the real loader and pool,
+// on .mj2t files written to a temporary directory.
+/////
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "../TextureCache.hpp"
+#include "../TextureFile.hpp"
+#include "../TextureLoader.hpp"
+#include "../ThreadPool.hpp"
+#include "../../math/tests/Check.hpp"
+
+using namespace mj2;
+using namespace mj2::test;
+
+namespace {
+
+    /// a 32 x 32 RGBA8 chain, no preview since it is no bigger than PreviewSize
+    const uint32_t kSmallSize = 32;
+    /// a 256 x 256 RGBA8 chain, its preview starts at level 2
+    const uint32_t kLargeSize = 256;
+
+    size_t ChainBytes(uint32_t size, uint32_t firstLevel = 0)
+    {
+        size_t bytes = 0;
+        for (uint32_t level = firstLevel; (size >> level) > 0; level++) {
+            bytes += TextureLevelBytes(TextureFormat_RGBA8, size >> level, size >> level);
+        }
+        return bytes;
+    }
+
+    //-------------------------------------------------------------
+    // StubTextureBackend
+    //-------------------------------------------------------------
+    /// Names from 1 up and the levels uploaded into each. Deleting a name that is not
+    /// live, or uploading into one, goes to errors.
+    class StubTextureBackend : public TextureBackend {
+    public:
+        StubTextureBackend()
+                : created(0)
+                , errors(0)
+                , nextTexture(1)
+        {
+        }
+
+        bool SupportsFormat(TextureFormat) override { return true; }
+        bool SupportsMipmaps(uint32_t, uint32_t) override { return true; }
+
+        uint32_t CreateTexture(TextureFormat, uint32_t width, uint32_t, uint32_t levelCount) override
+        {
+            const uint32_t texture = nextTexture++;
+            live[texture] = Texture{ width, levelCount, 0 };
+            created++;
+            return texture;
+        }
+
+        void UploadLevel(uint32_t texture, TextureFormat, const TextureLevel& level, uint32_t glLevel) override
+        {
+            auto found = live.find(texture);
+            if (found == live.end() || glLevel >= found->second.levelCount ||
+                level.width != std::max(found->second.width >> glLevel, 1u)) {
+                errors++;
+                return;
+            }
+            found->second.uploaded++;
+        }
+
+        void DeleteTexture(uint32_t texture) override
+        {
+            if (live.erase(texture) != 1) {
+                errors++;
+            }
+            deleted.push_back(texture);
+        }
+
+        bool Live(uint32_t texture) const { return live.count(texture) == 1; }
+        /// every level of a live texture is up
+        bool Complete(uint32_t texture) const
+        {
+            auto found = live.find(texture);
+            return found != live.end() && found->second.uploaded == found->second.levelCount;
+        }
+
+        struct Texture {
+        public:
+            uint32_t width;
+            uint32_t levelCount;
+            uint32_t uploaded;
+        };
+
+        std::map<uint32_t, Texture> live;
+        std::vector<uint32_t> deleted;
+        uint32_t created;
+        int errors;
+
+    private:
+        uint32_t nextTexture;
+    };
+
+    /// .mj2t files in a temporary directory, removed with it
+    struct TextureFiles {
+    public:
+        TextureFiles()
+        {
+            char name[] = "/tmp/mj2image_texturecache_XXXXXX";
+            if (mkdtemp(name)) {
+                directory = name;
+            }
+        }
+
+        ~TextureFiles()
+        {
+            for (const std::string& path : paths) {
+                remove(path.c_str());
+            }
+            if (!directory.empty()) {
+                rmdir(directory.c_str());
+            }
+        }
+
+        /// a full RGBA8 chain, size x size
+        std::string Add(const char* name, uint32_t size)
+        {
+            std::vector<std::vector<uint8_t> > data;
+            std::vector<TextureLevel> levels;
+            for (uint32_t level = 0; (size >> level) > 0; level++) {
+                TextureLevel entry;
+                entry.width = size >> level;
+                entry.height = size >> level;
+                entry.size = TextureLevelBytes(TextureFormat_RGBA8, entry.width, entry.height);
+                data.push_back(std::vector<uint8_t>(entry.size, (uint8_t)(level * 29)));
+                entry.data = data.back().data();
+                levels.push_back(entry);
+            }
+            const std::string path = directory + "/" + name + ".mj2t";
+            MJ2_CHECK(WriteTextureFile(path.c_str(), TextureFormat_RGBA8, levels.data(), (uint32_t)levels.size(), true));
+            paths.push_back(path);
+            return path;
+        }
+
+        std::string directory;
+        std::vector<std::string> paths;
+    };
+
+    bool Settled(TextureState state)
+    {
+        return state == TextureState_Resident || state == TextureState_Failed;
+    }
+
+    /// Update in single steps until id is resident or failed; the loads run on the pool
+    void Finish(TextureCache& cache, TextureId id)
+    {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (!Settled(cache.State(id)) && std::chrono::steady_clock::now() < deadline) {
+            cache.Update(0.0);
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        MJ2_CHECK(Settled(cache.State(id)));
+    }
+
+    /// Update until the texture of id is width across
+    void FinishAt(TextureCache& cache, TextureId id, uint32_t width)
+    {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        uint32_t textureWidth = 0, textureHeight = 0;
+        while (std::chrono::steady_clock::now() < deadline) {
+            cache.TextureSize(id, textureWidth, textureHeight);
+            if (textureWidth == width && Settled(cache.State(id))) {
+                break;
+            }
+            cache.Update(0.0);
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        MJ2_CHECK(textureWidth == width && cache.State(id) == TextureState_Resident);
+    }
+
+    TextureCacheBudget Budget(size_t gpuBytes, size_t stagingBytes = 64 << 20)
+    {
+        return TextureCacheBudget{ gpuBytes, stagingBytes };
+    }
+
+    void TestEvictionOrder(TextureFiles& files)
+    {
+        ThreadPool pool(2);
+        TextureLoader loader(pool);
+        StubTextureBackend backend;
+        TextureCache cache(loader, backend, Budget(3 * ChainBytes(kSmallSize)));
+
+        const std::string pathA = files.Add("evict_a", kSmallSize);
+        const TextureId a = cache.Acquire(pathA.c_str());
+        const TextureId b = cache.Acquire(files.Add("evict_b", kSmallSize).c_str());
+        const TextureId c = cache.Acquire(files.Add("evict_c", kSmallSize).c_str());
+        Finish(cache, a);
+        Finish(cache, b);
+        Finish(cache, c);
+        const uint32_t textureA = cache.Texture(a);
+        const uint32_t textureB = cache.Texture(b);
+        const uint32_t textureC = cache.Texture(c);
+        MJ2_CHECK(backend.Complete(textureA) && backend.Complete(textureB) && backend.Complete(textureC));
+        MJ2_CHECK(cache.GpuBytes() == 3 * ChainBytes(kSmallSize));
+
+        // released but within budget: all stay
+        cache.Release(a);
+        cache.Release(c);
+        cache.Release(b);
+        cache.Update(0.0);
+        MJ2_CHECK(cache.State(a) == TextureState_Resident && cache.State(b) == TextureState_Resident &&
+                  cache.State(c) == TextureState_Resident);
+
+        // least recently released first: a, then c, then b
+        const TextureId d = cache.Acquire(files.Add("evict_d", kSmallSize).c_str());
+        Finish(cache, d);
+        MJ2_CHECK(cache.State(a) == TextureState_Failed && cache.Texture(a) == 0);
+        MJ2_CHECK(cache.State(b) == TextureState_Resident && cache.State(c) == TextureState_Resident);
+        MJ2_CHECK(backend.deleted == std::vector<uint32_t>{ textureA });
+
+        const TextureId e = cache.Acquire(files.Add("evict_e", kSmallSize).c_str());
+        Finish(cache, e);
+        MJ2_CHECK(cache.State(c) == TextureState_Failed && cache.State(b) == TextureState_Resident);
+        MJ2_CHECK((backend.deleted == std::vector<uint32_t>{ textureA, textureC }));
+        MJ2_CHECK(backend.Live(textureB) && cache.GpuBytes() == 3 * ChainBytes(kSmallSize));
+
+        // an evicted path loads again under a new id
+        const TextureId again = cache.Acquire(pathA.c_str());
+        MJ2_CHECK(again != a && cache.State(again) == TextureState_Queued);
+        Finish(cache, again);
+        MJ2_CHECK(cache.State(b) == TextureState_Failed && cache.State(again) == TextureState_Resident);
+        MJ2_CHECK(backend.errors == 0);
+    }
+
+    void TestPinned(TextureFiles& files)
+    {
+        ThreadPool pool(2);
+        TextureLoader loader(pool);
+        StubTextureBackend backend;
+        TextureCache cache(loader, backend, Budget(2 * ChainBytes(kSmallSize)));
+
+        // three in use do not fit, they load anyway: without a preview the full chain is the minimum
+        const std::string paths[] = { files.Add("pinned_a", kSmallSize), files.Add("pinned_b", kSmallSize),
+                                      files.Add("pinned_c", kSmallSize) };
+        const TextureId ids[] = { cache.Acquire(paths[0].c_str()), cache.Acquire(paths[1].c_str()),
+                                  cache.Acquire(paths[2].c_str()) };
+        for (TextureId id : ids) {
+            Finish(cache, id);
+        }
+        for (int i = 0; i < 10; i++) {
+            cache.Update(0.0);
+        }
+        cache.SetBudget(Budget(0));
+        for (TextureId id : ids) {
+            MJ2_CHECK(cache.State(id) == TextureState_Resident && backend.Complete(cache.Texture(id)));
+        }
+        MJ2_CHECK(backend.deleted.empty() && cache.GpuBytes() == 3 * ChainBytes(kSmallSize));
+
+        // a second reference pins as well as the first; only the last Release unpins
+        MJ2_CHECK(cache.Acquire(paths[1].c_str()) == ids[1]);
+        cache.Release(ids[1]);
+        cache.Release(ids[0]);
+        cache.Update(0.0);
+        MJ2_CHECK(cache.State(ids[0]) == TextureState_Failed);
+        MJ2_CHECK(cache.State(ids[1]) == TextureState_Resident && cache.State(ids[2]) == TextureState_Resident);
+        MJ2_CHECK(cache.GpuBytes() == 2 * ChainBytes(kSmallSize) && backend.errors == 0);
+    }
+
+    void TestRevive(TextureFiles& files)
+    {
+        ThreadPool pool(2);
+        TextureLoader loader(pool);
+        StubTextureBackend backend;
+        TextureCache cache(loader, backend, Budget(ChainBytes(kSmallSize)));
+
+        const std::string path = files.Add("revive", kSmallSize);
+        const TextureId id = cache.Acquire(path.c_str());
+        Finish(cache, id);
+        const uint32_t texture = cache.Texture(id);
+        const uint32_t created = backend.created;
+
+        // back from the unused list as it was, no load and no upload
+        cache.Release(id);
+        cache.Update(0.0);
+        MJ2_CHECK(cache.Acquire(path.c_str()) == id);
+        MJ2_CHECK(cache.State(id) == TextureState_Resident && cache.Texture(id) == texture);
+        MJ2_CHECK(backend.created == created && loader.Pending() == 0);
+
+        // and pinned again: a budget of nothing cannot evict it
+        cache.SetBudget(Budget(0));
+        cache.Update(0.0);
+        MJ2_CHECK(cache.State(id) == TextureState_Resident && backend.Live(texture));
+
+        // within the same frame too
+        cache.Release(id);
+        MJ2_CHECK(cache.Acquire(path.c_str()) == id);
+        cache.Update(0.0);
+        MJ2_CHECK(cache.State(id) == TextureState_Resident && backend.Live(texture));
+
+        // released with the budget at zero it goes at the next Update
+        cache.Release(id);
+        cache.Update(0.0);
+        MJ2_CHECK(cache.State(id) == TextureState_Failed && !backend.Live(texture));
+        MJ2_CHECK(backend.errors == 0);
+    }
+
+    void TestLoadLimits(TextureFiles& files)
+    {
+        ThreadPool pool(2);
+        TextureLoader loader(pool);
+        StubTextureBackend backend;
+
+        const std::string small = files.Add("limit_small", kSmallSize);
+
+        // MaxLoadsInFlight in TextureCache.cpp; the rest wait for a slot
+        {
+            TextureCache cache(loader, backend, Budget(64 << 20));
+            std::vector<TextureId> ids;
+            for (int i = 0; i < 6; i++) {
+                const std::string name = "limit_" + std::to_string(i);
+                ids.push_back(cache.Acquire(files.Add(name.c_str(), kSmallSize).c_str()));
+            }
+            cache.Update(0.0);
+            MJ2_CHECK(std::count_if(ids.begin(), ids.end(), [&](TextureId id) {
+                          return cache.State(id) == TextureState_Queued;
+                      }) == 2);
+            MJ2_CHECK(cache.State(ids[4]) == TextureState_Queued && cache.State(ids[5]) == TextureState_Queued);
+            for (TextureId id : ids) {
+                Finish(cache, id);
+                MJ2_CHECK(cache.State(id) == TextureState_Resident);
+            }
+        }
+
+        // no staging budget, no loads
+        {
+            TextureCache cache(loader, backend, Budget(64 << 20, 0));
+            const TextureId id = cache.Acquire(small.c_str());
+            for (int i = 0; i < 10; i++) {
+                cache.Update(0.0);
+            }
+            MJ2_CHECK(cache.State(id) == TextureState_Queued && loader.Pending() == 0);
+        }
+
+        // one mapping held while a large texture streams fills a budget of one byte
+        {
+            TextureCache cache(loader, backend, Budget(64 << 20, 1));
+            const TextureId large = cache.Acquire(files.Add("limit_large", kLargeSize).c_str());
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+            while (cache.State(large) != TextureState_Streaming && std::chrono::steady_clock::now() < deadline) {
+                cache.Update(0.0);
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+            MJ2_CHECK(cache.State(large) == TextureState_Streaming && cache.StagingBytes() > 1);
+
+            const TextureId waiting = cache.Acquire(small.c_str());
+            cache.Update(0.0);
+            MJ2_CHECK(cache.State(waiting) == TextureState_Queued);
+
+            // the mapping goes once the last level is up, then the next load starts
+            Finish(cache, large);
+            MJ2_CHECK(cache.StagingBytes() == 0);
+            Finish(cache, waiting);
+            MJ2_CHECK(cache.State(waiting) == TextureState_Resident);
+        }
+        MJ2_CHECK(backend.errors == 0 && backend.live.empty());
+    }
+
+    void TestPromotion(TextureFiles& files)
+    {
+        ThreadPool pool(2);
+        TextureLoader loader(pool);
+        StubTextureBackend backend;
+
+        // the preview fits, the full chain next to it does not
+        const size_t previewBytes = ChainBytes(kLargeSize, 2);
+        TextureCache cache(loader, backend, Budget(previewBytes + ChainBytes(kLargeSize) / 2));
+
+        const std::string path = files.Add("promote", kLargeSize);
+        const TextureId id = cache.Acquire(path.c_str());
+        Finish(cache, id);
+        uint32_t width, height;
+        cache.TextureSize(id, width, height);
+        MJ2_CHECK(width == TextureCache::PreviewSize && height == TextureCache::PreviewSize);
+        MJ2_CHECK(cache.GpuBytes() == previewBytes && cache.StagingBytes() == 0);
+        const uint32_t preview = cache.Texture(id);
+        MJ2_CHECK(backend.Complete(preview));
+
+        // still reduced while the budget stays, and queued for promotion once however
+        // often it is released and acquired before the next Update
+        for (int i = 0; i < 3; i++) {
+            cache.Release(id);
+            MJ2_CHECK(cache.Acquire(path.c_str()) == id);
+        }
+        for (int i = 0; i < 5; i++) {
+            cache.Update(0.0);
+        }
+        MJ2_CHECK(cache.Texture(id) == preview && cache.State(id) == TextureState_Resident);
+
+        // room for it: reloaded and streamed behind the bound preview, which goes at the swap
+        cache.SetBudget(Budget(previewBytes + ChainBytes(kLargeSize)));
+        cache.Update(0.0);
+        // one load, not one per Acquire above
+        MJ2_CHECK(loader.Pending() <= 1);
+        FinishAt(cache, id, kLargeSize);
+        MJ2_CHECK(cache.Texture(id) != preview && backend.Complete(cache.Texture(id)));
+        MJ2_CHECK(!backend.Live(preview) && backend.live.size() == 1);
+        MJ2_CHECK(cache.GpuBytes() == ChainBytes(kLargeSize) && cache.StagingBytes() == 0);
+        MJ2_CHECK(backend.created == 2 && backend.errors == 0);
+    }
+
+    void TestInvalidateAll(TextureFiles& files)
+    {
+        ThreadPool pool(2);
+        TextureLoader loader(pool);
+        StubTextureBackend backend;
+        TextureCache cache(loader, backend, Budget(64 << 20));
+
+        const TextureId used = cache.Acquire(files.Add("lost_used", kSmallSize).c_str());
+        const TextureId unused = cache.Acquire(files.Add("lost_unused", kSmallSize).c_str());
+        Finish(cache, used);
+        Finish(cache, unused);
+        cache.Release(unused);
+
+        // the names died with the context, nothing is deleted
+        cache.InvalidateAll();
+        MJ2_CHECK(backend.deleted.empty());
+        MJ2_CHECK(cache.State(unused) == TextureState_Failed);
+        MJ2_CHECK(cache.State(used) == TextureState_Queued && cache.Texture(used) == 0);
+        MJ2_CHECK(cache.GpuBytes() == 0);
+
+        // the new context gets it again under the same id
+        backend.live.clear();
+        Finish(cache, used);
+        MJ2_CHECK(cache.State(used) == TextureState_Resident && backend.Complete(cache.Texture(used)));
+        MJ2_CHECK(cache.GpuBytes() == ChainBytes(kSmallSize) && backend.created == 3);
+        MJ2_CHECK(backend.errors == 0);
+    }
+
+} // namespace
+
+int main()
+{
+    TextureFiles files;
+    TestEvictionOrder(files);
+    TestPinned(files);
+    TestRevive(files);
+    TestLoadLimits(files);
+    TestPromotion(files);
+    TestInvalidateAll(files);
+    return CheckResult("TextureCacheTest");
+}
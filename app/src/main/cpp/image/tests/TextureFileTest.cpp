@@ -0,0 +1,318 @@
+/////
+// The .mj2t container: what WriteTextureFile writes, ParseTextureFile reads back level
+// for level, and every kind of damage the parser has to turn away before a level
+// pointer leaves the file: checksum, magic, version, a short level table, offsets past
+// the end and payloads off their alignment.
+/////
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "../MappedFile.hpp"
+#include "../MipChain.hpp"
+#include "../TextureFile.hpp"
+#include "../../math/tests/Check.hpp"
+
+using namespace mj2;
+using namespace mj2::test;
+
+namespace {
+
+    /// offsets in the header, see the layout comment in TextureFile.cpp
+    const size_t kHeaderSize = 32;
+    const size_t kLevelEntrySize = 16;
+    const size_t kVersionOffset = 4;
+    const size_t kChecksumOffset = 28;
+
+    uint32_t ReadU32(const std::vector<uint8_t>& data, size_t at)
+    {
+        return (uint32_t)data[at] | ((uint32_t)data[at + 1] << 8) | ((uint32_t)data[at + 2] << 16) |
+               ((uint32_t)data[at + 3] << 24);
+    }
+
+    void WriteU32(std::vector<uint8_t>& data, size_t at, uint32_t v)
+    {
+        for (int i = 0; i < 4; i++) {
+            data[at + i] = (uint8_t)(v >> (8 * i));
+        }
+    }
+
+    /// a temporary path, removed when the test is done with it
+    struct TempFile {
+    public:
+        TempFile()
+        {
+            char name[] = "/tmp/mj2image_texturefile_XXXXXX";
+            const int fd = mkstemp(name);
+            if (fd >= 0) {
+                close(fd);
+                path = name;
+            }
+        }
+
+        ~TempFile()
+        {
+            if (!path.empty()) {
+                remove(path.c_str());
+            }
+        }
+
+        std::vector<uint8_t> Read() const
+        {
+            std::vector<uint8_t> data;
+            FILE* in = fopen(path.c_str(), "rb");
+            uint8_t buffer[4096];
+            size_t read;
+            while (in && (read = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+                data.insert(data.end(), buffer, buffer + read);
+            }
+            if (in) {
+                fclose(in);
+            }
+            return data;
+        }
+
+        std::string path;
+    };
+
+    /// every level of a width x height chain (or just the base), each byte a function of
+    /// level and position so a level handed back at the wrong offset shows
+    struct Levels {
+    public:
+        Levels(TextureFormat format, uint32_t width, uint32_t height, bool chain)
+        {
+            const uint32_t count = chain ? MipChain::FullLevelCount(width, height) : 1;
+            data.resize(count);
+            for (uint32_t i = 0; i < count; i++) {
+                TextureLevel level;
+                level.width = std::max(width >> i, 1u);
+                level.height = std::max(height >> i, 1u);
+                level.size = TextureLevelBytes(format, level.width, level.height);
+                data[i].resize(level.size);
+                for (size_t b = 0; b < level.size; b++) {
+                    data[i][b] = (uint8_t)(i * 37 + b * 11);
+                }
+                level.data = data[i].data();
+                levels.push_back(level);
+            }
+        }
+
+        std::vector<std::vector<uint8_t> > data;
+        std::vector<TextureLevel> levels;
+    };
+
+    std::vector<uint8_t> WriteFile(TextureFormat format, uint32_t width, uint32_t height, bool chain, bool checksum)
+    {
+        const Levels levels(format, width, height, chain);
+        TempFile file;
+        MJ2_CHECK(WriteTextureFile(file.path.c_str(), format, levels.levels.data(), (uint32_t)levels.levels.size(),
+                                   checksum));
+        return file.Read();
+    }
+
+    ImageStatus Parse(const std::vector<uint8_t>& data, bool verifyChecksum = true)
+    {
+        TextureFile texture;
+        return ParseTextureFile(data.data(), data.size(), texture, verifyChecksum);
+    }
+
+    void CheckRoundTrip(TextureFormat format, uint32_t width, uint32_t height, bool chain, bool checksum)
+    {
+        const Levels expected(format, width, height, chain);
+        TempFile file;
+        MJ2_CHECK(WriteTextureFile(file.path.c_str(), format, expected.levels.data(),
+                                   (uint32_t)expected.levels.size(), checksum));
+
+        const std::vector<uint8_t> data = file.Read();
+        TextureFile texture;
+        MJ2_CHECK(ParseTextureFile(data.data(), data.size(), texture, true) == ImageStatus_Ok);
+        MJ2_CHECK(texture.format == format && texture.width == width && texture.height == height);
+        MJ2_CHECK(texture.levelCount == expected.levels.size() && texture.hasChecksum == checksum);
+        for (uint32_t i = 0; i < texture.levelCount && i < expected.levels.size(); i++) {
+            const TextureLevel& level = texture.levels[i];
+            MJ2_CHECK(level.width == expected.levels[i].width && level.height == expected.levels[i].height);
+            MJ2_CHECK(level.size == expected.levels[i].size);
+            MJ2_CHECK(memcmp(level.data, expected.levels[i].data, level.size) == 0);
+            MJ2_CHECK((size_t)(level.data - data.data()) % TextureFilePayloadAlignment == 0);
+        }
+
+        // the same through a mapping
+        MappedFile mapped;
+        TextureFile loaded;
+        MJ2_CHECK(LoadTextureFile(file.path.c_str(), mapped, loaded, true) == ImageStatus_Ok);
+        MJ2_CHECK(loaded.levelCount == texture.levelCount &&
+                  memcmp(loaded.levels[loaded.levelCount - 1].data, texture.levels[texture.levelCount - 1].data,
+                         texture.levels[texture.levelCount - 1].size) == 0);
+    }
+
+    void TestRoundTrip()
+    {
+        CheckRoundTrip(TextureFormat_RGBA8, 64, 64, true, true);
+        // padded rows and a non square chain that reaches 1 x 1 on one side first
+        CheckRoundTrip(TextureFormat_RGB8, 13, 5, true, true);
+        CheckRoundTrip(TextureFormat_RGB8, 1, 9, true, false);
+        CheckRoundTrip(TextureFormat_ETC1, 32, 8, true, true);
+        CheckRoundTrip(TextureFormat_ETC2_RGBA, 10, 6, false, true);
+        CheckRoundTrip(TextureFormat_ETC2_RGB, 1, 1, false, false);
+
+        MappedFile mapped;
+        TextureFile texture;
+        MJ2_CHECK(LoadTextureFile("/nonexistent/mj2image.mj2t", mapped, texture, true) == ImageStatus_OpenFailed);
+    }
+
+    /// WriteTextureFile refuses level tables ParseTextureFile would refuse
+    void TestWriteRejects()
+    {
+        TempFile file;
+        Levels levels(TextureFormat_RGBA8, 8, 4, true);
+
+        // a partial chain
+        MJ2_CHECK(!WriteTextureFile(file.path.c_str(), TextureFormat_RGBA8, levels.levels.data(), 2, true));
+        // a level of the wrong size
+        levels.levels[1].size--;
+        MJ2_CHECK(!WriteTextureFile(file.path.c_str(), TextureFormat_RGBA8, levels.levels.data(),
+                                    (uint32_t)levels.levels.size(), true));
+        levels.levels[1].size++;
+        // a level that does not halve
+        levels.levels[2].width = 3;
+        MJ2_CHECK(!WriteTextureFile(file.path.c_str(), TextureFormat_RGBA8, levels.levels.data(),
+                                    (uint32_t)levels.levels.size(), true));
+        levels.levels[2].width = 2;
+        MJ2_CHECK(!WriteTextureFile(file.path.c_str(), TextureFormat_RGBA8, levels.levels.data(), 0, true));
+        MJ2_CHECK(WriteTextureFile(file.path.c_str(), TextureFormat_RGBA8, levels.levels.data(),
+                                   (uint32_t)levels.levels.size(), true));
+    }
+
+    void TestChecksum()
+    {
+        const std::vector<uint8_t> good = WriteFile(TextureFormat_RGBA8, 16, 16, true, true);
+        MJ2_CHECK(Parse(good) == ImageStatus_Ok);
+
+        // a bit of the first level, and the last byte of the file
+        std::vector<uint8_t> bad = good;
+        bad[ReadU32(good, kHeaderSize) + 5] ^= 0x10;
+        MJ2_CHECK(Parse(bad) == ImageStatus_BadChecksum);
+        MJ2_CHECK(Parse(bad, false) == ImageStatus_Ok);
+        bad = good;
+        bad.back() ^= 1;
+        MJ2_CHECK(Parse(bad) == ImageStatus_BadChecksum);
+
+        // the checksum itself
+        bad = good;
+        bad[kChecksumOffset] ^= 0x80;
+        MJ2_CHECK(Parse(bad) == ImageStatus_BadChecksum);
+
+        // without the flag there is nothing to compare
+        const std::vector<uint8_t> unchecked = WriteFile(TextureFormat_RGBA8, 16, 16, true, false);
+        bad = unchecked;
+        bad.back() ^= 1;
+        MJ2_CHECK(Parse(bad) == ImageStatus_Ok);
+    }
+
+    void TestHeaderRejects()
+    {
+        const std::vector<uint8_t> good = WriteFile(TextureFormat_RGB8, 8, 8, true, true);
+
+        std::vector<uint8_t> bad = good;
+        bad[0] = 'X';
+        MJ2_CHECK(Parse(bad) == ImageStatus_BadSignature);
+        bad = good;
+        bad[3] = 't';
+        MJ2_CHECK(Parse(bad) == ImageStatus_BadSignature);
+
+        bad = good;
+        bad[kVersionOffset] = 2;
+        MJ2_CHECK(Parse(bad) == ImageStatus_Unsupported);
+        bad = good;
+        bad[kVersionOffset] = 0;
+        MJ2_CHECK(Parse(bad) == ImageStatus_Unsupported);
+
+        // an unknown format, a level count that is neither 1 nor the chain
+        bad = good;
+        WriteU32(bad, 8, TextureFormat_Count);
+        MJ2_CHECK(Parse(bad) == ImageStatus_Unsupported);
+        bad = good;
+        WriteU32(bad, 20, 2);
+        MJ2_CHECK(Parse(bad) == ImageStatus_BadHeader);
+
+        // shorter than a header
+        MJ2_CHECK(Parse(std::vector<uint8_t>(good.begin(), good.begin() + kHeaderSize - 1)) == ImageStatus_Truncated);
+    }
+
+    void TestLevelTableRejects()
+    {
+        const std::vector<uint8_t> good = WriteFile(TextureFormat_RGBA8, 8, 8, true, true);
+        const uint32_t levelCount = ReadU32(good, 20);
+        MJ2_CHECK(levelCount == 4);
+        const size_t tableEnd = kHeaderSize + levelCount * kLevelEntrySize;
+        const size_t lastEntry = tableEnd - kLevelEntrySize;
+
+        // the file ends inside the level table
+        MJ2_CHECK(Parse(std::vector<uint8_t>(good.begin(), good.begin() + tableEnd - 1)) == ImageStatus_Truncated);
+        MJ2_CHECK(Parse(std::vector<uint8_t>(good.begin(), good.begin() + kHeaderSize + 3)) == ImageStatus_Truncated);
+
+        // or inside the last level
+        MJ2_CHECK(Parse(std::vector<uint8_t>(good.begin(), good.end() - 1)) == ImageStatus_Truncated);
+
+        // an aligned offset past the end, and one whose level runs past it
+        std::vector<uint8_t> bad = good;
+        WriteU32(bad, lastEntry, (uint32_t)((good.size() + TextureFilePayloadAlignment) & ~(TextureFilePayloadAlignment - 1)));
+        MJ2_CHECK(Parse(bad) == ImageStatus_Truncated);
+        bad = good;
+        WriteU32(bad, kHeaderSize, (uint32_t)(ReadU32(good, lastEntry) & ~(TextureFilePayloadAlignment - 1)));
+        MJ2_CHECK(Parse(bad) == ImageStatus_Truncated);
+        // offset + size wrapping 32 bits
+        bad = good;
+        WriteU32(bad, lastEntry, 0xFFFFFFC0u);
+        MJ2_CHECK(Parse(bad) == ImageStatus_Truncated);
+
+        // off the payload alignment, and pointing back into the header
+        bad = good;
+        WriteU32(bad, kHeaderSize, ReadU32(good, kHeaderSize) + 4);
+        MJ2_CHECK(Parse(bad) == ImageStatus_BadHeader);
+        bad = good;
+        WriteU32(bad, lastEntry, 0);
+        MJ2_CHECK(Parse(bad) == ImageStatus_BadHeader);
+
+        // a level size or width that does not match the chain
+        bad = good;
+        WriteU32(bad, kHeaderSize + 4, ReadU32(good, kHeaderSize + 4) - 1);
+        MJ2_CHECK(Parse(bad) == ImageStatus_BadHeader);
+        bad = good;
+        WriteU32(bad, lastEntry + 8, 2);
+        MJ2_CHECK(Parse(bad) == ImageStatus_BadHeader);
+
+        // the largest RGBA8 level is 2^32 bytes, 0 in a 32 bit size_t: a file declaring
+        // size 0 for it must not get a level backed by nothing
+        const uint32_t largest = 32768;
+        MJ2_CHECK(TextureLevelBytes(TextureFormat_RGBA8, largest, largest) == (uint64_t)1 << 32);
+        std::vector<uint8_t> huge(good.begin(), good.begin() + kHeaderSize + kLevelEntrySize);
+        huge.resize(TextureFilePayloadAlignment);
+        WriteU32(huge, 8, TextureFormat_RGBA8);
+        WriteU32(huge, 12, largest);
+        WriteU32(huge, 16, largest);
+        WriteU32(huge, 20, 1);
+        WriteU32(huge, 24, 0);
+        WriteU32(huge, kHeaderSize, (uint32_t)TextureFilePayloadAlignment);
+        WriteU32(huge, kHeaderSize + 4, 0);
+        WriteU32(huge, kHeaderSize + 8, largest);
+        WriteU32(huge, kHeaderSize + 12, largest);
+        MJ2_CHECK(Parse(huge) == ImageStatus_BadHeader);
+    }
+
+} // namespace
+
+int main()
+{
+    TestRoundTrip();
+    TestWriteRejects();
+    TestChecksum();
+    TestHeaderRejects();
+    TestLevelTableRejects();
+    return CheckResult("TextureFileTest");
+}
@@ -0,0 +1,287 @@
+/////
+// The loader and what it runs on: MPSCQueue with several producers and one consumer,
+// losing and duplicating nothing and keeping each producer's order; ThreadPool::ParallelFor
+// nested inside pool tasks, down to a pool of one; and a TextureLoader destroyed with
+// loads still queued and running, which has to wait for them and delete every one.
+// Meant to run clean under TSan as well.
+/////
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "../MPSCQueue.hpp"
+#include "../PixelBufferPool.hpp"
+#include "../TextureLoader.hpp"
+#include "../ThreadPool.hpp"
+#include "../../math/tests/Check.hpp"
+
+using namespace mj2;
+using namespace mj2::test;
+
+namespace {
+
+    struct Item : public MPSCNode {
+    public:
+        uint32_t producer;
+        uint32_t sequence;
+    };
+
+    void TestQueue()
+    {
+        const uint32_t producerCount = 4;
+        const uint32_t perProducer = 50000;
+        std::vector<Item> items(producerCount * perProducer);
+        MPSCQueue<Item> queue;
+        MJ2_CHECK(queue.Pop() == nullptr);
+
+        std::atomic<uint32_t> ready(0);
+        std::vector<std::thread> producers;
+        for (uint32_t p = 0; p < producerCount; p++) {
+            producers.emplace_back([&items, &queue, &ready, p]() {
+                // all start together so the pushes interleave
+                ready.fetch_add(1);
+                while (ready.load() < producerCount) {
+                    std::this_thread::yield();
+                }
+                for (uint32_t i = 0; i < perProducer; i++) {
+                    Item& item = items[p * perProducer + i];
+                    item.producer = p;
+                    item.sequence = i;
+                    queue.Push(&item);
+                }
+            });
+        }
+
+        // Pop can miss a push in progress, so keep polling until everything came out
+        std::vector<uint8_t> seen(items.size(), 0);
+        std::vector<uint32_t> nextSequence(producerCount, 0);
+        bool unique = true;
+        bool ordered = true;
+        size_t popped = 0;
+        while (popped < items.size()) {
+            Item* item = queue.Pop();
+            if (!item) {
+                std::this_thread::yield();
+                continue;
+            }
+            const size_t index = (size_t)(item - items.data());
+            unique = unique && index < items.size() && seen[index]++ == 0;
+            ordered = ordered && item->sequence == nextSequence[item->producer]++;
+            popped++;
+        }
+        for (std::thread& producer : producers) {
+            producer.join();
+        }
+        MJ2_CHECK(unique);
+        MJ2_CHECK(ordered);
+        MJ2_CHECK(queue.Pop() == nullptr);
+
+        // and still works once drained, through the stub again
+        queue.Push(&items[0]);
+        queue.Push(&items[1]);
+        MJ2_CHECK(queue.Pop() == &items[0]);
+        MJ2_CHECK(queue.Pop() == &items[1]);
+        MJ2_CHECK(queue.Pop() == nullptr);
+    }
+
+    /// every index of [0, count) visited exactly once
+    bool AllOnce(const std::vector<std::atomic<uint32_t> >& visits)
+    {
+        for (const std::atomic<uint32_t>& visit : visits) {
+            if (visit.load() != 1) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void TestNestedParallelFor(unsigned threadCount)
+    {
+        ThreadPool pool(threadCount);
+        const size_t taskCount = 8;
+        const size_t count = 1000;
+
+        std::vector<std::vector<std::atomic<uint32_t> > > visits(taskCount);
+        std::vector<std::vector<std::atomic<uint32_t> > > innerVisits(taskCount);
+        for (size_t t = 0; t < taskCount; t++) {
+            visits[t] = std::vector<std::atomic<uint32_t> >(count);
+            innerVisits[t] = std::vector<std::atomic<uint32_t> >(count * 4);
+        }
+
+        std::mutex mutex;
+        std::condition_variable finished;
+        size_t done = 0;
+        for (size_t t = 0; t < taskCount; t++) {
+            pool.Submit([&, t]() {
+                // a ParallelFor from a task, with another one inside each band
+                pool.ParallelFor(count, 7, [&, t](size_t begin, size_t end) {
+                    for (size_t i = begin; i < end; i++) {
+                        visits[t][i].fetch_add(1);
+                    }
+                    pool.ParallelFor(4, 1, [&, t, begin, end](size_t innerBegin, size_t innerEnd) {
+                        for (size_t i = innerBegin; i < innerEnd; i++) {
+                            for (size_t j = begin; j < end; j++) {
+                                innerVisits[t][j * 4 + i].fetch_add(1);
+                            }
+                        }
+                    });
+                });
+                std::lock_guard<std::mutex> lock(mutex);
+                done++;
+                finished.notify_all();
+            });
+        }
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            finished.wait(lock, [&]() { return done == taskCount; });
+        }
+
+        for (size_t t = 0; t < taskCount; t++) {
+            MJ2_CHECK(AllOnce(visits[t]));
+            MJ2_CHECK(AllOnce(innerVisits[t]));
+        }
+
+        // from the calling thread too, and the empty and single band cases
+        std::vector<std::atomic<uint32_t> > direct(count);
+        pool.ParallelFor(count, 13, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                direct[i].fetch_add(1);
+            }
+        });
+        MJ2_CHECK(AllOnce(direct));
+        std::atomic<uint32_t> calls(0);
+        pool.ParallelFor(0, 4, [&](size_t, size_t) { calls.fetch_add(1); });
+        MJ2_CHECK(calls.load() == 0);
+        pool.ParallelFor(3, 0, [&](size_t begin, size_t end) { calls.fetch_add((uint32_t)(end - begin)); });
+        MJ2_CHECK(calls.load() == 3);
+    }
+
+    /// BMPs in a temporary directory, removed with it
+    struct BmpFiles {
+    public:
+        BmpFiles()
+        {
+            char name[] = "/tmp/mj2image_textureloader_XXXXXX";
+            if (mkdtemp(name)) {
+                directory = name;
+            }
+        }
+
+        ~BmpFiles()
+        {
+            for (const std::string& path : paths) {
+                remove(path.c_str());
+            }
+            if (!directory.empty()) {
+                rmdir(directory.c_str());
+            }
+        }
+
+        /// 24 bit BI_RGB, bottom-up, a gradient
+        std::string Add(const char* name, uint32_t width, uint32_t height)
+        {
+            const uint32_t rowStride = (width * 3 + 3) & ~3u;
+            const uint32_t imageSize = rowStride * height;
+            std::vector<uint8_t> data(54 + imageSize, 0);
+            data[0] = 'B';
+            data[1] = 'M';
+            PutU32(data, 2, (uint32_t)data.size());
+            PutU32(data, 10, 54);
+            PutU32(data, 14, 40);
+            PutU32(data, 18, width);
+            PutU32(data, 22, height);
+            data[26] = 1;
+            data[28] = 24;
+            PutU32(data, 34, imageSize);
+            for (uint32_t y = 0; y < height; y++) {
+                for (uint32_t x = 0; x < width * 3; x++) {
+                    data[54 + y * rowStride + x] = (uint8_t)(x + y);
+                }
+            }
+
+            const std::string path = directory + "/" + name;
+            FILE* out = fopen(path.c_str(), "wb");
+            if (out) {
+                fwrite(data.data(), 1, data.size(), out);
+                fclose(out);
+                paths.push_back(path);
+            }
+            return path;
+        }
+
+        std::string directory;
+        std::vector<std::string> paths;
+
+    private:
+        static void PutU32(std::vector<uint8_t>& data, size_t at, uint32_t v)
+        {
+            for (int i = 0; i < 4; i++) {
+                data[at + i] = (uint8_t)(v >> (8 * i));
+            }
+        }
+    };
+
+    void TestLoaderDestructor()
+    {
+        BmpFiles files;
+        const std::string paths[] = { files.Add("a.bmp", 256, 256), files.Add("b.bmp", 97, 301),
+                                      files.Add("c.bmp", 640, 8) };
+        const std::string missing = files.directory + "/missing.bmp";
+        const uint32_t requestCount = 120;
+
+        ThreadPool pool(3);
+        PixelBufferPool buffers;
+        {
+            TextureLoader loader(pool, &buffers);
+
+            // one load all the way through first
+            loader.Request(paths[0].c_str(), 1000, true);
+            LoadedImage* first = nullptr;
+            while (!(first = loader.Take())) {
+                std::this_thread::yield();
+            }
+            MJ2_CHECK(first->id == 1000 && first->status == ImageStatus_Ok);
+            MJ2_CHECK(first->mips.LevelCount() == MipChain::FullLevelCount(256, 256));
+            MJ2_CHECK(buffers.Stats().inUseBytes > 0);
+            delete first;
+            MJ2_CHECK(buffers.Stats().inUseBytes == 0);
+            MJ2_CHECK(loader.Pending() == 0);
+
+            // then many, some failing, a few taken and the rest left to the destructor
+            for (uint32_t i = 0; i < requestCount; i++) {
+                loader.Request(i % 10 == 9 ? missing.c_str() : paths[i % 3].c_str(), i, true);
+            }
+            MJ2_CHECK(loader.Pending() > 0);
+            for (int taken = 0; taken < 5;) {
+                if (LoadedImage* loaded = loader.Take()) {
+                    MJ2_CHECK(loaded->id < requestCount);
+                    MJ2_CHECK(loaded->status == (loaded->id % 10 == 9 ? ImageStatus_OpenFailed : ImageStatus_Ok));
+                    delete loaded;
+                    taken++;
+                }
+            }
+        }
+
+        // every load ran and every chain went back to the pool with its image
+        const PixelBufferPoolStats stats = buffers.Stats();
+        MJ2_CHECK(stats.inUseBytes == 0);
+        MJ2_CHECK(stats.acquires == 1 + requestCount - requestCount / 10);
+    }
+
+} // namespace
+
+int main()
+{
+    TestQueue();
+    TestNestedParallelFor(1);
+    TestNestedParallelFor(4);
+    TestLoaderDestructor();
+    return CheckResult("TextureLoaderTest");
+}
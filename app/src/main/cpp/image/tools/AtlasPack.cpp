@@ -0,0 +1,191 @@
+/////
+// Host tool for the asset pipeline: many small BMPs -> atlas pages as .mj2t plus a manifest.
+//
+// usage: atlaspack [--size <w>x<h>] [--padding <n>] [--gutter <n>] [--align <n>] [--rgb]
+//                  [--mips] [--etc1 | --etc2 | --alpha] <out prefix> <in.bmp>...
+//
+//   --size     page size, 1024x1024 by default
+//   --padding  empty texels between sprites, 0 by default
+//   --gutter   edge texels repeated around each sprite, 2 by default
+//   --align    sprite cells start on multiples of this, 4 by default (ETC blocks, mip level 2)
+//   --rgb      RGB pages instead of RGBA
+//   --mips     store the full chain of each page
+//   --etc1 / --etc2 / --alpha   compress the pages, see etccompress
+//
+// Writes <prefix>0.mj2t, <prefix>1.mj2t, ... and <prefix>.atlas, one line per sprite:
+//
+//   <in.bmp> <page> <x> <y> <width> <height> <u0> <v0> <u1> <v1>
+//
+// with v in GL order (row 0 at v 0), the same as the pages and RemapUVs.
+/////
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../BmpLoader.hpp"
+#include "../EtcCodec.hpp"
+#include "../MappedFile.hpp"
+#include "../MipChain.hpp"
+#include "../TextureAtlas.hpp"
+#include "../TextureFile.hpp"
+#include "../ThreadPool.hpp"
+
+using namespace mj2;
+
+namespace {
+
+    struct Options {
+    public:
+        AtlasOptions atlas;
+        bool mips = false;
+        bool compressed = false;
+        EtcFormat etcFormat = EtcFormat_ETC1;
+        const char* prefix = nullptr;
+        std::vector<const char*> inputs;
+    };
+
+    int Usage()
+    {
+        fprintf(stderr, "usage: atlaspack [--size <w>x<h>] [--padding <n>] [--gutter <n>] [--align <n>] [--rgb]\n"
+                        "                 [--mips] [--etc1 | --etc2 | --alpha] <out prefix> <in.bmp>...\n");
+        return 2;
+    }
+
+    bool ParseOptions(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; i++) {
+            const bool hasValue = i + 1 < argc;
+            if (strcmp(argv[i], "--size") == 0 && hasValue) {
+                if (sscanf(argv[++i], "%ux%u", &options.atlas.pageWidth, &options.atlas.pageHeight) != 2)
+                    return false;
+            } else if (strcmp(argv[i], "--padding") == 0 && hasValue) {
+                options.atlas.padding = (uint32_t)atoi(argv[++i]);
+            } else if (strcmp(argv[i], "--gutter") == 0 && hasValue) {
+                options.atlas.gutter = (uint32_t)atoi(argv[++i]);
+            } else if (strcmp(argv[i], "--align") == 0 && hasValue) {
+                options.atlas.alignment = (uint32_t)atoi(argv[++i]);
+            } else if (strcmp(argv[i], "--rgb") == 0) {
+                options.atlas.channels = 3;
+            } else if (strcmp(argv[i], "--mips") == 0) {
+                options.mips = true;
+            } else if (strcmp(argv[i], "--etc1") == 0) {
+                options.compressed = true;
+                options.etcFormat = EtcFormat_ETC1;
+            } else if (strcmp(argv[i], "--etc2") == 0) {
+                options.compressed = true;
+                options.etcFormat = EtcFormat_ETC2_RGB;
+            } else if (strcmp(argv[i], "--alpha") == 0) {
+                options.compressed = true;
+                options.etcFormat = EtcFormat_ETC2_RGBA;
+            } else if (argv[i][0] == '-') {
+                return false;
+            } else if (!options.prefix) {
+                options.prefix = argv[i];
+            } else {
+                options.inputs.push_back(argv[i]);
+            }
+        }
+        return options.prefix && !options.inputs.empty() && options.atlas.pageWidth && options.atlas.pageHeight;
+    }
+
+    /// one page as a .mj2t, with its chain and ETC blocks as asked
+    bool WritePage(const Options& options, const AtlasBuilder& atlas, uint32_t index, ThreadPool& pool, const std::string& path)
+    {
+        const AtlasOptions& layout = options.atlas;
+        MipChain mips;
+        MipLevel base = { atlas.Page(index), layout.pageWidth, layout.pageHeight, atlas.PageRowStride() };
+        if (options.mips && mips.Build(base.pixels, base.width, base.height, base.rowStride, layout.channels,
+                                       MipFilter_Box, MipColorSpace_Linear, &pool) != ImageStatus_Ok) {
+            return false;
+        }
+        const uint32_t levelCount = options.mips ? mips.LevelCount() : 1;
+
+        TextureFormat format;
+        if (options.compressed) {
+            format = (TextureFormat)(TextureFormat_ETC1 + options.etcFormat);
+        } else {
+            format = layout.channels == 4 ? TextureFormat_RGBA8 : TextureFormat_RGB8;
+        }
+
+        std::vector<TextureLevel> levels(levelCount);
+        std::vector<std::vector<uint8_t> > blocks(levelCount);
+        for (uint32_t i = 0; i < levelCount; i++) {
+            const MipLevel& mip = options.mips ? mips.Level(i) : base;
+            levels[i].width = mip.width;
+            levels[i].height = mip.height;
+            levels[i].size = (size_t)TextureLevelBytes(format, mip.width, mip.height);
+            levels[i].data = mip.pixels;
+            if (options.compressed) {
+                blocks[i].resize(levels[i].size);
+                if (EncodeEtcImage(blocks[i].data(), mip.pixels, mip.width, mip.height, mip.rowStride, layout.channels,
+                                   options.etcFormat, EtcQuality_High, &pool) != ImageStatus_Ok) {
+                    return false;
+                }
+                levels[i].data = blocks[i].data();
+            }
+        }
+        return WriteTextureFile(path.c_str(), format, levels.data(), levelCount, true);
+    }
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        return Usage();
+    }
+
+    // every input stays mapped until the pages are built
+    std::vector<std::unique_ptr<MappedFile> > files;
+    AtlasBuilder atlas(options.atlas);
+    for (const char* input : options.inputs) {
+        files.emplace_back(new MappedFile());
+        BmpImage image;
+        const ImageStatus status = LoadBmp(input, *files.back(), image);
+        if (status != ImageStatus_Ok) {
+            fprintf(stderr, "%s: %s\n", input, ImageStatusString(status));
+            return 1;
+        }
+        ConvertBmpToGL(image);
+        atlas.Add(image.pixels, image.width, image.height, image.rowStride, image.bitsPerPixel / 8);
+    }
+
+    if (atlas.Build() != ImageStatus_Ok) {
+        fprintf(stderr, "a sprite does not fit a %ux%u page\n", options.atlas.pageWidth, options.atlas.pageHeight);
+        return 1;
+    }
+
+    ThreadPool pool(0);
+    for (uint32_t page = 0; page < atlas.PageCount(); page++) {
+        const std::string path = std::string(options.prefix) + std::to_string(page) + ".mj2t";
+        if (!WritePage(options, atlas, page, pool, path)) {
+            fprintf(stderr, "%s: cannot write\n", path.c_str());
+            return 1;
+        }
+        printf("%s: %ux%u, %.1f%% used\n", path.c_str(), options.atlas.pageWidth, options.atlas.pageHeight,
+               atlas.PageOccupancy(page) * 100.0f);
+    }
+
+    const std::string manifestPath = std::string(options.prefix) + ".atlas";
+    FILE* manifest = fopen(manifestPath.c_str(), "w");
+    if (!manifest) {
+        fprintf(stderr, "%s: cannot write\n", manifestPath.c_str());
+        return 1;
+    }
+    for (uint32_t i = 0; i < atlas.SpriteCount(); i++) {
+        const AtlasSprite& sprite = atlas.Sprite(i);
+        fprintf(manifest, "%s %u %u %u %u %u %.8f %.8f %.8f %.8f\n", options.inputs[i], sprite.page, sprite.x, sprite.y,
+                sprite.width, sprite.height, sprite.u0, sprite.v0, sprite.u1, sprite.v1);
+    }
+    if (fclose(manifest) != 0) {
+        fprintf(stderr, "%s: cannot write\n", manifestPath.c_str());
+        return 1;
+    }
+    printf("%s: %u sprites on %u pages\n", manifestPath.c_str(), atlas.SpriteCount(), atlas.PageCount());
+    return 0;
+}
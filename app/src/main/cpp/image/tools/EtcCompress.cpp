@@ -0,0 +1,159 @@
+/////
+// Host tool for the asset pipeline: BMP -> PKM with ETC1 or ETC2 blocks.
+//
+// usage: etccompress [--etc2] [--alpha] [--fast] [--threads <n>] [--psnr] <in.bmp> <out.pkm>
+//
+//   --etc2     ETC2 RGB (planar mode for gradients), needs an ES 3 device
+//   --alpha    ETC2 RGBA with EAC alpha, implies --etc2
+//   --fast     skip the base color search, for quick iteration
+//   --threads  pool workers next to the main thread, 0 (default) is one per core less one
+//   --psnr     decode the result and print the PSNR against the source
+//
+// Blocks are encoded in parallel. Rows are stored in GL order (bottom row first),
+// the same as the BMP path uploads them.
+/////
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "../BmpLoader.hpp"
+#include "../EtcCodec.hpp"
+#include "../MappedFile.hpp"
+#include "../PkmFile.hpp"
+#include "../ThreadPool.hpp"
+
+using namespace mj2;
+
+namespace {
+
+    struct Options {
+    public:
+        EtcFormat format = EtcFormat_ETC1;
+        EtcQuality quality = EtcQuality_High;
+        unsigned threads = 0;
+        bool psnr = false;
+        const char* input = nullptr;
+        const char* output = nullptr;
+    };
+
+    int Usage()
+    {
+        fprintf(stderr, "usage: etccompress [--etc2] [--alpha] [--fast] [--threads <n>] [--psnr] <in.bmp> <out.pkm>\n");
+        return 2;
+    }
+
+    bool ParseOptions(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; i++) {
+            if (strcmp(argv[i], "--etc2") == 0) {
+                if (options.format == EtcFormat_ETC1)
+                    options.format = EtcFormat_ETC2_RGB;
+            } else if (strcmp(argv[i], "--alpha") == 0) {
+                options.format = EtcFormat_ETC2_RGBA;
+            } else if (strcmp(argv[i], "--fast") == 0) {
+                options.quality = EtcQuality_Fast;
+            } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+                options.threads = (unsigned)atoi(argv[++i]);
+            } else if (strcmp(argv[i], "--psnr") == 0) {
+                options.psnr = true;
+            } else if (argv[i][0] == '-') {
+                return false;
+            } else if (!options.input) {
+                options.input = argv[i];
+            } else if (!options.output) {
+                options.output = argv[i];
+            } else {
+                return false;
+            }
+        }
+        return options.input && options.output;
+    }
+
+    /// PSNR over the channels the format stores, edge blocks clipped to the image
+    double ComputePsnr(const std::vector<uint8_t>& blocks, const BmpImage& image, EtcFormat format)
+    {
+        const uint32_t channels = image.bitsPerPixel / 8;
+        const uint32_t compared = format == EtcFormat_ETC2_RGBA ? 4 : 3;
+        const size_t blocksX = (image.width + 3) / 4;
+        const size_t blockBytes = EtcBlockBytes(format);
+
+        double squared = 0.0;
+        uint8_t rgba[64];
+        for (size_t by = 0; by < (image.height + 3) / 4; by++) {
+            for (size_t bx = 0; bx < blocksX; bx++) {
+                DecodeEtcBlock(rgba, &blocks[(by * blocksX + bx) * blockBytes], format);
+                for (uint32_t y = 0; y < 4 && by * 4 + y < image.height; y++) {
+                    for (uint32_t x = 0; x < 4 && bx * 4 + x < image.width; x++) {
+                        const uint8_t* src = image.pixels + (by * 4 + y) * image.rowStride + (bx * 4 + x) * channels;
+                        for (uint32_t c = 0; c < compared; c++) {
+                            const int reference = c < channels ? src[c] : 255;
+                            const double d = rgba[(y * 4 + x) * 4 + c] - reference;
+                            squared += d * d;
+                        }
+                    }
+                }
+            }
+        }
+
+        const double mse = squared / ((double)image.width * image.height * compared);
+        return mse == 0.0 ? INFINITY : 10.0 * log10(255.0 * 255.0 / mse);
+    }
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        return Usage();
+    }
+
+    MappedFile file;
+    BmpImage image;
+    ImageStatus status = LoadBmp(options.input, file, image);
+    if (status != ImageStatus_Ok) {
+        fprintf(stderr, "%s: %s\n", options.input, ImageStatusString(status));
+        return 1;
+    }
+    if (image.width > 65535 || image.height > 65535) {
+        fprintf(stderr, "%s: %ux%u is too large for PKM\n", options.input, image.width, image.height);
+        return 1;
+    }
+    ConvertBmpToGL(image);
+
+    ThreadPool pool(options.threads);
+    std::vector<uint8_t> blocks(EtcImageBytes(options.format, image.width, image.height));
+
+    const auto start = std::chrono::steady_clock::now();
+    status = EncodeEtcImage(blocks.data(), image.pixels, image.width, image.height, image.rowStride, image.bitsPerPixel / 8,
+                            options.format, options.quality, &pool);
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (status != ImageStatus_Ok) {
+        fprintf(stderr, "%s: %s\n", options.input, ImageStatusString(status));
+        return 1;
+    }
+
+    uint8_t header[PkmHeaderSize];
+    WritePkmHeader(header, options.format, image.width, image.height);
+    FILE* out = fopen(options.output, "wb");
+    const bool written = out && fwrite(header, 1, sizeof(header), out) == sizeof(header) &&
+                         fwrite(blocks.data(), 1, blocks.size(), out) == blocks.size();
+    if (!out || fclose(out) != 0 || !written) {
+        fprintf(stderr, "%s: cannot write\n", options.output);
+        return 1;
+    }
+
+    static const char* formatNames[] = { "ETC1", "ETC2 RGB", "ETC2 RGBA" };
+    printf("%s: %ux%u %s, %zu bytes, %.1f ms (%.1f Mpixel/s, %u threads)",
+           options.output, image.width, image.height, formatNames[options.format], blocks.size() + sizeof(header),
+           ms, (double)image.width * image.height / (ms * 1000.0), pool.ThreadCount() + 1);
+    if (options.psnr) {
+        printf(", PSNR %.2f dB", ComputePsnr(blocks, image, options.format));
+    }
+    printf("\n");
+    return 0;
+}
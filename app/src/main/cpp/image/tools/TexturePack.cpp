@@ -0,0 +1,181 @@
+/////
+// Host tool for the asset pipeline: BMP -> .mj2t, the container TextureFile.hpp reads.
+//
+// usage: texturepack [--mips] [--kaiser] [--srgb] [--etc1 | --etc2 | --alpha] [--fast]
+//                    [--no-checksum] [--threads <n>] <in.bmp> <out.mj2t>
+//
+//   --mips         store the full chain down to 1 x 1
+//   --kaiser       Kaiser filter for the chain instead of the 2x2 box
+//   --srgb         filter in linear light, for color textures authored in sRGB
+//   --etc1         ETC1 blocks, ES 2 with GL_OES_compressed_ETC1_RGB8_texture
+//   --etc2         ETC2 RGB blocks, ES 3
+//   --alpha        ETC2 RGBA blocks with EAC alpha, ES 3
+//   --fast         skip the ETC base color search
+//   --no-checksum  leave the CRC out, the runtime then skips the verification pass
+//   --threads      pool workers next to the main thread, 0 (default) is one per core less one
+//
+// Without a compressed format 24 bit BMPs are stored as RGB8 and 32 bit ones as RGBA8.
+// Everything the runtime would do on load (BGR swizzle, row flip, mip filtering, ETC
+// encoding) happens here once.
+/////
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "../BmpLoader.hpp"
+#include "../EtcCodec.hpp"
+#include "../MappedFile.hpp"
+#include "../MipChain.hpp"
+#include "../TextureFile.hpp"
+#include "../ThreadPool.hpp"
+
+using namespace mj2;
+
+namespace {
+
+    struct Options {
+    public:
+        bool mips = false;
+        MipFilter filter = MipFilter_Box;
+        MipColorSpace colorSpace = MipColorSpace_Linear;
+        bool compressed = false;
+        EtcFormat etcFormat = EtcFormat_ETC1;
+        EtcQuality quality = EtcQuality_High;
+        bool checksum = true;
+        unsigned threads = 0;
+        const char* input = nullptr;
+        const char* output = nullptr;
+    };
+
+    int Usage()
+    {
+        fprintf(stderr, "usage: texturepack [--mips] [--kaiser] [--srgb] [--etc1 | --etc2 | --alpha] [--fast]\n"
+                        "                   [--no-checksum] [--threads <n>] <in.bmp> <out.mj2t>\n");
+        return 2;
+    }
+
+    bool ParseOptions(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; i++) {
+            if (strcmp(argv[i], "--mips") == 0) {
+                options.mips = true;
+            } else if (strcmp(argv[i], "--kaiser") == 0) {
+                options.filter = MipFilter_Kaiser;
+            } else if (strcmp(argv[i], "--srgb") == 0) {
+                options.colorSpace = MipColorSpace_SRGB;
+            } else if (strcmp(argv[i], "--etc1") == 0) {
+                options.compressed = true;
+                options.etcFormat = EtcFormat_ETC1;
+            } else if (strcmp(argv[i], "--etc2") == 0) {
+                options.compressed = true;
+                options.etcFormat = EtcFormat_ETC2_RGB;
+            } else if (strcmp(argv[i], "--alpha") == 0) {
+                options.compressed = true;
+                options.etcFormat = EtcFormat_ETC2_RGBA;
+            } else if (strcmp(argv[i], "--fast") == 0) {
+                options.quality = EtcQuality_Fast;
+            } else if (strcmp(argv[i], "--no-checksum") == 0) {
+                options.checksum = false;
+            } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+                options.threads = (unsigned)atoi(argv[++i]);
+            } else if (argv[i][0] == '-') {
+                return false;
+            } else if (!options.input) {
+                options.input = argv[i];
+            } else if (!options.output) {
+                options.output = argv[i];
+            } else {
+                return false;
+            }
+        }
+        return options.input && options.output;
+    }
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        return Usage();
+    }
+
+    MappedFile file;
+    BmpImage image;
+    ImageStatus status = LoadBmp(options.input, file, image);
+    if (status != ImageStatus_Ok) {
+        fprintf(stderr, "%s: %s\n", options.input, ImageStatusString(status));
+        return 1;
+    }
+    ConvertBmpToGL(image);
+
+    const auto start = std::chrono::steady_clock::now();
+    ThreadPool pool(options.threads);
+    const uint32_t channels = image.bitsPerPixel / 8;
+
+    // without --mips the base level is the only one and no chain is built
+    MipChain mips;
+    MipLevel base;
+    base.pixels = image.pixels;
+    base.width = image.width;
+    base.height = image.height;
+    base.rowStride = image.rowStride;
+    if (options.mips) {
+        status = mips.Build(image.pixels, image.width, image.height, image.rowStride, channels, options.filter,
+                            options.colorSpace, &pool);
+        if (status != ImageStatus_Ok) {
+            fprintf(stderr, "%s: %s\n", options.input, ImageStatusString(status));
+            return 1;
+        }
+    }
+    const uint32_t levelCount = options.mips ? mips.LevelCount() : 1;
+
+    TextureFormat format;
+    if (options.compressed) {
+        format = (TextureFormat)(TextureFormat_ETC1 + options.etcFormat);
+    } else {
+        format = channels == 4 ? TextureFormat_RGBA8 : TextureFormat_RGB8;
+    }
+
+    std::vector<TextureLevel> levels(levelCount);
+    std::vector<std::vector<uint8_t> > blocks(levelCount);
+    for (uint32_t i = 0; i < levelCount; i++) {
+        const MipLevel& mip = options.mips ? mips.Level(i) : base;
+        TextureLevel& level = levels[i];
+        level.width = mip.width;
+        level.height = mip.height;
+        level.size = (size_t)TextureLevelBytes(format, mip.width, mip.height);
+
+        if (options.compressed) {
+            blocks[i].resize(level.size);
+            status = EncodeEtcImage(blocks[i].data(), mip.pixels, mip.width, mip.height, mip.rowStride, channels,
+                                    options.etcFormat, options.quality, &pool);
+            if (status != ImageStatus_Ok) {
+                fprintf(stderr, "%s: %s\n", options.input, ImageStatusString(status));
+                return 1;
+            }
+            level.data = blocks[i].data();
+        } else {
+            // BMP rows and mip rows are both padded to 4 bytes already
+            level.data = mip.pixels;
+        }
+    }
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    if (!WriteTextureFile(options.output, format, levels.data(), levelCount, options.checksum)) {
+        fprintf(stderr, "%s: cannot write\n", options.output);
+        return 1;
+    }
+
+    static const char* formatNames[] = { "RGB8", "RGBA8", "ETC1", "ETC2 RGB", "ETC2 RGBA" };
+    size_t bytes = 0;
+    for (uint32_t i = 0; i < levelCount; i++) {
+        bytes += levels[i].size;
+    }
+    printf("%s: %ux%u %s, %u levels, %zu payload bytes, %.1f ms\n", options.output, image.width, image.height,
+           formatNames[format], levelCount, bytes, ms);
+    return 0;
+}
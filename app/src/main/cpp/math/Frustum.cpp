@@ -0,0 +1,161 @@
+#include "Frustum.hpp"
+
+#include "Matrix.hpp"
+#include "SIMD_Dispatch.hpp"
+
+namespace mj2
+{
+    //-------------------------------------------------------------
+    // Frustum
+    //-------------------------------------------------------------
+    Frustum Frustum::FromMatrix(const Matrix4x4& viewProjection)
+    {
+        const float (*m)[4] = viewProjection.m;
+        // clip component j is column j of the matrix
+        static const float sign[Plane_Count] = { 1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f };
+        static const int column[Plane_Count] = { 0, 0, 1, 1, 2, 2 };
+
+        Frustum frustum;
+        for (int p = 0; p < Plane_Count; p++) {
+            float plane[4];
+            for (int i = 0; i < 4; i++) {
+                plane[i] = m[i][3] + sign[p] * m[i][column[p]];
+            }
+
+            const float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+            const float scale = length > 0.0f ? 1.0f / length : 0.0f;
+            for (int i = 0; i < 4; i++) {
+                frustum.planes[p][i] = plane[i] * scale;
+            }
+        }
+        return frustum;
+    }
+
+    bool Frustum::TestSphere(float x, float y, float z, float radius) const
+    {
+        for (int p = 0; p < Plane_Count; p++) {
+            if (planes[p][0] * x + planes[p][1] * y + planes[p][2] * z + planes[p][3] < -radius)
+                return false;
+        }
+        return true;
+    }
+
+    bool Frustum::TestAABB(float centerX, float centerY, float centerZ, float extentX, float extentY, float extentZ) const
+    {
+        for (int p = 0; p < Plane_Count; p++) {
+            const float distance = planes[p][0] * centerX + planes[p][1] * centerY + planes[p][2] * centerZ + planes[p][3];
+            const float radius = std::fabs(planes[p][0]) * extentX + std::fabs(planes[p][1]) * extentY + std::fabs(planes[p][2]) * extentZ;
+            if (distance < -radius)
+                return false;
+        }
+        return true;
+    }
+
+    //-------------------------------------------------------------
+    // culling kernels
+    //-------------------------------------------------------------
+    size_t CullSpheresTail(const Frustum& frustum, const SphereStream& spheres, size_t first, size_t count, uint32_t* visibleIndices, size_t written)
+    {
+        for (size_t i = first; i < count; i++) {
+            if (frustum.TestSphere(spheres.x[i], spheres.y[i], spheres.z[i], spheres.radius[i]))
+                visibleIndices[written++] = (uint32_t)i;
+        }
+        return written;
+    }
+
+    size_t CullAABBsTail(const Frustum& frustum, const AABBStream& boxes, size_t first, size_t count, uint32_t* visibleIndices, size_t written)
+    {
+        for (size_t i = first; i < count; i++) {
+            if (frustum.TestAABB(boxes.centerX[i], boxes.centerY[i], boxes.centerZ[i], boxes.extentX[i], boxes.extentY[i], boxes.extentZ[i]))
+                visibleIndices[written++] = (uint32_t)i;
+        }
+        return written;
+    }
+
+    /// append base + lane for every set bit, branch free, out needs room for 4 entries past written
+    static inline size_t CompactIndices4(uint32_t* out, size_t written, uint32_t base, int mask)
+    {
+        out[written] = base + 0;
+        written += (mask >> 0) & 1;
+        out[written] = base + 1;
+        written += (mask >> 1) & 1;
+        out[written] = base + 2;
+        written += (mask >> 2) & 1;
+        out[written] = base + 3;
+        written += (mask >> 3) & 1;
+        return written;
+    }
+
+    size_t CullSpheresSIMD4(const Frustum& frustum, const SphereStream& spheres, size_t count, uint32_t* visibleIndices)
+    {
+        const VectorSIMD zero = VectorSplat(0.0f);
+        size_t written = 0;
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            const VectorSIMD x = VectorLoad4fUnaligned(spheres.x + i);
+            const VectorSIMD y = VectorLoad4fUnaligned(spheres.y + i);
+            const VectorSIMD z = VectorLoad4fUnaligned(spheres.z + i);
+            const VectorSIMD r = VectorLoad4fUnaligned(spheres.radius + i);
+
+            VectorSIMD inside = VectorCompareGE(zero, zero);
+            for (int p = 0; p < Frustum::Plane_Count; p++) {
+                // distance + radius >= 0
+                VectorSIMD distance = VectorAdd(r, VectorSplat(frustum.planes[p][3]));
+                distance = VectorMultiplyAdd(x, VectorSplat(frustum.planes[p][0]), distance);
+                distance = VectorMultiplyAdd(y, VectorSplat(frustum.planes[p][1]), distance);
+                distance = VectorMultiplyAdd(z, VectorSplat(frustum.planes[p][2]), distance);
+                inside = VectorAnd(inside, VectorCompareGE(distance, zero));
+            }
+
+            // written <= i, so the 4 scratch stores stay below count
+            written = CompactIndices4(visibleIndices, written, (uint32_t)i, VectorMoveMask(inside));
+        }
+
+        return CullSpheresTail(frustum, spheres, i, count, visibleIndices, written);
+    }
+
+    size_t CullAABBsSIMD4(const Frustum& frustum, const AABBStream& boxes, size_t count, uint32_t* visibleIndices)
+    {
+        const VectorSIMD zero = VectorSplat(0.0f);
+        size_t written = 0;
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            const VectorSIMD x = VectorLoad4fUnaligned(boxes.centerX + i);
+            const VectorSIMD y = VectorLoad4fUnaligned(boxes.centerY + i);
+            const VectorSIMD z = VectorLoad4fUnaligned(boxes.centerZ + i);
+            const VectorSIMD ex = VectorLoad4fUnaligned(boxes.extentX + i);
+            const VectorSIMD ey = VectorLoad4fUnaligned(boxes.extentY + i);
+            const VectorSIMD ez = VectorLoad4fUnaligned(boxes.extentZ + i);
+
+            VectorSIMD inside = VectorCompareGE(zero, zero);
+            for (int p = 0; p < Frustum::Plane_Count; p++) {
+                const VectorSIMD a = VectorSplat(frustum.planes[p][0]);
+                const VectorSIMD b = VectorSplat(frustum.planes[p][1]);
+                const VectorSIMD c = VectorSplat(frustum.planes[p][2]);
+
+                // distance + projected radius >= 0
+                VectorSIMD distance = VectorMultiplyAdd(x, a, VectorSplat(frustum.planes[p][3]));
+                distance = VectorMultiplyAdd(y, b, distance);
+                distance = VectorMultiplyAdd(z, c, distance);
+                distance = VectorMultiplyAdd(ex, VectorAbs(a), distance);
+                distance = VectorMultiplyAdd(ey, VectorAbs(b), distance);
+                distance = VectorMultiplyAdd(ez, VectorAbs(c), distance);
+                inside = VectorAnd(inside, VectorCompareGE(distance, zero));
+            }
+
+            written = CompactIndices4(visibleIndices, written, (uint32_t)i, VectorMoveMask(inside));
+        }
+
+        return CullAABBsTail(frustum, boxes, i, count, visibleIndices, written);
+    }
+
+    size_t CullSpheres(const Frustum& frustum, const SphereStream& spheres, size_t count, uint32_t* visibleIndices)
+    {
+        return GetSIMDKernels().CullSpheres(frustum, spheres, count, visibleIndices);
+    }
+
+    size_t CullAABBs(const Frustum& frustum, const AABBStream& boxes, size_t count, uint32_t* visibleIndices)
+    {
+        return GetSIMDKernels().CullAABBs(frustum, boxes, count, visibleIndices);
+    }
+}
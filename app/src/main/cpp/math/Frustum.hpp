@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace mj2 {
+
+    struct Matrix4x4;
+
+    /// Bounding spheres as structure-of-arrays streams
+    struct SphereStream {
+    public:
+        const float* x;
+        const float* y;
+        const float* z;
+        const float* radius;
+    };
+
+    /// Axis aligned boxes as center and half extents
+    struct AABBStream {
+    public:
+        const float* centerX;
+        const float* centerY;
+        const float* centerZ;
+        const float* extentX;
+        const float* extentY;
+        const float* extentZ;
+    };
+
+    //-------------------------------------------------------------
+    // Frustum
+    //-------------------------------------------------------------
+    struct Frustum {
+    public:
+        enum Plane
+        {
+            Plane_Left = 0, Plane_Right, Plane_Bottom, Plane_Top, Plane_Near, Plane_Far, Plane_Count
+        };
+
+        /// (a, b, c, d) with unit normals pointing inside: a * x + b * y + c * z + d >= 0
+        alignas(16) float planes[Plane_Count][4];
+
+        ///////////////////////////////////////////////////////////////////////////////
+        // Extract the planes of a view-projection matrix in the layout handed to
+        // glUniformMatrix4fv(..., GL_FALSE, ...): row vectors, clip = v * mat, clip w
+        // in column 3. Clip z is taken as [-w, w]; for a [0, w] projection the near
+        // plane is just conservative. Planes come out in the space v lives in, so a
+        // model-view-projection matrix gives object space planes.
+        //
+        // The Matrix4x4 builders do not all agree on that layout:
+        // - LookAt is row vector, but looks down +z;
+        // - Perspective(fov, width, height, near, far) is row vector, but looks down
+        //   -z (w = -z), so a LookAt view needs z negated in between;
+        // - Perspective(l, r, b, t, n, f) and Perspective(fovY, aspect, n, f) are
+        //   column vector like glFrustum and have to be transposed first.
+        ///////////////////////////////////////////////////////////////////////////////
+        static Frustum FromMatrix(const Matrix4x4& viewProjection);
+
+        bool TestSphere(float x, float y, float z, float radius) const;
+        bool TestAABB(float centerX, float centerY, float centerZ, float extentX, float extentY, float extentZ) const;
+    };
+
+    /// Writes the indices of spheres touching the frustum to visibleIndices, which must
+    /// hold count entries, and returns how many were written. Indices stay in order.
+    size_t CullSpheres(const Frustum& frustum, const SphereStream& spheres, size_t count, uint32_t* visibleIndices);
+
+    /// AABB version of CullSpheres
+    size_t CullAABBs(const Frustum& frustum, const AABBStream& boxes, size_t count, uint32_t* visibleIndices);
+
+} // namespace mj2
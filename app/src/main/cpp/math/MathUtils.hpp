@@ -3,6 +3,18 @@
 #include <cmath>
 #include <cstdio>
 #include <cstring>
+#include <cstdint>
+
+// USE_SIMD is defined by Matrix.hpp, included on its own this header assumes SIMD
+#if !defined(USE_SIMD) || USE_SIMD
+#if defined(__arm__) || defined(__aarch64__)
+#include <arm_neon.h>
+#define MJ2_RSQRT_NEON 1
+#else
+#include <xmmintrin.h>
+#define MJ2_RSQRT_SSE 1
+#endif
+#endif
 
 //#include "Matrix.hpp"
 
@@ -13,6 +25,12 @@ namespace mj2 {
         Axis_X = 0, Axis_Y = 1, Axis_Z = 2
     };
 
+    /// Constructor tag that skips initialisation, for results that get fully overwritten
+    enum NoInit
+    {
+        NoInit_Tag
+    };
+
     template<class T> constexpr T pi = 3.14159265358979323846264338327;
     template<class T> constexpr T two_pi = 6.28318530717958647692528676656;
     template<class T> constexpr T half_pi = pi<T> * 0.5;
@@ -25,10 +43,60 @@ namespace mj2 {
 
     const float  PI_F = 3.14159265358979f;
 
+    /// Accuracy of the reciprocal square root helpers, relative error
+    enum Precision
+    {
+        Precision_Fast = 0,     // hardware estimate, ~4e-4 (~2e-3 for the scalar fallback)
+        Precision_Accurate = 1, // estimate refined by Newton-Raphson, ~1e-6
+        Precision_Exact = 2     // 1 / std::sqrt
+    };
+
+    /// 1/sqrt(f). The hardware estimate is 12 bits on SSE and 8 bits on NEON, so NEON needs
+    /// one more Newton-Raphson step than SSE for the same precision. Without SIMD the estimate
+    /// is the quake 3 bit trick, which needs one more still.
+    static inline float InvSqrt(float f, Precision precision)
+    {
+        if (precision == Precision_Exact) {
+            return 1.0f / std::sqrt(f);
+        }
+#if defined(MJ2_RSQRT_SSE)
+        const float estimate = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(f)));
+        if (precision == Precision_Fast) {
+            return estimate;
+        }
+        return estimate * (1.5f - 0.5f * f * estimate * estimate);
+#elif defined(MJ2_RSQRT_NEON)
+        const float32x2_t value = vdup_n_f32(f);
+        float32x2_t estimate = vrsqrte_f32(value);
+        estimate = vmul_f32(estimate, vrsqrts_f32(vmul_f32(value, estimate), estimate));
+        if (precision == Precision_Accurate) {
+            estimate = vmul_f32(estimate, vrsqrts_f32(vmul_f32(value, estimate), estimate));
+        }
+        return vget_lane_f32(estimate, 0);
+#else
+        uint32_t bits;
+        std::memcpy(&bits, &f, sizeof(bits));
+        bits = 0x5f375a86u - (bits >> 1);
+        float estimate;
+        std::memcpy(&estimate, &bits, sizeof(estimate));
+        const float halfF = 0.5f * f;
+        estimate = estimate * (1.5f - halfF * estimate * estimate);
+        if (precision == Precision_Accurate) {
+            estimate = estimate * (1.5f - halfF * estimate * estimate);
+            estimate = estimate * (1.5f - halfF * estimate * estimate);
+        }
+        return estimate;
+#endif
+    }
+
     static inline float InvSqrt(float f)
     {
-        // TODO: quake 3, neon
-        return std::sqrt(1.0f / f);
+        return InvSqrt(f, Precision_Accurate);
+    }
+
+    static inline float InvSqrtFast(float f)
+    {
+        return InvSqrt(f, Precision_Fast);
     }
 
     struct Range {
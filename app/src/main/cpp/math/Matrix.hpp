@@ -3,6 +3,11 @@
 #include <cstdio>
 #include <cstring>
 
+// Build with -DUSE_SIMD=0 to fall back to the scalar code paths
+#ifndef USE_SIMD
+#define USE_SIMD 1
+#endif
+
 //#include "MathUtils.hpp"
 // SIMD
 #if defined(__arm__) || defined(__aarch64__)
@@ -10,11 +15,10 @@
 #else
 #include "SIMD_SSE.hpp"
 #endif
+#include "SIMD_Matrix.hpp"
 
 #include "MathUtils.hpp"
 
-#define USE_SIMD 1
-
 namespace mj2 {
 
     struct Vector2 {
@@ -136,7 +140,7 @@ namespace mj2 {
         float z;
 
         inline Vector3(){};
-        inline Vector3(float fX, float fY, float fZ);
+        constexpr Vector3(float fX, float fY, float fZ);
         inline Vector3(Vector2& v, float fZ);
 
         inline Vector3 operator-() const
@@ -169,13 +173,13 @@ namespace mj2 {
         inline static Vector3 CrossProduct(const Vector3& Left, const Vector3& Right);
         inline static float DotProduct(const Vector3& Left, const Vector3& Right);
 
-        inline void Normalize();
+        inline void Normalize(Precision precision = Precision_Accurate);
 
         void Print();
         void ToString(char* const str, size_t size);
     };
 
-    inline Vector3::Vector3(float fX, float fY, float fZ)
+    constexpr Vector3::Vector3(float fX, float fY, float fZ)
             : x(fX)
             , y(fY)
             , z(fZ)
@@ -312,12 +316,12 @@ namespace mj2 {
         return Left ^ Right;
     }
 
-    inline void Vector3::Normalize()
+    inline void Vector3::Normalize(Precision precision)
     {
-        float length = sqrt(x * x + y * y + z * z);
-        x /= length;
-        y /= length;
-        z /= length;
+        const float invLength = InvSqrt(x * x + y * y + z * z, precision);
+        x *= invLength;
+        y *= invLength;
+        z *= invLength;
     }
 
     typedef struct Vector4 {
@@ -347,10 +351,19 @@ namespace mj2 {
     public:
         alignas(16) float m[4][4];
 
-        inline Matrix4x4();
+        /// identity
+        constexpr Matrix4x4();
+        /// leaves m uninitialised
+        inline explicit Matrix4x4(NoInit);
         inline Matrix4x4(const float* array);
+        /// row by row
+        constexpr Matrix4x4(float m00, float m01, float m02, float m03,
+                            float m10, float m11, float m12, float m13,
+                            float m20, float m21, float m22, float m23,
+                            float m30, float m31, float m32, float m33);
 
-        inline void SetIdentity();
+        constexpr void SetIdentity();
+        static constexpr Matrix4x4 Identity();
 
         inline Matrix4x4 operator+(const Matrix4x4& other);
         inline Matrix4x4 operator-(const Matrix4x4& other);
@@ -358,20 +371,39 @@ namespace mj2 {
         inline void operator+=(const Matrix4x4& other);
         inline void operator*=(const Matrix4x4& other);
 
+        inline Matrix4x4 Transpose() const;
+        /// General inverse, non-finite or meaningless for a singular matrix
+        inline Matrix4x4 Inverse() const;
+        /// Inverse of an affine matrix, translation either in row 3 (LookAt) or column 3 (Translation)
+        inline Matrix4x4 InverseAffine() const;
+        /// Inverse of rotation + translation only, same layouts as InverseAffine
+        inline Matrix4x4 InverseRigid() const;
+        /// Inverse() into result; false and result untouched when the matrix is singular
+        /// to float precision
+        inline bool Inverse(Matrix4x4& result) const;
+        /// InverseAffine() into result; false and result untouched when the upper 3x3 is singular
+        inline bool InverseAffine(Matrix4x4& result) const;
+        inline float Determinant() const;
+
         static inline Matrix4x4 LookAt(const Vector3& eye, const Vector3& at, const Vector3& up);
         static inline Matrix4x4 Perspective(const float halfFOV, const float width, const float height, const float fNear, const float fFar);
         static inline Matrix4x4 Perspective(float fovY, float aspectRatio, float front, float back);
-        static inline Matrix4x4 Perspective(float l, float r, float b, float t, float n, float f);
-        static inline Matrix4x4 Translation(const Vector3& v);
+        static constexpr Matrix4x4 Perspective(float l, float r, float b, float t, float n, float f);
+        static constexpr Matrix4x4 Translation(const Vector3& v);
+        static constexpr Matrix4x4 Translation(float x, float y, float z);
         static inline Matrix4x4 RotationX(float angleInRad);
         static inline Matrix4x4 RotationY(float angleInRad);
         static inline Matrix4x4 RotationZ(float angleInRad);
+        /// constexpr rotations from a precomputed sine and cosine, sinf/cosf are not constexpr
+        static constexpr Matrix4x4 RotationX(float sine, float cosine);
+        static constexpr Matrix4x4 RotationY(float sine, float cosine);
+        static constexpr Matrix4x4 RotationZ(float sine, float cosine);
 
         void Print();
         void ToString(char* const str, size_t size);
     };
 
-    inline void Matrix4x4::SetIdentity()
+    constexpr void Matrix4x4::SetIdentity()
     {
         m[0][0] = 1;
         m[0][1] = 0;
@@ -391,9 +423,32 @@ namespace mj2 {
         m[3][3] = 1;
     }
 
-    inline Matrix4x4::Matrix4x4()
+    constexpr Matrix4x4::Matrix4x4()
+            : m{ { 1.0f, 0.0f, 0.0f, 0.0f },
+                 { 0.0f, 1.0f, 0.0f, 0.0f },
+                 { 0.0f, 0.0f, 1.0f, 0.0f },
+                 { 0.0f, 0.0f, 0.0f, 1.0f } }
     {
-        SetIdentity();
+    }
+
+    inline Matrix4x4::Matrix4x4(NoInit)
+    {
+    }
+
+    constexpr Matrix4x4::Matrix4x4(float m00, float m01, float m02, float m03,
+                                   float m10, float m11, float m12, float m13,
+                                   float m20, float m21, float m22, float m23,
+                                   float m30, float m31, float m32, float m33)
+            : m{ { m00, m01, m02, m03 },
+                 { m10, m11, m12, m13 },
+                 { m20, m21, m22, m23 },
+                 { m30, m31, m32, m33 } }
+    {
+    }
+
+    constexpr Matrix4x4 Matrix4x4::Identity()
+    {
+        return Matrix4x4();
     }
 
     inline Matrix4x4::Matrix4x4(const float* array)
@@ -403,7 +458,7 @@ namespace mj2 {
 
     inline Matrix4x4 Matrix4x4::operator+(const Matrix4x4& other)
     {
-        Matrix4x4 result;
+        Matrix4x4 result(NoInit_Tag);
         for (int i = 0; i < 4; i++) {
             for (int j = 0; j < 4; j++) {
                 result.m[i][j] = m[i][j] + other.m[i][j];
@@ -414,7 +469,7 @@ namespace mj2 {
 
     inline Matrix4x4 Matrix4x4::operator-(const Matrix4x4& other)
     {
-        Matrix4x4 result;
+        Matrix4x4 result(NoInit_Tag);
         for (int i = 0; i < 4; i++) {
             for (int j = 0; j < 4; j++) {
                 result.m[i][j] = m[i][j] - other.m[i][j];
@@ -425,14 +480,14 @@ namespace mj2 {
 
     inline Matrix4x4 Matrix4x4::operator*(const Matrix4x4& other)
     {
-        Matrix4x4 result;
+        Matrix4x4 result(NoInit_Tag);
 #if USE_SIMD
         MatrixMultiply(&result, this, &other);
 #else
 
         for (int i = 0; i < 4; i++) {
-            float accumulator;
             for (int j = 0; j < 4; j++) {
+                float accumulator = 0.0f;
                 for (int k = 0; k < 4; k++) {
                     accumulator += m[i][k] * other.m[k][j];
                 }
@@ -458,9 +513,154 @@ namespace mj2 {
 #endif
     }
 
+    inline Matrix4x4 Matrix4x4::Transpose() const
+    {
+        Matrix4x4 result(NoInit_Tag);
+#if USE_SIMD
+        MatrixTranspose(&result, this);
+#else
+        for (int i = 0; i < 4; i++) {
+            for (int j = 0; j < 4; j++) {
+                result.m[i][j] = m[j][i];
+            }
+        }
+#endif
+        return result;
+    }
+
+#if !USE_SIMD
+    /// scalar cofactor expansion, 2x2 sub-determinants shared between cofactors
+    inline void MatrixInverseScalar(float result[4][4], const float m[4][4])
+    {
+        const float s0 = m[0][0] * m[1][1] - m[1][0] * m[0][1];
+        const float s1 = m[0][0] * m[1][2] - m[1][0] * m[0][2];
+        const float s2 = m[0][0] * m[1][3] - m[1][0] * m[0][3];
+        const float s3 = m[0][1] * m[1][2] - m[1][1] * m[0][2];
+        const float s4 = m[0][1] * m[1][3] - m[1][1] * m[0][3];
+        const float s5 = m[0][2] * m[1][3] - m[1][2] * m[0][3];
+
+        const float c5 = m[2][2] * m[3][3] - m[3][2] * m[2][3];
+        const float c4 = m[2][1] * m[3][3] - m[3][1] * m[2][3];
+        const float c3 = m[2][1] * m[3][2] - m[3][1] * m[2][2];
+        const float c2 = m[2][0] * m[3][3] - m[3][0] * m[2][3];
+        const float c1 = m[2][0] * m[3][2] - m[3][0] * m[2][2];
+        const float c0 = m[2][0] * m[3][1] - m[3][0] * m[2][1];
+
+        const float invDet = 1.0f / (s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0);
+
+        result[0][0] = ( m[1][1] * c5 - m[1][2] * c4 + m[1][3] * c3) * invDet;
+        result[0][1] = (-m[0][1] * c5 + m[0][2] * c4 - m[0][3] * c3) * invDet;
+        result[0][2] = ( m[3][1] * s5 - m[3][2] * s4 + m[3][3] * s3) * invDet;
+        result[0][3] = (-m[2][1] * s5 + m[2][2] * s4 - m[2][3] * s3) * invDet;
+
+        result[1][0] = (-m[1][0] * c5 + m[1][2] * c2 - m[1][3] * c1) * invDet;
+        result[1][1] = ( m[0][0] * c5 - m[0][2] * c2 + m[0][3] * c1) * invDet;
+        result[1][2] = (-m[3][0] * s5 + m[3][2] * s2 - m[3][3] * s1) * invDet;
+        result[1][3] = ( m[2][0] * s5 - m[2][2] * s2 + m[2][3] * s1) * invDet;
+
+        result[2][0] = ( m[1][0] * c4 - m[1][1] * c2 + m[1][3] * c0) * invDet;
+        result[2][1] = (-m[0][0] * c4 + m[0][1] * c2 - m[0][3] * c0) * invDet;
+        result[2][2] = ( m[3][0] * s4 - m[3][1] * s2 + m[3][3] * s0) * invDet;
+        result[2][3] = (-m[2][0] * s4 + m[2][1] * s2 - m[2][3] * s0) * invDet;
+
+        result[3][0] = (-m[1][0] * c3 + m[1][1] * c1 - m[1][2] * c0) * invDet;
+        result[3][1] = ( m[0][0] * c3 - m[0][1] * c1 + m[0][2] * c0) * invDet;
+        result[3][2] = (-m[3][0] * s3 + m[3][1] * s1 - m[3][2] * s0) * invDet;
+        result[3][3] = ( m[2][0] * s3 - m[2][1] * s1 + m[2][2] * s0) * invDet;
+    }
+#endif
+
+    inline Matrix4x4 Matrix4x4::Inverse() const
+    {
+        Matrix4x4 result(NoInit_Tag);
+#if USE_SIMD
+        MatrixInverse(&result, this);
+#else
+        MatrixInverseScalar(result.m, m);
+#endif
+        return result;
+    }
+
+    inline Matrix4x4 Matrix4x4::InverseAffine() const
+    {
+        Matrix4x4 result(NoInit_Tag);
+#if USE_SIMD
+        MatrixInverseAffine(&result, this);
+#else
+        MatrixInverseScalar(result.m, m);
+#endif
+        return result;
+    }
+
+    /// |det| against Hadamard's bound, the product of the row lengths, so the test does
+    /// not depend on the scale of each row. Rounding in the determinant is a few float
+    /// epsilons of the bound.
+    static const float MatrixSingularThreshold = 1e-5f;
+
+    inline float Matrix4x4::Determinant() const
+    {
+        const float s0 = m[0][0] * m[1][1] - m[1][0] * m[0][1];
+        const float s1 = m[0][0] * m[1][2] - m[1][0] * m[0][2];
+        const float s2 = m[0][0] * m[1][3] - m[1][0] * m[0][3];
+        const float s3 = m[0][1] * m[1][2] - m[1][1] * m[0][2];
+        const float s4 = m[0][1] * m[1][3] - m[1][1] * m[0][3];
+        const float s5 = m[0][2] * m[1][3] - m[1][2] * m[0][3];
+
+        const float c5 = m[2][2] * m[3][3] - m[3][2] * m[2][3];
+        const float c4 = m[2][1] * m[3][3] - m[3][1] * m[2][3];
+        const float c3 = m[2][1] * m[3][2] - m[3][1] * m[2][2];
+        const float c2 = m[2][0] * m[3][3] - m[3][0] * m[2][3];
+        const float c1 = m[2][0] * m[3][2] - m[3][0] * m[2][2];
+        const float c0 = m[2][0] * m[3][1] - m[3][0] * m[2][1];
+
+        return s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+    }
+
+    inline bool Matrix4x4::Inverse(Matrix4x4& result) const
+    {
+        float bound = 1.0f;
+        for (int i = 0; i < 4; i++) {
+            bound *= m[i][0] * m[i][0] + m[i][1] * m[i][1] + m[i][2] * m[i][2] + m[i][3] * m[i][3];
+        }
+        const float det = Determinant();
+        // squared on both sides, no square roots; the negation catches NaN
+        if (!(det * det > MatrixSingularThreshold * MatrixSingularThreshold * bound)) {
+            return false;
+        }
+        result = Inverse();
+        return true;
+    }
+
+    inline bool Matrix4x4::InverseAffine(Matrix4x4& result) const
+    {
+        float bound = 1.0f;
+        for (int i = 0; i < 3; i++) {
+            bound *= m[i][0] * m[i][0] + m[i][1] * m[i][1] + m[i][2] * m[i][2];
+        }
+        const float det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+                          m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+                          m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+        if (!(det * det > MatrixSingularThreshold * MatrixSingularThreshold * bound)) {
+            return false;
+        }
+        result = InverseAffine();
+        return true;
+    }
+
+    inline Matrix4x4 Matrix4x4::InverseRigid() const
+    {
+        Matrix4x4 result(NoInit_Tag);
+#if USE_SIMD
+        MatrixInverseRigid(&result, this);
+#else
+        MatrixInverseScalar(result.m, m);
+#endif
+        return result;
+    }
+
     Matrix4x4 Matrix4x4::LookAt(const Vector3& eye, const Vector3& at, const Vector3& up)
     {
-        Matrix4x4 result;
+        Matrix4x4 result(NoInit_Tag);
 
         Vector3 zAxis = (at - eye);
         zAxis.Normalize();
@@ -488,20 +688,12 @@ namespace mj2 {
     // (left, right, bottom, top, near, far)
     // Note: this is for row-major notation. OpenGL needs transpose it
     ///////////////////////////////////////////////////////////////////////////////
-    Matrix4x4 Matrix4x4::Perspective(float l, float r, float b, float t, float n, float f)
+    constexpr Matrix4x4 Matrix4x4::Perspective(float l, float r, float b, float t, float n, float f)
     {
-        Matrix4x4 result;
-
-        result.m[0][0] = 2 * n / (r - l);
-        result.m[0][2] = (r + l) / (r - l);
-        result.m[1][1] = 2 * n / (t - b);
-        result.m[1][2] = (t + b) / (t - b);
-        result.m[2][2] = -(f + n) / (f - n);
-        result.m[2][3] = -(2 * f * n) / (f - n);
-        result.m[3][2] = -1;
-        result.m[3][3] = 0;
-
-        return result;
+        return Matrix4x4(2 * n / (r - l), 0.0f, (r + l) / (r - l), 0.0f,
+                         0.0f, 2 * n / (t - b), (t + b) / (t - b), 0.0f,
+                         0.0f, 0.0f, -(f + n) / (f - n), -(2 * f * n) / (f - n),
+                         0.0f, 0.0f, -1.0f, 0.0f);
     }
 
     ///////////////////////////////////////////////////////////////////////////////
@@ -520,128 +712,65 @@ namespace mj2 {
 
     Matrix4x4 Matrix4x4::Perspective(const float fov, const float width, const float height, const float zNear, const float zFar)
     {
-        Matrix4x4 result;
         // set the basic projection matrix
-        float scale = 1.0f / tanf(fov * 0.5f * PI_F / 180.0f);
-        result.m[0][0] = scale; // scale the x coordinates of the projected point
-        result.m[1][1] = scale; // scale the y coordinates of the projected point
-        result.m[2][2] = -zFar / (zFar - zNear); // used to remap z to [0,1]
-        result.m[3][2] = -zFar * zNear / (zFar - zNear); // used to remap z [0,1]
-        result.m[2][3] = -1; // set w = -z
-        result.m[3][3] = 0;
+        const float scale = 1.0f / tanf(fov * 0.5f * PI_F / 180.0f);
+        // scale x and y of the projected point, remap z to [0,1] and set w = -z
+        return Matrix4x4(scale, 0.0f, 0.0f, 0.0f,
+                         0.0f, scale, 0.0f, 0.0f,
+                         0.0f, 0.0f, -zFar / (zFar - zNear), -1.0f,
+                         0.0f, 0.0f, -zFar * zNear / (zFar - zNear), 0.0f);
+    }
 
-        return result;
+    constexpr Matrix4x4 Matrix4x4::Translation(float x, float y, float z)
+    {
+        return Matrix4x4(1.0f, 0.0f, 0.0f, x,
+                         0.0f, 1.0f, 0.0f, y,
+                         0.0f, 0.0f, 1.0f, z,
+                         0.0f, 0.0f, 0.0f, 1.0f);
     }
 
-    Matrix4x4 Matrix4x4::Translation(const Vector3& v)
-    {
-        Matrix4x4 result;
-
-        result.m[0][0] = 1.0f;
-        result.m[0][1] = 0.0f;
-        result.m[0][2] = 0.0f;
-        result.m[0][3] = v.x;
-        result.m[1][0] = 0.0f;
-        result.m[1][1] = 1.0f;
-        result.m[1][2] = 0.0f;
-        result.m[1][3] = v.y;
-        result.m[2][0] = 0.0f;
-        result.m[2][1] = 0.0f;
-        result.m[2][2] = 1.0f;
-        result.m[2][3] = v.z;
-        result.m[3][0] = 0.0f;
-        result.m[3][1] = 0.0f;
-        result.m[3][2] = 0.0f;
-        result.m[3][3] = 1.0f;
+    constexpr Matrix4x4 Matrix4x4::Translation(const Vector3& v)
+    {
+        return Translation(v.x, v.y, v.z);
+    }
 
-        return result;
+    constexpr Matrix4x4 Matrix4x4::RotationX(float sine, float cosine)
+    {
+        return Matrix4x4(1.0f, 0.0f, 0.0f, 0.0f,
+                         0.0f, cosine, sine, 0.0f,
+                         0.0f, -sine, cosine, 0.0f,
+                         0.0f, 0.0f, 0.0f, 1.0f);
     }
 
-    Matrix4x4 Matrix4x4::RotationX(float angleInRad)
+    constexpr Matrix4x4 Matrix4x4::RotationY(float sine, float cosine)
     {
-        Matrix4x4 result;
-
-        float fCosine, fSine;
-
-        fCosine = cosf(angleInRad);
-        fSine = sinf(angleInRad);
-
-        result.m[0][0] = 1.0f;
-        result.m[0][1] = 0.0f;
-        result.m[0][2] = 0.0f;
-        result.m[0][3] = 0.0f;
-        result.m[1][0] = 0.0f;
-        result.m[1][1] = fCosine;
-        result.m[1][2] = fSine;
-        result.m[1][3] = 0.0f;
-        result.m[2][0] = 0.0f;
-        result.m[2][1] = -fSine;
-        result.m[2][2] = fCosine;
-        result.m[2][3] = 0.0f;
-        result.m[3][0] = 0.0f;
-        result.m[3][1] = 0.0f;
-        result.m[3][2] = 0.0f;
-        result.m[3][3] = 1.0f;
+        return Matrix4x4(cosine, 0.0f, -sine, 0.0f,
+                         0.0f, 1.0f, 0.0f, 0.0f,
+                         sine, 0.0f, cosine, 0.0f,
+                         0.0f, 0.0f, 0.0f, 1.0f);
+    }
 
-        return result;
+    constexpr Matrix4x4 Matrix4x4::RotationZ(float sine, float cosine)
+    {
+        return Matrix4x4(cosine, sine, 0.0f, 0.0f,
+                         -sine, cosine, 0.0f, 0.0f,
+                         0.0f, 0.0f, 1.0f, 0.0f,
+                         0.0f, 0.0f, 0.0f, 1.0f);
     }
 
-    Matrix4x4 Matrix4x4::RotationY(float angleInRad)
+    Matrix4x4 Matrix4x4::RotationX(float angleInRad)
     {
-        Matrix4x4 result;
-
-        float fCosine, fSine;
-
-        fCosine = cosf(angleInRad);
-        fSine = sinf(angleInRad);
-
-        result.m[0][0] = fCosine;
-        result.m[0][1] = 0.0f;
-        result.m[0][2] = -fSine;
-        result.m[0][3] = 0.0f;
-        result.m[1][0] = 0.0f;
-        result.m[1][1] = 1.0f;
-        result.m[1][2] = 0.0f;
-        result.m[1][3] = 0.0f;
-        result.m[2][0] = fSine;
-        result.m[2][1] = 0.0f;
-        result.m[2][2] = fCosine;
-        result.m[2][3] = 0.0f;
-        result.m[3][0] = 0.0f;
-        result.m[3][1] = 0.0f;
-        result.m[3][2] = 0.0f;
-        result.m[3][3] = 1.0f;
+        return RotationX(sinf(angleInRad), cosf(angleInRad));
+    }
 
-        return result;
+    Matrix4x4 Matrix4x4::RotationY(float angleInRad)
+    {
+        return RotationY(sinf(angleInRad), cosf(angleInRad));
     }
 
     Matrix4x4 Matrix4x4::RotationZ(float angleInRad)
     {
-        Matrix4x4 result;
-
-        float fCosine, fSine;
-
-        fCosine = cosf(angleInRad);
-        fSine = sinf(angleInRad);
-
-        result.m[0][0] = fCosine;
-        result.m[0][1] = fSine;
-        result.m[0][2] = 0.0f;
-        result.m[0][3] = 0.0f;
-        result.m[1][0] = -fSine;
-        result.m[1][1] = fCosine;
-        result.m[1][2] = 0.0f;
-        result.m[1][3] = 0.0f;
-        result.m[2][0] = 0.0f;
-        result.m[2][1] = 0.0f;
-        result.m[2][2] = 1.0f;
-        result.m[2][3] = 0.0f;
-        result.m[3][0] = 0.0f;
-        result.m[3][1] = 0.0f;
-        result.m[3][2] = 0.0f;
-        result.m[3][3] = 1.0f;
-
-        return result;
+        return RotationZ(sinf(angleInRad), cosf(angleInRad));
     }
 
 } // namespace mj2
@@ -0,0 +1,77 @@
+#include "MatrixBatch.hpp"
+
+#include "Matrix.hpp"
+#include "SIMD_Dispatch.hpp"
+
+namespace mj2
+{
+    /// how many matrices ahead the array kernels prefetch, 4 x 64 bytes; never past count,
+    /// where the pointer itself would already be out of the array
+    static const size_t PrefetchDistance = 4;
+
+    void MatrixMultiplyArraySIMD4(float* out, const float* parents, const float* locals, size_t count)
+    {
+        for (size_t i = 0; i < count; i++) {
+            if (i + PrefetchDistance < count) {
+                VectorPrefetch(parents + 16 * (i + PrefetchDistance));
+                VectorPrefetch(locals + 16 * (i + PrefetchDistance));
+            }
+            MatrixMultiply(out + 16 * i, parents + 16 * i, locals + 16 * i);
+        }
+    }
+
+    void MatrixMultiplyHierarchySIMD4(float* out, const float* locals, const int* parentIndices, size_t count)
+    {
+        for (size_t i = 0; i < count; i++) {
+            if (i + PrefetchDistance < count) {
+                VectorPrefetch(locals + 16 * (i + PrefetchDistance));
+            }
+            const int parent = parentIndices[i];
+            if (parent < 0) {
+                std::memcpy(out + 16 * i, locals + 16 * i, 16 * sizeof(float));
+            } else {
+                MatrixMultiply(out + 16 * i, out + 16 * parent, locals + 16 * i);
+            }
+        }
+    }
+
+    void MatrixMultiplyArray(Matrix4x4* out, const Matrix4x4* parents, const Matrix4x4* locals, size_t count)
+    {
+        GetSIMDKernels().MatrixMultiplyArray(&out->m[0][0], &parents->m[0][0], &locals->m[0][0], count);
+    }
+
+    void MatrixMultiplyHierarchy(Matrix4x4* out, const Matrix4x4* locals, const int* parentIndices, size_t count)
+    {
+        GetSIMDKernels().MatrixMultiplyHierarchy(&out->m[0][0], &locals->m[0][0], parentIndices, count);
+    }
+
+    void MatrixInverseArray(Matrix4x4* out, const Matrix4x4* in, size_t count)
+    {
+        for (size_t i = 0; i < count; i++) {
+            if (i + PrefetchDistance < count) {
+                VectorPrefetch(in + i + PrefetchDistance);
+            }
+            MatrixInverse(out + i, in + i);
+        }
+    }
+
+    void MatrixInverseAffineArray(Matrix4x4* out, const Matrix4x4* in, size_t count)
+    {
+        for (size_t i = 0; i < count; i++) {
+            if (i + PrefetchDistance < count) {
+                VectorPrefetch(in + i + PrefetchDistance);
+            }
+            MatrixInverseAffine(out + i, in + i);
+        }
+    }
+
+    void MatrixInverseRigidArray(Matrix4x4* out, const Matrix4x4* in, size_t count)
+    {
+        for (size_t i = 0; i < count; i++) {
+            if (i + PrefetchDistance < count) {
+                VectorPrefetch(in + i + PrefetchDistance);
+            }
+            MatrixInverseRigid(out + i, in + i);
+        }
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+
+namespace mj2 {
+
+    struct Matrix4x4;
+
+    /// out[i] = parents[i] * locals[i] for count matrices. out may alias either input.
+    void MatrixMultiplyArray(Matrix4x4* out, const Matrix4x4* parents, const Matrix4x4* locals, size_t count);
+
+    /// Concatenate a flattened hierarchy: out[i] = out[parentIndices[i]] * locals[i].
+    /// Nodes must be sorted so that parentIndices[i] < i, roots use a negative index
+    /// and get out[i] = locals[i].
+    void MatrixMultiplyHierarchy(Matrix4x4* out, const Matrix4x4* locals, const int* parentIndices, size_t count);
+
+    /// out[i] = in[i].Inverse(), out may alias in
+    void MatrixInverseArray(Matrix4x4* out, const Matrix4x4* in, size_t count);
+
+    /// out[i] = in[i].InverseAffine(), out may alias in
+    void MatrixInverseAffineArray(Matrix4x4* out, const Matrix4x4* in, size_t count);
+
+    /// out[i] = in[i].InverseRigid(), out may alias in
+    void MatrixInverseRigidArray(Matrix4x4* out, const Matrix4x4* in, size_t count);
+
+} // namespace mj2
@@ -0,0 +1,17 @@
+#include "Quaternion.hpp"
+
+namespace mj2
+{
+    //-------------------------------------------------------------
+    // Quaternion
+    //-------------------------------------------------------------
+    void Quaternion::Print()
+    {
+        printf("(%.9g, %.9g, %.9g, %.9g)\n", x, y, z, w);
+    }
+
+    void Quaternion::ToString(char* const str, size_t size)
+    {
+        snprintf(str, size, "(%f, %f, %f, %f)", x, y, z, w);
+    }
+}
@@ -0,0 +1,293 @@
+#include "QuaternionBatch.hpp"
+
+#include "Matrix.hpp"
+
+namespace mj2
+{
+    /// four lanes of (x, y, z, w)
+    struct QuaternionSIMD {
+    public:
+        VectorSIMD x;
+        VectorSIMD y;
+        VectorSIMD z;
+        VectorSIMD w;
+    };
+
+    static inline QuaternionSIMD LoadQuaternion4(const QuaternionStream& stream, size_t i)
+    {
+        QuaternionSIMD q;
+        q.x = VectorLoad4fUnaligned(stream.x + i);
+        q.y = VectorLoad4fUnaligned(stream.y + i);
+        q.z = VectorLoad4fUnaligned(stream.z + i);
+        q.w = VectorLoad4fUnaligned(stream.w + i);
+        return q;
+    }
+
+    static inline void StoreQuaternion4(const QuaternionStream& stream, size_t i, const QuaternionSIMD& q)
+    {
+        VectorStore4fUnaligned(q.x, stream.x + i);
+        VectorStore4fUnaligned(q.y, stream.y + i);
+        VectorStore4fUnaligned(q.z, stream.z + i);
+        VectorStore4fUnaligned(q.w, stream.w + i);
+    }
+
+    /// the last count - first (< 4) quaternions, unused lanes padded with identity so the
+    /// tail can run through the same SIMD code
+    static inline QuaternionSIMD LoadQuaternionTail(const QuaternionStream& stream, size_t first, size_t count)
+    {
+        alignas(16) float lanes[4][4] = { { 0.0f, 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 0.0f },
+                                          { 0.0f, 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f, 1.0f } };
+        for (size_t i = first; i < count; i++) {
+            lanes[0][i - first] = stream.x[i];
+            lanes[1][i - first] = stream.y[i];
+            lanes[2][i - first] = stream.z[i];
+            lanes[3][i - first] = stream.w[i];
+        }
+
+        QuaternionSIMD q;
+        q.x = VectorLoad4f(lanes[0]);
+        q.y = VectorLoad4f(lanes[1]);
+        q.z = VectorLoad4f(lanes[2]);
+        q.w = VectorLoad4f(lanes[3]);
+        return q;
+    }
+
+    static inline void StoreQuaternionTail(const QuaternionStream& stream, size_t first, size_t count, const QuaternionSIMD& q)
+    {
+        alignas(16) float lanes[4][4];
+        VectorStore4f(q.x, lanes[0]);
+        VectorStore4f(q.y, lanes[1]);
+        VectorStore4f(q.z, lanes[2]);
+        VectorStore4f(q.w, lanes[3]);
+        for (size_t i = first; i < count; i++) {
+            stream.x[i] = lanes[0][i - first];
+            stream.y[i] = lanes[1][i - first];
+            stream.z[i] = lanes[2][i - first];
+            stream.w[i] = lanes[3][i - first];
+        }
+    }
+
+    static inline VectorSIMD Dot4(const QuaternionSIMD& a, const QuaternionSIMD& b)
+    {
+        VectorSIMD dot = VectorMultiply(a.x, b.x);
+        dot = VectorMultiplyAdd(a.y, b.y, dot);
+        dot = VectorMultiplyAdd(a.z, b.z, dot);
+        return VectorMultiplyAdd(a.w, b.w, dot);
+    }
+
+    static inline QuaternionSIMD Scale4(const QuaternionSIMD& q, VectorSIMD scale)
+    {
+        QuaternionSIMD result;
+        result.x = VectorMultiply(q.x, scale);
+        result.y = VectorMultiply(q.y, scale);
+        result.z = VectorMultiply(q.z, scale);
+        result.w = VectorMultiply(q.w, scale);
+        return result;
+    }
+
+    static inline QuaternionSIMD Normalize4(const QuaternionSIMD& q)
+    {
+        return Scale4(q, VectorDivide(VectorSplat(1.0f), VectorSqrt(Dot4(q, q))));
+    }
+
+    /// flip to when the dot product is negative so both ends are on the same hemisphere
+    static inline QuaternionSIMD ShortestArc4(const QuaternionSIMD& to, VectorSIMD& dot)
+    {
+        const VectorSIMD sign = VectorAnd(dot, VectorSplat(-0.0f));
+        dot = VectorXor(dot, sign);
+        QuaternionSIMD result;
+        result.x = VectorXor(to.x, sign);
+        result.y = VectorXor(to.y, sign);
+        result.z = VectorXor(to.z, sign);
+        result.w = VectorXor(to.w, sign);
+        return result;
+    }
+
+    static inline QuaternionSIMD Multiply4(const QuaternionSIMD& a, const QuaternionSIMD& b)
+    {
+        // same Hamilton product as VectorQuaternionMultiply2, one quaternion per lane
+        QuaternionSIMD result;
+        result.x = VectorSubstract(VectorMultiplyAdd(a.w, b.x, VectorMultiplyAdd(a.x, b.w, VectorMultiply(a.y, b.z))), VectorMultiply(a.z, b.y));
+        result.y = VectorSubstract(VectorMultiplyAdd(a.w, b.y, VectorMultiplyAdd(a.y, b.w, VectorMultiply(a.z, b.x))), VectorMultiply(a.x, b.z));
+        result.z = VectorSubstract(VectorMultiplyAdd(a.w, b.z, VectorMultiplyAdd(a.z, b.w, VectorMultiply(a.x, b.y))), VectorMultiply(a.y, b.x));
+        result.w = VectorSubstract(VectorMultiply(a.w, b.w),
+                                   VectorMultiplyAdd(a.x, b.x, VectorMultiplyAdd(a.y, b.y, VectorMultiply(a.z, b.z))));
+        return result;
+    }
+
+    void QuaternionMultiplyArray(void* out, const void* left, const void* right, size_t count)
+    {
+        const VectorSIMD* _left = (const VectorSIMD*)left;
+        const VectorSIMD* _right = (const VectorSIMD*)right;
+        VectorSIMD* _out = (VectorSIMD*)out;
+        for (size_t i = 0; i < count; i++) {
+            _out[i] = VectorQuaternionMultiply2(_left[i], _right[i]);
+        }
+    }
+
+    void QuaternionMultiplyArray(QuaternionStream out, const QuaternionStream left, const QuaternionStream right, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            StoreQuaternion4(out, i, Multiply4(LoadQuaternion4(left, i), LoadQuaternion4(right, i)));
+        }
+
+        if (i < count)
+            StoreQuaternionTail(out, i, count, Multiply4(LoadQuaternionTail(left, i, count), LoadQuaternionTail(right, i, count)));
+    }
+
+    void QuaternionNormalizeArray(QuaternionStream out, const QuaternionStream in, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            StoreQuaternion4(out, i, Normalize4(LoadQuaternion4(in, i)));
+        }
+
+        if (i < count)
+            StoreQuaternionTail(out, i, count, Normalize4(LoadQuaternionTail(in, i, count)));
+    }
+
+    static inline QuaternionSIMD Nlerp4(const QuaternionSIMD& from, const QuaternionSIMD& to, VectorSIMD t)
+    {
+        VectorSIMD dot = Dot4(from, to);
+        const QuaternionSIMD target = ShortestArc4(to, dot);
+
+        QuaternionSIMD result;
+        result.x = VectorMultiplyAdd(VectorSubstract(target.x, from.x), t, from.x);
+        result.y = VectorMultiplyAdd(VectorSubstract(target.y, from.y), t, from.y);
+        result.z = VectorMultiplyAdd(VectorSubstract(target.z, from.z), t, from.z);
+        result.w = VectorMultiplyAdd(VectorSubstract(target.w, from.w), t, from.w);
+        return Normalize4(result);
+    }
+
+    void QuaternionNlerpArray(QuaternionStream out, const QuaternionStream from, const QuaternionStream to, float t, size_t count)
+    {
+        const VectorSIMD weight = VectorSplat(t);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            StoreQuaternion4(out, i, Nlerp4(LoadQuaternion4(from, i), LoadQuaternion4(to, i), weight));
+        }
+
+        if (i < count)
+            StoreQuaternionTail(out, i, count, Nlerp4(LoadQuaternionTail(from, i, count), LoadQuaternionTail(to, i, count), weight));
+    }
+
+    /// Eberly's coefficients, u[i] = 1 / (i * (2i + 1)), v[i] = i / (2i + 1) with the last
+    /// term scaled by mu to absorb the truncation error
+    static const int SlerpTerms = 8;
+    static const float SlerpMu = 1.85298109240830f;
+    static const float SlerpU[SlerpTerms] = {
+        1.0f / (1 * 3), 1.0f / (2 * 5), 1.0f / (3 * 7), 1.0f / (4 * 9),
+        1.0f / (5 * 11), 1.0f / (6 * 13), 1.0f / (7 * 15), SlerpMu / (8 * 17)
+    };
+    static const float SlerpV[SlerpTerms] = {
+        1.0f / 3, 2.0f / 5, 3.0f / 7, 4.0f / 9,
+        5.0f / 11, 6.0f / 13, 7.0f / 15, SlerpMu * 8 / 17
+    };
+
+    /// per call constants of the polynomial in (cos(theta) - 1) for weight s
+    struct SlerpWeight {
+    public:
+        VectorSIMD s;
+        VectorSIMD k[SlerpTerms];
+
+        inline explicit SlerpWeight(float weight)
+        {
+            s = VectorSplat(weight);
+            for (int i = 0; i < SlerpTerms; i++) {
+                k[i] = VectorSplat(SlerpU[i] * weight * weight - SlerpV[i]);
+            }
+        }
+
+        /// sin(s * theta) / sin(theta)
+        inline VectorSIMD Evaluate(VectorSIMD cosineMinusOne) const
+        {
+            const VectorSIMD one = VectorSplat(1.0f);
+            VectorSIMD f = one;
+            for (int i = SlerpTerms - 1; i >= 0; i--) {
+                f = VectorMultiplyAdd(VectorMultiply(k[i], cosineMinusOne), f, one);
+            }
+            return VectorMultiply(s, f);
+        }
+    };
+
+    static inline QuaternionSIMD Slerp4(const QuaternionSIMD& from, const QuaternionSIMD& to, const SlerpWeight& weightTo, const SlerpWeight& weightFrom)
+    {
+        VectorSIMD dot = Dot4(from, to);
+        const QuaternionSIMD target = ShortestArc4(to, dot);
+        const VectorSIMD cosineMinusOne = VectorSubstract(dot, VectorSplat(1.0f));
+        const VectorSIMD cTo = weightTo.Evaluate(cosineMinusOne);
+        const VectorSIMD cFrom = weightFrom.Evaluate(cosineMinusOne);
+
+        QuaternionSIMD result;
+        result.x = VectorMultiplyAdd(from.x, cFrom, VectorMultiply(target.x, cTo));
+        result.y = VectorMultiplyAdd(from.y, cFrom, VectorMultiply(target.y, cTo));
+        result.z = VectorMultiplyAdd(from.z, cFrom, VectorMultiply(target.z, cTo));
+        result.w = VectorMultiplyAdd(from.w, cFrom, VectorMultiply(target.w, cTo));
+        return result;
+    }
+
+    void QuaternionSlerpArray(QuaternionStream out, const QuaternionStream from, const QuaternionStream to, float t, size_t count)
+    {
+        const SlerpWeight weightTo(t);
+        const SlerpWeight weightFrom(1.0f - t);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            StoreQuaternion4(out, i, Slerp4(LoadQuaternion4(from, i), LoadQuaternion4(to, i), weightTo, weightFrom));
+        }
+
+        if (i < count)
+            StoreQuaternionTail(out, i, count, Slerp4(LoadQuaternionTail(from, i, count), LoadQuaternionTail(to, i, count), weightTo, weightFrom));
+    }
+
+    /// rotation part of four matrices, lanes are quaternions; out is 64 floats, 16 byte aligned
+    static inline void ToMatrix4(float* out, const QuaternionSIMD& q)
+    {
+        const VectorSIMD x2 = VectorAdd(q.x, q.x);
+        const VectorSIMD y2 = VectorAdd(q.y, q.y);
+        const VectorSIMD z2 = VectorAdd(q.z, q.z);
+        const VectorSIMD xx = VectorMultiply(q.x, x2);
+        const VectorSIMD xy = VectorMultiply(q.x, y2);
+        const VectorSIMD xz = VectorMultiply(q.x, z2);
+        const VectorSIMD yy = VectorMultiply(q.y, y2);
+        const VectorSIMD yz = VectorMultiply(q.y, z2);
+        const VectorSIMD zz = VectorMultiply(q.z, z2);
+        const VectorSIMD wx = VectorMultiply(q.w, x2);
+        const VectorSIMD wy = VectorMultiply(q.w, y2);
+        const VectorSIMD wz = VectorMultiply(q.w, z2);
+        const VectorSIMD one = VectorSplat(1.0f);
+        const VectorSIMD zero = VectorSplat(0.0f);
+
+        // one register per matrix element, transposed into rows of the four matrices
+        VectorSIMD row0[4] = { VectorSubstract(one, VectorAdd(yy, zz)), VectorAdd(xy, wz), VectorSubstract(xz, wy), zero };
+        VectorSIMD row1[4] = { VectorSubstract(xy, wz), VectorSubstract(one, VectorAdd(xx, zz)), VectorAdd(yz, wx), zero };
+        VectorSIMD row2[4] = { VectorAdd(xz, wy), VectorSubstract(yz, wx), VectorSubstract(one, VectorAdd(xx, yy)), zero };
+        VectorTranspose4(row0[0], row0[1], row0[2], row0[3]);
+        VectorTranspose4(row1[0], row1[1], row1[2], row1[3]);
+        VectorTranspose4(row2[0], row2[1], row2[2], row2[3]);
+
+        const VectorSIMD row3 = MakeVectorSIMD(0.0f, 0.0f, 0.0f, 1.0f);
+        for (int i = 0; i < 4; i++) {
+            VectorSIMD* m = (VectorSIMD*)(out + i * 16);
+            m[0] = row0[i];
+            m[1] = row1[i];
+            m[2] = row2[i];
+            m[3] = row3;
+        }
+    }
+
+    void QuaternionToMatrixArray(Matrix4x4* out, const QuaternionStream in, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            ToMatrix4(&out[i].m[0][0], LoadQuaternion4(in, i));
+        }
+
+        if (i < count) {
+            // plain floats, a Matrix4x4 array would be set to identity first
+            alignas(16) float scratch[4 * 16];
+            ToMatrix4(scratch, LoadQuaternionTail(in, i, count));
+            memcpy(&out[i].m[0][0], scratch, (count - i) * 16 * sizeof(float));
+        }
+    }
+}
@@ -0,0 +1,250 @@
+// Built with -mavx2 -mfma, only entered through SIMD_Dispatch once CPUID reports support.
+// Keep Matrix.hpp and the SSE header out of this file, see SIMD_AVX.hpp.
+#include "SIMD_AVX.hpp"
+#include "SIMD_Dispatch.hpp"
+
+namespace mj2
+{
+    template<bool IsPoint>
+    static inline void TransformStreamAVX2(Vector3Stream out, const Vector3Stream in, const float* mat, size_t count)
+    {
+        const VectorSIMD8 m00 = Vector8Splat(mat[0]);
+        const VectorSIMD8 m01 = Vector8Splat(mat[1]);
+        const VectorSIMD8 m02 = Vector8Splat(mat[2]);
+        const VectorSIMD8 m10 = Vector8Splat(mat[4]);
+        const VectorSIMD8 m11 = Vector8Splat(mat[5]);
+        const VectorSIMD8 m12 = Vector8Splat(mat[6]);
+        const VectorSIMD8 m20 = Vector8Splat(mat[8]);
+        const VectorSIMD8 m21 = Vector8Splat(mat[9]);
+        const VectorSIMD8 m22 = Vector8Splat(mat[10]);
+        const VectorSIMD8 m30 = Vector8Splat(IsPoint ? mat[12] : 0.0f);
+        const VectorSIMD8 m31 = Vector8Splat(IsPoint ? mat[13] : 0.0f);
+        const VectorSIMD8 m32 = Vector8Splat(IsPoint ? mat[14] : 0.0f);
+
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            const VectorSIMD8 x = Vector8LoadUnaligned(in.x + i);
+            const VectorSIMD8 y = Vector8LoadUnaligned(in.y + i);
+            const VectorSIMD8 z = Vector8LoadUnaligned(in.z + i);
+
+            VectorSIMD8 rx = Vector8MultiplyAdd(x, m00, m30);
+            VectorSIMD8 ry = Vector8MultiplyAdd(x, m01, m31);
+            VectorSIMD8 rz = Vector8MultiplyAdd(x, m02, m32);
+            rx = Vector8MultiplyAdd(y, m10, rx);
+            ry = Vector8MultiplyAdd(y, m11, ry);
+            rz = Vector8MultiplyAdd(y, m12, rz);
+            rx = Vector8MultiplyAdd(z, m20, rx);
+            ry = Vector8MultiplyAdd(z, m21, ry);
+            rz = Vector8MultiplyAdd(z, m22, rz);
+
+            Vector8StoreUnaligned(rx, out.x + i);
+            Vector8StoreUnaligned(ry, out.y + i);
+            Vector8StoreUnaligned(rz, out.z + i);
+        }
+
+        // tail
+        const float tx = IsPoint ? mat[12] : 0.0f;
+        const float ty = IsPoint ? mat[13] : 0.0f;
+        const float tz = IsPoint ? mat[14] : 0.0f;
+        for (; i < count; i++) {
+            const float x = in.x[i];
+            const float y = in.y[i];
+            const float z = in.z[i];
+            out.x[i] = x * mat[0] + y * mat[4] + z * mat[8] + tx;
+            out.y[i] = x * mat[1] + y * mat[5] + z * mat[9] + ty;
+            out.z[i] = x * mat[2] + y * mat[6] + z * mat[10] + tz;
+        }
+    }
+
+    void TransformBatchAVX2(Vector3Stream out, const Vector3Stream in, const float* mat, size_t count)
+    {
+        TransformStreamAVX2<true>(out, in, mat, count);
+    }
+
+    void TransformBatchDirectionsAVX2(Vector3Stream out, const Vector3Stream in, const float* mat, size_t count)
+    {
+        TransformStreamAVX2<false>(out, in, mat, count);
+    }
+
+    static const size_t PrefetchDistance = 4;
+
+    void MatrixMultiplyArrayAVX2(float* out, const float* parents, const float* locals, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 2 <= count; i += 2) {
+            if (i + PrefetchDistance + 1 < count) {
+                VectorPrefetch(parents + 16 * (i + PrefetchDistance));
+                VectorPrefetch(parents + 16 * (i + PrefetchDistance + 1));
+                VectorPrefetch(locals + 16 * (i + PrefetchDistance));
+                VectorPrefetch(locals + 16 * (i + PrefetchDistance + 1));
+            }
+            MatrixMultiply2(out + 16 * i, out + 16 * (i + 1),
+                            parents + 16 * i, locals + 16 * i,
+                            parents + 16 * (i + 1), locals + 16 * (i + 1));
+        }
+
+        if (i < count)
+            MatrixMultiplyFMA(out + 16 * i, parents + 16 * i, locals + 16 * i);
+    }
+
+    void MatrixMultiplyHierarchyAVX2(float* out, const float* locals, const int* parentIndices, size_t count)
+    {
+        size_t i = 0;
+        while (i < count) {
+            if (i + PrefetchDistance + 1 < count) {
+                VectorPrefetch(locals + 16 * (i + PrefetchDistance));
+                VectorPrefetch(locals + 16 * (i + PrefetchDistance + 1));
+            }
+
+            const int parent0 = parentIndices[i];
+            // pair up siblings, a child of node i has to wait for it
+            if (i + 1 < count && parent0 >= 0 && parentIndices[i + 1] >= 0 && parentIndices[i + 1] != (int)i) {
+                MatrixMultiply2(out + 16 * i, out + 16 * (i + 1),
+                                out + 16 * parent0, locals + 16 * i,
+                                out + 16 * parentIndices[i + 1], locals + 16 * (i + 1));
+                i += 2;
+                continue;
+            }
+
+            if (parent0 < 0) {
+                // Matrix4x4 is only 16 byte aligned
+                Vector8StoreUnaligned(Vector8LoadUnaligned(locals + 16 * i), out + 16 * i);
+                Vector8StoreUnaligned(Vector8LoadUnaligned(locals + 16 * i + 8), out + 16 * i + 8);
+            } else {
+                MatrixMultiplyFMA(out + 16 * i, out + 16 * parent0, locals + 16 * i);
+            }
+            i++;
+        }
+    }
+
+    /// append base + lane for every set bit, branch free, out needs room for 8 entries past written
+    static inline size_t CompactIndices8(uint32_t* out, size_t written, uint32_t base, int mask)
+    {
+        for (uint32_t lane = 0; lane < 8; lane++) {
+            out[written] = base + lane;
+            written += (mask >> lane) & 1;
+        }
+        return written;
+    }
+
+    size_t CullSpheresAVX2(const Frustum& frustum, const SphereStream& spheres, size_t count, uint32_t* visibleIndices)
+    {
+        const VectorSIMD8 zero = _mm256_setzero_ps();
+        size_t written = 0;
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            const VectorSIMD8 x = Vector8LoadUnaligned(spheres.x + i);
+            const VectorSIMD8 y = Vector8LoadUnaligned(spheres.y + i);
+            const VectorSIMD8 z = Vector8LoadUnaligned(spheres.z + i);
+            const VectorSIMD8 r = Vector8LoadUnaligned(spheres.radius + i);
+
+            VectorSIMD8 inside = Vector8CompareGE(zero, zero);
+            for (int p = 0; p < Frustum::Plane_Count; p++) {
+                VectorSIMD8 distance = Vector8Add(r, Vector8Splat(frustum.planes[p][3]));
+                distance = Vector8MultiplyAdd(x, Vector8Splat(frustum.planes[p][0]), distance);
+                distance = Vector8MultiplyAdd(y, Vector8Splat(frustum.planes[p][1]), distance);
+                distance = Vector8MultiplyAdd(z, Vector8Splat(frustum.planes[p][2]), distance);
+                inside = Vector8And(inside, Vector8CompareGE(distance, zero));
+            }
+
+            written = CompactIndices8(visibleIndices, written, (uint32_t)i, Vector8MoveMask(inside));
+        }
+
+        return CullSpheresTail(frustum, spheres, i, count, visibleIndices, written);
+    }
+
+    size_t CullAABBsAVX2(const Frustum& frustum, const AABBStream& boxes, size_t count, uint32_t* visibleIndices)
+    {
+        const VectorSIMD8 zero = _mm256_setzero_ps();
+        size_t written = 0;
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            const VectorSIMD8 x = Vector8LoadUnaligned(boxes.centerX + i);
+            const VectorSIMD8 y = Vector8LoadUnaligned(boxes.centerY + i);
+            const VectorSIMD8 z = Vector8LoadUnaligned(boxes.centerZ + i);
+            const VectorSIMD8 ex = Vector8LoadUnaligned(boxes.extentX + i);
+            const VectorSIMD8 ey = Vector8LoadUnaligned(boxes.extentY + i);
+            const VectorSIMD8 ez = Vector8LoadUnaligned(boxes.extentZ + i);
+
+            VectorSIMD8 inside = Vector8CompareGE(zero, zero);
+            for (int p = 0; p < Frustum::Plane_Count; p++) {
+                const VectorSIMD8 a = Vector8Splat(frustum.planes[p][0]);
+                const VectorSIMD8 b = Vector8Splat(frustum.planes[p][1]);
+                const VectorSIMD8 c = Vector8Splat(frustum.planes[p][2]);
+
+                VectorSIMD8 distance = Vector8MultiplyAdd(x, a, Vector8Splat(frustum.planes[p][3]));
+                distance = Vector8MultiplyAdd(y, b, distance);
+                distance = Vector8MultiplyAdd(z, c, distance);
+                distance = Vector8MultiplyAdd(ex, Vector8Abs(a), distance);
+                distance = Vector8MultiplyAdd(ey, Vector8Abs(b), distance);
+                distance = Vector8MultiplyAdd(ez, Vector8Abs(c), distance);
+                inside = Vector8And(inside, Vector8CompareGE(distance, zero));
+            }
+
+            written = CompactIndices8(visibleIndices, written, (uint32_t)i, Vector8MoveMask(inside));
+        }
+
+        return CullAABBsTail(frustum, boxes, i, count, visibleIndices, written);
+    }
+
+    template<Precision P>
+    static inline VectorSIMD8 ReciprocalLengthAVX2(VectorSIMD8 lengthSquared)
+    {
+        if (P == Precision_Exact)
+            return Vector8Divide(Vector8Splat(1.0f), Vector8Sqrt(lengthSquared));
+
+        const VectorSIMD8 estimate = Vector8ReciprocalSqrtEstimate(lengthSquared);
+        if (P == Precision_Fast)
+            return estimate;
+
+        // one Newton-Raphson step, e * (1.5 - 0.5 * v * e * e)
+        const VectorSIMD8 halfVE = Vector8Multiply(Vector8Multiply(lengthSquared, Vector8Splat(0.5f)), estimate);
+        return Vector8Multiply(estimate, Vector8NegativeMultiplyAdd(halfVE, estimate, Vector8Splat(1.5f)));
+    }
+
+    template<Precision P>
+    static inline void NormalizeStreamAVX2(Vector3Stream out, const Vector3Stream in, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            const VectorSIMD8 x = Vector8LoadUnaligned(in.x + i);
+            const VectorSIMD8 y = Vector8LoadUnaligned(in.y + i);
+            const VectorSIMD8 z = Vector8LoadUnaligned(in.z + i);
+
+            VectorSIMD8 lengthSquared = Vector8Multiply(x, x);
+            lengthSquared = Vector8MultiplyAdd(y, y, lengthSquared);
+            lengthSquared = Vector8MultiplyAdd(z, z, lengthSquared);
+            const VectorSIMD8 invLength = ReciprocalLengthAVX2<P>(lengthSquared);
+
+            Vector8StoreUnaligned(Vector8Multiply(x, invLength), out.x + i);
+            Vector8StoreUnaligned(Vector8Multiply(y, invLength), out.y + i);
+            Vector8StoreUnaligned(Vector8Multiply(z, invLength), out.z + i);
+        }
+
+        // tail
+        for (; i < count; i++) {
+            const float x = in.x[i];
+            const float y = in.y[i];
+            const float z = in.z[i];
+            const float invLength = InvSqrt(x * x + y * y + z * z, P);
+            out.x[i] = x * invLength;
+            out.y[i] = y * invLength;
+            out.z[i] = z * invLength;
+        }
+    }
+
+    void NormalizeArrayAVX2(Vector3Stream out, const Vector3Stream in, size_t count, Precision precision)
+    {
+        switch (precision) {
+            case Precision_Fast:
+                NormalizeStreamAVX2<Precision_Fast>(out, in, count);
+                break;
+            case Precision_Accurate:
+                NormalizeStreamAVX2<Precision_Accurate>(out, in, count);
+                break;
+            default:
+                NormalizeStreamAVX2<Precision_Exact>(out, in, count);
+                break;
+        }
+    }
+}
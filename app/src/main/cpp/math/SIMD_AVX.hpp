@@ -0,0 +1,103 @@
+#pragma once
+
+#include <immintrin.h> // AVX2 + FMA
+
+// Only include this header from translation units built with -mavx2 -mfma and reached
+// through the runtime dispatch in SIMD_Dispatch.hpp. Inline functions emitted here are
+// VEX encoded and must never be merged into code that runs on plain SSE2 machines.
+
+#ifndef SHUFFLEMASK
+#define SHUFFLEMASK(A0, A1, B2, B3) ((A0) | ((A1) << 2) | ((B2) << 4) | ((B3) << 6))
+#endif
+
+namespace mj2 {
+    using VectorSIMD8 = __m256;
+
+#define Vector8Splat(f) _mm256_set1_ps(f)
+#define Vector8Load(ptr) _mm256_load_ps((const float*)(ptr))
+#define Vector8Store(vec, ptr) _mm256_store_ps((float*)(ptr), vec)
+#define Vector8LoadUnaligned(ptr) _mm256_loadu_ps((const float*)(ptr))
+#define Vector8StoreUnaligned(vec, ptr) _mm256_storeu_ps((float*)(ptr), vec)
+/// two 128 bit halves from independent addresses, lo from ptrLo and hi from ptrHi
+#define Vector8LoadPair(ptrLo, ptrHi) _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_load_ps((const float*)(ptrLo))), _mm_load_ps((const float*)(ptrHi)), 1)
+
+#define Vector8Add(v0, v1) _mm256_add_ps(v0, v1)
+#define Vector8Substract(v0, v1) _mm256_sub_ps(v0, v1)
+#define Vector8Multiply(v0, v1) _mm256_mul_ps(v0, v1)
+/// v0 * v1 + v2, fused
+#define Vector8MultiplyAdd(v0, v1, v2) _mm256_fmadd_ps(v0, v1, v2)
+/// v2 - v0 * v1
+#define Vector8NegativeMultiplyAdd(v0, v1, v2) _mm256_fnmadd_ps(v0, v1, v2)
+#define Vector8Divide(v0, v1) _mm256_div_ps(v0, v1)
+#define Vector8Sqrt(v) _mm256_sqrt_ps(v)
+/// 1/sqrt(v), 12 bits
+#define Vector8ReciprocalSqrtEstimate(v) _mm256_rsqrt_ps(v)
+#define Vector8And(v0, v1) _mm256_and_ps(v0, v1)
+#define Vector8CompareGE(v0, v1) _mm256_cmp_ps(v0, v1, _CMP_GE_OQ)
+#define Vector8MoveMask(v) _mm256_movemask_ps(v)
+#define Vector8Abs(v) _mm256_and_ps(v, _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff)))
+/// broadcast element index inside each 128 bit half
+#define Vector8ReplicateInLane(v, index) _mm256_permute_ps(v, SHUFFLEMASK(index, index, index, index))
+
+#define VectorPrefetch(ptr) _mm_prefetch((const char*)(ptr), _MM_HINT_T0)
+
+    /// 4 wide MatrixMultiply using fused multiply-add, pointers must be 16 byte aligned
+    inline void MatrixMultiplyFMA(void* result, const void* left, const void* right)
+    {
+        const __m128* _left = (const __m128*)left;
+        const __m128* _right = (const __m128*)right;
+        __m128* _result = (__m128*)result;
+        const __m128 right0 = _right[0];
+        const __m128 right1 = _right[1];
+        const __m128 right2 = _right[2];
+        const __m128 right3 = _right[3];
+
+        __m128 rows[4];
+        for (int i = 0; i < 4; i++) {
+            const __m128 row = _left[i];
+            __m128 temp = _mm_mul_ps(_mm_permute_ps(row, SHUFFLEMASK(0, 0, 0, 0)), right0);
+            temp = _mm_fmadd_ps(_mm_permute_ps(row, SHUFFLEMASK(1, 1, 1, 1)), right1, temp);
+            temp = _mm_fmadd_ps(_mm_permute_ps(row, SHUFFLEMASK(2, 2, 2, 2)), right2, temp);
+            rows[i] = _mm_fmadd_ps(_mm_permute_ps(row, SHUFFLEMASK(3, 3, 3, 3)), right3, temp);
+        }
+
+        _result[0] = rows[0];
+        _result[1] = rows[1];
+        _result[2] = rows[2];
+        _result[3] = rows[3];
+    }
+
+    /// Two independent 4x4 products in one pass: result0 = left0 * right0, result1 = left1 * right1.
+    /// Row i of both products lives in one 256 bit register, lo half for the first matrix.
+    /// All pointers must be 16 byte aligned, results may alias the inputs.
+    inline void MatrixMultiply2(void* result0, void* result1,
+                                const void* left0, const void* right0,
+                                const void* left1, const void* right1)
+    {
+        const float* l0 = (const float*)left0;
+        const float* l1 = (const float*)left1;
+        const float* r0 = (const float*)right0;
+        const float* r1 = (const float*)right1;
+
+        const VectorSIMD8 right_0 = Vector8LoadPair(r0 + 0, r1 + 0);
+        const VectorSIMD8 right_1 = Vector8LoadPair(r0 + 4, r1 + 4);
+        const VectorSIMD8 right_2 = Vector8LoadPair(r0 + 8, r1 + 8);
+        const VectorSIMD8 right_3 = Vector8LoadPair(r0 + 12, r1 + 12);
+
+        VectorSIMD8 rows[4];
+        for (int i = 0; i < 4; i++) {
+            const VectorSIMD8 left = Vector8LoadPair(l0 + 4 * i, l1 + 4 * i);
+            VectorSIMD8 temp = Vector8Multiply(Vector8ReplicateInLane(left, 0), right_0);
+            temp = Vector8MultiplyAdd(Vector8ReplicateInLane(left, 1), right_1, temp);
+            temp = Vector8MultiplyAdd(Vector8ReplicateInLane(left, 2), right_2, temp);
+            rows[i] = Vector8MultiplyAdd(Vector8ReplicateInLane(left, 3), right_3, temp);
+        }
+
+        float* out0 = (float*)result0;
+        float* out1 = (float*)result1;
+        for (int i = 0; i < 4; i++) {
+            _mm_store_ps(out0 + 4 * i, _mm256_castps256_ps128(rows[i]));
+            _mm_store_ps(out1 + 4 * i, _mm256_extractf128_ps(rows[i], 1));
+        }
+    }
+} // end of namespace mj2
@@ -0,0 +1,155 @@
+#include "SIMD_Dispatch.hpp"
+
+#include <atomic>
+
+#if defined(MJ2_HAS_AVX2_KERNELS)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace mj2
+{
+#if defined(MJ2_HAS_AVX2_KERNELS)
+    static void CpuId(unsigned int leaf, unsigned int subLeaf, unsigned int regs[4])
+    {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuidex(info, (int)leaf, (int)subLeaf);
+        for (int i = 0; i < 4; i++)
+            regs[i] = (unsigned int)info[i];
+#else
+        __cpuid_count(leaf, subLeaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    }
+
+    /// XCR0, which register states the OS saves on context switch
+    static unsigned long long ReadXCR0()
+    {
+#ifdef _MSC_VER
+        return _xgetbv(0);
+#else
+        unsigned int eax, edx;
+        __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return ((unsigned long long)edx << 32) | eax;
+#endif
+    }
+#endif
+
+    static CpuFeatures DetectCpuFeatures()
+    {
+        CpuFeatures features = {};
+
+#if defined(MJ2_HAS_AVX2_KERNELS)
+        unsigned int regs[4];
+        CpuId(0, 0, regs);
+        const unsigned int maxLeaf = regs[0];
+
+        CpuId(1, 0, regs);
+        features.sse2 = (regs[3] & (1u << 26)) != 0;
+        features.ssse3 = (regs[2] & (1u << 9)) != 0;
+        features.sse41 = (regs[2] & (1u << 19)) != 0;
+        features.fma = (regs[2] & (1u << 12)) != 0;
+        const bool osxsave = (regs[2] & (1u << 27)) != 0;
+        const bool avx = (regs[2] & (1u << 28)) != 0;
+
+        // the OS has to save XMM and YMM state (XCR0 bits 1 and 2) before AVX is usable
+        const bool ymmEnabled = osxsave && (ReadXCR0() & 0x6) == 0x6;
+        features.avx = avx && ymmEnabled;
+        if (!ymmEnabled)
+            features.fma = false;
+
+        if (maxLeaf >= 7) {
+            CpuId(7, 0, regs);
+            features.avx2 = features.avx && (regs[1] & (1u << 5)) != 0;
+        }
+#elif defined(__arm__) || defined(__aarch64__)
+        // the NDK build is configured with ANDROID_ARM_NEON=TRUE
+        features.neon = true;
+#endif
+        return features;
+    }
+
+    const CpuFeatures& GetCpuFeatures()
+    {
+        static const CpuFeatures features = DetectCpuFeatures();
+        return features;
+    }
+
+    static const SIMDKernels SIMD4Kernels = {
+#if defined(__arm__) || defined(__aarch64__)
+        SIMDLevel_NEON, "NEON",
+#else
+        SIMDLevel_SSE2, "SSE2",
+#endif
+        TransformBatchSIMD4,
+        TransformBatchDirectionsSIMD4,
+        MatrixMultiplyArraySIMD4,
+        MatrixMultiplyHierarchySIMD4,
+        CullSpheresSIMD4,
+        CullAABBsSIMD4,
+        NormalizeArraySIMD4,
+    };
+
+#if defined(MJ2_HAS_AVX2_KERNELS)
+    static const SIMDKernels AVX2Kernels = {
+        SIMDLevel_AVX2, "AVX2+FMA",
+        TransformBatchAVX2,
+        TransformBatchDirectionsAVX2,
+        MatrixMultiplyArrayAVX2,
+        MatrixMultiplyHierarchyAVX2,
+        CullSpheresAVX2,
+        CullAABBsAVX2,
+        NormalizeArrayAVX2,
+    };
+#endif
+
+    static const SIMDKernels* SelectKernels(SIMDLevel level)
+    {
+        const CpuFeatures& features = GetCpuFeatures();
+        switch (level) {
+#if defined(MJ2_HAS_AVX2_KERNELS)
+            case SIMDLevel_AVX2:
+                return (features.avx2 && features.fma) ? &AVX2Kernels : nullptr;
+#endif
+            case SIMDLevel_SSE2:
+            case SIMDLevel_NEON:
+                return SIMD4Kernels.level == level ? &SIMD4Kernels : nullptr;
+            default:
+                return nullptr;
+        }
+    }
+
+    static const SIMDKernels* SelectBestKernels()
+    {
+        const SIMDKernels* kernels = SelectKernels(SIMDLevel_AVX2);
+        return kernels ? kernels : &SIMD4Kernels;
+    }
+
+    static std::atomic<const SIMDKernels*> gKernels(nullptr);
+
+    const SIMDKernels& GetSIMDKernels()
+    {
+        const SIMDKernels* kernels = gKernels.load(std::memory_order_acquire);
+        if (!kernels) {
+            // only fill in the default: a SetSIMDLevel that got in first wins, and
+            // expected comes back holding it
+            const SIMDKernels* best = SelectBestKernels();
+            if (gKernels.compare_exchange_strong(kernels, best, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                kernels = best;
+            }
+        }
+        return *kernels;
+    }
+
+    bool SetSIMDLevel(SIMDLevel level)
+    {
+        const SIMDKernels* kernels = SelectKernels(level);
+        if (!kernels)
+            return false;
+        gKernels.store(kernels, std::memory_order_release);
+        return true;
+    }
+}
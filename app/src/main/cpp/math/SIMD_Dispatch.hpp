@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+
+#include "Frustum.hpp"
+#include "VectorBatch.hpp"
+
+namespace mj2 {
+
+    enum SIMDLevel
+    {
+        SIMDLevel_SSE2 = 0, SIMDLevel_NEON = 1, SIMDLevel_AVX2 = 2
+    };
+
+    struct CpuFeatures {
+    public:
+        bool sse2;
+        bool ssse3;
+        bool sse41;
+        bool avx;
+        bool avx2;
+        bool fma;
+        bool neon;
+    };
+
+    /// CPUID on x86 (including the OS YMM state check), compile-time answer on ARM
+    const CpuFeatures& GetCpuFeatures();
+
+    //-------------------------------------------------------------
+    // SIMDKernels
+    //-------------------------------------------------------------
+    /// Batch kernels for one backend. Matrices are passed as 16 floats in Matrix4x4 layout
+    /// so the AVX translation unit never has to include Matrix.hpp.
+    struct SIMDKernels {
+    public:
+        SIMDLevel level;
+        const char* name;
+
+        void (*TransformBatch)(Vector3Stream out, const Vector3Stream in, const float* mat, size_t count);
+        void (*TransformBatchDirections)(Vector3Stream out, const Vector3Stream in, const float* mat, size_t count);
+        void (*MatrixMultiplyArray)(float* out, const float* parents, const float* locals, size_t count);
+        void (*MatrixMultiplyHierarchy)(float* out, const float* locals, const int* parentIndices, size_t count);
+        size_t (*CullSpheres)(const Frustum& frustum, const SphereStream& spheres, size_t count, uint32_t* visibleIndices);
+        size_t (*CullAABBs)(const Frustum& frustum, const AABBStream& boxes, size_t count, uint32_t* visibleIndices);
+        void (*NormalizeArray)(Vector3Stream out, const Vector3Stream in, size_t count, Precision precision);
+    };
+
+    /// Kernels of the best backend the running CPU supports, picked on first use
+    const SIMDKernels& GetSIMDKernels();
+
+    /// Force a backend, e.g. to compare them in benchmarks. Returns false and keeps the
+    /// current one if the CPU or the build does not support level.
+    bool SetSIMDLevel(SIMDLevel level);
+
+    /// Backend implementations, SIMD4 is SSE2 or NEON depending on the target
+    void TransformBatchSIMD4(Vector3Stream out, const Vector3Stream in, const float* mat, size_t count);
+    void TransformBatchDirectionsSIMD4(Vector3Stream out, const Vector3Stream in, const float* mat, size_t count);
+    void MatrixMultiplyArraySIMD4(float* out, const float* parents, const float* locals, size_t count);
+    void MatrixMultiplyHierarchySIMD4(float* out, const float* locals, const int* parentIndices, size_t count);
+    size_t CullSpheresSIMD4(const Frustum& frustum, const SphereStream& spheres, size_t count, uint32_t* visibleIndices);
+    size_t CullAABBsSIMD4(const Frustum& frustum, const AABBStream& boxes, size_t count, uint32_t* visibleIndices);
+    void NormalizeArraySIMD4(Vector3Stream out, const Vector3Stream in, size_t count, Precision precision);
+    /// scalar remainder [first, count) shared by the culling kernels, returns the new written count
+    size_t CullSpheresTail(const Frustum& frustum, const SphereStream& spheres, size_t first, size_t count, uint32_t* visibleIndices, size_t written);
+    size_t CullAABBsTail(const Frustum& frustum, const AABBStream& boxes, size_t first, size_t count, uint32_t* visibleIndices, size_t written);
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define MJ2_HAS_AVX2_KERNELS 1
+    void TransformBatchAVX2(Vector3Stream out, const Vector3Stream in, const float* mat, size_t count);
+    void TransformBatchDirectionsAVX2(Vector3Stream out, const Vector3Stream in, const float* mat, size_t count);
+    void MatrixMultiplyArrayAVX2(float* out, const float* parents, const float* locals, size_t count);
+    void MatrixMultiplyHierarchyAVX2(float* out, const float* locals, const int* parentIndices, size_t count);
+    size_t CullSpheresAVX2(const Frustum& frustum, const SphereStream& spheres, size_t count, uint32_t* visibleIndices);
+    size_t CullAABBsAVX2(const Frustum& frustum, const AABBStream& boxes, size_t count, uint32_t* visibleIndices);
+    void NormalizeArrayAVX2(Vector3Stream out, const Vector3Stream in, size_t count, Precision precision);
+#endif
+
+} // end of namespace mj2
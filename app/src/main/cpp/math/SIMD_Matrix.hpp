@@ -0,0 +1,194 @@
+#pragma once
+
+// Backend independent matrix kernels built on the VectorSIMD primitives of
+// SIMD_SSE.hpp / SIMD_NEON.hpp. All pointers are 4x4 float matrices, 16 byte aligned,
+// and result may alias the source.
+
+namespace mj2 {
+
+    /// x * y + z * w per lane of a 2x2 block stored as (m00, m01, m10, m11)
+    inline VectorSIMD Matrix2Multiply(VectorSIMD v0, VectorSIMD v1)
+    {
+        return VectorAdd(VectorMultiply(v0, VectorSwizzle(v1, 0, 3, 0, 3)),
+                         VectorMultiply(VectorSwizzle(v0, 1, 0, 3, 2), VectorSwizzle(v1, 2, 1, 2, 1)));
+    }
+
+    /// adjugate(v0) * v1 for 2x2 blocks
+    inline VectorSIMD Matrix2AdjugateMultiply(VectorSIMD v0, VectorSIMD v1)
+    {
+        return VectorSubstract(VectorMultiply(VectorSwizzle(v0, 3, 3, 0, 0), v1),
+                               VectorMultiply(VectorSwizzle(v0, 1, 1, 2, 2), VectorSwizzle(v1, 2, 3, 0, 1)));
+    }
+
+    /// v0 * adjugate(v1) for 2x2 blocks
+    inline VectorSIMD Matrix2MultiplyAdjugate(VectorSIMD v0, VectorSIMD v1)
+    {
+        return VectorSubstract(VectorMultiply(v0, VectorSwizzle(v1, 3, 0, 3, 0)),
+                               VectorMultiply(VectorSwizzle(v0, 1, 0, 3, 2), VectorSwizzle(v1, 2, 1, 2, 1)));
+    }
+
+    /// sum of all four lanes, replicated
+    inline VectorSIMD VectorHorizontalAdd(VectorSIMD v)
+    {
+        v = VectorAdd(v, VectorSwizzle(v, 1, 0, 3, 2));
+        return VectorAdd(v, VectorSwizzle(v, 2, 3, 0, 1));
+    }
+
+    /// cross product of the xyz lanes, w of the result is 0
+    inline VectorSIMD VectorCross3(VectorSIMD v0, VectorSIMD v1)
+    {
+        return VectorSubstract(VectorMultiply(VectorSwizzle(v0, 1, 2, 0, 3), VectorSwizzle(v1, 2, 0, 1, 3)),
+                               VectorMultiply(VectorSwizzle(v0, 2, 0, 1, 3), VectorSwizzle(v1, 1, 2, 0, 3)));
+    }
+
+    inline void VectorTranspose4(VectorSIMD& row0, VectorSIMD& row1, VectorSIMD& row2, VectorSIMD& row3)
+    {
+        const VectorSIMD t0 = VectorShuffle(row0, row1, 0, 1, 0, 1);
+        const VectorSIMD t1 = VectorShuffle(row0, row1, 2, 3, 2, 3);
+        const VectorSIMD t2 = VectorShuffle(row2, row3, 0, 1, 0, 1);
+        const VectorSIMD t3 = VectorShuffle(row2, row3, 2, 3, 2, 3);
+        row0 = VectorShuffle(t0, t2, 0, 2, 0, 2);
+        row1 = VectorShuffle(t0, t2, 1, 3, 1, 3);
+        row2 = VectorShuffle(t1, t3, 0, 2, 0, 2);
+        row3 = VectorShuffle(t1, t3, 1, 3, 1, 3);
+    }
+
+    inline void MatrixTranspose(void* result, const void* src)
+    {
+        const VectorSIMD* _src = (const VectorSIMD*)src;
+        VectorSIMD* _result = (VectorSIMD*)result;
+        VectorSIMD row0 = _src[0], row1 = _src[1], row2 = _src[2], row3 = _src[3];
+        VectorTranspose4(row0, row1, row2, row3);
+        _result[0] = row0;
+        _result[1] = row1;
+        _result[2] = row2;
+        _result[3] = row3;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////
+    // general inverse, Cramer's rule on 2x2 blocks
+    //     | A B |            1    | X Y |
+    // M = | C D |   M^-1 = ----- | Z W |
+    //                       |M|
+    // with adjugate blocks X# = |D|A - B(D#C), W# = |A|D - C(A#B),
+    // Y# = |B|C - D(A#B)#, Z# = |C|B - A(D#C)#, |M| = |A||D| + |B||C| - tr((A#B)(D#C)).
+    // A singular matrix gives non-finite results.
+    ///////////////////////////////////////////////////////////////////////////////
+    inline void MatrixInverse(void* result, const void* src)
+    {
+        const VectorSIMD* _src = (const VectorSIMD*)src;
+        VectorSIMD* _result = (VectorSIMD*)result;
+        const VectorSIMD row0 = _src[0], row1 = _src[1], row2 = _src[2], row3 = _src[3];
+
+        // 2x2 sub matrices
+        const VectorSIMD A = VectorShuffle(row0, row1, 0, 1, 0, 1);
+        const VectorSIMD B = VectorShuffle(row0, row1, 2, 3, 2, 3);
+        const VectorSIMD C = VectorShuffle(row2, row3, 0, 1, 0, 1);
+        const VectorSIMD D = VectorShuffle(row2, row3, 2, 3, 2, 3);
+
+        // (|A|, |B|, |C|, |D|)
+        const VectorSIMD detSub = VectorSubstract(
+                VectorMultiply(VectorShuffle(row0, row2, 0, 2, 0, 2), VectorShuffle(row1, row3, 1, 3, 1, 3)),
+                VectorMultiply(VectorShuffle(row0, row2, 1, 3, 1, 3), VectorShuffle(row1, row3, 0, 2, 0, 2)));
+        const VectorSIMD detA = VectorReplicate(detSub, 0);
+        const VectorSIMD detB = VectorReplicate(detSub, 1);
+        const VectorSIMD detC = VectorReplicate(detSub, 2);
+        const VectorSIMD detD = VectorReplicate(detSub, 3);
+
+        const VectorSIMD D_C = Matrix2AdjugateMultiply(D, C);
+        const VectorSIMD A_B = Matrix2AdjugateMultiply(A, B);
+        VectorSIMD X_ = VectorSubstract(VectorMultiply(detD, A), Matrix2Multiply(B, D_C));
+        VectorSIMD W_ = VectorSubstract(VectorMultiply(detA, D), Matrix2Multiply(C, A_B));
+        VectorSIMD Y_ = VectorSubstract(VectorMultiply(detB, C), Matrix2MultiplyAdjugate(D, A_B));
+        VectorSIMD Z_ = VectorSubstract(VectorMultiply(detC, B), Matrix2MultiplyAdjugate(A, D_C));
+
+        VectorSIMD detM = VectorAdd(VectorMultiply(detA, detD), VectorMultiply(detB, detC));
+        const VectorSIMD trace = VectorHorizontalAdd(VectorMultiply(A_B, VectorSwizzle(D_C, 0, 2, 1, 3)));
+        detM = VectorSubstract(detM, trace);
+
+        // (1/|M|, -1/|M|, -1/|M|, 1/|M|), the signs complete the adjugates
+        const VectorSIMD reciprocalDet = VectorDivide(MakeVectorSIMD(1.0f, -1.0f, -1.0f, 1.0f), detM);
+        X_ = VectorMultiply(X_, reciprocalDet);
+        Y_ = VectorMultiply(Y_, reciprocalDet);
+        Z_ = VectorMultiply(Z_, reciprocalDet);
+        W_ = VectorMultiply(W_, reciprocalDet);
+
+        // the adjugate swap and the block layout fold into the final shuffles
+        _result[0] = VectorShuffle(X_, Y_, 3, 1, 3, 1);
+        _result[1] = VectorShuffle(X_, Y_, 2, 0, 2, 0);
+        _result[2] = VectorShuffle(Z_, W_, 3, 1, 3, 1);
+        _result[3] = VectorShuffle(Z_, W_, 2, 0, 2, 0);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////
+    // affine inverse, the upper 3x3 R is inverted through cross products.
+    // Works for both layouts in this library: translation t in row 3 with a last
+    // column of (0, 0, 0, 1) as LookAt builds it, or translation in column 3 with a
+    // last row of (0, 0, 0, 1) as Translation builds it. One of the two translation
+    // terms below is always zero.
+    ///////////////////////////////////////////////////////////////////////////////
+    inline void MatrixInverseAffine(void* result, const void* src)
+    {
+        const VectorSIMD* _src = (const VectorSIMD*)src;
+        VectorSIMD* _result = (VectorSIMD*)result;
+        const VectorSIMD row0 = _src[0], row1 = _src[1], row2 = _src[2], row3 = _src[3];
+
+        // columns of R^-1 scaled by |R|
+        VectorSIMD c0 = VectorCross3(row1, row2);
+        VectorSIMD c1 = VectorCross3(row2, row0);
+        VectorSIMD c2 = VectorCross3(row0, row1);
+        const VectorSIMD reciprocalDet = VectorDivide(MakeVectorSIMD(1.0f, 1.0f, 1.0f, 1.0f),
+                                                      VectorHorizontalAdd(VectorMultiply(row0, c0)));
+
+        // column translation: -R^-1 * (m03, m13, m23)
+        VectorSIMD c3 = VectorMultiply(VectorReplicate(row0, 3), c0);
+        c3 = VectorMultiplyAdd(VectorReplicate(row1, 3), c1, c3);
+        c3 = VectorMultiplyAdd(VectorReplicate(row2, 3), c2, c3);
+        c3 = VectorSubstract(MakeVectorSIMD(0.0f, 0.0f, 0.0f, 0.0f), c3);
+
+        VectorTranspose4(c0, c1, c2, c3);
+        c0 = VectorMultiply(c0, reciprocalDet);
+        c1 = VectorMultiply(c1, reciprocalDet);
+        c2 = VectorMultiply(c2, reciprocalDet);
+
+        // row translation: -(m30, m31, m32) * R^-1
+        VectorSIMD r3 = VectorMultiply(VectorReplicate(row3, 0), c0);
+        r3 = VectorMultiplyAdd(VectorReplicate(row3, 1), c1, r3);
+        r3 = VectorMultiplyAdd(VectorReplicate(row3, 2), c2, r3);
+        r3 = VectorSubstract(MakeVectorSIMD(0.0f, 0.0f, 0.0f, 1.0f), r3);
+
+        _result[0] = c0;
+        _result[1] = c1;
+        _result[2] = c2;
+        _result[3] = r3;
+    }
+
+    /// Inverse of rotation + translation, R must be orthonormal so R^-1 = R^T.
+    /// Same layout rules as MatrixInverseAffine.
+    inline void MatrixInverseRigid(void* result, const void* src)
+    {
+        const VectorSIMD* _src = (const VectorSIMD*)src;
+        VectorSIMD* _result = (VectorSIMD*)result;
+        VectorSIMD row0 = _src[0], row1 = _src[1], row2 = _src[2];
+        const VectorSIMD row3 = _src[3];
+
+        // column translation: -R^T * (m03, m13, m23)
+        VectorSIMD c3 = VectorMultiply(VectorReplicate(row0, 3), row0);
+        c3 = VectorMultiplyAdd(VectorReplicate(row1, 3), row1, c3);
+        c3 = VectorMultiplyAdd(VectorReplicate(row2, 3), row2, c3);
+        c3 = VectorSubstract(MakeVectorSIMD(0.0f, 0.0f, 0.0f, 0.0f), c3);
+
+        VectorTranspose4(row0, row1, row2, c3);
+
+        // row translation: -(m30, m31, m32) * R^T
+        VectorSIMD r3 = VectorMultiply(VectorReplicate(row3, 0), row0);
+        r3 = VectorMultiplyAdd(VectorReplicate(row3, 1), row1, r3);
+        r3 = VectorMultiplyAdd(VectorReplicate(row3, 2), row2, r3);
+        r3 = VectorSubstract(MakeVectorSIMD(0.0f, 0.0f, 0.0f, 1.0f), r3);
+
+        _result[0] = row0;
+        _result[1] = row1;
+        _result[2] = row2;
+        _result[3] = r3;
+    }
+} // end of namespace mj2
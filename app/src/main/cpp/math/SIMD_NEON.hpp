@@ -25,6 +25,11 @@ namespace mj2 {
         return vectorSIMD._vectorSIMD;
     }
 
+    inline VectorSIMD VectorSplat(float f)
+    {
+        return vdupq_n_f32(f);
+    }
+
     inline VectorSIMD VectorLoad4f(const void* ptr)
     {
         return vld1q_f32((float32_t*)ptr);
@@ -35,8 +40,22 @@ namespace mj2 {
         vst1q_f32((float32_t*)ptr, v);
     }
 
+    /// vld1q/vst1q have no alignment requirement
+    inline VectorSIMD VectorLoad4fUnaligned(const void* ptr)
+    {
+        return vld1q_f32((const float32_t*)ptr);
+    }
+
+    inline void VectorStore4fUnaligned(VectorSIMD v, void* ptr)
+    {
+        vst1q_f32((float32_t*)ptr, v);
+    }
+
+#define VectorPrefetch(ptr) __builtin_prefetch(ptr)
 #define VectorReplicate(v, index) vdupq_n_f32(vgetq_lane_f32(v, index))
 #define VectorSwizzle(v, x, y, z, w) __builtin_shufflevector(v, v, x, y, z, w)
+/// (v0[x], v0[y], v1[z], v1[w])
+#define VectorShuffle(v0, v1, x, y, z, w) __builtin_shufflevector(v0, v1, x, y, (z) + 4, (w) + 4)
 
     /// Add two VectorSIMD
     inline VectorSIMD VectorAdd(VectorSIMD v0, VectorSIMD v1)
@@ -56,9 +75,82 @@ namespace mj2 {
         return vmulq_f32(v0, v1);
     }
 
+    inline VectorSIMD VectorDivide(VectorSIMD v0, VectorSIMD v1)
+    {
+#if defined(__aarch64__)
+        return vdivq_f32(v0, v1);
+#else
+        // ARMv7 has no vector divide, refine the reciprocal estimate twice
+        VectorSIMD reciprocal = vrecpeq_f32(v1);
+        reciprocal = vmulq_f32(vrecpsq_f32(v1, reciprocal), reciprocal);
+        reciprocal = vmulq_f32(vrecpsq_f32(v1, reciprocal), reciprocal);
+        return vmulq_f32(v0, reciprocal);
+#endif
+    }
+
+    inline VectorSIMD VectorSqrt(VectorSIMD v)
+    {
+#if defined(__aarch64__)
+        return vsqrtq_f32(v);
+#else
+        // v * 1/sqrt(v) with two Newton-Raphson steps, masked so that sqrt(0) stays 0
+        VectorSIMD estimate = vrsqrteq_f32(v);
+        estimate = vmulq_f32(estimate, vrsqrtsq_f32(vmulq_f32(v, estimate), estimate));
+        estimate = vmulq_f32(estimate, vrsqrtsq_f32(vmulq_f32(v, estimate), estimate));
+        const uint32x4_t nonZero = vcgtq_f32(v, vdupq_n_f32(0.0f));
+        return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(vmulq_f32(v, estimate)), nonZero));
+#endif
+    }
+
+    /// 1/sqrt(v), the 8 bit hardware estimate refined once so it is at least as good as _mm_rsqrt_ps
+    inline VectorSIMD VectorReciprocalSqrtEstimate(VectorSIMD v)
+    {
+        const VectorSIMD estimate = vrsqrteq_f32(v);
+        return vmulq_f32(estimate, vrsqrtsq_f32(vmulq_f32(v, estimate), estimate));
+    }
+
+    /// 1/sqrt(v) to ~22 bits, two Newton-Raphson steps
+    inline VectorSIMD VectorReciprocalSqrt(VectorSIMD v)
+    {
+        const VectorSIMD estimate = VectorReciprocalSqrtEstimate(v);
+        return vmulq_f32(estimate, vrsqrtsq_f32(vmulq_f32(v, estimate), estimate));
+    }
+
+    inline VectorSIMD VectorAnd(VectorSIMD v0, VectorSIMD v1)
+    {
+        return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(v0), vreinterpretq_u32_f32(v1)));
+    }
+
+    inline VectorSIMD VectorXor(VectorSIMD v0, VectorSIMD v1)
+    {
+        return vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(v0), vreinterpretq_u32_f32(v1)));
+    }
+
+    /// lanes are all ones where v0 >= v1, zero otherwise
+    inline VectorSIMD VectorCompareGE(VectorSIMD v0, VectorSIMD v1)
+    {
+        return vreinterpretq_f32_u32(vcgeq_f32(v0, v1));
+    }
+
+    /// sign bit of each lane packed into the low 4 bits, like _mm_movemask_ps
+    inline int VectorMoveMask(VectorSIMD v)
+    {
+        static const int32_t laneShift[4] = { 0, 1, 2, 3 };
+        const uint32x4_t bits = vshlq_u32(vshrq_n_u32(vreinterpretq_u32_f32(v), 31), vld1q_s32(laneShift));
+        uint32x2_t folded = vorr_u32(vget_low_u32(bits), vget_high_u32(bits));
+        folded = vpadd_u32(folded, folded);
+        return (int)vget_lane_u32(folded, 0);
+    }
+
+    inline VectorSIMD VectorAbs(VectorSIMD v)
+    {
+        return vabsq_f32(v);
+    }
+
+    /// v0 * v1 + v2, same operand order as the SSE backend
     inline VectorSIMD VectorMultiplyAdd(VectorSIMD v0, VectorSIMD v1, VectorSIMD v2)
     {
-        return vmlaq_f32(v0, v1, v2);
+        return vmlaq_f32(v2, v0, v1);
     }
 
     inline void MatrixMultiply(void* result, const void* m0, const void* m1)
@@ -98,7 +190,7 @@ namespace mj2 {
     static const VectorSIMD QMULTI_SIGN_MASK1 = MakeVectorSIMD(1.0f, 1.0f, -1.0f, -1.0f);
     static const VectorSIMD QMULTI_SIGN_MASK2 = MakeVectorSIMD(-1.0f, 1.0f, 1.0f, -1.0f);
 
-    inline VectorSIMD QuaternionMultiply2(const VectorSIMD& quat0, const VectorSIMD& quat1)
+    inline VectorSIMD VectorQuaternionMultiply2(const VectorSIMD& quat0, const VectorSIMD& quat1)
     {
         VectorSIMD result = VectorMultiply(VectorReplicate(quat0, 3), quat1);
         result = VectorMultiplyAdd(VectorMultiply(VectorReplicate(quat0, 0), VectorSwizzle(quat1, 3, 2, 1, 0)), QMULTI_SIGN_MASK0, result);
@@ -113,6 +205,6 @@ namespace mj2 {
             const void* __restrict__ quat0,
             const void* __restrict__ quat1)
     {
-        *((VectorSIMD*)resultSIMD) = QuaternionMultiply2(*((const VectorSIMD*)quat0), *((const VectorSIMD*)quat1));
+        *((VectorSIMD*)resultSIMD) = VectorQuaternionMultiply2(*((const VectorSIMD*)quat0), *((const VectorSIMD*)quat1));
     }
 } // end of namespace mj2
@@ -10,15 +10,47 @@ namespace mj2 {
         return _mm_setr_ps(fX, fY, fZ, fW);
     }
 
-#define VectorLoad4f(ptr) _mm_load_ps((float*)(ptr));
+    inline VectorSIMD VectorSplat(float f)
+    {
+        return _mm_set1_ps(f);
+    }
+
+#define VectorLoad4f(ptr) _mm_load_ps((float*)(ptr))
 #define VectorStore4f(vec, ptr) _mm_store_ps((float*)(ptr), vec)
+#define VectorLoad4fUnaligned(ptr) _mm_loadu_ps((const float*)(ptr))
+#define VectorStore4fUnaligned(vec, ptr) _mm_storeu_ps((float*)(ptr), vec)
+#define VectorPrefetch(ptr) _mm_prefetch((const char*)(ptr), _MM_HINT_T0)
 
 #define SHUFFLEMASK(A0, A1, B2, B3) ((A0) | ((A1) << 2) | ((B2) << 4) | ((B3) << 6))
 
+#define VectorAdd(v0, v1) _mm_add_ps(v0, v1)
+#define VectorSubstract(v0, v1) _mm_sub_ps(v0, v1)
 #define VectorMultiply(v0, v1) _mm_mul_ps(v0, v1)
+/// v0 * v1 + v2
 #define VectorMultiplyAdd(v0, v1, v2) _mm_add_ps(_mm_mul_ps(v0, v1), v2)
+#define VectorDivide(v0, v1) _mm_div_ps(v0, v1)
+#define VectorSqrt(v) _mm_sqrt_ps(v)
+/// 1/sqrt(v), 12 bits
+#define VectorReciprocalSqrtEstimate(v) _mm_rsqrt_ps(v)
+#define VectorAnd(v0, v1) _mm_and_ps(v0, v1)
+#define VectorXor(v0, v1) _mm_xor_ps(v0, v1)
+/// lanes are all ones where v0 >= v1, zero otherwise
+#define VectorCompareGE(v0, v1) _mm_cmpge_ps(v0, v1)
+/// sign bit of each lane packed into the low 4 bits
+#define VectorMoveMask(v) _mm_movemask_ps(v)
+#define VectorAbs(v) _mm_and_ps(v, _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff)))
 #define VectorReplicate(v, index) _mm_shuffle_ps(v, v, SHUFFLEMASK(index, index, index, index))
 #define VectorSwizzle(vec, x, y, z, w) _mm_shuffle_ps(vec, vec, SHUFFLEMASK(x, y, z, w))
+/// (v0[x], v0[y], v1[z], v1[w])
+#define VectorShuffle(v0, v1, x, y, z, w) _mm_shuffle_ps(v0, v1, SHUFFLEMASK(x, y, z, w))
+
+    /// 1/sqrt(v) to ~22 bits, the estimate refined by one Newton-Raphson step
+    inline VectorSIMD VectorReciprocalSqrt(VectorSIMD v)
+    {
+        const VectorSIMD estimate = _mm_rsqrt_ps(v);
+        const VectorSIMD halfV = _mm_mul_ps(v, _mm_set1_ps(0.5f));
+        return _mm_mul_ps(estimate, _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(halfV, _mm_mul_ps(estimate, estimate))));
+    }
 
     inline void MatrixMultiply(void* result, const void* left, const void* right)
     {
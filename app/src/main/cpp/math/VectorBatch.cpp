@@ -0,0 +1,198 @@
+#include "VectorBatch.hpp"
+
+#include "Matrix.hpp"
+#include "SIMD_Dispatch.hpp"
+
+namespace mj2
+{
+    template<bool IsPoint>
+    static inline void TransformStream(Vector3Stream out, const Vector3Stream in, const float* mat, size_t count)
+    {
+        const VectorSIMD m00 = VectorSplat(mat[0]);
+        const VectorSIMD m01 = VectorSplat(mat[1]);
+        const VectorSIMD m02 = VectorSplat(mat[2]);
+        const VectorSIMD m10 = VectorSplat(mat[4]);
+        const VectorSIMD m11 = VectorSplat(mat[5]);
+        const VectorSIMD m12 = VectorSplat(mat[6]);
+        const VectorSIMD m20 = VectorSplat(mat[8]);
+        const VectorSIMD m21 = VectorSplat(mat[9]);
+        const VectorSIMD m22 = VectorSplat(mat[10]);
+        const VectorSIMD m30 = VectorSplat(IsPoint ? mat[12] : 0.0f);
+        const VectorSIMD m31 = VectorSplat(IsPoint ? mat[13] : 0.0f);
+        const VectorSIMD m32 = VectorSplat(IsPoint ? mat[14] : 0.0f);
+
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            const VectorSIMD x = VectorLoad4fUnaligned(in.x + i);
+            const VectorSIMD y = VectorLoad4fUnaligned(in.y + i);
+            const VectorSIMD z = VectorLoad4fUnaligned(in.z + i);
+
+            VectorSIMD rx = VectorMultiplyAdd(x, m00, m30);
+            VectorSIMD ry = VectorMultiplyAdd(x, m01, m31);
+            VectorSIMD rz = VectorMultiplyAdd(x, m02, m32);
+            rx = VectorMultiplyAdd(y, m10, rx);
+            ry = VectorMultiplyAdd(y, m11, ry);
+            rz = VectorMultiplyAdd(y, m12, rz);
+            rx = VectorMultiplyAdd(z, m20, rx);
+            ry = VectorMultiplyAdd(z, m21, ry);
+            rz = VectorMultiplyAdd(z, m22, rz);
+
+            VectorStore4fUnaligned(rx, out.x + i);
+            VectorStore4fUnaligned(ry, out.y + i);
+            VectorStore4fUnaligned(rz, out.z + i);
+        }
+
+        // tail
+        const float tx = IsPoint ? mat[12] : 0.0f;
+        const float ty = IsPoint ? mat[13] : 0.0f;
+        const float tz = IsPoint ? mat[14] : 0.0f;
+        for (; i < count; i++) {
+            const float x = in.x[i];
+            const float y = in.y[i];
+            const float z = in.z[i];
+            out.x[i] = x * mat[0] + y * mat[4] + z * mat[8] + tx;
+            out.y[i] = x * mat[1] + y * mat[5] + z * mat[9] + ty;
+            out.z[i] = x * mat[2] + y * mat[6] + z * mat[10] + tz;
+        }
+    }
+
+    void TransformBatchSIMD4(Vector3Stream out, const Vector3Stream in, const float* mat, size_t count)
+    {
+        TransformStream<true>(out, in, mat, count);
+    }
+
+    void TransformBatchDirectionsSIMD4(Vector3Stream out, const Vector3Stream in, const float* mat, size_t count)
+    {
+        TransformStream<false>(out, in, mat, count);
+    }
+
+    template<Precision P>
+    static inline VectorSIMD ReciprocalLength(VectorSIMD lengthSquared)
+    {
+        if (P == Precision_Fast)
+            return VectorReciprocalSqrtEstimate(lengthSquared);
+        if (P == Precision_Accurate)
+            return VectorReciprocalSqrt(lengthSquared);
+        return VectorDivide(VectorSplat(1.0f), VectorSqrt(lengthSquared));
+    }
+
+    template<Precision P>
+    static inline void NormalizeStream(Vector3Stream out, const Vector3Stream in, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            const VectorSIMD x = VectorLoad4fUnaligned(in.x + i);
+            const VectorSIMD y = VectorLoad4fUnaligned(in.y + i);
+            const VectorSIMD z = VectorLoad4fUnaligned(in.z + i);
+
+            VectorSIMD lengthSquared = VectorMultiply(x, x);
+            lengthSquared = VectorMultiplyAdd(y, y, lengthSquared);
+            lengthSquared = VectorMultiplyAdd(z, z, lengthSquared);
+            const VectorSIMD invLength = ReciprocalLength<P>(lengthSquared);
+
+            VectorStore4fUnaligned(VectorMultiply(x, invLength), out.x + i);
+            VectorStore4fUnaligned(VectorMultiply(y, invLength), out.y + i);
+            VectorStore4fUnaligned(VectorMultiply(z, invLength), out.z + i);
+        }
+
+        // tail
+        for (; i < count; i++) {
+            const float x = in.x[i];
+            const float y = in.y[i];
+            const float z = in.z[i];
+            const float invLength = InvSqrt(x * x + y * y + z * z, P);
+            out.x[i] = x * invLength;
+            out.y[i] = y * invLength;
+            out.z[i] = z * invLength;
+        }
+    }
+
+    /////
+    // Four packed Vector3 are three registers:
+    //   a = x0 y0 z0 x1, b = y1 z1 x2 y2, c = z2 x3 y3 z3
+    // The squared components are regrouped so that one add per register yields the four
+    // squared lengths, and the reciprocal lengths are spread back in the same interleaving.
+    /////
+    template<Precision P>
+    static inline void NormalizePacked(float* out, const float* in, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            const VectorSIMD a = VectorLoad4fUnaligned(in + 3 * i);
+            const VectorSIMD b = VectorLoad4fUnaligned(in + 3 * i + 4);
+            const VectorSIMD c = VectorLoad4fUnaligned(in + 3 * i + 8);
+
+            const VectorSIMD sa = VectorMultiply(a, a);
+            const VectorSIMD sb = VectorMultiply(b, b);
+            const VectorSIMD sc = VectorMultiply(c, c);
+
+            // (x0², x1², x2², x3²), (y0², ...), (z0², ...)
+            const VectorSIMD xx = VectorShuffle(sa, VectorShuffle(sb, sc, 2, 3, 1, 0), 0, 3, 0, 2);
+            const VectorSIMD yy = VectorShuffle(VectorShuffle(sa, sb, 1, 1, 0, 0), VectorShuffle(sb, sc, 3, 3, 2, 2), 0, 2, 0, 2);
+            const VectorSIMD zz = VectorShuffle(VectorShuffle(sa, sb, 2, 2, 1, 1), VectorSwizzle(sc, 0, 0, 3, 3), 0, 2, 0, 2);
+            const VectorSIMD invLength = ReciprocalLength<P>(VectorAdd(VectorAdd(xx, yy), zz));
+
+            VectorStore4fUnaligned(VectorMultiply(a, VectorSwizzle(invLength, 0, 0, 0, 1)), out + 3 * i);
+            VectorStore4fUnaligned(VectorMultiply(b, VectorSwizzle(invLength, 1, 1, 2, 2)), out + 3 * i + 4);
+            VectorStore4fUnaligned(VectorMultiply(c, VectorSwizzle(invLength, 2, 3, 3, 3)), out + 3 * i + 8);
+        }
+
+        // tail
+        for (; i < count; i++) {
+            const float x = in[3 * i + 0];
+            const float y = in[3 * i + 1];
+            const float z = in[3 * i + 2];
+            const float invLength = InvSqrt(x * x + y * y + z * z, P);
+            out[3 * i + 0] = x * invLength;
+            out[3 * i + 1] = y * invLength;
+            out[3 * i + 2] = z * invLength;
+        }
+    }
+
+    void NormalizeArraySIMD4(Vector3Stream out, const Vector3Stream in, size_t count, Precision precision)
+    {
+        switch (precision) {
+            case Precision_Fast:
+                NormalizeStream<Precision_Fast>(out, in, count);
+                break;
+            case Precision_Accurate:
+                NormalizeStream<Precision_Accurate>(out, in, count);
+                break;
+            default:
+                NormalizeStream<Precision_Exact>(out, in, count);
+                break;
+        }
+    }
+
+    void TransformBatch(Vector3Stream out, const Vector3Stream in, const Matrix4x4& mat, size_t count)
+    {
+        GetSIMDKernels().TransformBatch(out, in, &mat.m[0][0], count);
+    }
+
+    void TransformBatchDirections(Vector3Stream out, const Vector3Stream in, const Matrix4x4& mat, size_t count)
+    {
+        GetSIMDKernels().TransformBatchDirections(out, in, &mat.m[0][0], count);
+    }
+
+    void NormalizeArray(Vector3Stream out, const Vector3Stream in, size_t count, Precision precision)
+    {
+        GetSIMDKernels().NormalizeArray(out, in, count, precision);
+    }
+
+    void NormalizeArray(Vector3* out, const Vector3* in, size_t count, Precision precision)
+    {
+        static_assert(sizeof(Vector3) == 3 * sizeof(float), "NormalizePacked expects tightly packed Vector3");
+
+        switch (precision) {
+            case Precision_Fast:
+                NormalizePacked<Precision_Fast>(&out->x, &in->x, count);
+                break;
+            case Precision_Accurate:
+                NormalizePacked<Precision_Accurate>(&out->x, &in->x, count);
+                break;
+            default:
+                NormalizePacked<Precision_Exact>(&out->x, &in->x, count);
+                break;
+        }
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+
+#include "MathUtils.hpp"
+
+namespace mj2 {
+
+    struct Matrix4x4;
+    struct Vector3;
+
+    //-------------------------------------------------------------
+    // Vector3Stream
+    //-------------------------------------------------------------
+    /// Structure-of-arrays view over a stream of 3D vectors, one array per component
+    struct Vector3Stream {
+    public:
+        float* x;
+        float* y;
+        float* z;
+    };
+
+    /// Transform count points (w = 1) by mat. Points are row vectors, out = in * mat,
+    /// which is the layout glUniformMatrix4fv(..., GL_FALSE, ...) hands to the shader.
+    /// out and in may be the same stream.
+    void TransformBatch(Vector3Stream out, const Vector3Stream in, const Matrix4x4& mat, size_t count);
+
+    /// Same as TransformBatch but for directions (w = 0), translation is ignored
+    void TransformBatchDirections(Vector3Stream out, const Vector3Stream in, const Matrix4x4& mat, size_t count);
+
+    /// Normalize count vectors, out and in may be the same stream.
+    /// Zero length vectors come out as NaN, like Vector3::Normalize.
+    void NormalizeArray(Vector3Stream out, const Vector3Stream in, size_t count, Precision precision = Precision_Accurate);
+
+    /// Same for packed Vector3 arrays (12 byte stride), deinterleaved four at a time
+    void NormalizeArray(Vector3* out, const Vector3* in, size_t count, Precision precision = Precision_Accurate);
+
+} // namespace mj2
@@ -0,0 +1,502 @@
+/////
+// Host micro-benchmarks for mj2math.
+//
+// Built twice by bench/CMakeLists.txt: mj2math_bench with the SIMD paths and
+// mj2math_bench_scalar with -DUSE_SIMD=0. The scalar binary only uses the inline
+// header code so it never links against objects compiled with the SIMD paths.
+// The SIMD binary additionally runs the batch kernels once per dispatch level
+// the CPU supports (SSE2 / AVX2+FMA on x86, NEON on ARM).
+//
+// usage: mj2math_bench [--json] [--filter <substring>] [--min-time <ms>]
+//
+// Every result is the best of several repetitions, reported as ns/op, ops/s and,
+// on x86, TSC ticks/op (reference cycles, they do not follow frequency scaling).
+/////
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "../Matrix.hpp"
+#include "../Quaternion.hpp"
+
+#if USE_SIMD
+#include "../Frustum.hpp"
+#include "../MatrixBatch.hpp"
+#include "../QuaternionBatch.hpp"
+#include "../SIMD_Dispatch.hpp"
+#include "../VectorBatch.hpp"
+#endif
+
+using namespace mj2;
+
+namespace {
+
+    //-------------------------------------------------------------
+    // Harness
+    //-------------------------------------------------------------
+    struct BenchmarkResult {
+    public:
+        std::string name;
+        std::string backend;
+        double nsPerOp;
+        double opsPerSecond;
+        double cyclesPerOp;
+        uint64_t operations;
+    };
+
+    struct BenchmarkOptions {
+    public:
+        bool json = false;
+        const char* filter = nullptr;
+        double minTimeMs = 100.0;
+    };
+
+    const int kRepetitions = 5;
+    const size_t kWorkingSet = 1024;
+
+    BenchmarkOptions gOptions;
+    std::vector<BenchmarkResult> gResults;
+
+    /// Keeps the compiler from proving a result unused and deleting the work
+    template <typename T>
+    inline void DoNotOptimize(const T& value)
+    {
+#if defined(__GNUC__)
+        asm volatile("" : : "g"(&value) : "memory");
+#else
+        static volatile const void* sink;
+        sink = &value;
+#endif
+    }
+
+    inline uint64_t ReadCycleCounter()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return 0;
+#endif
+    }
+
+    /// Runs body(iterations) with growing iteration counts until one run lasts minTimeMs,
+    /// then keeps the best of kRepetitions runs. body has to do opsPerIteration operations
+    /// per iteration.
+    template <typename Body>
+    void Run(const char* name, const char* backend, size_t opsPerIteration, Body body)
+    {
+        if (gOptions.filter && !std::strstr(name, gOptions.filter)) {
+            return;
+        }
+
+        typedef std::chrono::steady_clock Clock;
+        const double minTimeNs = gOptions.minTimeMs * 1e6;
+
+        uint64_t iterations = 1;
+        for (;;) {
+            const Clock::time_point start = Clock::now();
+            body(iterations);
+            const double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            if (elapsed >= minTimeNs / kRepetitions || iterations >= (1ull << 40)) {
+                break;
+            }
+            iterations *= 2;
+        }
+
+        double bestNs = 1e300;
+        double bestCycles = 0.0;
+        for (int rep = 0; rep < kRepetitions; rep++) {
+            const Clock::time_point start = Clock::now();
+            const uint64_t startCycles = ReadCycleCounter();
+            body(iterations);
+            const uint64_t cycles = ReadCycleCounter() - startCycles;
+            const double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            if (elapsed < bestNs) {
+                bestNs = elapsed;
+                bestCycles = double(cycles);
+            }
+        }
+
+        const double operations = double(iterations) * double(opsPerIteration);
+        BenchmarkResult result;
+        result.name = name;
+        result.backend = backend;
+        result.nsPerOp = bestNs / operations;
+        result.opsPerSecond = operations * 1e9 / bestNs;
+        result.cyclesPerOp = bestCycles / operations;
+        result.operations = uint64_t(operations);
+        gResults.push_back(result);
+
+        if (!gOptions.json) {
+            printf("%-32s %-10s %10.3f ns/op %14.0f ops/s %9.2f cycles/op\n",
+                   name, backend, result.nsPerOp, result.opsPerSecond, result.cyclesPerOp);
+        }
+    }
+
+    void PrintJson(const char* variant)
+    {
+        printf("{\n  \"variant\": \"%s\",\n  \"results\": [\n", variant);
+        for (size_t i = 0; i < gResults.size(); i++) {
+            const BenchmarkResult& r = gResults[i];
+            printf("    {\"name\": \"%s\", \"backend\": \"%s\", \"ns_per_op\": %.4f, \"ops_per_sec\": %.1f, "
+                   "\"cycles_per_op\": %.3f, \"operations\": %llu}%s\n",
+                   r.name.c_str(), r.backend.c_str(), r.nsPerOp, r.opsPerSecond, r.cyclesPerOp,
+                   (unsigned long long)r.operations, i + 1 < gResults.size() ? "," : "");
+        }
+        printf("  ]\n}\n");
+    }
+
+    //-------------------------------------------------------------
+    // Inputs
+    //-------------------------------------------------------------
+    /// xorshift, deterministic so runs stay comparable
+    float RandomFloat(float lo, float hi)
+    {
+        static uint32_t state = 0x9E3779B9u;
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return lo + (hi - lo) * float(state & 0xFFFFFF) / float(0xFFFFFF);
+    }
+
+    Matrix4x4 RandomRigidMatrix()
+    {
+        Matrix4x4 m = Matrix4x4::RotationX(RandomFloat(-3.f, 3.f)) * Matrix4x4::RotationY(RandomFloat(-3.f, 3.f));
+        m.m[3][0] = RandomFloat(-10.f, 10.f);
+        m.m[3][1] = RandomFloat(-10.f, 10.f);
+        m.m[3][2] = RandomFloat(-10.f, 10.f);
+        return m;
+    }
+
+    Quaternion RandomQuaternion()
+    {
+        Vector3 axis(RandomFloat(-1.f, 1.f), RandomFloat(-1.f, 1.f), RandomFloat(0.1f, 1.f));
+        axis.Normalize();
+        return Quaternion(axis, RandomFloat(-3.f, 3.f));
+    }
+
+    //-------------------------------------------------------------
+    // Single element operations, scalar and SIMD builds
+    //-------------------------------------------------------------
+    void RunScalarOrSIMD(const char* backend)
+    {
+        std::vector<Matrix4x4> matrices(kWorkingSet);
+        std::vector<Quaternion> quaternions(kWorkingSet);
+        std::vector<Vector3> vectors(kWorkingSet);
+        std::vector<float> angles(kWorkingSet);
+        for (size_t i = 0; i < kWorkingSet; i++) {
+            matrices[i] = RandomRigidMatrix();
+            quaternions[i] = RandomQuaternion();
+            vectors[i] = Vector3(RandomFloat(-5.f, 5.f), RandomFloat(-5.f, 5.f), RandomFloat(-5.f, 5.f));
+            angles[i] = RandomFloat(0.1f, 3.f);
+        }
+
+        Run("MatrixMultiply", backend, kWorkingSet, [&](uint64_t iterations) {
+            Matrix4x4 accumulated;
+            for (uint64_t it = 0; it < iterations; it++) {
+                for (size_t i = 0; i < kWorkingSet; i++) {
+                    accumulated = matrices[i] * matrices[(i + 1) & (kWorkingSet - 1)];
+                    DoNotOptimize(accumulated);
+                }
+            }
+        });
+
+        Run("MatrixInverse", backend, kWorkingSet, [&](uint64_t iterations) {
+            for (uint64_t it = 0; it < iterations; it++) {
+                for (size_t i = 0; i < kWorkingSet; i++) {
+                    Matrix4x4 inverse = matrices[i].Inverse();
+                    DoNotOptimize(inverse);
+                }
+            }
+        });
+
+        Run("QuaternionMultiply", backend, kWorkingSet, [&](uint64_t iterations) {
+            for (uint64_t it = 0; it < iterations; it++) {
+                for (size_t i = 0; i < kWorkingSet; i++) {
+                    Quaternion product = quaternions[i] * quaternions[(i + 1) & (kWorkingSet - 1)];
+                    DoNotOptimize(product);
+                }
+            }
+        });
+
+        Run("QuaternionRotateVector", backend, kWorkingSet, [&](uint64_t iterations) {
+            for (uint64_t it = 0; it < iterations; it++) {
+                for (size_t i = 0; i < kWorkingSet; i++) {
+                    Vector3 rotated = quaternions[i] * vectors[i];
+                    DoNotOptimize(rotated);
+                }
+            }
+        });
+
+        Run("Vector3Normalize", backend, kWorkingSet, [&](uint64_t iterations) {
+            for (uint64_t it = 0; it < iterations; it++) {
+                for (size_t i = 0; i < kWorkingSet; i++) {
+                    Vector3 v = vectors[i];
+                    v.Normalize();
+                    DoNotOptimize(v);
+                }
+            }
+        });
+
+        const Vector3 up(0.f, 1.f, 0.f);
+        Run("Vector3NormalizeFast", backend, kWorkingSet, [&](uint64_t iterations) {
+            for (uint64_t it = 0; it < iterations; it++) {
+                for (size_t i = 0; i < kWorkingSet; i++) {
+                    Vector3 v = vectors[i];
+                    v.Normalize(Precision_Fast);
+                    DoNotOptimize(v);
+                }
+            }
+        });
+
+        Run("LookAt", backend, kWorkingSet, [&](uint64_t iterations) {
+            for (uint64_t it = 0; it < iterations; it++) {
+                for (size_t i = 0; i < kWorkingSet; i++) {
+                    Matrix4x4 view = Matrix4x4::LookAt(vectors[i], vectors[(i + 1) & (kWorkingSet - 1)], up);
+                    DoNotOptimize(view);
+                }
+            }
+        });
+
+        Run("Perspective", backend, kWorkingSet, [&](uint64_t iterations) {
+            for (uint64_t it = 0; it < iterations; it++) {
+                for (size_t i = 0; i < kWorkingSet; i++) {
+                    Matrix4x4 projection = Matrix4x4::Perspective(angles[i] * 30.f, 1.5f, 0.1f, 100.f);
+                    DoNotOptimize(projection);
+                }
+            }
+        });
+
+        Run("RotationX", backend, kWorkingSet, [&](uint64_t iterations) {
+            for (uint64_t it = 0; it < iterations; it++) {
+                for (size_t i = 0; i < kWorkingSet; i++) {
+                    Matrix4x4 rotation = Matrix4x4::RotationX(angles[i]);
+                    DoNotOptimize(rotation);
+                }
+            }
+        });
+
+        Run("RotationY", backend, kWorkingSet, [&](uint64_t iterations) {
+            for (uint64_t it = 0; it < iterations; it++) {
+                for (size_t i = 0; i < kWorkingSet; i++) {
+                    Matrix4x4 rotation = Matrix4x4::RotationY(angles[i]);
+                    DoNotOptimize(rotation);
+                }
+            }
+        });
+
+        Run("RotationZ", backend, kWorkingSet, [&](uint64_t iterations) {
+            for (uint64_t it = 0; it < iterations; it++) {
+                for (size_t i = 0; i < kWorkingSet; i++) {
+                    Matrix4x4 rotation = Matrix4x4::RotationZ(angles[i]);
+                    DoNotOptimize(rotation);
+                }
+            }
+        });
+    }
+
+#if USE_SIMD
+    //-------------------------------------------------------------
+    // Batch kernels, once per dispatch level
+    //-------------------------------------------------------------
+    struct PointCloud {
+    public:
+        std::vector<float> x, y, z;
+
+        explicit PointCloud(size_t count)
+                : x(count)
+                , y(count)
+                , z(count)
+        {
+        }
+
+        Vector3Stream Stream()
+        {
+            Vector3Stream stream = { x.data(), y.data(), z.data() };
+            return stream;
+        }
+    };
+
+    void RunBatchKernels(const char* backend)
+    {
+        std::vector<Matrix4x4> parents(kWorkingSet);
+        std::vector<Matrix4x4> locals(kWorkingSet);
+        std::vector<Matrix4x4> results(kWorkingSet);
+        std::vector<int> parentIndices(kWorkingSet);
+        for (size_t i = 0; i < kWorkingSet; i++) {
+            parents[i] = RandomRigidMatrix();
+            locals[i] = RandomRigidMatrix();
+            parentIndices[i] = i == 0 ? -1 : int(i / 4);
+        }
+
+        Run("MatrixMultiplyArray", backend, kWorkingSet, [&](uint64_t iterations) {
+            for (uint64_t it = 0; it < iterations; it++) {
+                MatrixMultiplyArray(results.data(), parents.data(), locals.data(), kWorkingSet);
+                DoNotOptimize(results[0]);
+            }
+        });
+
+        Run("MatrixMultiplyHierarchy", backend, kWorkingSet, [&](uint64_t iterations) {
+            for (uint64_t it = 0; it < iterations; it++) {
+                MatrixMultiplyHierarchy(results.data(), locals.data(), parentIndices.data(), kWorkingSet);
+                DoNotOptimize(results[0]);
+            }
+        });
+
+        PointCloud points(kWorkingSet);
+        PointCloud transformed(kWorkingSet);
+        for (size_t i = 0; i < kWorkingSet; i++) {
+            points.x[i] = RandomFloat(-50.f, 50.f);
+            points.y[i] = RandomFloat(-50.f, 50.f);
+            points.z[i] = RandomFloat(-50.f, 50.f);
+        }
+
+        Run("TransformBatch", backend, kWorkingSet, [&](uint64_t iterations) {
+            for (uint64_t it = 0; it < iterations; it++) {
+                TransformBatch(transformed.Stream(), points.Stream(), parents[0], kWorkingSet);
+                DoNotOptimize(transformed.x[0]);
+            }
+        });
+
+        Run("NormalizeArray", backend, kWorkingSet, [&](uint64_t iterations) {
+            for (uint64_t it = 0; it < iterations; it++) {
+                NormalizeArray(transformed.Stream(), points.Stream(), kWorkingSet);
+                DoNotOptimize(transformed.x[0]);
+            }
+        });
+
+        Run("NormalizeArrayFast", backend, kWorkingSet, [&](uint64_t iterations) {
+            for (uint64_t it = 0; it < iterations; it++) {
+                NormalizeArray(transformed.Stream(), points.Stream(), kWorkingSet, Precision_Fast);
+                DoNotOptimize(transformed.x[0]);
+            }
+        });
+
+        std::vector<float> radius(kWorkingSet);
+        std::vector<uint32_t> visible(kWorkingSet);
+        for (size_t i = 0; i < kWorkingSet; i++) {
+            radius[i] = RandomFloat(0.1f, 2.f);
+        }
+        const SphereStream spheres = { points.x.data(), points.y.data(), points.z.data(), radius.data() };
+        const Frustum frustum = Frustum::FromMatrix(
+            Matrix4x4::LookAt(Vector3(0.f, 0.f, -60.f), Vector3(0.f, 0.f, 0.f), Vector3(0.f, 1.f, 0.f))
+            * Matrix4x4::Perspective(1.f, 1.5f, 0.1f, 100.f));
+
+        Run("CullSpheres", backend, kWorkingSet, [&](uint64_t iterations) {
+            for (uint64_t it = 0; it < iterations; it++) {
+                size_t count = CullSpheres(frustum, spheres, kWorkingSet, visible.data());
+                DoNotOptimize(count);
+            }
+        });
+    }
+
+    /// Kernels without a dispatch table, SIMD4 only
+    void RunSIMD4Kernels(const char* backend)
+    {
+        std::vector<Vector3> packed(kWorkingSet);
+        std::vector<Vector3> normalized(kWorkingSet);
+        for (size_t i = 0; i < kWorkingSet; i++) {
+            packed[i] = Vector3(RandomFloat(-5.f, 5.f), RandomFloat(-5.f, 5.f), RandomFloat(-5.f, 5.f));
+        }
+
+        Run("NormalizeArrayPacked", backend, kWorkingSet, [&](uint64_t iterations) {
+            for (uint64_t it = 0; it < iterations; it++) {
+                NormalizeArray(normalized.data(), packed.data(), kWorkingSet);
+                DoNotOptimize(normalized[0]);
+            }
+        });
+
+        std::vector<float> from[4], to[4], result[4];
+        for (int c = 0; c < 4; c++) {
+            from[c].resize(kWorkingSet);
+            to[c].resize(kWorkingSet);
+            result[c].resize(kWorkingSet);
+        }
+        for (size_t i = 0; i < kWorkingSet; i++) {
+            const Quaternion a = RandomQuaternion();
+            const Quaternion b = RandomQuaternion();
+            from[0][i] = a.x, from[1][i] = a.y, from[2][i] = a.z, from[3][i] = a.w;
+            to[0][i] = b.x, to[1][i] = b.y, to[2][i] = b.z, to[3][i] = b.w;
+        }
+        const QuaternionStream fromStream = { from[0].data(), from[1].data(), from[2].data(), from[3].data() };
+        const QuaternionStream toStream = { to[0].data(), to[1].data(), to[2].data(), to[3].data() };
+        const QuaternionStream resultStream = { result[0].data(), result[1].data(), result[2].data(), result[3].data() };
+
+        Run("QuaternionMultiplyArray", backend, kWorkingSet, [&](uint64_t iterations) {
+            for (uint64_t it = 0; it < iterations; it++) {
+                QuaternionMultiplyArray(resultStream, fromStream, toStream, kWorkingSet);
+                DoNotOptimize(result[0][0]);
+            }
+        });
+
+        Run("QuaternionSlerpArray", backend, kWorkingSet, [&](uint64_t iterations) {
+            for (uint64_t it = 0; it < iterations; it++) {
+                QuaternionSlerpArray(resultStream, fromStream, toStream, 0.3f, kWorkingSet);
+                DoNotOptimize(result[0][0]);
+            }
+        });
+    }
+#endif
+
+    bool ParseArguments(int argc, char** argv)
+    {
+        for (int i = 1; i < argc; i++) {
+            if (!std::strcmp(argv[i], "--json")) {
+                gOptions.json = true;
+            } else if (!std::strcmp(argv[i], "--filter") && i + 1 < argc) {
+                gOptions.filter = argv[++i];
+            } else if (!std::strcmp(argv[i], "--min-time") && i + 1 < argc) {
+                gOptions.minTimeMs = std::atof(argv[++i]);
+            } else {
+                fprintf(stderr, "usage: %s [--json] [--filter <substring>] [--min-time <ms>]\n", argv[0]);
+                return false;
+            }
+        }
+        return true;
+    }
+
+} // end of anonymous namespace
+
+int main(int argc, char** argv)
+{
+    if (!ParseArguments(argc, argv)) {
+        return 1;
+    }
+
+#if USE_SIMD
+    // inline header code and the non dispatched kernels always use the 4-wide backend
+#if defined(__arm__) || defined(__aarch64__)
+    const char* simd4 = "NEON";
+#else
+    const char* simd4 = "SSE";
+#endif
+    const char* variant = "simd";
+    RunScalarOrSIMD(simd4);
+    RunSIMD4Kernels(simd4);
+
+#if defined(MJ2_HAS_AVX2_KERNELS)
+    const SIMDLevel levels[] = { SIMDLevel_SSE2, SIMDLevel_AVX2 };
+#else
+    const SIMDLevel levels[] = { SIMDLevel_NEON };
+#endif
+    for (SIMDLevel level : levels) {
+        if (SetSIMDLevel(level)) {
+            RunBatchKernels(GetSIMDKernels().name);
+        }
+    }
+#else
+    const char* variant = "scalar";
+    RunScalarOrSIMD("scalar");
+#endif
+
+    if (gOptions.json) {
+        PrintJson(variant);
+    }
+    return 0;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdio>
+
+/////
+// The tests are plain executables: MJ2_CHECK reports a failed condition and carries on,
+// main returns CheckResult() so ctest sees the failure.
+/////
+
+#define MJ2_CHECK(condition) mj2::test::Check((condition), #condition, __FILE__, __LINE__)
+
+namespace mj2 {
+namespace test {
+
+    inline int& CheckFailures()
+    {
+        static int failures = 0;
+        return failures;
+    }
+
+    inline void Check(bool passed, const char* condition, const char* file, int line)
+    {
+        if (!passed) {
+            fprintf(stderr, "%s:%d: check failed: %s\n", file, line, condition);
+            CheckFailures()++;
+        }
+    }
+
+    /// exit code for main, with a line for the log
+    inline int CheckResult(const char* name)
+    {
+        if (CheckFailures() == 0) {
+            printf("%s: all checks passed\n", name);
+            return 0;
+        }
+        printf("%s: %d checks failed\n", name, CheckFailures());
+        return 1;
+    }
+
+} // namespace test
+} // namespace mj2
@@ -0,0 +1,144 @@
+/////
+// Frustum planes from view-projection matrices built with the Matrix4x4 helpers, in the
+// combinations the FromMatrix comment gives, checked against points whose place in the
+// view is known. CullSpheres and CullAABBs have to agree with the single tests.
+/////
+
+#include <cstdint>
+#include <vector>
+
+#include "../Frustum.hpp"
+#include "../Matrix.hpp"
+#include "Check.hpp"
+
+using namespace mj2;
+using namespace mj2::test;
+
+namespace {
+
+    /// LookAt looks down +z, the projections down -z
+    const float kFlipZ[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, -1, 0, 0, 0, 0, 1 };
+
+    const float kNear = 1.0f;
+    const float kFar = 100.0f;
+
+    /// the eye 5 units behind the origin, looking at it; 90 degrees, so at distance d
+    /// the view reaches d to each side
+    Matrix4x4 View()
+    {
+        return Matrix4x4::LookAt(Vector3(0.0f, 0.0f, -5.0f), Vector3(0.0f, 0.0f, 0.0f), Vector3(0.0f, 1.0f, 0.0f));
+    }
+
+    bool Visible(const Frustum& frustum, float x, float y, float z)
+    {
+        return frustum.TestSphere(x, y, z, 0.01f);
+    }
+
+    /// what every layout has to get right, z being the distance in front of the eye
+    void CheckView(const Frustum& frustum)
+    {
+        MJ2_CHECK(Visible(frustum, 0.0f, 0.0f, 0.0f));
+        MJ2_CHECK(Visible(frustum, 4.0f, 0.0f, 0.0f) && Visible(frustum, -4.0f, 0.0f, 0.0f));
+        MJ2_CHECK(Visible(frustum, 0.0f, 4.0f, 0.0f) && Visible(frustum, 0.0f, -4.0f, 0.0f));
+        MJ2_CHECK(!Visible(frustum, 6.0f, 0.0f, 0.0f) && !Visible(frustum, -6.0f, 0.0f, 0.0f));
+        MJ2_CHECK(!Visible(frustum, 0.0f, 6.0f, 0.0f) && !Visible(frustum, 0.0f, -6.0f, 0.0f));
+        MJ2_CHECK(!Visible(frustum, 0.0f, 0.0f, -10.0f));
+        MJ2_CHECK(Visible(frustum, 0.0f, 0.0f, kFar - 5.0f - 1.0f));
+        MJ2_CHECK(!Visible(frustum, 0.0f, 0.0f, kFar - 5.0f + 1.0f));
+
+        // a sphere reaching in from the side is kept, the box around it too
+        MJ2_CHECK(frustum.TestSphere(6.0f, 0.0f, 0.0f, 1.5f));
+        MJ2_CHECK(frustum.TestAABB(6.0f, 0.0f, 0.0f, 1.5f, 1.5f, 1.5f));
+        MJ2_CHECK(!frustum.TestAABB(9.0f, 0.0f, 0.0f, 1.5f, 1.5f, 1.5f));
+    }
+
+    void TestRowVectorPerspective()
+    {
+        // z in [0, w]: the near plane is at half the near distance, no further
+        Matrix4x4 projection = Matrix4x4::Perspective(90.0f, 1.0f, 1.0f, kNear, kFar);
+        const Frustum frustum = Frustum::FromMatrix(View() * Matrix4x4(kFlipZ) * projection);
+        CheckView(frustum);
+        MJ2_CHECK(Visible(frustum, 0.0f, 0.0f, -5.0f + kNear));
+        MJ2_CHECK(!Visible(frustum, 0.0f, 0.0f, -5.0f + 0.25f * kNear));
+    }
+
+    void TestColumnVectorPerspective()
+    {
+        Matrix4x4 projection = Matrix4x4::Perspective(90.0f, 1.0f, kNear, kFar).Transpose();
+        const Frustum frustum = Frustum::FromMatrix(View() * Matrix4x4(kFlipZ) * projection);
+        CheckView(frustum);
+        MJ2_CHECK(Visible(frustum, 0.0f, 0.0f, -5.0f + 1.1f * kNear));
+        MJ2_CHECK(!Visible(frustum, 0.0f, 0.0f, -5.0f + 0.9f * kNear));
+
+        // the glFrustum form is the same matrix
+        Matrix4x4 frustumProjection = Matrix4x4::Perspective(-kNear, kNear, -kNear, kNear, kNear, kFar).Transpose();
+        CheckView(Frustum::FromMatrix(View() * Matrix4x4(kFlipZ) * frustumProjection));
+    }
+
+    void TestWithoutFlip()
+    {
+        // LookAt straight into Perspective: the frustum opens behind the eye
+        Matrix4x4 projection = Matrix4x4::Perspective(90.0f, 1.0f, 1.0f, kNear, kFar);
+        const Frustum frustum = Frustum::FromMatrix(View() * projection);
+        MJ2_CHECK(!Visible(frustum, 0.0f, 0.0f, 0.0f));
+        MJ2_CHECK(Visible(frustum, 0.0f, 0.0f, -10.0f));
+    }
+
+    /// xorshift, fixed seed
+    uint32_t gRandomState = 2463534242u;
+
+    float Random(float range)
+    {
+        gRandomState ^= gRandomState << 13;
+        gRandomState ^= gRandomState >> 17;
+        gRandomState ^= gRandomState << 5;
+        return range * ((float)(gRandomState % 20001) / 10000.0f - 1.0f);
+    }
+
+    /// every count up to 37 so all the SIMD tails are covered
+    void TestCullMatchesSingleTests()
+    {
+        Matrix4x4 projection = Matrix4x4::Perspective(90.0f, 1.0f, 1.0f, kNear, kFar);
+        const Frustum frustum = Frustum::FromMatrix(View() * Matrix4x4(kFlipZ) * projection);
+
+        for (uint32_t count = 0; count <= 37; count++) {
+            std::vector<float> x(count), y(count), z(count), radius(count);
+            for (uint32_t i = 0; i < count; i++) {
+                x[i] = Random(12.0f);
+                y[i] = Random(12.0f);
+                z[i] = Random(12.0f);
+                radius[i] = 1.0f + Random(1.0f);
+            }
+
+            std::vector<uint32_t> expected;
+            std::vector<uint32_t> expectedBoxes;
+            for (uint32_t i = 0; i < count; i++) {
+                if (frustum.TestSphere(x[i], y[i], z[i], radius[i])) {
+                    expected.push_back(i);
+                }
+                if (frustum.TestAABB(x[i], y[i], z[i], radius[i], radius[i], radius[i])) {
+                    expectedBoxes.push_back(i);
+                }
+            }
+
+            std::vector<uint32_t> visible(count + 1);
+            const SphereStream spheres = { x.data(), y.data(), z.data(), radius.data() };
+            const size_t written = CullSpheres(frustum, spheres, count, visible.data());
+            MJ2_CHECK(std::vector<uint32_t>(visible.begin(), visible.begin() + written) == expected);
+
+            const AABBStream boxes = { x.data(), y.data(), z.data(), radius.data(), radius.data(), radius.data() };
+            const size_t writtenBoxes = CullAABBs(frustum, boxes, count, visible.data());
+            MJ2_CHECK(std::vector<uint32_t>(visible.begin(), visible.begin() + writtenBoxes) == expectedBoxes);
+        }
+    }
+
+} // namespace
+
+int main()
+{
+    TestRowVectorPerspective();
+    TestColumnVectorPerspective();
+    TestWithoutFlip();
+    TestCullMatchesSingleTests();
+    return CheckResult("FrustumTest");
+}
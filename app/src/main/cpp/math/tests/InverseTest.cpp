@@ -0,0 +1,254 @@
+/////
+// Matrix4x4 inverses: M * M^-1 has to come out as the identity for random affine
+// matrices in both translation layouts and for projective ones, and singular input has
+// to be reported by the bool overloads instead of handed back as a matrix.
+/////
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "../Matrix.hpp"
+#include "../MatrixBatch.hpp"
+#include "Check.hpp"
+
+using namespace mj2;
+using namespace mj2::test;
+
+namespace {
+
+    /// about 150 float epsilons; the worst camera below lands at 80
+    const float kTolerance = 2e-5f;
+
+    /// xorshift, fixed seed
+    uint32_t gRandomState = 88172645u;
+
+    /// in [-range, range]
+    float Random(float range)
+    {
+        gRandomState ^= gRandomState << 13;
+        gRandomState ^= gRandomState >> 17;
+        gRandomState ^= gRandomState << 5;
+        return range * ((float)(gRandomState % 20001) / 10000.0f - 1.0f);
+    }
+
+    /// m * inverse is the identity up to tolerance times the size of the terms summed into
+    /// each element: a camera with its near plane at 0.1 and a translation of 50 cannot
+    /// get closer than 1e-3 in absolute terms
+    bool IsInverse(const Matrix4x4& m, const Matrix4x4& inverse, float tolerance)
+    {
+        for (int i = 0; i < 4; i++) {
+            for (int j = 0; j < 4; j++) {
+                float product = 0.0f;
+                float magnitude = 0.0f;
+                for (int k = 0; k < 4; k++) {
+                    product += m.m[i][k] * inverse.m[k][j];
+                    magnitude += std::fabs(m.m[i][k] * inverse.m[k][j]);
+                }
+                if (!(std::fabs(product - (i == j ? 1.0f : 0.0f)) <= tolerance * std::max(magnitude, 1.0f))) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    bool SameMatrix(const Matrix4x4& a, const Matrix4x4& b)
+    {
+        for (int i = 0; i < 4; i++) {
+            for (int j = 0; j < 4; j++) {
+                if (a.m[i][j] != b.m[i][j]) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    Matrix4x4 Scale(float x, float y, float z)
+    {
+        return Matrix4x4(x, 0, 0, 0, 0, y, 0, 0, 0, 0, z, 0, 0, 0, 0, 1);
+    }
+
+    Matrix4x4 RandomRotation()
+    {
+        return Matrix4x4::RotationX(Random(PI_F)) * Matrix4x4::RotationY(Random(PI_F)) *
+               Matrix4x4::RotationZ(Random(PI_F));
+    }
+
+    /// non-uniform scale, never below 0.25 per axis
+    Matrix4x4 RandomScale()
+    {
+        const float x = 0.25f + std::fabs(Random(4.0f));
+        const float y = 0.25f + std::fabs(Random(4.0f));
+        const float z = 0.25f + std::fabs(Random(4.0f));
+        return Scale(Random(1.0f) < 0.0f ? -x : x, y, z);
+    }
+
+    /// translation in column 3, as Translation builds it
+    Matrix4x4 RandomColumnAffine()
+    {
+        return Matrix4x4::Translation(Random(50.0f), Random(50.0f), Random(50.0f)) * RandomRotation() * RandomScale();
+    }
+
+    void TestAffine()
+    {
+        for (int i = 0; i < 1000; i++) {
+            const Matrix4x4 column = RandomColumnAffine();
+            Matrix4x4 inverse;
+            MJ2_CHECK(column.InverseAffine(inverse));
+            MJ2_CHECK(IsInverse(column, inverse, kTolerance));
+            MJ2_CHECK(IsInverse(column, column.Inverse(), kTolerance));
+
+            const Matrix4x4 row = Matrix4x4::LookAt(Vector3(Random(20.0f), Random(20.0f), Random(20.0f)),
+                                                    Vector3(Random(1.0f), Random(1.0f), Random(1.0f)),
+                                                    Vector3(0.0f, 1.0f, 0.0f)) * RandomScale();
+            MJ2_CHECK(row.InverseAffine(inverse));
+            MJ2_CHECK(IsInverse(row, inverse, kTolerance));
+            MJ2_CHECK(IsInverse(row, row.Inverse(), kTolerance));
+        }
+    }
+
+    void TestRigid()
+    {
+        for (int i = 0; i < 1000; i++) {
+            const Matrix4x4 column = Matrix4x4::Translation(Random(50.0f), Random(50.0f), Random(50.0f)) * RandomRotation();
+            MJ2_CHECK(IsInverse(column, column.InverseRigid(), kTolerance));
+
+            const Matrix4x4 row = Matrix4x4::LookAt(Vector3(Random(20.0f), Random(20.0f), Random(20.0f)),
+                                                    Vector3(Random(1.0f), Random(1.0f), Random(1.0f)),
+                                                    Vector3(0.0f, 1.0f, 0.0f));
+            MJ2_CHECK(IsInverse(row, row.InverseRigid(), kTolerance));
+        }
+    }
+
+    void TestProjective()
+    {
+        for (int i = 0; i < 1000; i++) {
+            // a camera for row vectors like FrustumTest builds: a view with the translation
+            // in row 3 times each of the perspective forms
+            const float fNear = 0.1f + std::fabs(Random(1.0f));
+            const float fFar = fNear + 10.0f + std::fabs(Random(500.0f));
+            Matrix4x4 projection;
+            switch (i % 3) {
+                case 0:
+                    projection = Matrix4x4::Perspective(30.0f + std::fabs(Random(60.0f)), 1.0f + std::fabs(Random(1.0f)), 1.0f,
+                                                        fNear, fFar);
+                    break;
+                case 1:
+                    projection = Matrix4x4::Perspective(30.0f + std::fabs(Random(60.0f)), 0.5f + std::fabs(Random(2.0f)),
+                                                        fNear, fFar).Transpose();
+                    break;
+                default:
+                    projection = Matrix4x4::Perspective(-fNear, fNear, -fNear, fNear, fNear, fFar).Transpose();
+                    break;
+            }
+            const Matrix4x4 camera = RandomColumnAffine().Transpose() * projection;
+            Matrix4x4 inverse;
+            MJ2_CHECK(camera.Inverse(inverse));
+            MJ2_CHECK(IsInverse(camera, inverse, kTolerance));
+
+            // dense and well conditioned: random entries on a dominant diagonal
+            Matrix4x4 dense;
+            for (int r = 0; r < 4; r++) {
+                for (int c = 0; c < 4; c++) {
+                    dense.m[r][c] = Random(1.0f) + (r == c ? 4.0f : 0.0f);
+                }
+            }
+            MJ2_CHECK(dense.Inverse(inverse));
+            MJ2_CHECK(IsInverse(dense, inverse, kTolerance));
+            MJ2_CHECK(IsInverse(dense, dense.Inverse(), kTolerance));
+        }
+    }
+
+    /// the batch kernels are always SIMD, the members only with USE_SIMD
+    void TestArrays()
+    {
+        for (uint32_t count = 0; count <= 11; count++) {
+            std::vector<Matrix4x4> in(count), out(count);
+            for (uint32_t i = 0; i < count; i++) {
+                in[i] = RandomColumnAffine();
+            }
+            MatrixInverseArray(out.data(), in.data(), count);
+            for (uint32_t i = 0; i < count; i++) {
+                MJ2_CHECK(IsInverse(in[i], out[i], kTolerance));
+            }
+            MatrixInverseAffineArray(out.data(), in.data(), count);
+            for (uint32_t i = 0; i < count; i++) {
+                MJ2_CHECK(IsInverse(in[i], out[i], kTolerance));
+            }
+            // in place
+            MatrixInverseArray(out.data(), in.data(), count);
+            MatrixInverseArray(in.data(), in.data(), count);
+            for (uint32_t i = 0; i < count; i++) {
+                MJ2_CHECK(SameMatrix(in[i], out[i]));
+            }
+        }
+    }
+
+    void CheckSingular(const Matrix4x4& singular, bool affine)
+    {
+        const Matrix4x4 marker(7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7);
+        Matrix4x4 result = marker;
+        MJ2_CHECK(!singular.Inverse(result));
+        MJ2_CHECK(SameMatrix(result, marker));
+        if (affine) {
+            MJ2_CHECK(!singular.InverseAffine(result));
+            MJ2_CHECK(SameMatrix(result, marker));
+        }
+    }
+
+    void TestSingular()
+    {
+        // all zero, a zero row, a zero scale axis
+        CheckSingular(Matrix4x4(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0), true);
+        CheckSingular(Matrix4x4(1, 2, 3, 4, 0, 0, 0, 0, 5, 6, 7, 8, 9, 1, 2, 3), false);
+        CheckSingular(Matrix4x4::Translation(1.0f, 2.0f, 3.0f) * Scale(1.0f, 0.0f, 1.0f), true);
+
+        // rank 3 by construction: one row a combination of two others, where the
+        // determinant only cancels out to rounding error
+        for (int i = 0; i < 100; i++) {
+            Matrix4x4 m;
+            for (int r = 0; r < 3; r++) {
+                for (int c = 0; c < 4; c++) {
+                    m.m[r][c] = Random(10.0f);
+                }
+            }
+            const float a = Random(3.0f);
+            const float b = Random(3.0f);
+            for (int c = 0; c < 4; c++) {
+                m.m[3][c] = a * m.m[0][c] + b * m.m[2][c];
+            }
+            CheckSingular(m, false);
+
+            // affine with a flattened upper 3x3, translation in column 3
+            Matrix4x4 flat = RandomColumnAffine();
+            for (int c = 0; c < 3; c++) {
+                flat.m[2][c] = a * flat.m[0][c] - b * flat.m[1][c];
+            }
+            CheckSingular(flat, true);
+        }
+
+        // NaN is never invertible
+        Matrix4x4 nan;
+        nan.m[1][2] = std::nanf("");
+        CheckSingular(nan, true);
+
+        // tiny but regular: the test is relative, a uniformly scaled matrix still inverts
+        Matrix4x4 inverse;
+        const Matrix4x4 tiny = Scale(1e-6f, 1e-6f, 1e-6f);
+        MJ2_CHECK(tiny.Inverse(inverse) && tiny.InverseAffine(inverse));
+    }
+
+} // namespace
+
+int main()
+{
+    TestAffine();
+    TestRigid();
+    TestProjective();
+    TestArrays();
+    TestSingular();
+    return CheckResult("InverseTest");
+}
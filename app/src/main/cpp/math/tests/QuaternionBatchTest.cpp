@@ -0,0 +1,252 @@
+/////
+// The QuaternionBatch kernels against the scalar Quaternion code, for every count up to
+// two full SIMD iterations plus a tail of three, so each tail length is covered and
+// nothing past count is written. Slerp is held to the error bound its header states.
+/////
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "../Quaternion.hpp"
+#include "../QuaternionBatch.hpp"
+#include "Check.hpp"
+
+using namespace mj2;
+using namespace mj2::test;
+
+namespace {
+
+    /// quaternions per SIMD iteration in QuaternionBatch.cpp
+    const uint32_t kWidth = 4;
+    const uint32_t kMaxCount = 2 * kWidth + 3;
+
+    /// what QuaternionSlerpArray promises in QuaternionBatch.hpp
+    const float kSlerpBound = 3e-5f;
+
+    /// written after the last element; a kernel that touches it overran its count
+    const float kGuard = 12345.0f;
+
+    /// xorshift, fixed seed
+    uint32_t gRandomState = 1234567u;
+
+    /// in [-range, range]
+    float Random(float range)
+    {
+        gRandomState ^= gRandomState << 13;
+        gRandomState ^= gRandomState >> 17;
+        gRandomState ^= gRandomState << 5;
+        return range * ((float)(gRandomState % 20001) / 10000.0f - 1.0f);
+    }
+
+    Quaternion RandomUnit()
+    {
+        Quaternion q;
+        float length;
+        do {
+            q = Quaternion(Random(1.0f), Random(1.0f), Random(1.0f), Random(1.0f));
+            length = std::sqrt(q | q);
+        } while (length < 0.1f);
+        return q / length;
+    }
+
+    /// SoA arrays with one guard element past count
+    struct Stream {
+    public:
+        explicit Stream(uint32_t count)
+                : x(count + 1, kGuard)
+                , y(count + 1, kGuard)
+                , z(count + 1, kGuard)
+                , w(count + 1, kGuard)
+        {
+        }
+
+        QuaternionStream View() { return QuaternionStream{ x.data(), y.data(), z.data(), w.data() }; }
+
+        void Set(uint32_t i, const Quaternion& q)
+        {
+            x[i] = q.x;
+            y[i] = q.y;
+            z[i] = q.z;
+            w[i] = q.w;
+        }
+
+        Quaternion Get(uint32_t i) const { return Quaternion(x[i], y[i], z[i], w[i]); }
+
+        bool GuardIntact() const
+        {
+            return x.back() == kGuard && y.back() == kGuard && z.back() == kGuard && w.back() == kGuard;
+        }
+
+        std::vector<float> x, y, z, w;
+    };
+
+    float Distance(const Quaternion& a, const Quaternion& b)
+    {
+        return std::max(std::max(std::fabs(a.x - b.x), std::fabs(a.y - b.y)),
+                        std::max(std::fabs(a.z - b.z), std::fabs(a.w - b.w)));
+    }
+
+    /// reference slerp in double, shortest arc
+    Quaternion ExactSlerp(const Quaternion& from, const Quaternion& to, float t)
+    {
+        double dot = (double)from.x * to.x + (double)from.y * to.y + (double)from.z * to.z + (double)from.w * to.w;
+        const double sign = dot < 0.0 ? -1.0 : 1.0;
+        dot = std::min(std::fabs(dot), 1.0);
+        const double theta = std::acos(dot);
+        double a = 1.0 - t;
+        double b = t;
+        if (theta > 1e-6) {
+            a = std::sin((1.0 - t) * theta) / std::sin(theta);
+            b = std::sin(t * theta) / std::sin(theta);
+        }
+        b *= sign;
+        return Quaternion((float)(a * from.x + b * to.x), (float)(a * from.y + b * to.y),
+                          (float)(a * from.z + b * to.z), (float)(a * from.w + b * to.w));
+    }
+
+    Quaternion ScalarNlerp(const Quaternion& from, const Quaternion& to, float t)
+    {
+        const Quaternion target = (from | to) < 0.0f ? to * -1.0f : to;
+        const Quaternion blend = from + (target - from) * t;
+        return blend / std::sqrt(blend | blend);
+    }
+
+    void TestMultiply()
+    {
+        for (uint32_t count = 0; count <= kMaxCount; count++) {
+            Stream left(count), right(count), out(count);
+            std::vector<Quaternion> aosLeft(count), aosRight(count), aosOut(count);
+            for (uint32_t i = 0; i < count; i++) {
+                aosLeft[i] = RandomUnit();
+                aosRight[i] = RandomUnit();
+                left.Set(i, aosLeft[i]);
+                right.Set(i, aosRight[i]);
+            }
+
+            QuaternionMultiplyArray(out.View(), left.View(), right.View(), count);
+            QuaternionMultiplyArray(aosOut.data(), aosLeft.data(), aosRight.data(), count);
+            for (uint32_t i = 0; i < count; i++) {
+                const Quaternion expected = aosLeft[i] * aosRight[i];
+                MJ2_CHECK(Distance(out.Get(i), expected) <= 1e-6f);
+                MJ2_CHECK(Distance(aosOut[i], expected) <= 1e-6f);
+            }
+            MJ2_CHECK(out.GuardIntact());
+
+            // out aliasing an input
+            QuaternionMultiplyArray(left.View(), left.View(), right.View(), count);
+            for (uint32_t i = 0; i < count; i++) {
+                MJ2_CHECK(Distance(left.Get(i), out.Get(i)) == 0.0f);
+            }
+        }
+    }
+
+    void TestNormalize()
+    {
+        for (uint32_t count = 0; count <= kMaxCount; count++) {
+            Stream in(count), out(count);
+            for (uint32_t i = 0; i < count; i++) {
+                in.Set(i, RandomUnit() * (0.5f + std::fabs(Random(4.0f))));
+            }
+            QuaternionNormalizeArray(out.View(), in.View(), count);
+            for (uint32_t i = 0; i < count; i++) {
+                const Quaternion q = in.Get(i);
+                MJ2_CHECK(Distance(out.Get(i), q / std::sqrt(q | q)) <= 1e-6f);
+            }
+            MJ2_CHECK(out.GuardIntact());
+        }
+    }
+
+    void TestNlerp()
+    {
+        const float weights[] = { 0.0f, 0.25f, 0.5f, 0.8f, 1.0f };
+        for (float t : weights) {
+            for (uint32_t count = 0; count <= kMaxCount; count++) {
+                Stream from(count), to(count), out(count);
+                for (uint32_t i = 0; i < count; i++) {
+                    from.Set(i, RandomUnit());
+                    to.Set(i, RandomUnit());
+                }
+                QuaternionNlerpArray(out.View(), from.View(), to.View(), t, count);
+                for (uint32_t i = 0; i < count; i++) {
+                    MJ2_CHECK(Distance(out.Get(i), ScalarNlerp(from.Get(i), to.Get(i), t)) <= 2e-6f);
+                }
+                MJ2_CHECK(out.GuardIntact());
+            }
+        }
+    }
+
+    void TestSlerp()
+    {
+        float worst = 0.0f;
+        for (int round = 0; round < 200; round++) {
+            const float t = round % 20 == 0 ? (float)(round / 20 % 2) : std::fabs(Random(1.0f));
+            for (uint32_t count = 0; count <= kMaxCount; count++) {
+                Stream from(count), to(count), out(count);
+                for (uint32_t i = 0; i < count; i++) {
+                    const Quaternion a = RandomUnit();
+                    Quaternion b = RandomUnit();
+                    // the ends of the range: the same rotation, and nearly opposite ones
+                    // that the shortest arc turns into nearly the same
+                    if (i % 5 == 1) {
+                        b = a;
+                    } else if (i % 5 == 3) {
+                        b = a * -1.0f + Quaternion(Random(1e-3f), Random(1e-3f), Random(1e-3f), Random(1e-3f));
+                        b = b / std::sqrt(b | b);
+                    }
+                    from.Set(i, a);
+                    to.Set(i, b);
+                }
+                QuaternionSlerpArray(out.View(), from.View(), to.View(), t, count);
+                for (uint32_t i = 0; i < count; i++) {
+                    worst = std::max(worst, Distance(out.Get(i), ExactSlerp(from.Get(i), to.Get(i), t)));
+                }
+                MJ2_CHECK(out.GuardIntact());
+            }
+        }
+        MJ2_CHECK(worst <= kSlerpBound);
+    }
+
+    void TestToMatrix()
+    {
+        for (uint32_t count = 0; count <= kMaxCount; count++) {
+            Stream in(count);
+            for (uint32_t i = 0; i < count; i++) {
+                in.Set(i, RandomUnit());
+            }
+
+            // one guard matrix after the last
+            std::vector<Matrix4x4> out(count + 1);
+            for (float& f : out[count].m[0]) {
+                f = kGuard;
+            }
+            QuaternionToMatrixArray(out.data(), in.View(), count);
+
+            for (uint32_t i = 0; i < count; i++) {
+                Matrix4x4 expected;
+                in.Get(i).ToMatrix(expected);
+                float error = 0.0f;
+                for (int r = 0; r < 4; r++) {
+                    for (int c = 0; c < 4; c++) {
+                        error = std::max(error, std::fabs(out[i].m[r][c] - expected.m[r][c]));
+                    }
+                }
+                MJ2_CHECK(error <= 1e-6f);
+            }
+            MJ2_CHECK(std::all_of(out[count].m[0], out[count].m[0] + 4, [](float f) { return f == kGuard; }));
+            MJ2_CHECK(out[count].m[1][1] == 1.0f && out[count].m[3][3] == 1.0f);
+        }
+    }
+
+} // namespace
+
+int main()
+{
+    TestMultiply();
+    TestNormalize();
+    TestNlerp();
+    TestSlerp();
+    TestToMatrix();
+    return CheckResult("QuaternionBatchTest");
+}
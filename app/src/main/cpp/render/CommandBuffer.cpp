@@ -0,0 +1,382 @@
+#include "CommandBuffer.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace mj2
+{
+    enum CommandType
+    {
+        CommandType_DeleteBuffer = 0,
+        CommandType_BindBuffer,
+        CommandType_BufferData,
+        CommandType_BufferSubData,
+        CommandType_VertexAttribPointer,
+        CommandType_EnableVertexAttribArray,
+        CommandType_DisableVertexAttribArray,
+        CommandType_VertexAttribDivisor,
+        CommandType_UseProgram,
+        CommandType_Uniform1i,
+        CommandType_Uniform4fv,
+        CommandType_UniformMatrix4fv,
+        CommandType_ActiveTexture,
+        CommandType_BindTexture,
+        CommandType_BindFramebuffer,
+        CommandType_FramebufferColorTexture,
+        CommandType_FramebufferDepthRenderbuffer,
+        CommandType_DrawArrays,
+        CommandType_DrawElements,
+        CommandType_DrawElementsInstanced
+    };
+
+    struct CommandHeader {
+    public:
+        uint32_t type;
+        uint32_t size;  // of the whole command, payload and padding included
+    };
+
+    /// one name or value, for a location where the call has one
+    struct ValueCommand {
+    public:
+        CommandHeader header;
+        int32_t location;
+        uint32_t value;
+    };
+
+    /// followed by size bytes when hasData
+    struct BufferDataCommand {
+    public:
+        CommandHeader header;
+        uint32_t target;
+        uint32_t usage;
+        uint64_t offset;
+        uint64_t size;
+        uint32_t hasData;
+    };
+
+    struct AttributeCommand {
+    public:
+        CommandHeader header;
+        uint32_t location;
+        uint32_t components;
+        uint32_t format;
+        uint32_t stride;
+        uint64_t offset;
+    };
+
+    /// followed by the values, 4 or 16 floats per count
+    struct UniformCommand {
+    public:
+        CommandHeader header;
+        int32_t location;
+        uint32_t count;
+    };
+
+    struct DrawCommand {
+    public:
+        CommandHeader header;
+        uint32_t primitive;
+        uint32_t first;
+        uint32_t count;
+        uint32_t instanceCount;
+        uint64_t offset;
+    };
+
+    CommandBuffer::CommandBuffer()
+            : used(0)
+            , commandCount(0)
+            , supportsInstancing(false)
+    {
+    }
+
+    void CommandBuffer::Clear()
+    {
+        used = 0;
+        commandCount = 0;
+    }
+
+    void* CommandBuffer::Append(size_t size)
+    {
+        size = (size + 7) & ~(size_t)7;
+        if (storage.size() - used < size) {
+            storage.resize(std::max(storage.size() * 2, used + size));
+        }
+        CommandHeader* header = (CommandHeader*)&storage[used];
+        header->size = (uint32_t)size;
+        used += size;
+        commandCount++;
+        return header;
+    }
+
+    template <typename Command>
+    static Command* Record(void* memory, CommandType type)
+    {
+        Command* command = (Command*)memory;
+        command->header.type = type;
+        return command;
+    }
+
+    static void RecordValue(void* memory, CommandType type, int32_t location, uint32_t value)
+    {
+        ValueCommand* command = Record<ValueCommand>(memory, type);
+        command->location = location;
+        command->value = value;
+    }
+
+    //-------------------------------------------------------------
+    // Recording
+    //-------------------------------------------------------------
+    uint32_t CommandBuffer::CreateBuffer()
+    {
+        return 0;
+    }
+
+    void CommandBuffer::DeleteBuffer(uint32_t buffer)
+    {
+        RecordValue(Append(sizeof(ValueCommand)), CommandType_DeleteBuffer, -1, buffer);
+    }
+
+    void CommandBuffer::BindBuffer(BufferTarget target, uint32_t buffer)
+    {
+        RecordValue(Append(sizeof(ValueCommand)), CommandType_BindBuffer, (int32_t)target, buffer);
+    }
+
+    void CommandBuffer::BufferData(BufferTarget target, size_t size, const void* data, BufferUsage usage)
+    {
+        BufferDataCommand* command = Record<BufferDataCommand>(
+                Append(sizeof(BufferDataCommand) + (data ? size : 0)), CommandType_BufferData);
+        command->target = target;
+        command->usage = usage;
+        command->offset = 0;
+        command->size = size;
+        command->hasData = data != nullptr;
+        if (data) {
+            memcpy(command + 1, data, size);
+        }
+    }
+
+    void CommandBuffer::BufferSubData(BufferTarget target, size_t offset, size_t size, const void* data)
+    {
+        BufferDataCommand* command = Record<BufferDataCommand>(Append(sizeof(BufferDataCommand) + size),
+                                                               CommandType_BufferSubData);
+        command->target = target;
+        command->usage = 0;
+        command->offset = offset;
+        command->size = size;
+        command->hasData = 1;
+        memcpy(command + 1, data, size);
+    }
+
+    void CommandBuffer::VertexAttribPointer(uint32_t location, uint32_t components, AttributeFormat format,
+                                            uint32_t stride, size_t offset)
+    {
+        AttributeCommand* command = Record<AttributeCommand>(Append(sizeof(AttributeCommand)),
+                                                             CommandType_VertexAttribPointer);
+        command->location = location;
+        command->components = components;
+        command->format = format;
+        command->stride = stride;
+        command->offset = offset;
+    }
+
+    void CommandBuffer::EnableVertexAttribArray(uint32_t location)
+    {
+        RecordValue(Append(sizeof(ValueCommand)), CommandType_EnableVertexAttribArray, (int32_t)location, 0);
+    }
+
+    void CommandBuffer::DisableVertexAttribArray(uint32_t location)
+    {
+        RecordValue(Append(sizeof(ValueCommand)), CommandType_DisableVertexAttribArray, (int32_t)location, 0);
+    }
+
+    void CommandBuffer::VertexAttribDivisor(uint32_t location, uint32_t divisor)
+    {
+        RecordValue(Append(sizeof(ValueCommand)), CommandType_VertexAttribDivisor, (int32_t)location, divisor);
+    }
+
+    void CommandBuffer::UseProgram(uint32_t program)
+    {
+        RecordValue(Append(sizeof(ValueCommand)), CommandType_UseProgram, -1, program);
+    }
+
+    void CommandBuffer::Uniform1i(int32_t location, int32_t value)
+    {
+        RecordValue(Append(sizeof(ValueCommand)), CommandType_Uniform1i, location, (uint32_t)value);
+    }
+
+    void CommandBuffer::Uniform4fv(int32_t location, uint32_t count, const float* values)
+    {
+        const size_t bytes = (size_t)count * 4 * sizeof(float);
+        UniformCommand* command = Record<UniformCommand>(Append(sizeof(UniformCommand) + bytes), CommandType_Uniform4fv);
+        command->location = location;
+        command->count = count;
+        memcpy(command + 1, values, bytes);
+    }
+
+    void CommandBuffer::UniformMatrix4fv(int32_t location, uint32_t count, const float* values)
+    {
+        const size_t bytes = (size_t)count * 16 * sizeof(float);
+        UniformCommand* command = Record<UniformCommand>(Append(sizeof(UniformCommand) + bytes),
+                                                         CommandType_UniformMatrix4fv);
+        command->location = location;
+        command->count = count;
+        memcpy(command + 1, values, bytes);
+    }
+
+    void CommandBuffer::ActiveTexture(uint32_t unit)
+    {
+        RecordValue(Append(sizeof(ValueCommand)), CommandType_ActiveTexture, -1, unit);
+    }
+
+    void CommandBuffer::BindTexture(uint32_t texture)
+    {
+        RecordValue(Append(sizeof(ValueCommand)), CommandType_BindTexture, -1, texture);
+    }
+
+    void CommandBuffer::BindFramebuffer(uint32_t framebuffer)
+    {
+        RecordValue(Append(sizeof(ValueCommand)), CommandType_BindFramebuffer, -1, framebuffer);
+    }
+
+    void CommandBuffer::FramebufferColorTexture(uint32_t texture)
+    {
+        RecordValue(Append(sizeof(ValueCommand)), CommandType_FramebufferColorTexture, -1, texture);
+    }
+
+    void CommandBuffer::FramebufferDepthRenderbuffer(uint32_t renderbuffer)
+    {
+        RecordValue(Append(sizeof(ValueCommand)), CommandType_FramebufferDepthRenderbuffer, -1, renderbuffer);
+    }
+
+    void CommandBuffer::DrawArrays(PrimitiveType primitive, uint32_t first, uint32_t count)
+    {
+        DrawCommand* command = Record<DrawCommand>(Append(sizeof(DrawCommand)), CommandType_DrawArrays);
+        command->primitive = primitive;
+        command->first = first;
+        command->count = count;
+        command->instanceCount = 1;
+        command->offset = 0;
+    }
+
+    void CommandBuffer::DrawElements(PrimitiveType primitive, uint32_t count, size_t offset)
+    {
+        DrawCommand* command = Record<DrawCommand>(Append(sizeof(DrawCommand)), CommandType_DrawElements);
+        command->primitive = primitive;
+        command->first = 0;
+        command->count = count;
+        command->instanceCount = 1;
+        command->offset = offset;
+    }
+
+    bool CommandBuffer::SupportsInstancing()
+    {
+        return supportsInstancing;
+    }
+
+    void CommandBuffer::DrawElementsInstanced(PrimitiveType primitive, uint32_t count, size_t offset,
+                                              uint32_t instanceCount)
+    {
+        DrawCommand* command = Record<DrawCommand>(Append(sizeof(DrawCommand)), CommandType_DrawElementsInstanced);
+        command->primitive = primitive;
+        command->first = 0;
+        command->count = count;
+        command->instanceCount = instanceCount;
+        command->offset = offset;
+    }
+
+    //-------------------------------------------------------------
+    // Replay
+    //-------------------------------------------------------------
+    void CommandBuffer::Execute(RenderBackend& target) const
+    {
+        for (size_t position = 0; position < used;) {
+            const uint8_t* memory = &storage[position];
+            const CommandHeader& header = *(const CommandHeader*)memory;
+            const ValueCommand& value = *(const ValueCommand*)memory;
+            position += header.size;
+
+            switch (header.type) {
+                case CommandType_DeleteBuffer:
+                    target.DeleteBuffer(value.value);
+                    break;
+                case CommandType_BindBuffer:
+                    target.BindBuffer((BufferTarget)value.location, value.value);
+                    break;
+                case CommandType_BufferData: {
+                    const BufferDataCommand& command = *(const BufferDataCommand*)memory;
+                    target.BufferData((BufferTarget)command.target, (size_t)command.size,
+                                      command.hasData ? &command + 1 : nullptr, (BufferUsage)command.usage);
+                    break;
+                }
+                case CommandType_BufferSubData: {
+                    const BufferDataCommand& command = *(const BufferDataCommand*)memory;
+                    target.BufferSubData((BufferTarget)command.target, (size_t)command.offset, (size_t)command.size,
+                                         &command + 1);
+                    break;
+                }
+                case CommandType_VertexAttribPointer: {
+                    const AttributeCommand& command = *(const AttributeCommand*)memory;
+                    target.VertexAttribPointer(command.location, command.components, (AttributeFormat)command.format,
+                                               command.stride, (size_t)command.offset);
+                    break;
+                }
+                case CommandType_EnableVertexAttribArray:
+                    target.EnableVertexAttribArray((uint32_t)value.location);
+                    break;
+                case CommandType_DisableVertexAttribArray:
+                    target.DisableVertexAttribArray((uint32_t)value.location);
+                    break;
+                case CommandType_VertexAttribDivisor:
+                    target.VertexAttribDivisor((uint32_t)value.location, value.value);
+                    break;
+                case CommandType_UseProgram:
+                    target.UseProgram(value.value);
+                    break;
+                case CommandType_Uniform1i:
+                    target.Uniform1i(value.location, (int32_t)value.value);
+                    break;
+                case CommandType_Uniform4fv: {
+                    const UniformCommand& command = *(const UniformCommand*)memory;
+                    target.Uniform4fv(command.location, command.count, (const float*)(&command + 1));
+                    break;
+                }
+                case CommandType_UniformMatrix4fv: {
+                    const UniformCommand& command = *(const UniformCommand*)memory;
+                    target.UniformMatrix4fv(command.location, command.count, (const float*)(&command + 1));
+                    break;
+                }
+                case CommandType_ActiveTexture:
+                    target.ActiveTexture(value.value);
+                    break;
+                case CommandType_BindTexture:
+                    target.BindTexture(value.value);
+                    break;
+                case CommandType_BindFramebuffer:
+                    target.BindFramebuffer(value.value);
+                    break;
+                case CommandType_FramebufferColorTexture:
+                    target.FramebufferColorTexture(value.value);
+                    break;
+                case CommandType_FramebufferDepthRenderbuffer:
+                    target.FramebufferDepthRenderbuffer(value.value);
+                    break;
+                case CommandType_DrawArrays: {
+                    const DrawCommand& command = *(const DrawCommand*)memory;
+                    target.DrawArrays((PrimitiveType)command.primitive, command.first, command.count);
+                    break;
+                }
+                case CommandType_DrawElements: {
+                    const DrawCommand& command = *(const DrawCommand*)memory;
+                    target.DrawElements((PrimitiveType)command.primitive, command.count, (size_t)command.offset);
+                    break;
+                }
+                case CommandType_DrawElementsInstanced: {
+                    const DrawCommand& command = *(const DrawCommand*)memory;
+                    target.DrawElementsInstanced((PrimitiveType)command.primitive, command.count,
+                                                 (size_t)command.offset, command.instanceCount);
+                    break;
+                }
+            }
+        }
+    }
+}
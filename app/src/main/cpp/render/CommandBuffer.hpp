@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "RenderBackend.hpp"
+
+namespace mj2 {
+
+    //-------------------------------------------------------------
+    // CommandBuffer
+    //-------------------------------------------------------------
+    /////
+    // A RenderBackend that records instead of drawing, so frame preparation (culling,
+    // sorting a RenderQueue, computing uniforms) can run on worker threads while GL
+    // stays on the one thread that owns the context.
+    //
+    // Every call becomes a small POD command appended to one linear block: an 8 byte
+    // header and the arguments, followed by whatever the call pointed at (uniform
+    // values, buffer data), so the caller's memory can go away once the call returns.
+    // Execute replays the commands in recorded order into another backend, normally the
+    // StateCache on the GL thread, which then drops what an earlier buffer already set.
+    // Clear keeps the memory, after the first few frames recording allocates nothing.
+    //
+    // One buffer per recording thread, no locking inside. Object names come from the GL
+    // thread: CreateBuffer cannot be recorded and returns 0, a failure to callers.
+    // DeleteBuffer is recorded and happens on replay. SupportsInstancing answers what
+    // SetSupportsInstancing was told, the real backend's answer for the current context.
+    /////
+    class CommandBuffer : public RenderBackend {
+    public:
+        CommandBuffer();
+
+        CommandBuffer(const CommandBuffer&) = delete;
+        CommandBuffer& operator=(const CommandBuffer&) = delete;
+
+        /// Replays every command into target, in recorded order; GL thread only
+        void Execute(RenderBackend& target) const;
+        /// Drops the commands, keeping the memory
+        void Clear();
+
+        bool Empty() const { return commandCount == 0; }
+        uint32_t CommandCount() const { return commandCount; }
+        /// bytes recorded / held
+        size_t Bytes() const { return used; }
+        size_t Capacity() const { return storage.size(); }
+
+        /// set on the GL thread, for every new context
+        void SetSupportsInstancing(bool supported) { supportsInstancing = supported; }
+
+        uint32_t CreateBuffer() override;
+        void DeleteBuffer(uint32_t buffer) override;
+        void BindBuffer(BufferTarget target, uint32_t buffer) override;
+        void BufferData(BufferTarget target, size_t size, const void* data, BufferUsage usage) override;
+        void BufferSubData(BufferTarget target, size_t offset, size_t size, const void* data) override;
+
+        void VertexAttribPointer(uint32_t location, uint32_t components, AttributeFormat format, uint32_t stride,
+                                 size_t offset) override;
+        void EnableVertexAttribArray(uint32_t location) override;
+        void DisableVertexAttribArray(uint32_t location) override;
+
+        void UseProgram(uint32_t program) override;
+        void Uniform1i(int32_t location, int32_t value) override;
+        void Uniform4fv(int32_t location, uint32_t count, const float* values) override;
+        void UniformMatrix4fv(int32_t location, uint32_t count, const float* values) override;
+
+        void ActiveTexture(uint32_t unit) override;
+        void BindTexture(uint32_t texture) override;
+
+        void BindFramebuffer(uint32_t framebuffer) override;
+        void FramebufferColorTexture(uint32_t texture) override;
+        void FramebufferDepthRenderbuffer(uint32_t renderbuffer) override;
+
+        void DrawArrays(PrimitiveType primitive, uint32_t first, uint32_t count) override;
+        void DrawElements(PrimitiveType primitive, uint32_t count, size_t offset) override;
+
+        bool SupportsInstancing() override;
+        void VertexAttribDivisor(uint32_t location, uint32_t divisor) override;
+        void DrawElementsInstanced(PrimitiveType primitive, uint32_t count, size_t offset,
+                                   uint32_t instanceCount) override;
+
+    private:
+        /// room for a command of size bytes, payload included, 8 byte aligned
+        void* Append(size_t size);
+
+        std::vector<uint8_t> storage;
+        size_t used;
+        uint32_t commandCount;
+        bool supportsInstancing;
+    };
+
+} // namespace mj2
@@ -0,0 +1,190 @@
+#include "InstancedMesh.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace mj2
+{
+    static const uint32_t MatrixBytes = 16 * sizeof(float);
+
+    uint32_t PseudoInstancingBatchSize(uint32_t maxVertexUniformVectors, uint32_t reservedVectors)
+    {
+        // a mat4 takes 4 vectors
+        return maxVertexUniformVectors > reservedVectors ? (maxVertexUniformVectors - reservedVectors) / 4 : 0;
+    }
+
+    InstancedMesh::InstancedMesh(RenderBackend& backend)
+            : backend(backend)
+            , mesh(backend)
+            , mode(InstancingMode_Hardware)
+            , batchSize(0)
+            , indexCount(0)
+            , attributeCount(0)
+            , instanceBuffer(0)
+            , instanceBytes(0)
+            , draws(0)
+    {
+    }
+
+    InstancedMesh::~InstancedMesh()
+    {
+        Destroy();
+    }
+
+    InstancingMode InstancedMesh::ModeFor(RenderBackend& backend)
+    {
+        return backend.SupportsInstancing() ? InstancingMode_Hardware : InstancingMode_Pseudo;
+    }
+
+    bool InstancedMesh::Create(InstancingMode mode, uint32_t maxBatch, const VertexLayout& layout,
+                               const void* vertices, uint32_t vertexCount, const uint16_t* indices,
+                               uint32_t indexCount)
+    {
+        if (vertexCount == 0 || vertexCount > MaxVerticesPerPart || indexCount == 0) {
+            return false;
+        }
+        for (uint32_t i = 0; i < indexCount; i++) {
+            if (indices[i] >= vertexCount) {
+                return false;
+            }
+        }
+
+        this->mode = mode;
+        this->indexCount = indexCount;
+        attributeCount = layout.attributeCount;
+        if (mode == InstancingMode_Hardware) {
+            batchSize = 0;
+            if (!instanceBuffer) {
+                instanceBuffer = backend.CreateBuffer();
+            }
+            return instanceBuffer && mesh.Create(layout, vertices, vertexCount, indices, indexCount,
+                                                 BufferUsage_Static);
+        }
+
+        // drop a stream left from the hardware path
+        if (instanceBuffer) {
+            backend.DeleteBuffer(instanceBuffer);
+            instanceBuffer = 0;
+            instanceBytes = 0;
+        }
+        batchSize = std::min(maxBatch, MaxVerticesPerPart / vertexCount);
+        if (batchSize == 0 || layout.attributeCount >= MaxVertexAttributes) {
+            return false;
+        }
+
+        // every copy is the vertex followed by its number, kept 4 byte aligned
+        VertexLayout copyLayout = layout;
+        const uint32_t idOffset = (layout.stride + 3) & ~3u;
+        copyLayout.stride = idOffset + sizeof(float);
+        copyLayout.attributes[copyLayout.attributeCount++] = VertexAttribute{ 1, AttributeFormat_Float, idOffset };
+
+        std::vector<uint8_t> copies((size_t)batchSize * vertexCount * copyLayout.stride, 0);
+        std::vector<uint16_t> copyIndices((size_t)batchSize * indexCount);
+        uint8_t* out = copies.data();
+        for (uint32_t copy = 0; copy < batchSize; copy++) {
+            const float id = (float)copy;
+            const uint8_t* in = (const uint8_t*)vertices;
+            for (uint32_t i = 0; i < vertexCount; i++, in += layout.stride, out += copyLayout.stride) {
+                memcpy(out, in, layout.stride);
+                memcpy(out + idOffset, &id, sizeof(id));
+            }
+            const uint32_t base = copy * vertexCount;
+            uint16_t* copyIndex = &copyIndices[(size_t)copy * indexCount];
+            for (uint32_t i = 0; i < indexCount; i++) {
+                copyIndex[i] = (uint16_t)(base + indices[i]);
+            }
+        }
+        return mesh.Create(copyLayout, copies.data(), batchSize * vertexCount, copyIndices.data(),
+                           batchSize * indexCount, BufferUsage_Static);
+    }
+
+    void InstancedMesh::Draw(RenderBackend& target, const InstancingProgram& program, uint32_t texture,
+                             const float* matrices, uint32_t instanceCount)
+    {
+        draws = 0;
+        if (!IsValid() || instanceCount == 0) {
+            return;
+        }
+        target.UseProgram(program.program);
+        if (program.textureLocation >= 0) {
+            target.ActiveTexture(0);
+            target.BindTexture(texture);
+            target.Uniform1i(program.textureLocation, 0);
+        }
+        if (mode == InstancingMode_Hardware) {
+            DrawHardware(target, program, matrices, instanceCount);
+        } else {
+            DrawPseudo(target, program, matrices, instanceCount);
+        }
+    }
+
+    void InstancedMesh::DrawHardware(RenderBackend& target, const InstancingProgram& program, const float* matrices,
+                                     uint32_t instanceCount)
+    {
+        if (program.instanceMatrixLocation < 0) {
+            return;
+        }
+        mesh.Bind(target, program.attributeLocations);
+
+        // a stream buffer respecified whole, the driver hands out fresh storage instead of
+        // waiting for the last frame's draw to finish reading it
+        instanceBytes = (size_t)instanceCount * MatrixBytes;
+        target.BindBuffer(BufferTarget_Vertex, instanceBuffer);
+        target.BufferData(BufferTarget_Vertex, instanceBytes, matrices, BufferUsage_Stream);
+
+        // a mat4 attribute is four vec4 columns at consecutive locations
+        const uint32_t location = (uint32_t)program.instanceMatrixLocation;
+        for (uint32_t column = 0; column < 4; column++) {
+            target.EnableVertexAttribArray(location + column);
+            target.VertexAttribPointer(location + column, 4, AttributeFormat_Float, MatrixBytes,
+                                       column * 4 * sizeof(float));
+            target.VertexAttribDivisor(location + column, 1);
+        }
+        target.DrawElementsInstanced(PrimitiveType_Triangles, indexCount, 0, instanceCount);
+        draws++;
+
+        // a divisor stays with the location, whatever uses it next expects one per vertex
+        for (uint32_t column = 0; column < 4; column++) {
+            target.VertexAttribDivisor(location + column, 0);
+            target.DisableVertexAttribArray(location + column);
+        }
+    }
+
+    void InstancedMesh::DrawPseudo(RenderBackend& target, const InstancingProgram& program, const float* matrices,
+                                   uint32_t instanceCount)
+    {
+        if (program.instanceArrayLocation < 0) {
+            return;
+        }
+        int32_t locations[MaxVertexAttributes];
+        std::copy(program.attributeLocations, program.attributeLocations + attributeCount, locations);
+        locations[attributeCount] = program.instanceIdLocation;
+        mesh.Bind(target, locations);
+
+        // the copies are back to back in the index buffer, the first n of them are n instances
+        for (uint32_t first = 0; first < instanceCount; first += batchSize) {
+            const uint32_t count = std::min(batchSize, instanceCount - first);
+            target.UniformMatrix4fv(program.instanceArrayLocation, count, matrices + (size_t)first * 16);
+            mesh.DrawRange(target, 0, count * indexCount);
+            draws++;
+        }
+    }
+
+    void InstancedMesh::Invalidate()
+    {
+        mesh.Invalidate();
+        instanceBuffer = 0;
+        instanceBytes = 0;
+    }
+
+    void InstancedMesh::Destroy()
+    {
+        mesh.Destroy();
+        if (instanceBuffer) {
+            backend.DeleteBuffer(instanceBuffer);
+        }
+        instanceBuffer = 0;
+        instanceBytes = 0;
+    }
+}
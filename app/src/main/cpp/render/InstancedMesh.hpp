@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "MeshBuffer.hpp"
+#include "RenderBackend.hpp"
+
+namespace mj2 {
+
+    enum InstancingMode
+    {
+        InstancingMode_Hardware = 0, // one instanced draw, a mat4 attribute per instance
+        InstancingMode_Pseudo        // mesh copies picking their matrix from a uniform array
+    };
+
+    /// A program drawing instances and where its inputs are, -1 for what it does not use
+    struct InstancingProgram {
+    public:
+        uint32_t program;
+        int32_t textureLocation;        // sampler2D, always unit 0
+        int32_t attributeLocations[MaxVertexAttributes]; // in the mesh layout's order
+        int32_t instanceMatrixLocation; // hardware: mat4 attribute, this location and the 3 after it
+        int32_t instanceIdLocation;     // pseudo: float attribute, the copy's index in its batch
+        int32_t instanceArrayLocation;  // pseudo: mat4 uniform array, BatchSize() long
+    };
+
+    /// Matrices that fit the pseudo instancing uniform array next to reservedVectors
+    /// other vec4 uniforms, from GL_MAX_VERTEX_UNIFORM_VECTORS (at least 128 in ES 2)
+    uint32_t PseudoInstancingBatchSize(uint32_t maxVertexUniformVectors, uint32_t reservedVectors);
+
+    //-------------------------------------------------------------
+    // InstancedMesh
+    //-------------------------------------------------------------
+    /////
+    // One mesh drawn many times with a matrix per instance, in as few draw calls as the
+    // context allows, instead of a uniform upload and a draw per copy.
+    //
+    // Hardware: with instanced arrays the matrices are streamed into a vertex buffer
+    // and read through a mat4 attribute with divisor 1, one draw for every instance.
+    //
+    // Pseudo: ES 2 without the extension. The mesh is stored BatchSize() times with a
+    // trailing float attribute holding the copy's number, and the vertex shader indexes
+    // a uniform mat4 array with it; each draw uploads up to BatchSize() matrices and
+    // draws that many copies. The copies have to fit 16 bit indices, so the batch is
+    // also limited to 65536 / vertexCount.
+    //
+    // The two modes need different vertex shaders, the program has to match the mode.
+    // Matrices are column major, 16 floats per instance, the whole object to clip
+    // transform as RenderQueue takes it.
+    /////
+    class InstancedMesh {
+    public:
+        explicit InstancedMesh(RenderBackend& backend);
+        /// deletes the buffers
+        ~InstancedMesh();
+
+        InstancedMesh(const InstancedMesh&) = delete;
+        InstancedMesh& operator=(const InstancedMesh&) = delete;
+
+        /// Hardware when the backend supports it, pseudo instancing otherwise
+        static InstancingMode ModeFor(RenderBackend& backend);
+
+        /// vertexCount at most 65536 and a free attribute slot in the layout for pseudo
+        /// instancing; maxBatch is the uniform array's length, ignored by the hardware path.
+        /// Replaces the previous contents. False on bad input or when buffers cannot be made.
+        bool Create(InstancingMode mode, uint32_t maxBatch, const VertexLayout& layout, const void* vertices,
+                    uint32_t vertexCount, const uint16_t* indices, uint32_t indexCount);
+
+        /// Draws instanceCount instances with the program, texture on unit 0. Leaves the
+        /// mesh's index buffer and attributes bound, every divisor at 0 and the instance
+        /// attributes disabled. In hardware mode the vertex buffer bound is the instance
+        /// stream, not the mesh's.
+        void Draw(const InstancingProgram& program, uint32_t texture, const float* matrices, uint32_t instanceCount)
+        {
+            Draw(backend, program, texture, matrices, instanceCount);
+        }
+        /// The same through target, e.g. a CommandBuffer; one recording thread at a time
+        void Draw(RenderBackend& target, const InstancingProgram& program, uint32_t texture, const float* matrices,
+                  uint32_t instanceCount);
+
+        /// Forget the buffers without deleting them, after the context was lost
+        void Invalidate();
+        void Destroy();
+
+        bool IsValid() const { return mesh.IsValid(); }
+        InstancingMode Mode() const { return mode; }
+        /// instances per draw call, 0 for as many as given in hardware mode
+        uint32_t BatchSize() const { return mode == InstancingMode_Hardware ? 0 : batchSize; }
+        /// draw calls of the last Draw
+        uint32_t Draws() const { return draws; }
+        /// GPU memory of the mesh, its copies and the instance stream
+        size_t Bytes() const { return mesh.Bytes() + instanceBytes; }
+
+    private:
+        void DrawHardware(RenderBackend& target, const InstancingProgram& program, const float* matrices,
+                          uint32_t instanceCount);
+        void DrawPseudo(RenderBackend& target, const InstancingProgram& program, const float* matrices,
+                        uint32_t instanceCount);
+
+        RenderBackend& backend;
+        MeshBuffer mesh;
+        InstancingMode mode;
+        uint32_t batchSize;
+        uint32_t indexCount;      // of one copy
+        uint32_t attributeCount;  // of the layout given to Create
+        uint32_t instanceBuffer;  // hardware: the matrices, orphaned by each Draw
+        size_t instanceBytes;
+        uint32_t draws;
+    };
+
+} // namespace mj2
@@ -0,0 +1,251 @@
+#include "MeshBuffer.hpp"
+
+namespace mj2
+{
+    static bool IsValidLayout(const VertexLayout& layout)
+    {
+        if (layout.stride == 0 || layout.attributeCount == 0 || layout.attributeCount > MaxVertexAttributes) {
+            return false;
+        }
+        for (uint32_t i = 0; i < layout.attributeCount; i++) {
+            const VertexAttribute& attribute = layout.attributes[i];
+            if (attribute.components == 0 || attribute.components > 4 || attribute.offset >= layout.stride) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    MeshBuffer::MeshBuffer(RenderBackend& backend)
+            : backend(backend)
+            , layout()
+            , vertexBuffer(0)
+            , indexBuffer(0)
+            , vertexCount(0)
+            , indexCount(0)
+            , usage(BufferUsage_Static)
+    {
+    }
+
+    MeshBuffer::~MeshBuffer()
+    {
+        Destroy();
+    }
+
+    bool MeshBuffer::Upload(const VertexLayout& layout, const void* vertices, uint32_t vertexCount,
+                            const uint16_t* indices, uint32_t indexCount, BufferUsage usage)
+    {
+        if (!vertexBuffer) {
+            vertexBuffer = backend.CreateBuffer();
+        }
+        if (!indexBuffer) {
+            indexBuffer = backend.CreateBuffer();
+        }
+        if (!vertexBuffer || !indexBuffer) {
+            Destroy();
+            return false;
+        }
+
+        this->layout = layout;
+        this->vertexCount = vertexCount;
+        this->indexCount = indexCount;
+        this->usage = usage;
+        backend.BindBuffer(BufferTarget_Vertex, vertexBuffer);
+        backend.BufferData(BufferTarget_Vertex, (size_t)vertexCount * layout.stride, vertices, usage);
+        backend.BindBuffer(BufferTarget_Index, indexBuffer);
+        backend.BufferData(BufferTarget_Index, (size_t)indexCount * sizeof(uint16_t), indices, usage);
+        return true;
+    }
+
+    bool MeshBuffer::Create(const VertexLayout& layout, const void* vertices, uint32_t vertexCount,
+                            const uint16_t* indices, uint32_t indexCount, BufferUsage usage)
+    {
+        if (!IsValidLayout(layout) || vertexCount == 0 || vertexCount > MaxVerticesPerPart || indexCount == 0 ||
+            indexCount % 3 != 0) {
+            return false;
+        }
+        for (uint32_t i = 0; i < indexCount; i++) {
+            if (indices[i] >= vertexCount) {
+                return false;
+            }
+        }
+        if (!Upload(layout, vertices, vertexCount, indices, indexCount, usage)) {
+            return false;
+        }
+        parts.assign(1, MeshPart{ 0, 0, indexCount });
+        return true;
+    }
+
+    bool MeshBuffer::Create(const VertexLayout& layout, const void* vertices, uint32_t vertexCount,
+                            const uint32_t* indices, uint32_t indexCount, BufferUsage usage)
+    {
+        if (!IsValidLayout(layout) || vertexCount == 0 || indexCount == 0 || indexCount % 3 != 0) {
+            return false;
+        }
+        for (uint32_t i = 0; i < indexCount; i++) {
+            if (indices[i] >= vertexCount) {
+                return false;
+            }
+        }
+
+        if (vertexCount <= MaxVerticesPerPart) {
+            std::vector<uint16_t> narrow(indices, indices + indexCount);
+            return Create(layout, vertices, vertexCount, narrow.data(), indexCount, usage);
+        }
+
+        // Triangles go into the current part in order; a part closes when the next one
+        // would bring in more vertices than 16 bit indices reach from its base.
+        const uint8_t* source = (const uint8_t*)vertices;
+        std::vector<uint8_t> packed;
+        std::vector<uint16_t> narrow;
+        std::vector<int32_t> local(vertexCount, -1);
+        std::vector<uint32_t> used;
+        std::vector<MeshPart> split;
+        packed.reserve((size_t)vertexCount * layout.stride);
+        narrow.reserve(indexCount);
+        used.reserve(MaxVerticesPerPart);
+        split.push_back(MeshPart{ 0, 0, 0 });
+
+        for (uint32_t i = 0; i < indexCount; i += 3) {
+            const uint32_t* triangle = indices + i;
+            uint32_t added = 0;
+            for (uint32_t j = 0; j < 3; j++) {
+                const bool repeated = (j > 0 && triangle[j] == triangle[0]) || (j > 1 && triangle[j] == triangle[1]);
+                added += local[triangle[j]] < 0 && !repeated ? 1 : 0;
+            }
+            if (used.size() + added > MaxVerticesPerPart) {
+                for (uint32_t vertex : used) {
+                    local[vertex] = -1;
+                }
+                used.clear();
+                split.push_back(MeshPart{ (uint32_t)(packed.size() / layout.stride), (uint32_t)narrow.size(), 0 });
+            }
+            for (uint32_t j = 0; j < 3; j++) {
+                const uint32_t vertex = triangle[j];
+                if (local[vertex] < 0) {
+                    local[vertex] = (int32_t)used.size();
+                    used.push_back(vertex);
+                    const uint8_t* in = source + (size_t)vertex * layout.stride;
+                    packed.insert(packed.end(), in, in + layout.stride);
+                }
+                narrow.push_back((uint16_t)local[vertex]);
+            }
+            split.back().indexCount += 3;
+        }
+
+        if (!Upload(layout, packed.data(), (uint32_t)(packed.size() / layout.stride), narrow.data(), indexCount, usage)) {
+            return false;
+        }
+        parts.swap(split);
+        return true;
+    }
+
+    void MeshBuffer::UpdateVertices(uint32_t first, uint32_t count, const void* vertices)
+    {
+        if (!vertexBuffer || parts.size() != 1 || first > vertexCount || count > vertexCount - first || count == 0) {
+            return;
+        }
+        backend.BindBuffer(BufferTarget_Vertex, vertexBuffer);
+        if (usage == BufferUsage_Stream && first == 0 && count == vertexCount) {
+            backend.BufferData(BufferTarget_Vertex, (size_t)count * layout.stride, vertices, usage);
+        } else {
+            backend.BufferSubData(BufferTarget_Vertex, (size_t)first * layout.stride, (size_t)count * layout.stride, vertices);
+        }
+    }
+
+    void MeshBuffer::UpdateIndices(uint32_t first, uint32_t count, const uint16_t* indices)
+    {
+        if (!indexBuffer || parts.size() != 1 || first > indexCount || count > indexCount - first || count == 0) {
+            return;
+        }
+        backend.BindBuffer(BufferTarget_Index, indexBuffer);
+        if (usage == BufferUsage_Stream && first == 0 && count == indexCount) {
+            backend.BufferData(BufferTarget_Index, (size_t)count * sizeof(uint16_t), indices, usage);
+        } else {
+            backend.BufferSubData(BufferTarget_Index, (size_t)first * sizeof(uint16_t), (size_t)count * sizeof(uint16_t), indices);
+        }
+    }
+
+    void MeshBuffer::Bind(RenderBackend& target, const int32_t* locations) const
+    {
+        if (!IsValid()) {
+            return;
+        }
+        target.BindBuffer(BufferTarget_Vertex, vertexBuffer);
+        target.BindBuffer(BufferTarget_Index, indexBuffer);
+        for (uint32_t i = 0; i < layout.attributeCount; i++) {
+            if (locations[i] >= 0) {
+                target.EnableVertexAttribArray((uint32_t)locations[i]);
+            }
+        }
+        BindPart(target, 0, locations);
+    }
+
+    void MeshBuffer::BindPart(RenderBackend& target, uint32_t index, const int32_t* locations) const
+    {
+        if (!IsValid() || index >= parts.size()) {
+            return;
+        }
+        const size_t base = (size_t)parts[index].baseVertex * layout.stride;
+        for (uint32_t i = 0; i < layout.attributeCount; i++) {
+            const VertexAttribute& attribute = layout.attributes[i];
+            if (locations[i] >= 0) {
+                target.VertexAttribPointer((uint32_t)locations[i], attribute.components, attribute.format, layout.stride,
+                                           base + attribute.offset);
+            }
+        }
+    }
+
+    void MeshBuffer::Unbind(const int32_t* locations) const
+    {
+        for (uint32_t i = 0; i < layout.attributeCount; i++) {
+            if (locations[i] >= 0) {
+                backend.DisableVertexAttribArray((uint32_t)locations[i]);
+            }
+        }
+        backend.BindBuffer(BufferTarget_Vertex, 0);
+        backend.BindBuffer(BufferTarget_Index, 0);
+    }
+
+    void MeshBuffer::Draw(const int32_t* locations) const
+    {
+        for (uint32_t i = 0; i < parts.size(); i++) {
+            if (i > 0) {
+                BindPart(i, locations);
+            }
+            backend.DrawElements(PrimitiveType_Triangles, parts[i].indexCount, parts[i].firstIndex * sizeof(uint16_t));
+        }
+        // leave part 0 bound, as Bind does, so DrawRange works after Draw
+        if (parts.size() > 1) {
+            BindPart(0, locations);
+        }
+    }
+
+    void MeshBuffer::DrawRange(RenderBackend& target, uint32_t firstIndex, uint32_t indexCount) const
+    {
+        if (!IsValid()) {
+            return;
+        }
+        target.DrawElements(PrimitiveType_Triangles, indexCount, (size_t)firstIndex * sizeof(uint16_t));
+    }
+
+    void MeshBuffer::Invalidate()
+    {
+        vertexBuffer = 0;
+        indexBuffer = 0;
+        parts.clear();
+        vertexCount = 0;
+        indexCount = 0;
+    }
+
+    void MeshBuffer::Destroy()
+    {
+        if (vertexBuffer) {
+            backend.DeleteBuffer(vertexBuffer);
+        }
+        if (indexBuffer) {
+            backend.DeleteBuffer(indexBuffer);
+        }
+        Invalidate();
+    }
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "RenderBackend.hpp"
+
+namespace mj2 {
+
+    static const uint32_t MaxVertexAttributes = 8;
+
+    /// 16 bit indices reach this many vertices from one base
+    static const uint32_t MaxVerticesPerPart = 65536;
+
+    struct VertexAttribute {
+    public:
+        uint32_t components; // 1 to 4
+        AttributeFormat format;
+        uint32_t offset;     // bytes from the start of the vertex
+    };
+
+    /// Interleaved vertices: attribute i of every vertex at offset, stride bytes apart
+    struct VertexLayout {
+    public:
+        uint32_t stride;
+        uint32_t attributeCount;
+        VertexAttribute attributes[MaxVertexAttributes];
+    };
+
+    /// A range of the index buffer whose indices count from baseVertex
+    struct MeshPart {
+    public:
+        uint32_t baseVertex;
+        uint32_t firstIndex;
+        uint32_t indexCount;
+    };
+
+    //-------------------------------------------------------------
+    // MeshBuffer
+    //-------------------------------------------------------------
+    /////
+    // Interleaved vertices and 16 bit triangle list indices in a VBO / IBO pair, uploaded
+    // once instead of handing client arrays to glVertexAttribPointer, which makes the
+    // driver copy every vertex on every draw.
+    //
+    // Meshes up to 65536 vertices are one part. Bigger triangle lists are split into
+    // parts of at most that many vertices (the ones shared across a split are stored
+    // twice) and each part points the attributes at its own base vertex, since GLES 2
+    // has neither 32 bit indices without an extension nor a base vertex in the draw.
+    //
+    // Attribute locations are the caller's: Bind takes one per layout attribute, in
+    // layout order, and skips the negative ones (attributes the shader optimised out).
+    //
+    // Buffers are made and filled through the backend given to the constructor, on the
+    // GL thread. Binding and drawing can go to another one, a CommandBuffer recording on
+    // a worker, as long as the mesh is not recreated meanwhile.
+    /////
+    class MeshBuffer {
+    public:
+        explicit MeshBuffer(RenderBackend& backend);
+        /// deletes the buffers
+        ~MeshBuffer();
+
+        MeshBuffer(const MeshBuffer&) = delete;
+        MeshBuffer& operator=(const MeshBuffer&) = delete;
+
+        /// One part of whole triangles, vertexCount at most 65536 and every index below it.
+        /// Replaces the previous contents, reusing the buffer names. False on bad input or
+        /// when the buffers cannot be created.
+        bool Create(const VertexLayout& layout, const void* vertices, uint32_t vertexCount, const uint16_t* indices,
+                    uint32_t indexCount, BufferUsage usage);
+
+        /// Triangle lists of any size, split into parts as needed
+        bool Create(const VertexLayout& layout, const void* vertices, uint32_t vertexCount, const uint32_t* indices,
+                    uint32_t indexCount, BufferUsage usage);
+
+        /// Rewrite vertices [first, first + count) of a single part mesh, nothing when the
+        /// range is empty or not inside the mesh. A stream mesh rewritten whole orphans the
+        /// old storage, so a draw still reading it does not stall.
+        void UpdateVertices(uint32_t first, uint32_t count, const void* vertices);
+        void UpdateIndices(uint32_t first, uint32_t count, const uint16_t* indices);
+
+        /// Binds both buffers and points the attributes at part 0, nothing when not valid
+        void Bind(const int32_t* locations) const { Bind(backend, locations); }
+        void Bind(RenderBackend& target, const int32_t* locations) const;
+        /// Points the attributes at part index, the buffers have to be bound; nothing for
+        /// an index past PartCount()
+        void BindPart(uint32_t index, const int32_t* locations) const { BindPart(backend, index, locations); }
+        void BindPart(RenderBackend& target, uint32_t index, const int32_t* locations) const;
+        void Unbind(const int32_t* locations) const;
+
+        /// Draws every part, rebinding attributes between them; Bind first
+        void Draw(const int32_t* locations) const;
+        /// indexCount indices from firstIndex, counted from the start of the index buffer;
+        /// the part they belong to has to be bound (Bind binds part 0); nothing when not valid
+        void DrawRange(uint32_t firstIndex, uint32_t indexCount) const { DrawRange(backend, firstIndex, indexCount); }
+        void DrawRange(RenderBackend& target, uint32_t firstIndex, uint32_t indexCount) const;
+
+        /// Forget the buffers without deleting them, after the context was lost
+        void Invalidate();
+        void Destroy();
+
+        bool IsValid() const { return vertexBuffer != 0; }
+        uint32_t VertexBuffer() const { return vertexBuffer; }
+        uint32_t IndexBuffer() const { return indexBuffer; }
+        const VertexLayout& Layout() const { return layout; }
+        uint32_t VertexCount() const { return vertexCount; }
+        uint32_t IndexCount() const { return indexCount; }
+        uint32_t PartCount() const { return (uint32_t)parts.size(); }
+        const MeshPart& Part(uint32_t index) const { return parts[index]; }
+        /// GPU memory of both buffers
+        size_t Bytes() const { return (size_t)vertexCount * layout.stride + (size_t)indexCount * sizeof(uint16_t); }
+
+    private:
+        bool Upload(const VertexLayout& layout, const void* vertices, uint32_t vertexCount, const uint16_t* indices,
+                    uint32_t indexCount, BufferUsage usage);
+
+        RenderBackend& backend;
+        VertexLayout layout;
+        std::vector<MeshPart> parts;
+        uint32_t vertexBuffer;
+        uint32_t indexBuffer;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        BufferUsage usage;
+    };
+
+} // namespace mj2
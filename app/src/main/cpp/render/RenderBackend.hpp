@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace mj2 {
+
+    enum BufferTarget
+    {
+        BufferTarget_Vertex = 0, // GL_ARRAY_BUFFER
+        BufferTarget_Index       // GL_ELEMENT_ARRAY_BUFFER, 16 bit indices
+    };
+
+    enum BufferUsage
+    {
+        BufferUsage_Static = 0,  // uploaded once, drawn many times
+        BufferUsage_Dynamic,     // parts rewritten now and then
+        BufferUsage_Stream       // rewritten every frame, each update orphans the old storage
+    };
+
+    enum AttributeFormat
+    {
+        AttributeFormat_Float = 0,       // GL_FLOAT
+        AttributeFormat_UByteNormalized, // GL_UNSIGNED_BYTE, normalized to [0, 1]
+        AttributeFormat_ShortNormalized  // GL_SHORT, normalized to [-1, 1]
+    };
+
+    enum PrimitiveType
+    {
+        PrimitiveType_Triangles = 0,
+        PrimitiveType_TriangleStrip,
+        PrimitiveType_Lines,
+        PrimitiveType_Points
+    };
+
+    //-------------------------------------------------------------
+    // RenderBackend
+    //-------------------------------------------------------------
+    /////
+    // The GL side of the render library, which itself makes no GL calls: gl_code.cpp
+    // forwards these one to one to GLES 2, a desktop build can record or check them.
+    // Buffers, programs, textures and framebuffers are GL names, 0 is none. Offsets into
+    // the bound buffers are in bytes, uniform locations are -1 for none.
+    /////
+    class RenderBackend {
+    public:
+        virtual ~RenderBackend() {}
+
+        /// returns 0 on failure
+        virtual uint32_t CreateBuffer() = 0;
+        virtual void DeleteBuffer(uint32_t buffer) = 0;
+        virtual void BindBuffer(BufferTarget target, uint32_t buffer) = 0;
+        /// (re)allocates the bound buffer; data may be nullptr to leave it undefined
+        virtual void BufferData(BufferTarget target, size_t size, const void* data, BufferUsage usage) = 0;
+        virtual void BufferSubData(BufferTarget target, size_t offset, size_t size, const void* data) = 0;
+
+        /// offset into the bound vertex buffer
+        virtual void VertexAttribPointer(uint32_t location, uint32_t components, AttributeFormat format, uint32_t stride,
+                                         size_t offset) = 0;
+        virtual void EnableVertexAttribArray(uint32_t location) = 0;
+        virtual void DisableVertexAttribArray(uint32_t location) = 0;
+
+        virtual void UseProgram(uint32_t program) = 0;
+        /// uniforms of the program in use
+        virtual void Uniform1i(int32_t location, int32_t value) = 0;
+        virtual void Uniform4fv(int32_t location, uint32_t count, const float* values) = 0;
+        /// column major, count matrices of 16 floats
+        virtual void UniformMatrix4fv(int32_t location, uint32_t count, const float* values) = 0;
+
+        /// GL_TEXTURE0 + unit
+        virtual void ActiveTexture(uint32_t unit) = 0;
+        /// GL_TEXTURE_2D of the active unit
+        virtual void BindTexture(uint32_t texture) = 0;
+
+        /// 0 is the window
+        virtual void BindFramebuffer(uint32_t framebuffer) = 0;
+        /// attachments of the bound framebuffer, 0 detaches
+        virtual void FramebufferColorTexture(uint32_t texture) = 0;
+        virtual void FramebufferDepthRenderbuffer(uint32_t renderbuffer) = 0;
+
+        virtual void DrawArrays(PrimitiveType primitive, uint32_t first, uint32_t count) = 0;
+        /// count 16 bit indices starting offset bytes into the bound index buffer
+        virtual void DrawElements(PrimitiveType primitive, uint32_t count, size_t offset) = 0;
+
+        /// GL_EXT_instanced_arrays, GL_ANGLE_instanced_arrays or ES 3; the two calls below
+        /// are only made when this is true
+        virtual bool SupportsInstancing() = 0;
+        /// attribute location advances once every divisor instances, 0 is once per vertex
+        virtual void VertexAttribDivisor(uint32_t location, uint32_t divisor) = 0;
+        /// DrawElements, instanceCount times
+        virtual void DrawElementsInstanced(PrimitiveType primitive, uint32_t count, size_t offset,
+                                           uint32_t instanceCount) = 0;
+    };
+
+} // namespace mj2
@@ -0,0 +1,153 @@
+#include "RenderQueue.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace mj2
+{
+    uint64_t MakeSortKey(uint32_t layer, uint32_t target, uint32_t program, uint32_t texture, uint32_t depth)
+    {
+        return (uint64_t)(layer & 0xF) << 60 | (uint64_t)(target & 0xFF) << 52 | (uint64_t)(program & 0xFFF) << 40 |
+               (uint64_t)(texture & 0xFFFF) << 24 | (uint64_t)(depth & 0xFFFFFF);
+    }
+
+    uint32_t QuantizeDepth(float depth, float nearPlane, float farPlane, bool backToFront)
+    {
+        const float range = farPlane - nearPlane;
+        float t = range > 0.0f ? (depth - nearPlane) / range : 0.0f;
+        // written so a NaN fails the comparison and lands on the near plane
+        t = t > 0.0f ? std::min(t, 1.0f) : 0.0f;
+        const uint32_t quantized = (uint32_t)(t * 16777215.0 + 0.5);  // a float has no room for the .5
+        return backToFront ? 0xFFFFFF - quantized : quantized;
+    }
+
+    static const float IdentityTransform[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+
+    static bool SameTransform(const float* a, const float* b)
+    {
+        return a == b || (a && b && memcmp(a, b, 16 * sizeof(float)) == 0);
+    }
+
+    /// b can be drawn by extending a's draw
+    static bool CanMerge(const DrawItem& a, uint32_t aCount, const DrawItem& b)
+    {
+        return a.framebuffer == b.framebuffer && a.program == b.program && a.texture == b.texture &&
+               a.mesh == b.mesh && a.part == b.part && a.firstIndex + aCount == b.firstIndex &&
+               SameTransform(a.transform, b.transform);
+    }
+
+    RenderQueue::RenderQueue(RenderBackend& backend)
+            : backend(backend)
+            , stats()
+            , boundProgram(nullptr)
+            , boundMesh(nullptr)
+            , boundPart(0)
+    {
+    }
+
+    void RenderQueue::Submit(const DrawItem& item)
+    {
+        if (!item.mesh || !item.program || item.indexCount == 0 || !item.mesh->IsValid() ||
+            item.part >= item.mesh->PartCount()) {
+            return;
+        }
+        // written so firstIndex + indexCount cannot wrap
+        const uint32_t partCount = item.mesh->Part(item.part).indexCount;
+        if (item.indexCount > partCount || item.firstIndex > partCount - item.indexCount) {
+            return;
+        }
+        items.push_back(item);
+    }
+
+    void RenderQueue::Sort()
+    {
+        const size_t count = items.size();
+        sorted.resize(count);
+        scratch.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            sorted[i] = SortEntry{ items[i].key, (uint32_t)i };
+        }
+
+        for (uint32_t shift = 0; shift < 64; shift += 8) {
+            size_t histogram[256] = {};
+            for (const SortEntry& entry : sorted) {
+                histogram[(entry.key >> shift) & 0xFF]++;
+            }
+            // every key has the same byte here, the pass would not move anything
+            if (histogram[(sorted[0].key >> shift) & 0xFF] == count) {
+                continue;
+            }
+            stats.sortPasses++;
+            size_t offset = 0;
+            for (size_t& bucket : histogram) {
+                const size_t size = bucket;
+                bucket = offset;
+                offset += size;
+            }
+            for (const SortEntry& entry : sorted) {
+                scratch[histogram[(entry.key >> shift) & 0xFF]++] = entry;
+            }
+            sorted.swap(scratch);
+        }
+    }
+
+    void RenderQueue::Issue(const DrawItem& item, uint32_t indexCount)
+    {
+        const RenderProgram& program = *item.program;
+        backend.BindFramebuffer(item.framebuffer);
+        backend.UseProgram(program.program);
+        if (program.textureLocation >= 0) {
+            backend.ActiveTexture(0);
+            backend.BindTexture(item.texture);
+            backend.Uniform1i(program.textureLocation, 0);
+        }
+
+        // attribute locations belong to the program, a new one needs the pointers again
+        if (item.mesh != boundMesh || &program != boundProgram) {
+            item.mesh->Bind(backend, program.attributeLocations);
+            boundPart = 0;
+        }
+        if (item.part != boundPart) {
+            item.mesh->BindPart(backend, item.part, program.attributeLocations);
+        }
+        boundProgram = &program;
+        boundMesh = item.mesh;
+        boundPart = item.part;
+
+        // no transform is the identity, not whatever the last item of the program left
+        if (program.transformLocation >= 0) {
+            backend.UniformMatrix4fv(program.transformLocation, 1, item.transform ? item.transform : IdentityTransform);
+        }
+        item.mesh->DrawRange(backend, item.mesh->Part(item.part).firstIndex + item.firstIndex, indexCount);
+        stats.draws++;
+    }
+
+    void RenderQueue::Flush()
+    {
+        stats.submitted = (uint32_t)items.size();
+        stats.draws = 0;
+        stats.sortPasses = 0;
+        boundProgram = nullptr;
+        boundMesh = nullptr;
+        boundPart = 0;
+        if (items.empty()) {
+            return;
+        }
+
+        Sort();
+        const DrawItem* pending = &items[sorted[0].index];
+        uint32_t pendingCount = pending->indexCount;
+        for (size_t i = 1; i < sorted.size(); i++) {
+            const DrawItem& next = items[sorted[i].index];
+            if (CanMerge(*pending, pendingCount, next)) {
+                pendingCount += next.indexCount;
+            } else {
+                Issue(*pending, pendingCount);
+                pending = &next;
+                pendingCount = next.indexCount;
+            }
+        }
+        Issue(*pending, pendingCount);
+        items.clear();
+    }
+}
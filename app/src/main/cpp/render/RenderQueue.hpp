@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "MeshBuffer.hpp"
+#include "RenderBackend.hpp"
+
+namespace mj2 {
+
+    /// A linked program and where its inputs are, -1 for what it does not use
+    struct RenderProgram {
+    public:
+        uint32_t program;
+        int32_t transformLocation;  // mat4 uniform set per draw item
+        int32_t textureLocation;    // sampler2D, always unit 0
+        int32_t attributeLocations[MaxVertexAttributes]; // in the mesh layout's order
+    };
+
+    /////
+    // Sort key, most significant first:
+    //
+    //   layer 4 | target 8 | program 12 | texture 16 | depth 24
+    //
+    // Layers order passes (opaque before transparent before overlays), the render target
+    // comes next so each framebuffer is bound once, then the most expensive state changes.
+    // Names wider than their field are masked, which only costs sorting quality; merging
+    // compares the real state. Depth is the caller's: front to back for opaque items,
+    // back to front (inverted) for blended ones, coarse or 0 to keep buffer order.
+    /////
+    uint64_t MakeSortKey(uint32_t layer, uint32_t target, uint32_t program, uint32_t texture, uint32_t depth);
+
+    /// view depth in [nearPlane, farPlane] to the 24 bit key field, inverted for backToFront;
+    /// outside depths are clamped, NaN counts as nearPlane
+    uint32_t QuantizeDepth(float depth, float nearPlane, float farPlane, bool backToFront);
+
+    /// One draw as submitted. Everything pointed at has to live until Flush.
+    struct DrawItem {
+    public:
+        uint64_t key;
+        uint32_t framebuffer;           // 0 is the window
+        const RenderProgram* program;
+        uint32_t texture;               // bound to unit 0, 0 for none
+        const MeshBuffer* mesh;
+        uint32_t part;                  // mesh part the range is in
+        uint32_t firstIndex;            // from the start of the part
+        uint32_t indexCount;
+        const float* transform;         // 16 floats, nullptr for the identity (vertices already placed)
+    };
+
+    struct RenderQueueStats {
+    public:
+        uint32_t submitted;  // items in the last Flush
+        uint32_t draws;      // draw calls they became
+        uint32_t sortPasses; // radix passes the sort needed, of 8
+    };
+
+    //-------------------------------------------------------------
+    // RenderQueue
+    //-------------------------------------------------------------
+    /////
+    // Collects a frame's draws, sorts them by key and issues them with as few state
+    // changes and draw calls as the sort allows.
+    //
+    // Keys are sorted with an LSD radix sort, 8 bits per pass, skipping passes where
+    // every key has the same byte (usually the layer and target bytes). It is stable,
+    // so items with equal keys stay in submission order.
+    //
+    // After sorting, neighbours merge into one glDrawElements when they use the same
+    // framebuffer, program, texture, mesh part and transform (by value) and their index
+    // ranges follow each other. Static geometry baked into a shared buffer in world
+    // space, submitted in buffer order with no transform, collapses into a draw per
+    // state change that way.
+    //
+    // State, mesh bindings and draws all go through the backend given to the constructor:
+    // a StateCache on the GL thread, or a CommandBuffer to sort and record on a worker.
+    /////
+    class RenderQueue {
+    public:
+        explicit RenderQueue(RenderBackend& backend);
+
+        RenderQueue(const RenderQueue&) = delete;
+        RenderQueue& operator=(const RenderQueue&) = delete;
+
+        /// Drops items that cannot be drawn: no program, a mesh that is missing or not
+        /// valid, a part past its PartCount() or a range past the end of the part
+        void Submit(const DrawItem& item);
+
+        /// sorts, merges and draws everything submitted, then empties the queue
+        void Flush();
+
+        size_t Size() const { return items.size(); }
+        const RenderQueueStats& Stats() const { return stats; }
+
+    private:
+        struct SortEntry {
+        public:
+            uint64_t key;
+            uint32_t index;
+        };
+
+        void Sort();
+        void Issue(const DrawItem& item, uint32_t indexCount);
+
+        RenderBackend& backend;
+        std::vector<DrawItem> items;
+        std::vector<SortEntry> sorted;
+        std::vector<SortEntry> scratch;
+        RenderQueueStats stats;
+
+        // what the last Issue left bound, so unchanged meshes are not even looked at
+        const RenderProgram* boundProgram;
+        const MeshBuffer* boundMesh;
+        uint32_t boundPart;
+    };
+
+} // namespace mj2
@@ -0,0 +1,313 @@
+#include "StateCache.hpp"
+
+#include <cstring>
+
+namespace mj2
+{
+    StateCache::StateCache(RenderBackend& backend)
+            : backend(backend)
+    {
+        Invalidate();
+        ResetStats();
+    }
+
+    void StateCache::Invalidate()
+    {
+        program = Unknown;
+        framebuffer = Unknown;
+        activeUnit = Unknown;
+        buffers[BufferTarget_Vertex] = Unknown;
+        buffers[BufferTarget_Index] = Unknown;
+        enabledKnown = 0;
+        enabled = 0;
+        for (AttributePointer& pointer : pointers) {
+            pointer.buffer = Unknown;
+        }
+        for (uint32_t& divisor : divisors) {
+            divisor = Unknown;
+        }
+        uniforms.clear();
+        InvalidateTextures();
+    }
+
+    void StateCache::InvalidateTextures()
+    {
+        for (uint32_t& texture : textures) {
+            texture = Unknown;
+        }
+        attachments.clear();
+    }
+
+    void StateCache::ResetStats()
+    {
+        stats.issued = 0;
+        stats.elided = 0;
+    }
+
+    bool StateCache::Changed(bool changed)
+    {
+        if (changed) {
+            stats.issued++;
+        } else {
+            stats.elided++;
+        }
+        return changed;
+    }
+
+    //-------------------------------------------------------------
+    // Buffers
+    //-------------------------------------------------------------
+    uint32_t StateCache::CreateBuffer()
+    {
+        return backend.CreateBuffer();
+    }
+
+    void StateCache::DeleteBuffer(uint32_t buffer)
+    {
+        // GL unbinds a deleted buffer, but attribute pointers keep the old storage; the
+        // name can come back for a new buffer, which then needs its pointers set again
+        for (uint32_t& bound : buffers) {
+            if (bound == buffer) {
+                bound = 0;
+            }
+        }
+        for (AttributePointer& pointer : pointers) {
+            if (pointer.buffer == buffer) {
+                pointer.buffer = Unknown;
+            }
+        }
+        backend.DeleteBuffer(buffer);
+    }
+
+    void StateCache::BindBuffer(BufferTarget target, uint32_t buffer)
+    {
+        if (Changed(buffers[target] != buffer)) {
+            buffers[target] = buffer;
+            backend.BindBuffer(target, buffer);
+        }
+    }
+
+    void StateCache::BufferData(BufferTarget target, size_t size, const void* data, BufferUsage usage)
+    {
+        backend.BufferData(target, size, data, usage);
+    }
+
+    void StateCache::BufferSubData(BufferTarget target, size_t offset, size_t size, const void* data)
+    {
+        backend.BufferSubData(target, offset, size, data);
+    }
+
+    //-------------------------------------------------------------
+    // Attributes
+    //-------------------------------------------------------------
+    void StateCache::VertexAttribPointer(uint32_t location, uint32_t components, AttributeFormat format, uint32_t stride,
+                                         size_t offset)
+    {
+        // the pointer captures the vertex buffer bound at the time of the call
+        const uint32_t buffer = buffers[BufferTarget_Vertex];
+        if (location >= MaxAttributes || buffer == Unknown) {
+            Changed(true);
+            if (location < MaxAttributes) {
+                pointers[location].buffer = Unknown;
+            }
+            backend.VertexAttribPointer(location, components, format, stride, offset);
+            return;
+        }
+
+        AttributePointer& pointer = pointers[location];
+        const bool same = pointer.buffer == buffer && pointer.components == components && pointer.format == format &&
+                          pointer.stride == stride && pointer.offset == offset;
+        if (Changed(!same)) {
+            pointer.buffer = buffer;
+            pointer.components = components;
+            pointer.format = format;
+            pointer.stride = stride;
+            pointer.offset = offset;
+            backend.VertexAttribPointer(location, components, format, stride, offset);
+        }
+    }
+
+    void StateCache::EnableVertexAttribArray(uint32_t location)
+    {
+        const uint32_t bit = location < MaxAttributes ? 1u << location : 0;
+        if (Changed(!(enabledKnown & enabled & bit) || !bit)) {
+            enabledKnown |= bit;
+            enabled |= bit;
+            backend.EnableVertexAttribArray(location);
+        }
+    }
+
+    void StateCache::DisableVertexAttribArray(uint32_t location)
+    {
+        const uint32_t bit = location < MaxAttributes ? 1u << location : 0;
+        if (Changed(!(enabledKnown & bit) || (enabled & bit) || !bit)) {
+            enabledKnown |= bit;
+            enabled &= ~bit;
+            backend.DisableVertexAttribArray(location);
+        }
+    }
+
+    void StateCache::VertexAttribDivisor(uint32_t location, uint32_t divisor)
+    {
+        if (location >= MaxAttributes) {
+            Changed(true);
+            backend.VertexAttribDivisor(location, divisor);
+            return;
+        }
+        if (Changed(divisors[location] != divisor)) {
+            divisors[location] = divisor;
+            backend.VertexAttribDivisor(location, divisor);
+        }
+    }
+
+    //-------------------------------------------------------------
+    // Program and uniforms
+    //-------------------------------------------------------------
+    void StateCache::UseProgram(uint32_t program)
+    {
+        if (Changed(this->program != program)) {
+            this->program = program;
+            backend.UseProgram(program);
+        }
+    }
+
+    bool StateCache::SetUniform(int32_t location, UniformKind kind, const void* values, size_t bytes)
+    {
+        if (program == Unknown || location < 0) {
+            return true;
+        }
+        const uint64_t key = (uint64_t)program << 32 | (uint32_t)location;
+        auto found = uniforms.find(key);
+        if (found != uniforms.end() && found->second.kind == kind && memcmp(found->second.values, values, bytes) == 0) {
+            return false;
+        }
+        UniformValue& value = found != uniforms.end() ? found->second : uniforms[key];
+        value.kind = kind;
+        memcpy(value.values, values, bytes);
+        return true;
+    }
+
+    bool StateCache::SetUniforms(int32_t location, uint32_t count, UniformKind kind, const float* values, size_t bytes)
+    {
+        if (count == 1) {
+            return SetUniform(location, kind, values, bytes);
+        }
+        // element 0 sits at location, the rest at the locations after it; the first is
+        // known now, whatever was cached for the others may be stale
+        if (count > 1) {
+            SetUniform(location, kind, values, bytes);
+        }
+        if (program != Unknown && location >= 0) {
+            const uint64_t key = (uint64_t)program << 32 | (uint32_t)location;
+            for (uint32_t i = 1; i < count && (uint64_t)location + i <= INT32_MAX; i++) {
+                uniforms.erase(key + i);
+            }
+        }
+        return true;
+    }
+
+    void StateCache::Uniform1i(int32_t location, int32_t value)
+    {
+        if (Changed(SetUniform(location, UniformKind_Int, &value, sizeof(value)))) {
+            backend.Uniform1i(location, value);
+        }
+    }
+
+    void StateCache::Uniform4fv(int32_t location, uint32_t count, const float* values)
+    {
+        if (Changed(SetUniforms(location, count, UniformKind_Vec4, values, 4 * sizeof(float)))) {
+            backend.Uniform4fv(location, count, values);
+        }
+    }
+
+    void StateCache::UniformMatrix4fv(int32_t location, uint32_t count, const float* values)
+    {
+        if (Changed(SetUniforms(location, count, UniformKind_Mat4, values, 16 * sizeof(float)))) {
+            backend.UniformMatrix4fv(location, count, values);
+        }
+    }
+
+    //-------------------------------------------------------------
+    // Textures and framebuffers
+    //-------------------------------------------------------------
+    void StateCache::ActiveTexture(uint32_t unit)
+    {
+        if (Changed(activeUnit != unit)) {
+            activeUnit = unit;
+            backend.ActiveTexture(unit);
+        }
+    }
+
+    void StateCache::BindTexture(uint32_t texture)
+    {
+        if (activeUnit >= MaxTextureUnits) {
+            Changed(true);
+            backend.BindTexture(texture);
+            return;
+        }
+        if (Changed(textures[activeUnit] != texture)) {
+            textures[activeUnit] = texture;
+            backend.BindTexture(texture);
+        }
+    }
+
+    void StateCache::BindFramebuffer(uint32_t framebuffer)
+    {
+        if (Changed(this->framebuffer != framebuffer)) {
+            this->framebuffer = framebuffer;
+            backend.BindFramebuffer(framebuffer);
+        }
+    }
+
+    void StateCache::FramebufferColorTexture(uint32_t texture)
+    {
+        if (framebuffer == Unknown || framebuffer == 0) {
+            Changed(true);
+            backend.FramebufferColorTexture(texture);
+            return;
+        }
+        Attachments& attached = attachments[framebuffer];
+        if (Changed(attached.color != texture)) {
+            attached.color = texture;
+            backend.FramebufferColorTexture(texture);
+        }
+    }
+
+    void StateCache::FramebufferDepthRenderbuffer(uint32_t renderbuffer)
+    {
+        if (framebuffer == Unknown || framebuffer == 0) {
+            Changed(true);
+            backend.FramebufferDepthRenderbuffer(renderbuffer);
+            return;
+        }
+        Attachments& attached = attachments[framebuffer];
+        if (Changed(attached.depth != renderbuffer)) {
+            attached.depth = renderbuffer;
+            backend.FramebufferDepthRenderbuffer(renderbuffer);
+        }
+    }
+
+    //-------------------------------------------------------------
+    // Draws
+    //-------------------------------------------------------------
+    void StateCache::DrawArrays(PrimitiveType primitive, uint32_t first, uint32_t count)
+    {
+        backend.DrawArrays(primitive, first, count);
+    }
+
+    void StateCache::DrawElements(PrimitiveType primitive, uint32_t count, size_t offset)
+    {
+        backend.DrawElements(primitive, count, offset);
+    }
+
+    bool StateCache::SupportsInstancing()
+    {
+        return backend.SupportsInstancing();
+    }
+
+    void StateCache::DrawElementsInstanced(PrimitiveType primitive, uint32_t count, size_t offset,
+                                           uint32_t instanceCount)
+    {
+        backend.DrawElementsInstanced(primitive, count, offset, instanceCount);
+    }
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+#include "RenderBackend.hpp"
+
+namespace mj2 {
+
+    struct StateCacheStats {
+    public:
+        uint64_t issued;  // state calls passed on to the backend
+        uint64_t elided;  // state calls that would not have changed anything
+    };
+
+    //-------------------------------------------------------------
+    // StateCache
+    //-------------------------------------------------------------
+    /////
+    // Shadow copy of the GL state in front of a RenderBackend: a call that sets what is
+    // already set never reaches the driver, where even a no-op costs validation time.
+    //
+    // Tracked: the program, buffer bindings, enabled attributes, their pointers and divisors, the
+    // active unit and the texture of each unit, the framebuffer and its attachments, and
+    // single value uniforms per program. Arrays always go through; afterwards their first
+    // element counts as set and the others as unknown. Everything starts unknown, so the
+    // first call of each kind is issued. Buffers, draws and everything else pass straight
+    // through uncounted.
+    //
+    // The cache only knows what goes through it. GL calls made around it (texture
+    // uploads bind textures, a new context resets everything) have to be followed by
+    // InvalidateTextures or Invalidate.
+    /////
+    class StateCache : public RenderBackend {
+    public:
+        explicit StateCache(RenderBackend& backend);
+
+        StateCache(const StateCache&) = delete;
+        StateCache& operator=(const StateCache&) = delete;
+
+        /// forget everything, after a context loss or GL calls made around the cache
+        void Invalidate();
+        /// forget texture bindings and framebuffer attachments, after textures were
+        /// bound, uploaded or deleted around the cache (a deleted name can come back)
+        void InvalidateTextures();
+
+        const StateCacheStats& Stats() const { return stats; }
+        void ResetStats();
+
+        uint32_t CreateBuffer() override;
+        void DeleteBuffer(uint32_t buffer) override;
+        void BindBuffer(BufferTarget target, uint32_t buffer) override;
+        void BufferData(BufferTarget target, size_t size, const void* data, BufferUsage usage) override;
+        void BufferSubData(BufferTarget target, size_t offset, size_t size, const void* data) override;
+
+        void VertexAttribPointer(uint32_t location, uint32_t components, AttributeFormat format, uint32_t stride,
+                                 size_t offset) override;
+        void EnableVertexAttribArray(uint32_t location) override;
+        void DisableVertexAttribArray(uint32_t location) override;
+
+        void UseProgram(uint32_t program) override;
+        void Uniform1i(int32_t location, int32_t value) override;
+        void Uniform4fv(int32_t location, uint32_t count, const float* values) override;
+        void UniformMatrix4fv(int32_t location, uint32_t count, const float* values) override;
+
+        void ActiveTexture(uint32_t unit) override;
+        void BindTexture(uint32_t texture) override;
+
+        void BindFramebuffer(uint32_t framebuffer) override;
+        void FramebufferColorTexture(uint32_t texture) override;
+        void FramebufferDepthRenderbuffer(uint32_t renderbuffer) override;
+
+        void DrawArrays(PrimitiveType primitive, uint32_t first, uint32_t count) override;
+        void DrawElements(PrimitiveType primitive, uint32_t count, size_t offset) override;
+
+        bool SupportsInstancing() override;
+        void VertexAttribDivisor(uint32_t location, uint32_t divisor) override;
+        void DrawElementsInstanced(PrimitiveType primitive, uint32_t count, size_t offset,
+                                   uint32_t instanceCount) override;
+
+    private:
+        static const uint32_t Unknown = UINT32_MAX;
+        static const uint32_t MaxTextureUnits = 16;
+        static const uint32_t MaxAttributes = 32;
+
+        struct AttributePointer {
+        public:
+            uint32_t buffer;  // Unknown until set through the cache
+            uint32_t components;
+            AttributeFormat format;
+            uint32_t stride;
+            size_t offset;
+        };
+
+        struct Attachments {
+        public:
+            uint32_t color = Unknown;
+            uint32_t depth = Unknown;
+        };
+
+        enum UniformKind
+        {
+            UniformKind_Int = 0,
+            UniformKind_Vec4,
+            UniformKind_Mat4
+        };
+
+        struct UniformValue {
+        public:
+            UniformKind kind;
+            float values[16];  // an int is stored bit for bit
+        };
+
+        /// counts the call; true when it has to go through
+        bool Changed(bool changed);
+        /// true when location of the program in use holds something else than values
+        bool SetUniform(int32_t location, UniformKind kind, const void* values, size_t bytes);
+        /// SetUniform for count elements; an array is always true, its first element is
+        /// remembered and the locations after it are forgotten
+        bool SetUniforms(int32_t location, uint32_t count, UniformKind kind, const float* values, size_t bytes);
+
+        RenderBackend& backend;
+        uint32_t program;
+        uint32_t framebuffer;
+        uint32_t activeUnit;
+        uint32_t textures[MaxTextureUnits];
+        uint32_t buffers[2];
+        uint32_t enabledKnown;  // bit per attribute location
+        uint32_t enabled;
+        AttributePointer pointers[MaxAttributes];
+        uint32_t divisors[MaxAttributes];
+        std::unordered_map<uint32_t, Attachments> attachments;     // by framebuffer
+        std::unordered_map<uint64_t, UniformValue> uniforms;       // by program << 32 | location
+        StateCacheStats stats;
+    };
+
+} // namespace mj2
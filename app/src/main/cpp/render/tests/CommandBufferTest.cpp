@@ -0,0 +1,168 @@
+/////
+// CommandBuffer: a frame recorded on two threads and executed into RecordingBackend has
+// to make the same calls, with the same data, as the frame run directly, in both
+// instancing modes and with or without a StateCache in front.
+/////
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "../CommandBuffer.hpp"
+#include "../InstancedMesh.hpp"
+#include "../RenderQueue.hpp"
+#include "../StateCache.hpp"
+#include "../../math/tests/Check.hpp"
+#include "RecordingBackend.hpp"
+
+using namespace mj2;
+using namespace mj2::test;
+
+namespace {
+
+    const RenderProgram kProgram = { 7, 2, 3, { 0, 1, -1, -1, -1, -1, -1, -1 } };
+    const InstancingProgram kInstancingProgram = { 9, 3, { 0, -1, -1, -1, -1, -1, -1, -1 }, 4, 5, 6 };
+
+    /// What the GL thread makes once per backend: the same calls in the same order, so
+    /// both backends hand out the same names
+    struct Scene {
+    public:
+        explicit Scene(RenderBackend& backend)
+                : mesh(backend)
+                , instanced(backend)
+        {
+            VertexLayout layout{};
+            layout.stride = 5 * sizeof(float);
+            layout.attributeCount = 2;
+            layout.attributes[0] = VertexAttribute{ 3, AttributeFormat_Float, 0 };
+            layout.attributes[1] = VertexAttribute{ 2, AttributeFormat_Float, 3 * sizeof(float) };
+            std::vector<float> vertices(24 * 5);
+            for (size_t i = 0; i < vertices.size(); i++) {
+                vertices[i] = (float)i;
+            }
+            std::vector<uint16_t> indices(36);
+            for (size_t i = 0; i < indices.size(); i++) {
+                indices[i] = (uint16_t)((i * 7) % 24);
+            }
+            MJ2_CHECK(mesh.Create(layout, vertices.data(), 24, indices.data(), 36, BufferUsage_Static));
+            MJ2_CHECK(instanced.Create(InstancedMesh::ModeFor(backend), 8, layout, vertices.data(), 24, indices.data(), 36));
+        }
+
+        MeshBuffer mesh;
+        InstancedMesh instanced;
+    };
+
+    /// Opaque items through a RenderQueue, transforms in a local array that is gone
+    /// (scribbled over) by the time a CommandBuffer is executed
+    void RecordQueue(RenderBackend& target, const Scene& scene, uint32_t frame)
+    {
+        std::vector<float> transforms(3 * 16);
+        for (size_t i = 0; i < transforms.size(); i++) {
+            transforms[i] = (float)(frame * 100 + i);
+        }
+        RenderQueue queue(target);
+        for (uint32_t k = 0; k < 3; k++) {
+            DrawItem item{};
+            item.key = MakeSortKey(0, 0, kProgram.program, k % 2, 2 - k);
+            item.program = &kProgram;
+            item.texture = 20 + k % 2;
+            item.mesh = &scene.mesh;
+            item.firstIndex = k * 12;
+            item.indexCount = 12;
+            item.transform = k == 1 ? nullptr : &transforms[k * 16];
+            queue.Submit(item);
+        }
+        queue.Flush();
+        memset(transforms.data(), 0xFF, transforms.size() * sizeof(float));
+    }
+
+    /// Every other kind of call, then a hundred instances
+    void RecordOther(RenderBackend& target, Scene& scene, uint32_t frame)
+    {
+        std::vector<float> values(100 * 16);
+        for (size_t i = 0; i < values.size(); i++) {
+            values[i] = (float)(frame + i) * 0.5f;
+        }
+        target.BindFramebuffer(5);
+        target.FramebufferColorTexture(6);
+        target.FramebufferDepthRenderbuffer(0);
+        target.UseProgram(kProgram.program);
+        target.Uniform4fv(1, 2, values.data());
+        target.Uniform4fv(1, 1, values.data() + 4);
+        target.BindBuffer(BufferTarget_Vertex, scene.mesh.VertexBuffer());
+        target.BufferSubData(BufferTarget_Vertex, 8, 16, values.data());
+        target.DrawArrays(PrimitiveType_Points, 3, 4);
+        target.BindFramebuffer(0);
+        scene.instanced.Draw(target, kInstancingProgram, 4, values.data(), 100);
+        target.UseProgram(0);
+        memset(values.data(), 0xFF, values.size() * sizeof(float));
+    }
+
+    void Compare(const RecordingBackend& direct, const RecordingBackend& replayed)
+    {
+        MJ2_CHECK(!direct.Log().empty());
+        MJ2_CHECK(direct.Log() == replayed.Log());
+        MJ2_CHECK(direct.Draws().size() == replayed.Draws().size());
+        for (size_t i = 0; i < direct.Draws().size() && i < replayed.Draws().size(); i++) {
+            MJ2_CHECK(direct.Draws()[i].uniforms == replayed.Draws()[i].uniforms);
+        }
+        MJ2_CHECK(direct.Errors().empty() && replayed.Errors().empty());
+    }
+
+    void TestRecordAndExecute(bool instancing, bool throughCache)
+    {
+        RecordingBackend direct(instancing);
+        RecordingBackend replayed(instancing);
+        StateCache directCache(direct);
+        StateCache replayedCache(replayed);
+        RenderBackend& directTarget = throughCache ? static_cast<RenderBackend&>(directCache) : direct;
+        RenderBackend& replayTarget = throughCache ? static_cast<RenderBackend&>(replayedCache) : replayed;
+        Scene directScene(direct);
+        Scene replayedScene(replayed);
+        MJ2_CHECK(directScene.instanced.Mode() == (instancing ? InstancingMode_Hardware : InstancingMode_Pseudo));
+
+        CommandBuffer buffers[2];
+        for (CommandBuffer& buffer : buffers) {
+            buffer.SetSupportsInstancing(replayTarget.SupportsInstancing());
+        }
+        for (uint32_t frame = 0; frame < 3; frame++) {
+            direct.ClearLog();
+            RecordQueue(directTarget, directScene, frame);
+            RecordOther(directTarget, directScene, frame);
+
+            std::thread queueThread([&] { RecordQueue(buffers[0], replayedScene, frame); });
+            std::thread otherThread([&] { RecordOther(buffers[1], replayedScene, frame); });
+            queueThread.join();
+            otherThread.join();
+
+            replayed.ClearLog();
+            buffers[0].Execute(replayTarget);
+            buffers[1].Execute(replayTarget);
+            Compare(direct, replayed);
+
+            MJ2_CHECK(!buffers[0].Empty() && buffers[1].CommandCount() > 0);
+            const size_t capacity = buffers[1].Capacity();
+            buffers[0].Clear();
+            buffers[1].Clear();
+            MJ2_CHECK(buffers[0].Empty() && buffers[1].Bytes() == 0 && buffers[1].Capacity() == capacity);
+        }
+
+        // names come from the GL thread, deletes wait for the replay
+        MJ2_CHECK(buffers[0].CreateBuffer() == 0);
+        buffers[0].DeleteBuffer(replayedScene.mesh.IndexBuffer());
+        MJ2_CHECK(replayed.IsBuffer(replayedScene.mesh.IndexBuffer()));
+        buffers[0].Execute(replayTarget);
+        MJ2_CHECK(!replayed.IsBuffer(replayedScene.mesh.IndexBuffer()));
+        replayedScene.mesh.Invalidate();
+    }
+
+} // namespace
+
+int main()
+{
+    TestRecordAndExecute(false, false);
+    TestRecordAndExecute(true, false);
+    TestRecordAndExecute(false, true);
+    TestRecordAndExecute(true, true);
+    return CheckResult("CommandBufferTest");
+}
@@ -0,0 +1,204 @@
+/////
+// InstancedMesh against RecordingBackend, directly and behind a StateCache. Every draw
+// is replayed vertex by vertex from the recorded buffers and uniforms, so the test
+// sees which matrix each drawn copy would be transformed by.
+/////
+
+#include <cstring>
+#include <vector>
+
+#include "../InstancedMesh.hpp"
+#include "../StateCache.hpp"
+#include "../../math/tests/Check.hpp"
+#include "RecordingBackend.hpp"
+
+using namespace mj2;
+using namespace mj2::test;
+
+namespace {
+
+    const InstancingProgram kProgram = { 9, 3, { 0, -1, -1, -1, -1, -1, -1, -1 }, 4, 5, 6 };
+
+    const uint32_t kVertexCount = 4;
+    const uint32_t kIndexCount = 6;
+
+    VertexLayout QuadLayout()
+    {
+        VertexLayout layout{};
+        layout.stride = 3 * sizeof(float);
+        layout.attributeCount = 1;
+        layout.attributes[0] = VertexAttribute{ 3, AttributeFormat_Float, 0 };
+        return layout;
+    }
+
+    bool CreateQuad(InstancedMesh& mesh, InstancingMode mode, uint32_t maxBatch)
+    {
+        const float vertices[kVertexCount * 3] = { 0, 0, 0, 1, 0, 0, 0, 1, 0, 1, 1, 0 };
+        const uint16_t indices[kIndexCount] = { 0, 1, 2, 2, 1, 3 };
+        return mesh.Create(mode, maxBatch, QuadLayout(), vertices, kVertexCount, indices, kIndexCount);
+    }
+
+    /// instance i's matrix is 16 floats starting at frame * 1000 + i * 16
+    std::vector<float> Matrices(uint32_t count, uint32_t frame)
+    {
+        std::vector<float> matrices((size_t)count * 16);
+        for (size_t i = 0; i < matrices.size(); i++) {
+            matrices[i] = (float)(frame * 1000 + i);
+        }
+        return matrices;
+    }
+
+    float ReadFloat(const std::vector<uint8_t>& data, size_t offset)
+    {
+        float value = 0.0f;
+        if (offset + sizeof(value) <= data.size()) {
+            memcpy(&value, data.data() + offset, sizeof(value));
+        }
+        return value;
+    }
+
+    /// Pseudo instancing as the vertex shader runs it: for every index drawn, the copy
+    /// number from the id attribute picks an element of the matrix array. Draws have to
+    /// cover instances in order, each vertex seeing the matrix of its instance.
+    void CheckPseudoDraws(RecordingBackend& backend, const std::vector<float>& matrices, uint32_t instanceCount)
+    {
+        const RecordingBackend::AttributePointer* id = backend.Pointer((uint32_t)kProgram.instanceIdLocation);
+        MJ2_CHECK(id != nullptr);
+        if (!id) {
+            return;
+        }
+        const std::vector<uint8_t>& vertices = backend.BufferContents(id->buffer).data;
+        const std::vector<uint8_t>& indexData = backend.BufferContents(backend.Bound(BufferTarget_Index)).data;
+
+        uint32_t instance = 0;
+        uint32_t wrong = 0;
+        for (const RecordingBackend::Draw& draw : backend.Draws()) {
+            MJ2_CHECK(draw.program == kProgram.program && draw.count % kIndexCount == 0 && draw.offset == 0);
+            for (uint32_t i = 0; i < draw.count; i++) {
+                uint16_t index = 0;
+                memcpy(&index, indexData.data() + draw.offset + i * sizeof(uint16_t), sizeof(index));
+                const uint32_t copy = (uint32_t)ReadFloat(vertices, (size_t)index * id->stride + id->offset);
+                const auto element = draw.uniforms.find(kProgram.instanceArrayLocation + (int32_t)copy);
+                const uint32_t expected = instance + i / kIndexCount;
+                const bool right = copy == i / kIndexCount && element != draw.uniforms.end() &&
+                                   expected < instanceCount &&
+                                   element->second == std::vector<float>(&matrices[expected * 16],
+                                                                         &matrices[expected * 16] + 16);
+                wrong += right ? 0 : 1;
+            }
+            instance += draw.count / kIndexCount;
+        }
+        MJ2_CHECK(wrong == 0);
+        MJ2_CHECK(instance == instanceCount);
+    }
+
+    /// batch 2 over 1 to 7 instances, three frames each, so every count leaves a different
+    /// remainder; frame 1 repeats frame 0's matrices to give a StateCache something to drop
+    void TestPseudo(bool throughCache)
+    {
+        RecordingBackend backend;
+        StateCache cache(backend);
+        RenderBackend& target = throughCache ? static_cast<RenderBackend&>(cache) : backend;
+        InstancedMesh mesh(backend);
+        MJ2_CHECK(InstancedMesh::ModeFor(backend) == InstancingMode_Pseudo);
+        MJ2_CHECK(CreateQuad(mesh, InstancingMode_Pseudo, 2));
+        MJ2_CHECK(mesh.BatchSize() == 2);
+
+        for (uint32_t count = 1; count <= 7; count++) {
+            for (uint32_t frame = 0; frame < 3; frame++) {
+                const std::vector<float> matrices = Matrices(count, frame == 2 ? 1 : 0);
+                backend.ClearLog();
+                mesh.Draw(target, kProgram, 11, matrices.data(), count);
+                MJ2_CHECK(mesh.Draws() == (count + 1) / 2);
+                CheckPseudoDraws(backend, matrices, count);
+                MJ2_CHECK(backend.Errors().empty());
+            }
+        }
+
+        // the batch is also held to what 16 bit indices reach
+        InstancedMesh big(backend);
+        MJ2_CHECK(CreateQuad(big, InstancingMode_Pseudo, 1u << 20));
+        MJ2_CHECK(big.BatchSize() == MaxVerticesPerPart / kVertexCount);
+
+        // nothing drawn for no instances
+        backend.ClearLog();
+        mesh.Draw(target, kProgram, 11, nullptr, 0);
+        MJ2_CHECK(mesh.Draws() == 0 && backend.Draws().empty());
+    }
+
+    void TestHardware(bool throughCache)
+    {
+        RecordingBackend backend(true);
+        StateCache cache(backend);
+        RenderBackend& target = throughCache ? static_cast<RenderBackend&>(cache) : backend;
+        InstancedMesh mesh(backend);
+        MJ2_CHECK(InstancedMesh::ModeFor(backend) == InstancingMode_Hardware);
+        MJ2_CHECK(CreateQuad(mesh, InstancingMode_Hardware, 0));
+        MJ2_CHECK(mesh.BatchSize() == 0);
+
+        const uint32_t matrixLocation = (uint32_t)kProgram.instanceMatrixLocation;
+        for (uint32_t frame = 0; frame < 2; frame++) {
+            const std::vector<float> matrices = Matrices(5, frame);
+            backend.ClearLog();
+            mesh.Draw(target, kProgram, 11, matrices.data(), 5);
+            MJ2_CHECK(mesh.Draws() == 1);
+            MJ2_CHECK(backend.Draws().size() == 1);
+            if (backend.Draws().size() != 1) {
+                continue;
+            }
+
+            // one instanced draw, the four matrix columns stepping per instance from the
+            // stream, the mesh attribute per vertex
+            const RecordingBackend::Draw& draw = backend.Draws()[0];
+            MJ2_CHECK(draw.instanceCount == 5 && draw.count == kIndexCount && draw.texture == 11);
+            MJ2_CHECK(draw.divisors.size() == 5 && draw.divisors.at(0) == 0);
+            for (uint32_t column = 0; column < 4; column++) {
+                MJ2_CHECK(draw.divisors.count(matrixLocation + column) && draw.divisors.at(matrixLocation + column) == 1);
+                const RecordingBackend::AttributePointer* pointer = backend.Pointer(matrixLocation + column);
+                MJ2_CHECK(pointer && pointer->stride == 16 * sizeof(float) && pointer->offset == column * 4 * sizeof(float));
+                if (pointer) {
+                    const std::vector<uint8_t>& stream = backend.BufferContents(pointer->buffer).data;
+                    MJ2_CHECK(stream.size() == matrices.size() * sizeof(float) &&
+                              memcmp(stream.data(), matrices.data(), stream.size()) == 0);
+                    MJ2_CHECK(backend.BufferContents(pointer->buffer).usage == BufferUsage_Stream);
+                    MJ2_CHECK(backend.Bound(BufferTarget_Vertex) == pointer->buffer);
+                }
+            }
+
+            // and afterwards every divisor back at 0 with the columns disabled
+            for (uint32_t column = 0; column < 4; column++) {
+                MJ2_CHECK(backend.Divisor(matrixLocation + column) == 0);
+                MJ2_CHECK(!backend.IsEnabled(matrixLocation + column));
+            }
+            MJ2_CHECK(backend.Errors().empty());
+        }
+
+        // so a plain mesh reusing a matrix column's location draws one value per vertex
+        MeshBuffer plain(backend);
+        const float vertices[kVertexCount * 3] = {};
+        const uint16_t indices[kIndexCount] = { 0, 1, 2, 2, 1, 3 };
+        MJ2_CHECK(plain.Create(QuadLayout(), vertices, kVertexCount, indices, kIndexCount, BufferUsage_Static));
+        const int32_t locations[MaxVertexAttributes] = { (int32_t)matrixLocation + 1, -1, -1, -1, -1, -1, -1, -1 };
+        backend.ClearLog();
+        target.UseProgram(kProgram.program);
+        plain.Bind(target, locations);
+        plain.DrawRange(target, 0, kIndexCount);
+        MJ2_CHECK(backend.Draws().size() == 1 && backend.Draws()[0].divisors.at(matrixLocation + 1) == 0);
+        MJ2_CHECK(backend.Errors().empty());
+
+        // switching the mesh to pseudo instancing drops the stream
+        const size_t deleted = backend.DeletedBuffers().size();
+        MJ2_CHECK(CreateQuad(mesh, InstancingMode_Pseudo, 4));
+        MJ2_CHECK(backend.DeletedBuffers().size() == deleted + 1);
+    }
+
+} // namespace
+
+int main()
+{
+    TestPseudo(false);
+    TestPseudo(true);
+    TestHardware(false);
+    TestHardware(true);
+    return CheckResult("InstancedMeshTest");
+}
@@ -0,0 +1,292 @@
+/////
+// MeshBuffer against RecordingBackend: what ends up in the buffers, how big meshes are
+// split into parts and drawn, the bounds of the partial updates, and which calls
+// delete GL names.
+/////
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../MeshBuffer.hpp"
+#include "../../math/tests/Check.hpp"
+#include "RecordingBackend.hpp"
+
+using namespace mj2;
+using namespace mj2::test;
+
+namespace {
+
+    const int32_t kLocations[MaxVertexAttributes] = { 0, -1, -1, -1, -1, -1, -1, -1 };
+
+    /// one float per vertex, its own number, so a vertex can be traced through a split
+    VertexLayout NumberLayout()
+    {
+        VertexLayout layout{};
+        layout.stride = sizeof(float);
+        layout.attributeCount = 1;
+        layout.attributes[0] = VertexAttribute{ 1, AttributeFormat_Float, 0 };
+        return layout;
+    }
+
+    std::vector<float> Numbers(uint32_t count)
+    {
+        std::vector<float> numbers(count);
+        for (uint32_t i = 0; i < count; i++) {
+            numbers[i] = (float)i;
+        }
+        return numbers;
+    }
+
+    template <typename T>
+    std::vector<T> Contents(const RecordingBackend& backend, uint32_t buffer)
+    {
+        const std::vector<uint8_t>& data = backend.BufferContents(buffer).data;
+        std::vector<T> values(data.size() / sizeof(T));
+        memcpy(values.data(), data.data(), values.size() * sizeof(T));
+        return values;
+    }
+
+    /// lines of the log starting with prefix
+    size_t CountCalls(const std::string& log, const std::string& prefix)
+    {
+        size_t count = 0;
+        for (size_t line = 0; line < log.size(); line = log.find('\n', line) + 1) {
+            count += log.compare(line, prefix.size(), prefix) == 0 ? 1 : 0;
+        }
+        return count;
+    }
+
+    void TestSinglePart()
+    {
+        RecordingBackend backend;
+        MeshBuffer mesh(backend);
+        const std::vector<float> vertices = Numbers(4);
+        const uint16_t indices[] = { 0, 1, 2, 2, 1, 3 };
+        MJ2_CHECK(mesh.Create(NumberLayout(), vertices.data(), 4, indices, 6, BufferUsage_Static));
+        MJ2_CHECK(mesh.PartCount() == 1 && mesh.VertexCount() == 4 && mesh.IndexCount() == 6);
+        MJ2_CHECK(Contents<float>(backend, mesh.VertexBuffer()) == vertices);
+        MJ2_CHECK(Contents<uint16_t>(backend, mesh.IndexBuffer()) == std::vector<uint16_t>(indices, indices + 6));
+
+        // an index past the vertices is refused before anything is made
+        RecordingBackend other;
+        MeshBuffer bad(other);
+        const uint16_t outside[] = { 0, 1, 4 };
+        MJ2_CHECK(!bad.Create(NumberLayout(), vertices.data(), 4, outside, 3, BufferUsage_Static));
+        MJ2_CHECK(!bad.IsValid());
+        // so is a partial triangle
+        MJ2_CHECK(!bad.Create(NumberLayout(), vertices.data(), 4, indices, 5, BufferUsage_Static));
+        MJ2_CHECK(!bad.IsValid());
+        // and nothing is drawn from a mesh that was never made
+        bad.DrawRange(0, 3);
+        MJ2_CHECK(other.Log().empty());
+
+        // a failed CreateBuffer leaves nothing behind
+        RecordingBackend failing;
+        failing.SetFailCreate(true);
+        MeshBuffer none(failing);
+        MJ2_CHECK(!none.Create(NumberLayout(), vertices.data(), 4, indices, 6, BufferUsage_Static));
+        MJ2_CHECK(!none.IsValid());
+    }
+
+    /// Triangles in the order given, indices as 32 bit, checked part by part against
+    /// what the buffers hold and what a Draw binds
+    void CheckSplit(uint32_t vertexCount, const std::vector<uint32_t>& indices)
+    {
+        RecordingBackend backend;
+        MeshBuffer mesh(backend);
+        const std::vector<float> vertices = Numbers(vertexCount);
+        MJ2_CHECK(mesh.Create(NumberLayout(), vertices.data(), vertexCount, indices.data(), (uint32_t)indices.size(),
+                              BufferUsage_Static));
+        MJ2_CHECK(mesh.PartCount() > 1);
+        MJ2_CHECK(mesh.IndexCount() == indices.size());
+
+        const std::vector<float> packed = Contents<float>(backend, mesh.VertexBuffer());
+        const std::vector<uint16_t> narrow = Contents<uint16_t>(backend, mesh.IndexBuffer());
+        MJ2_CHECK(packed.size() == mesh.VertexCount() && narrow.size() == indices.size());
+
+        uint32_t nextIndex = 0;
+        for (uint32_t p = 0; p < mesh.PartCount(); p++) {
+            const MeshPart& part = mesh.Part(p);
+            const uint32_t partVertices = (p + 1 < mesh.PartCount() ? mesh.Part(p + 1).baseVertex : mesh.VertexCount()) -
+                                          part.baseVertex;
+            MJ2_CHECK(part.firstIndex == nextIndex);
+            MJ2_CHECK(part.indexCount % 3 == 0 && part.indexCount > 0);
+            MJ2_CHECK(partVertices <= MaxVerticesPerPart);
+            for (uint32_t i = part.firstIndex; i < part.firstIndex + part.indexCount; i++) {
+                MJ2_CHECK(narrow[i] < partVertices);
+                MJ2_CHECK(packed[part.baseVertex + narrow[i]] == (float)indices[i]);
+            }
+            nextIndex += part.indexCount;
+        }
+        MJ2_CHECK(nextIndex == indices.size());
+
+        // a draw per part, each with the attribute pointed at its base vertex
+        backend.ClearLog();
+        mesh.Bind(kLocations);
+        mesh.Draw(kLocations);
+        MJ2_CHECK(backend.Draws().size() == mesh.PartCount());
+        MJ2_CHECK(backend.Errors().empty());
+        for (uint32_t p = 0; p < backend.Draws().size() && p < mesh.PartCount(); p++) {
+            MJ2_CHECK(backend.Draws()[p].count == mesh.Part(p).indexCount);
+            MJ2_CHECK(backend.Draws()[p].offset == mesh.Part(p).firstIndex * sizeof(uint16_t));
+        }
+        // and part 0 bound again afterwards
+        MJ2_CHECK(backend.Pointer(0) && backend.Pointer(0)->offset == 0);
+    }
+
+    void TestSplit()
+    {
+        // a strip of triangles sharing edges, every vertex used by the next two triangles
+        const uint32_t stripVertices = MaxVerticesPerPart + 5000;
+        std::vector<uint32_t> strip;
+        for (uint32_t i = 0; i + 2 < stripVertices; i++) {
+            strip.insert(strip.end(), { i, i + 1, i + 2 });
+        }
+        CheckSplit(stripVertices, strip);
+
+        // triangles reaching from the front of the vertices to the back, so a vertex
+        // shared across a split is stored again in the next part
+        const uint32_t spanVertices = 3 * MaxVerticesPerPart;
+        std::vector<uint32_t> span;
+        for (uint32_t i = 0; i + 1 < spanVertices / 2; i++) {
+            span.insert(span.end(), { i, spanVertices - 1 - i, i + 1 });
+        }
+        span.insert(span.end(), { 0, 0, spanVertices - 1 });
+        CheckSplit(spanVertices, span);
+
+        // exactly one part's worth is not split
+        RecordingBackend backend;
+        MeshBuffer mesh(backend);
+        const std::vector<float> vertices = Numbers(MaxVerticesPerPart);
+        std::vector<uint32_t> full;
+        for (uint32_t i = 0; i + 2 < MaxVerticesPerPart; i += 3) {
+            full.insert(full.end(), { i, i + 1, i + 2 });
+        }
+        full.insert(full.end(), { 0, MaxVerticesPerPart - 2, MaxVerticesPerPart - 1 });
+        MJ2_CHECK(mesh.Create(NumberLayout(), vertices.data(), MaxVerticesPerPart, full.data(), (uint32_t)full.size(),
+                              BufferUsage_Static));
+        MJ2_CHECK(mesh.PartCount() == 1);
+
+        // and an index past the vertices is refused
+        full.back() = MaxVerticesPerPart;
+        MJ2_CHECK(!mesh.Create(NumberLayout(), vertices.data(), MaxVerticesPerPart, full.data(), (uint32_t)full.size(),
+                               BufferUsage_Static));
+    }
+
+    void TestUpdateBounds()
+    {
+        RecordingBackend backend;
+        MeshBuffer mesh(backend);
+        const std::vector<float> vertices = Numbers(4);
+        const uint16_t indices[] = { 0, 1, 2, 2, 1, 3 };
+        MJ2_CHECK(mesh.Create(NumberLayout(), vertices.data(), 4, indices, 6, BufferUsage_Dynamic));
+
+        const float replacement[] = { 10.0f, 11.0f };
+        mesh.UpdateVertices(2, 2, replacement);
+        MJ2_CHECK(Contents<float>(backend, mesh.VertexBuffer()) == std::vector<float>({ 0.0f, 1.0f, 10.0f, 11.0f }));
+        const uint16_t flipped[] = { 3, 1, 2 };
+        mesh.UpdateIndices(3, 3, flipped);
+        MJ2_CHECK(Contents<uint16_t>(backend, mesh.IndexBuffer()) == std::vector<uint16_t>({ 0, 1, 2, 3, 1, 2 }));
+
+        // past the end, empty, and first + count wrapping around 2^32 back into range
+        backend.ClearLog();
+        mesh.UpdateVertices(3, 2, replacement);
+        mesh.UpdateVertices(4, 1, replacement);
+        mesh.UpdateVertices(0, 0, replacement);
+        mesh.UpdateVertices(1, 0xFFFFFFFFu, replacement);
+        mesh.UpdateVertices(0xFFFFFFFFu, 2, replacement);
+        mesh.UpdateIndices(5, 2, flipped);
+        mesh.UpdateIndices(2, 0xFFFFFFFEu, flipped);
+        mesh.UpdateIndices(0xFFFFFFFFu, 3, flipped);
+        MJ2_CHECK(backend.Log().empty());
+
+        // a stream mesh rewritten whole is respecified, anything less is a sub update
+        MJ2_CHECK(mesh.Create(NumberLayout(), vertices.data(), 4, indices, 6, BufferUsage_Stream));
+        backend.ClearLog();
+        mesh.UpdateVertices(0, 4, vertices.data());
+        mesh.UpdateVertices(1, 3, vertices.data());
+        MJ2_CHECK(CountCalls(backend.Log(), "BufferData 0 16 ") == 1);
+        MJ2_CHECK(CountCalls(backend.Log(), "BufferSubData 0 4 12 ") == 1);
+        MJ2_CHECK(backend.Errors().empty());
+
+        // split meshes take no updates
+        const uint32_t bigCount = MaxVerticesPerPart + 3;
+        const std::vector<float> big = Numbers(bigCount);
+        std::vector<uint32_t> bigIndices;
+        for (uint32_t i = 0; i + 2 < bigCount; i += 3) {
+            bigIndices.insert(bigIndices.end(), { i, i + 1, i + 2 });
+        }
+        MJ2_CHECK(mesh.Create(NumberLayout(), big.data(), bigCount, bigIndices.data(), (uint32_t)bigIndices.size(),
+                              BufferUsage_Dynamic));
+        MJ2_CHECK(mesh.PartCount() == 2);
+        backend.ClearLog();
+        mesh.UpdateVertices(0, 1, replacement);
+        mesh.UpdateIndices(0, 1, flipped);
+        MJ2_CHECK(backend.Log().empty());
+    }
+
+    void TestInvalidateAndDestroy()
+    {
+        RecordingBackend backend;
+        const std::vector<float> vertices = Numbers(4);
+        const uint16_t indices[] = { 0, 1, 2 };
+        {
+            MeshBuffer mesh(backend);
+            MJ2_CHECK(mesh.Create(NumberLayout(), vertices.data(), 4, indices, 3, BufferUsage_Static));
+            const uint32_t vertexBuffer = mesh.VertexBuffer();
+            const uint32_t indexBuffer = mesh.IndexBuffer();
+
+            // Create again reuses the names
+            MJ2_CHECK(mesh.Create(NumberLayout(), vertices.data(), 4, indices, 3, BufferUsage_Static));
+            MJ2_CHECK(mesh.VertexBuffer() == vertexBuffer && mesh.IndexBuffer() == indexBuffer);
+
+            // Invalidate forgets them: no delete now or at destruction, new names on Create
+            mesh.Invalidate();
+            MJ2_CHECK(!mesh.IsValid() && mesh.PartCount() == 0 && mesh.Bytes() == 0);
+            MJ2_CHECK(backend.IsBuffer(vertexBuffer) && backend.IsBuffer(indexBuffer));
+            MJ2_CHECK(mesh.Create(NumberLayout(), vertices.data(), 4, indices, 3, BufferUsage_Static));
+            MJ2_CHECK(mesh.VertexBuffer() != vertexBuffer && mesh.IndexBuffer() != indexBuffer);
+            mesh.Invalidate();
+        }
+        MJ2_CHECK(backend.DeletedBuffers().empty());
+
+        // Destroy and the destructor delete both
+        MeshBuffer mesh(backend);
+        MJ2_CHECK(mesh.Create(NumberLayout(), vertices.data(), 4, indices, 3, BufferUsage_Static));
+        const uint32_t vertexBuffer = mesh.VertexBuffer();
+        const uint32_t indexBuffer = mesh.IndexBuffer();
+        mesh.Destroy();
+        MJ2_CHECK(!mesh.IsValid());
+        MJ2_CHECK(!backend.IsBuffer(vertexBuffer) && !backend.IsBuffer(indexBuffer));
+        MJ2_CHECK(backend.DeletedBuffers() == std::vector<uint32_t>({ vertexBuffer, indexBuffer }));
+        mesh.Destroy();
+        MJ2_CHECK(backend.DeletedBuffers().size() == 2);
+        {
+            MeshBuffer scoped(backend);
+            MJ2_CHECK(scoped.Create(NumberLayout(), vertices.data(), 4, indices, 3, BufferUsage_Static));
+        }
+        MJ2_CHECK(backend.DeletedBuffers().size() == 4);
+        MJ2_CHECK(backend.Errors().empty());
+
+        // binding a mesh without buffers, or a part it does not have, makes no calls
+        backend.ClearLog();
+        mesh.Bind(kLocations);
+        mesh.BindPart(0, kLocations);
+        mesh.Draw(kLocations);
+        MJ2_CHECK(mesh.Create(NumberLayout(), vertices.data(), 4, indices, 3, BufferUsage_Static));
+        const std::string created = backend.Log();
+        mesh.BindPart(1, kLocations);
+        MJ2_CHECK(backend.Log() == created);
+    }
+
+} // namespace
+
+int main()
+{
+    TestSinglePart();
+    TestSplit();
+    TestUpdateBounds();
+    TestInvalidateAndDestroy();
+    return CheckResult("MeshBufferTest");
+}
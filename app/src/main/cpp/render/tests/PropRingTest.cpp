@@ -0,0 +1,129 @@
+/////
+// The prop ring from gl_code.cpp: the cube goes through a RenderQueue as a transform
+// uniform, the props through hardware instancing as a mat4 attribute. Both are read back
+// from RecordingBackend and applied the way the two vertex shaders do, matrix * vPosition
+// with the uploaded floats as columns, so a prop's corner has to land exactly where the
+// cube's transform puts the same point.
+/////
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "../../PropRing.hpp"
+#include "../../math/tests/Check.hpp"
+#include "../InstancedMesh.hpp"
+#include "../RenderQueue.hpp"
+#include "RecordingBackend.hpp"
+
+using namespace mj2;
+using namespace mj2::test;
+
+namespace {
+
+    const RenderProgram kCubeProgram = { 1, 4, -1, { 0, -1, -1, -1, -1, -1, -1, -1 } };
+    const InstancingProgram kPropProgram = { 2, -1, { 0, -1, -1, -1, -1, -1, -1, -1 }, 4, -1, -1 };
+
+    const uint32_t kPropCount = 12;
+
+    /// the ring's size and scale, as in PropRing.hpp
+    const float kScale = 0.2f;
+    const float kRadius = 0.75f;
+
+    /// gl_Position = matrix * position, GLSL reading the 16 floats column by column
+    void ShaderTransform(const float* matrix, const float* position, float* clip)
+    {
+        for (uint32_t row = 0; row < 4; row++) {
+            clip[row] = 0.0f;
+            for (uint32_t column = 0; column < 4; column++) {
+                clip[row] += matrix[column * 4 + row] * position[column];
+            }
+        }
+    }
+
+    /// no symmetry and a projective last column, so a transposed or reversed product
+    /// cannot pass
+    Matrix4x4 Model()
+    {
+        Matrix4x4 model;
+        for (uint32_t row = 0; row < 4; row++) {
+            for (uint32_t column = 0; column < 4; column++) {
+                model.m[row][column] = (row == column ? 1.0f : 0.0f) + 0.1f * (float)((row * 5 + column * 3) % 7) - 0.3f;
+            }
+        }
+        return model;
+    }
+
+    void CreateMeshes(MeshBuffer& cube, InstancedMesh& props)
+    {
+        VertexLayout layout{};
+        layout.stride = 4 * sizeof(float);
+        layout.attributeCount = 1;
+        layout.attributes[0] = VertexAttribute{ 4, AttributeFormat_Float, 0 };
+        const float vertices[3 * 4] = { -1, -1, -1, 1, 1, -1, 1, 1, 1, 1, -1, 1 };
+        const uint16_t indices[3] = { 0, 1, 2 };
+        MJ2_CHECK(cube.Create(layout, vertices, 3, indices, 3, BufferUsage_Static));
+        MJ2_CHECK(props.Create(InstancingMode_Hardware, 0, layout, vertices, 3, indices, 3));
+    }
+
+    void TestPropsFollowTheCube()
+    {
+        RecordingBackend backend(true);
+        MeshBuffer cube(backend);
+        InstancedMesh props(backend);
+        CreateMeshes(cube, props);
+
+        const Matrix4x4 model = Model();
+        RenderQueue queue(backend);
+        DrawItem item{ MakeSortKey(0, 0, kCubeProgram.program, 0, 0), 0, &kCubeProgram, 0, &cube, 0, 0, 3,
+                       &model.m[0][0] };
+        queue.Submit(item);
+        std::vector<float> matrices(kPropCount * 16);
+        propRingMatrices(model, kPropCount, matrices.data());
+
+        backend.ClearLog();
+        queue.Flush();
+        props.Draw(kPropProgram, 0, matrices.data(), kPropCount);
+        MJ2_CHECK(backend.Draws().size() == 2 && backend.Errors().empty());
+        const RecordingBackend::AttributePointer* column0 = backend.Pointer((uint32_t)kPropProgram.instanceMatrixLocation);
+        MJ2_CHECK(column0 != nullptr);
+        if (backend.Draws().size() != 2 || !column0) {
+            return;
+        }
+        const std::vector<float>& cubeMatrix = backend.Draws()[0].uniforms.at(kCubeProgram.transformLocation);
+        const std::vector<uint8_t>& stream = backend.BufferContents(column0->buffer).data;
+        MJ2_CHECK(stream.size() == kPropCount * 16 * sizeof(float));
+        if (stream.size() != kPropCount * 16 * sizeof(float)) {
+            return;
+        }
+
+        const float corners[][4] = { { 0, 0, 0, 1 }, { 1, 1, 1, 1 }, { -1, 1, -1, 1 }, { 1, -1, 0.5f, 1 } };
+        float worst = 0.0f;
+        for (uint32_t i = 0; i < kPropCount; i++) {
+            float instance[16];
+            memcpy(instance, stream.data() + i * sizeof(instance), sizeof(instance));
+            const float angle = 6.2831853f * i / kPropCount;
+            for (const float* corner : corners) {
+                // the same point in the cube's object space: scaled, then moved onto the ring
+                const float inCube[4] = { kScale * corner[0] + kRadius * cosf(angle),
+                                          kScale * corner[1] + kRadius * sinf(angle), kScale * corner[2], 1.0f };
+                float prop[4];
+                float expected[4];
+                ShaderTransform(instance, corner, prop);
+                ShaderTransform(cubeMatrix.data(), inCube, expected);
+                for (uint32_t k = 0; k < 4; k++) {
+                    worst = std::max(worst, std::fabs(prop[k] - expected[k]));
+                }
+            }
+        }
+        MJ2_CHECK(worst < 1e-5f);
+    }
+
+} // namespace
+
+int main()
+{
+    TestPropsFollowTheCube();
+    return CheckResult("PropRingTest");
+}
@@ -0,0 +1,368 @@
+#pragma once
+
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "../RenderBackend.hpp"
+
+namespace mj2 {
+namespace test {
+
+    //-------------------------------------------------------------
+    // RecordingBackend
+    //-------------------------------------------------------------
+    /////
+    // Stands in for GL in the host tests. Every call is appended to Log() as one line,
+    // with a hash of whatever it points at, so two runs can be compared call for call.
+    // Next to that it keeps the state the calls would leave in a GLES 2 context: buffer
+    // contents, bindings, attribute pointers and divisors, and uniform values per program.
+    // Element i of a uniform array sits at location + i, which is what drivers do for
+    // arrays of vectors and matrices.
+    //
+    // Draws are recorded with a copy of the program's uniforms at the time, and calls
+    // GL would reject (out of range buffer writes and draws, unknown names) go to Errors().
+    /////
+    class RecordingBackend : public RenderBackend {
+    public:
+        struct Buffer {
+        public:
+            std::vector<uint8_t> data;
+            BufferUsage usage;
+        };
+
+        struct AttributePointer {
+        public:
+            uint32_t buffer;
+            uint32_t components;
+            AttributeFormat format;
+            uint32_t stride;
+            size_t offset;
+        };
+
+        /// values by location, Uniform1i stored as one float
+        typedef std::map<int32_t, std::vector<float> > Uniforms;
+
+        struct Draw {
+        public:
+            PrimitiveType primitive;
+            uint32_t first;          // DrawArrays, 0 otherwise
+            uint32_t count;
+            size_t offset;           // bytes into the index buffer
+            uint32_t instanceCount;  // 1 unless instanced
+            uint32_t program;
+            uint32_t texture;        // on unit 0
+            Uniforms uniforms;       // of program
+            std::map<uint32_t, uint32_t> divisors;  // enabled attributes only
+        };
+
+        explicit RecordingBackend(bool supportsInstancing = false)
+                : supportsInstancing(supportsInstancing)
+                , failCreate(false)
+                , nextBuffer(1)
+                , program(0)
+                , activeUnit(0)
+                , framebuffer(0)
+        {
+            bound[BufferTarget_Vertex] = 0;
+            bound[BufferTarget_Index] = 0;
+        }
+
+        const std::string& Log() const { return log; }
+        const std::vector<std::string>& Errors() const { return errors; }
+        const std::vector<Draw>& Draws() const { return draws; }
+        /// Forget the calls and draws so far, keeping the state
+        void ClearLog()
+        {
+            log.clear();
+            errors.clear();
+            draws.clear();
+        }
+
+        /// CreateBuffer returns 0 while set, a lost context or out of memory
+        void SetFailCreate(bool fail) { failCreate = fail; }
+
+        bool IsBuffer(uint32_t buffer) const { return buffers.count(buffer) != 0; }
+        const Buffer& BufferContents(uint32_t buffer) const { return buffers.at(buffer); }
+        const std::vector<uint32_t>& DeletedBuffers() const { return deleted; }
+        uint32_t Bound(BufferTarget target) const { return bound[target]; }
+        bool IsEnabled(uint32_t location) const { return enabled.count(location) != 0; }
+        uint32_t Divisor(uint32_t location) const
+        {
+            auto found = divisors.find(location);
+            return found == divisors.end() ? 0 : found->second;
+        }
+        const AttributePointer* Pointer(uint32_t location) const
+        {
+            auto found = pointers.find(location);
+            return found == pointers.end() ? nullptr : &found->second;
+        }
+        const Uniforms& ProgramUniforms(uint32_t program) { return uniforms[program]; }
+
+        uint32_t CreateBuffer() override
+        {
+            if (failCreate) {
+                Record("CreateBuffer -> 0");
+                return 0;
+            }
+            const uint32_t buffer = nextBuffer++;
+            buffers[buffer] = Buffer{ std::vector<uint8_t>(), BufferUsage_Static };
+            Record("CreateBuffer -> %u", buffer);
+            return buffer;
+        }
+
+        void DeleteBuffer(uint32_t buffer) override
+        {
+            Record("DeleteBuffer %u", buffer);
+            if (buffers.erase(buffer) == 0) {
+                Error("DeleteBuffer of unknown buffer %u", buffer);
+                return;
+            }
+            deleted.push_back(buffer);
+            for (uint32_t& name : bound) {
+                name = name == buffer ? 0 : name;
+            }
+        }
+
+        void BindBuffer(BufferTarget target, uint32_t buffer) override
+        {
+            Record("BindBuffer %d %u", target, buffer);
+            if (buffer != 0 && !IsBuffer(buffer)) {
+                Error("BindBuffer of unknown buffer %u", buffer);
+            }
+            bound[target] = buffer;
+        }
+
+        void BufferData(BufferTarget target, size_t size, const void* data, BufferUsage usage) override
+        {
+            Record("BufferData %d %zu %08x %d", target, size, Hash(data, size), usage);
+            Buffer* buffer = BoundBuffer(target, "BufferData");
+            if (buffer) {
+                buffer->data.assign(size, 0);
+                if (data) {
+                    memcpy(buffer->data.data(), data, size);
+                }
+                buffer->usage = usage;
+            }
+        }
+
+        void BufferSubData(BufferTarget target, size_t offset, size_t size, const void* data) override
+        {
+            Record("BufferSubData %d %zu %zu %08x", target, offset, size, Hash(data, size));
+            Buffer* buffer = BoundBuffer(target, "BufferSubData");
+            if (!buffer) {
+                return;
+            }
+            if (offset > buffer->data.size() || size > buffer->data.size() - offset) {
+                Error("BufferSubData of %zu bytes at %zu past the end of %zu", size, offset, buffer->data.size());
+                return;
+            }
+            memcpy(buffer->data.data() + offset, data, size);
+        }
+
+        void VertexAttribPointer(uint32_t location, uint32_t components, AttributeFormat format, uint32_t stride,
+                                 size_t offset) override
+        {
+            Record("VertexAttribPointer %u %u %d %u %zu", location, components, format, stride, offset);
+            pointers[location] = AttributePointer{ bound[BufferTarget_Vertex], components, format, stride, offset };
+        }
+
+        void EnableVertexAttribArray(uint32_t location) override
+        {
+            Record("EnableVertexAttribArray %u", location);
+            enabled.insert(location);
+        }
+
+        void DisableVertexAttribArray(uint32_t location) override
+        {
+            Record("DisableVertexAttribArray %u", location);
+            enabled.erase(location);
+        }
+
+        void UseProgram(uint32_t program) override
+        {
+            Record("UseProgram %u", program);
+            this->program = program;
+        }
+
+        void Uniform1i(int32_t location, int32_t value) override
+        {
+            Record("Uniform1i %d %d", location, value);
+            SetUniform(location, 1, 1, nullptr, (float)value);
+        }
+
+        void Uniform4fv(int32_t location, uint32_t count, const float* values) override
+        {
+            Record("Uniform4fv %d %u %08x", location, count, Hash(values, (size_t)count * 4 * sizeof(float)));
+            SetUniform(location, count, 4, values, 0.0f);
+        }
+
+        void UniformMatrix4fv(int32_t location, uint32_t count, const float* values) override
+        {
+            Record("UniformMatrix4fv %d %u %08x", location, count, Hash(values, (size_t)count * 16 * sizeof(float)));
+            SetUniform(location, count, 16, values, 0.0f);
+        }
+
+        void ActiveTexture(uint32_t unit) override
+        {
+            Record("ActiveTexture %u", unit);
+            activeUnit = unit;
+        }
+
+        void BindTexture(uint32_t texture) override
+        {
+            Record("BindTexture %u", texture);
+            textures[activeUnit] = texture;
+        }
+
+        void BindFramebuffer(uint32_t framebuffer) override
+        {
+            Record("BindFramebuffer %u", framebuffer);
+            this->framebuffer = framebuffer;
+        }
+
+        void FramebufferColorTexture(uint32_t texture) override { Record("FramebufferColorTexture %u", texture); }
+
+        void FramebufferDepthRenderbuffer(uint32_t renderbuffer) override
+        {
+            Record("FramebufferDepthRenderbuffer %u", renderbuffer);
+        }
+
+        void DrawArrays(PrimitiveType primitive, uint32_t first, uint32_t count) override
+        {
+            Record("DrawArrays %d %u %u", primitive, first, count);
+            AddDraw(primitive, first, count, 0, 1);
+        }
+
+        void DrawElements(PrimitiveType primitive, uint32_t count, size_t offset) override
+        {
+            Record("DrawElements %d %u %zu", primitive, count, offset);
+            CheckIndices(count, offset);
+            AddDraw(primitive, 0, count, offset, 1);
+        }
+
+        bool SupportsInstancing() override { return supportsInstancing; }
+
+        void VertexAttribDivisor(uint32_t location, uint32_t divisor) override
+        {
+            Record("VertexAttribDivisor %u %u", location, divisor);
+            if (!supportsInstancing) {
+                Error("VertexAttribDivisor without instancing");
+            }
+            divisors[location] = divisor;
+        }
+
+        void DrawElementsInstanced(PrimitiveType primitive, uint32_t count, size_t offset,
+                                   uint32_t instanceCount) override
+        {
+            Record("DrawElementsInstanced %d %u %zu %u", primitive, count, offset, instanceCount);
+            if (!supportsInstancing) {
+                Error("DrawElementsInstanced without instancing");
+            }
+            CheckIndices(count, offset);
+            AddDraw(primitive, 0, count, offset, instanceCount);
+        }
+
+    private:
+        static uint32_t Hash(const void* data, size_t size)
+        {
+            // FNV-1a, nullptr hashes like no bytes
+            uint32_t hash = 2166136261u;
+            const uint8_t* bytes = (const uint8_t*)data;
+            for (size_t i = 0; data && i < size; i++) {
+                hash = (hash ^ bytes[i]) * 16777619u;
+            }
+            return hash;
+        }
+
+        void Record(const char* format, ...)
+        {
+            char line[256];
+            va_list arguments;
+            va_start(arguments, format);
+            vsnprintf(line, sizeof(line), format, arguments);
+            va_end(arguments);
+            log += line;
+            log += '\n';
+        }
+
+        void Error(const char* format, ...)
+        {
+            char line[256];
+            va_list arguments;
+            va_start(arguments, format);
+            vsnprintf(line, sizeof(line), format, arguments);
+            va_end(arguments);
+            errors.push_back(line);
+        }
+
+        Buffer* BoundBuffer(BufferTarget target, const char* call)
+        {
+            auto found = buffers.find(bound[target]);
+            if (found == buffers.end()) {
+                Error("%s with no buffer bound to %d", call, target);
+                return nullptr;
+            }
+            return &found->second;
+        }
+
+        void SetUniform(int32_t location, uint32_t count, uint32_t floats, const float* values, float value)
+        {
+            if (location < 0) {
+                return;
+            }
+            if (program == 0) {
+                Error("uniform %d set without a program", location);
+                return;
+            }
+            for (uint32_t i = 0; i < count; i++) {
+                uniforms[program][location + (int32_t)i] =
+                    values ? std::vector<float>(values + i * floats, values + (i + 1) * floats)
+                           : std::vector<float>(1, value);
+            }
+        }
+
+        void CheckIndices(uint32_t count, size_t offset)
+        {
+            Buffer* buffer = BoundBuffer(BufferTarget_Index, "draw");
+            if (buffer && (offset > buffer->data.size() || (size_t)count * 2 > buffer->data.size() - offset)) {
+                Error("draw of %u indices at %zu past the end of %zu", count, offset, buffer->data.size());
+            }
+        }
+
+        void AddDraw(PrimitiveType primitive, uint32_t first, uint32_t count, size_t offset, uint32_t instanceCount)
+        {
+            Draw draw{ primitive, first, count, offset, instanceCount, program, textures[0], uniforms[program], {} };
+            for (uint32_t location : enabled) {
+                draw.divisors[location] = Divisor(location);
+            }
+            draws.push_back(draw);
+        }
+
+        bool supportsInstancing;
+        bool failCreate;
+        std::string log;
+        std::vector<std::string> errors;
+        std::vector<Draw> draws;
+
+        std::map<uint32_t, Buffer> buffers;
+        std::vector<uint32_t> deleted;
+        uint32_t nextBuffer;
+        uint32_t bound[2];
+        std::map<uint32_t, AttributePointer> pointers;
+        std::set<uint32_t> enabled;
+        std::map<uint32_t, uint32_t> divisors;
+        uint32_t program;
+        std::map<uint32_t, Uniforms> uniforms;
+        uint32_t activeUnit;
+        std::map<uint32_t, uint32_t> textures;
+        uint32_t framebuffer;
+    };
+
+} // namespace test
+} // namespace mj2
@@ -0,0 +1,268 @@
+/////
+// RenderQueue against RecordingBackend: the order items are drawn in, which of them
+// merge, the transform each draw sees, the items Submit turns away, and depth
+// quantization at the edges.
+/////
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "../RenderQueue.hpp"
+#include "../../math/tests/Check.hpp"
+#include "RecordingBackend.hpp"
+
+using namespace mj2;
+using namespace mj2::test;
+
+namespace {
+
+    const RenderProgram kProgram = { 1, 4, -1, { 0, -1, -1, -1, -1, -1, -1, -1 } };
+    const RenderProgram kOtherProgram = { 2, 4, -1, { 0, -1, -1, -1, -1, -1, -1, -1 } };
+
+    const uint32_t kIndexCount = 3 * 1000;
+
+    const float kIdentity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+
+    /// a mesh big enough for every range the tests draw
+    void CreateMesh(MeshBuffer& mesh)
+    {
+        VertexLayout layout{};
+        layout.stride = sizeof(float);
+        layout.attributeCount = 1;
+        layout.attributes[0] = VertexAttribute{ 1, AttributeFormat_Float, 0 };
+        std::vector<float> vertices(3, 0.0f);
+        std::vector<uint16_t> indices(kIndexCount);
+        for (uint32_t i = 0; i < kIndexCount; i++) {
+            indices[i] = (uint16_t)(i % 3);
+        }
+        MJ2_CHECK(mesh.Create(layout, vertices.data(), 3, indices.data(), kIndexCount, BufferUsage_Static));
+    }
+
+    DrawItem Item(uint64_t key, const MeshBuffer& mesh, uint32_t firstIndex, uint32_t indexCount,
+                  const float* transform = nullptr, const RenderProgram* program = &kProgram)
+    {
+        return DrawItem{ key, 0, program, 0, &mesh, 0, firstIndex, indexCount, transform };
+    }
+
+    /// first index of every draw, in draw order
+    std::vector<uint32_t> DrawnRanges(const RecordingBackend& backend)
+    {
+        std::vector<uint32_t> firsts;
+        for (const RecordingBackend::Draw& draw : backend.Draws()) {
+            firsts.push_back((uint32_t)(draw.offset / sizeof(uint16_t)));
+        }
+        return firsts;
+    }
+
+    /// xorshift, fixed seed
+    uint32_t gRandomState = 777;
+
+    uint32_t Random()
+    {
+        gRandomState ^= gRandomState << 13;
+        gRandomState ^= gRandomState >> 17;
+        gRandomState ^= gRandomState << 5;
+        return gRandomState;
+    }
+
+    void TestSortStable()
+    {
+        RecordingBackend backend;
+        MeshBuffer mesh(backend);
+        CreateMesh(mesh);
+        RenderQueue queue(backend);
+
+        // 400 items over 5 keys that differ in several bytes, every range 6 indices
+        // apart so nothing merges; equal keys have to keep submission order
+        const uint64_t keys[] = {
+            MakeSortKey(1, 0, 3, 9, 100), MakeSortKey(0, 2, 3, 9, 100), MakeSortKey(0, 0, 3, 9, 0xFFFFFF),
+            MakeSortKey(0, 0, 3, 9, 100), MakeSortKey(15, 255, 4095, 65535, 0)
+        };
+        std::vector<uint64_t> submitted;
+        for (uint32_t i = 0; i < 400; i++) {
+            submitted.push_back(keys[Random() % 5]);
+            queue.Submit(Item(submitted.back(), mesh, i * 6, 3));
+        }
+        backend.ClearLog();
+        queue.Flush();
+        MJ2_CHECK(queue.Stats().submitted == 400 && queue.Stats().draws == 400);
+        MJ2_CHECK(queue.Size() == 0);
+
+        const std::vector<uint32_t> firsts = DrawnRanges(backend);
+        MJ2_CHECK(firsts.size() == 400);
+        for (size_t i = 1; i < firsts.size(); i++) {
+            const uint32_t previous = firsts[i - 1] / 6;
+            const uint32_t current = firsts[i] / 6;
+            MJ2_CHECK(submitted[previous] < submitted[current] ||
+                      (submitted[previous] == submitted[current] && previous < current));
+        }
+        MJ2_CHECK(backend.Errors().empty());
+    }
+
+    void TestSkippedPasses()
+    {
+        RecordingBackend backend;
+        MeshBuffer mesh(backend);
+        CreateMesh(mesh);
+        RenderQueue queue(backend);
+
+        // one key for all: every pass skipped, submission order
+        for (uint32_t i = 0; i < 10; i++) {
+            queue.Submit(Item(MakeSortKey(2, 1, 3, 4, 5), mesh, (9 - i) * 6, 3));
+        }
+        backend.ClearLog();
+        queue.Flush();
+        MJ2_CHECK(queue.Stats().sortPasses == 0);
+        MJ2_CHECK(DrawnRanges(backend) == std::vector<uint32_t>({ 54, 48, 42, 36, 30, 24, 18, 12, 6, 0 }));
+
+        // keys differing only in the lowest depth byte and the layer: two passes, and an
+        // even number of swaps leaves the result in the right buffer
+        const uint32_t depths[] = { 7, 3, 200, 3, 0 };
+        const uint32_t layers[] = { 1, 0, 0, 1, 0 };
+        for (uint32_t i = 0; i < 5; i++) {
+            queue.Submit(Item(MakeSortKey(layers[i], 0, 3, 4, depths[i]), mesh, i * 6, 3));
+        }
+        backend.ClearLog();
+        queue.Flush();
+        MJ2_CHECK(queue.Stats().sortPasses == 2);
+        MJ2_CHECK(DrawnRanges(backend) == std::vector<uint32_t>({ 24, 6, 12, 18, 0 }));
+
+        // one byte that differs: a single pass, an odd number of swaps
+        for (uint32_t i = 0; i < 5; i++) {
+            queue.Submit(Item(MakeSortKey(0, 0, 3, 4, depths[i] << 16), mesh, i * 6, 3));
+        }
+        backend.ClearLog();
+        queue.Flush();
+        MJ2_CHECK(queue.Stats().sortPasses == 1);
+        MJ2_CHECK(DrawnRanges(backend) == std::vector<uint32_t>({ 24, 6, 18, 0, 12 }));
+        MJ2_CHECK(backend.Errors().empty());
+    }
+
+    void TestMerge()
+    {
+        RecordingBackend backend;
+        MeshBuffer mesh(backend);
+        CreateMesh(mesh);
+        RenderQueue queue(backend);
+        const uint64_t key = MakeSortKey(0, 0, 1, 0, 0);
+
+        // [0, 6) and [6, 12) follow each other, [15, 18) does not
+        queue.Submit(Item(key, mesh, 0, 6));
+        queue.Submit(Item(key, mesh, 6, 6));
+        queue.Submit(Item(key, mesh, 15, 3));
+        backend.ClearLog();
+        queue.Flush();
+        MJ2_CHECK(queue.Stats().draws == 2);
+        MJ2_CHECK(backend.Draws().size() == 2 && backend.Draws()[0].count == 12 && backend.Draws()[1].count == 3);
+
+        // contiguous in the buffer but drawn in the other order: no merge
+        queue.Submit(Item(key, mesh, 6, 6));
+        queue.Submit(Item(key, mesh, 0, 6));
+        queue.Flush();
+        MJ2_CHECK(queue.Stats().draws == 2);
+
+        // transforms compare by value, a different program or texture breaks the run
+        float a[16];
+        float sameAsA[16];
+        float b[16];
+        for (uint32_t i = 0; i < 16; i++) {
+            a[i] = sameAsA[i] = (float)i;
+            b[i] = (float)i + 0.5f;
+        }
+        queue.Submit(Item(key, mesh, 0, 3, a));
+        queue.Submit(Item(key, mesh, 3, 3, sameAsA));
+        queue.Submit(Item(key, mesh, 6, 3, b));
+        queue.Submit(Item(key, mesh, 9, 3, b, &kOtherProgram));
+        DrawItem textured = Item(key, mesh, 12, 3, b, &kOtherProgram);
+        textured.texture = 5;
+        queue.Submit(textured);
+        backend.ClearLog();
+        queue.Flush();
+        MJ2_CHECK(queue.Stats().draws == 4);
+        MJ2_CHECK(DrawnRanges(backend) == std::vector<uint32_t>({ 0, 6, 9, 12 }));
+        MJ2_CHECK(backend.Errors().empty());
+    }
+
+    void TestNullTransform()
+    {
+        RecordingBackend backend;
+        MeshBuffer mesh(backend);
+        CreateMesh(mesh);
+        RenderQueue queue(backend);
+
+        float placed[16];
+        for (uint32_t i = 0; i < 16; i++) {
+            placed[i] = (float)(i + 2);
+        }
+        queue.Submit(Item(MakeSortKey(0, 0, 1, 0, 0), mesh, 0, 3, placed));
+        queue.Submit(Item(MakeSortKey(0, 0, 1, 0, 1), mesh, 6, 3));
+        backend.ClearLog();
+        queue.Flush();
+        MJ2_CHECK(backend.Draws().size() == 2);
+        if (backend.Draws().size() == 2) {
+            MJ2_CHECK(backend.Draws()[0].uniforms.at(4) == std::vector<float>(placed, placed + 16));
+            MJ2_CHECK(backend.Draws()[1].uniforms.at(4) == std::vector<float>(kIdentity, kIdentity + 16));
+        }
+    }
+
+    void TestRejected()
+    {
+        RecordingBackend backend;
+        MeshBuffer mesh(backend);
+        CreateMesh(mesh);
+        MeshBuffer empty(backend);
+        RenderQueue queue(backend);
+        const uint64_t key = MakeSortKey(0, 0, 1, 0, 0);
+
+        // a part the mesh does not have
+        DrawItem part = Item(key, mesh, 0, 3);
+        part.part = 1;
+        queue.Submit(part);
+        // a mesh that was never created
+        queue.Submit(Item(key, empty, 0, 3));
+        // ranges past the end of the part, including one that wraps around
+        queue.Submit(Item(key, mesh, kIndexCount - 3, 6));
+        queue.Submit(Item(key, mesh, 0, kIndexCount + 3));
+        queue.Submit(Item(key, mesh, 0xFFFFFFFF, 3));
+        MJ2_CHECK(queue.Size() == 0);
+
+        // the last triangle still fits
+        queue.Submit(Item(key, mesh, kIndexCount - 3, 3));
+        MJ2_CHECK(queue.Size() == 1);
+        backend.ClearLog();
+        queue.Flush();
+        MJ2_CHECK(DrawnRanges(backend) == std::vector<uint32_t>{ kIndexCount - 3 });
+        MJ2_CHECK(backend.Errors().empty());
+    }
+
+    void TestQuantizeDepth()
+    {
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        const float infinity = std::numeric_limits<float>::infinity();
+        MJ2_CHECK(QuantizeDepth(1.0f, 1.0f, 101.0f, false) == 0);
+        MJ2_CHECK(QuantizeDepth(101.0f, 1.0f, 101.0f, false) == 0xFFFFFF);
+        MJ2_CHECK(QuantizeDepth(51.0f, 1.0f, 101.0f, false) == 0x800000);
+        MJ2_CHECK(QuantizeDepth(51.0f, 1.0f, 101.0f, true) == 0x7FFFFF);
+        MJ2_CHECK(QuantizeDepth(-5.0f, 1.0f, 101.0f, false) == 0);
+        MJ2_CHECK(QuantizeDepth(1e30f, 1.0f, 101.0f, false) == 0xFFFFFF);
+        MJ2_CHECK(QuantizeDepth(infinity, 1.0f, 101.0f, false) == 0xFFFFFF);
+        MJ2_CHECK(QuantizeDepth(-infinity, 1.0f, 101.0f, true) == 0xFFFFFF);
+        MJ2_CHECK(QuantizeDepth(nan, 1.0f, 101.0f, false) == 0);
+        MJ2_CHECK(QuantizeDepth(nan, 1.0f, 101.0f, true) == 0xFFFFFF);
+        MJ2_CHECK(QuantizeDepth(5.0f, nan, 101.0f, false) == 0);
+        MJ2_CHECK(QuantizeDepth(5.0f, 10.0f, 10.0f, false) == 0);
+    }
+
+} // namespace
+
+int main()
+{
+    TestSortStable();
+    TestSkippedPasses();
+    TestMerge();
+    TestNullTransform();
+    TestRejected();
+    TestQuantizeDepth();
+    return CheckResult("RenderQueueTest");
+}
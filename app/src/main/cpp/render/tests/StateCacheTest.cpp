@@ -0,0 +1,158 @@
+/////
+// StateCache in front of RecordingBackend: redundant calls stop at the cache, and
+// whatever goes through leaves the state a direct run would, draw for draw.
+/////
+
+#include <cstdint>
+#include <vector>
+
+#include "../StateCache.hpp"
+#include "../../math/tests/Check.hpp"
+#include "RecordingBackend.hpp"
+
+using namespace mj2;
+using namespace mj2::test;
+
+namespace {
+
+    std::vector<float> Filled(uint32_t count, float first)
+    {
+        std::vector<float> values(count);
+        for (uint32_t i = 0; i < count; i++) {
+            values[i] = first + (float)i;
+        }
+        return values;
+    }
+
+    void TestElision()
+    {
+        RecordingBackend backend;
+        StateCache cache(backend);
+        cache.UseProgram(3);
+        cache.UseProgram(3);
+        cache.BindBuffer(BufferTarget_Vertex, 0);
+        cache.BindBuffer(BufferTarget_Vertex, 0);
+        cache.EnableVertexAttribArray(2);
+        cache.EnableVertexAttribArray(2);
+        cache.Uniform1i(1, 7);
+        cache.Uniform1i(1, 7);
+        MJ2_CHECK(cache.Stats().issued == 4 && cache.Stats().elided == 4);
+
+        // after Invalidate everything goes through once more
+        cache.Invalidate();
+        cache.UseProgram(3);
+        cache.Uniform1i(1, 7);
+        MJ2_CHECK(cache.Stats().issued == 6 && cache.Stats().elided == 4);
+        MJ2_CHECK(backend.Errors().empty());
+    }
+
+    void TestUniformArrays()
+    {
+        RecordingBackend backend;
+        StateCache cache(backend);
+        const std::vector<float> a = Filled(16, 100.0f);
+        const std::vector<float> bc = Filled(32, 200.0f);
+        cache.UseProgram(1);
+
+        // a single matrix, an array over it, the single one again: the last has to reach
+        // the backend, the array replaced what was at the location
+        cache.UniformMatrix4fv(5, 1, a.data());
+        cache.UniformMatrix4fv(5, 2, bc.data());
+        cache.UniformMatrix4fv(5, 1, a.data());
+        MJ2_CHECK(backend.ProgramUniforms(1).at(5) == a);
+        MJ2_CHECK(backend.ProgramUniforms(1).at(6) == std::vector<float>(bc.begin() + 16, bc.end()));
+
+        // the array's first element is known: writing it again alone is elided
+        cache.UniformMatrix4fv(5, 2, bc.data());
+        const uint64_t elided = cache.Stats().elided;
+        cache.UniformMatrix4fv(5, 1, bc.data());
+        MJ2_CHECK(cache.Stats().elided == elided + 1);
+
+        // an element after the first, cached from a single write, is forgotten too
+        const std::vector<float> x = Filled(4, 1.0f);
+        const std::vector<float> yz = Filled(8, 10.0f);
+        cache.Uniform4fv(9, 1, x.data());
+        cache.Uniform4fv(8, 2, yz.data());
+        cache.Uniform4fv(9, 1, x.data());
+        MJ2_CHECK(backend.ProgramUniforms(1).at(9) == x);
+
+        // and another program's value at the same location is left alone
+        cache.UseProgram(2);
+        cache.UniformMatrix4fv(5, 1, a.data());
+        cache.UseProgram(1);
+        cache.UniformMatrix4fv(5, 3, Filled(48, 0.0f).data());
+        cache.UseProgram(2);
+        const uint64_t issued = cache.Stats().issued;
+        cache.UniformMatrix4fv(5, 1, a.data());
+        MJ2_CHECK(cache.Stats().issued == issued);
+        MJ2_CHECK(backend.Errors().empty());
+    }
+
+    /// xorshift, fixed seed
+    uint32_t gRandomState = 12345;
+
+    uint32_t Random(uint32_t range)
+    {
+        gRandomState ^= gRandomState << 13;
+        gRandomState ^= gRandomState >> 17;
+        gRandomState ^= gRandomState << 5;
+        return gRandomState % range;
+    }
+
+    /// The same random calls into the cache and straight into a second backend, over few
+    /// enough values that most of them repeat; every draw has to see the same state
+    void TestAgainstDirect(bool instancing)
+    {
+        RecordingBackend cached(instancing);
+        RecordingBackend direct(instancing);
+        StateCache cache(cached);
+        RenderBackend* targets[] = { &cache, &direct };
+        std::vector<float> values(64);
+
+        for (uint32_t step = 0; step < 20000; step++) {
+            const uint32_t call = Random(instancing ? 10 : 9);
+            const uint32_t a = Random(4);
+            const uint32_t b = Random(3);
+            const uint32_t count = 1 + Random(3);
+            for (float& value : values) {
+                value = (float)Random(2);
+            }
+            for (RenderBackend* target : targets) {
+                switch (call) {
+                    case 0: target->UseProgram(1 + a); break;
+                    case 1: target->Uniform1i((int32_t)a, (int32_t)b); break;
+                    case 2: target->Uniform4fv((int32_t)a, count, values.data()); break;
+                    case 3: target->UniformMatrix4fv((int32_t)a, count, values.data()); break;
+                    case 4: target->EnableVertexAttribArray(a); break;
+                    case 5: target->DisableVertexAttribArray(a); break;
+                    case 6: target->ActiveTexture(b); target->BindTexture(a); break;
+                    case 7: target->VertexAttribPointer(a, 1 + b, AttributeFormat_Float, 16, b * 4); break;
+                    case 8: target->DrawArrays(PrimitiveType_Triangles, 0, 3); break;
+                    case 9: target->VertexAttribDivisor(a, b & 1); break;
+                }
+            }
+        }
+
+        MJ2_CHECK(cached.Draws().size() == direct.Draws().size());
+        uint32_t mismatches = 0;
+        for (size_t i = 0; i < cached.Draws().size() && i < direct.Draws().size(); i++) {
+            const RecordingBackend::Draw& left = cached.Draws()[i];
+            const RecordingBackend::Draw& right = direct.Draws()[i];
+            mismatches += left.program != right.program || left.texture != right.texture ||
+                          left.uniforms != right.uniforms || left.divisors != right.divisors ? 1 : 0;
+        }
+        MJ2_CHECK(mismatches == 0);
+        MJ2_CHECK(cache.Stats().elided > 0);
+        MJ2_CHECK(cached.Errors() == direct.Errors());
+    }
+
+} // namespace
+
+int main()
+{
+    TestElision();
+    TestUniformArrays();
+    TestAgainstDirect(false);
+    TestAgainstDirect(true);
+    return CheckResult("StateCacheTest");
+}